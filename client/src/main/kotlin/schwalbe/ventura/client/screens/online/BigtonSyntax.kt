@@ -39,8 +39,8 @@ private val Char.isAsciiNumeric: Boolean
     get() = this in '0'..'9'
 
 private val BIGTON_KEYWORDS: Set<String> = setOf(
-    "var", "fun", "loop", "while", "tick", "continue", "break", "return",
-    "and", "or", "not", "if", "else"
+    "var", "fun", "loop", "while", "for", "tick", "continue", "break",
+    "return", "and", "or", "not", "if", "else"
 )
 
 private val BIGTON_CONSTANTS: Set<String> = setOf(
@@ -15,12 +15,14 @@ tasks.withType<CCompile>().configureEach {
     mustRunAfter("generateKotlinMainJniHeaders")
     compilerArgs.addAll(listOf(
         "-O3",
-        "-flto"
+        "-flto",
+        "-pthread"
     ))
 }
 
 tasks.withType<AbstractLinkTask>().configureEach {
     linkerArgs.addAll(listOf(
-        "-flto"
+        "-flto",
+        "-pthread"
     ))
 }
\ No newline at end of file
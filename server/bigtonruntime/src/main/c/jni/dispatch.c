@@ -0,0 +1,162 @@
+
+#include "generated/kotlin/main/schwalbe_ventura_bigton_runtime_BigtonDispatchN.h"
+#include <bigton/runtime.h>
+#include <bigton/dispatch.h>
+#include "helpers.h"
+
+#define DISPATCH_CHUNK_SIZE 64
+
+// Returns whether the given number of elements of the given size fit into the
+// direct buffer.
+static bool buffFits(JNIEnv *env, jobject buff, jlong count, size_t size) {
+    jlong capacity = (*env)->GetDirectBufferCapacity(env, buff);
+    return count >= 0 && capacity >= 0 && count <= capacity / (jlong) size;
+}
+
+
+// external fun groupAwaitingBuiltins(
+//     resultsBuf: ByteBuffer,
+//     count: Int,
+//     orderBuf: ByteBuffer,
+//     groupsBuf: ByteBuffer
+// ): Int
+JNIEXPORT jint JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonDispatchN_groupAwaitingBuiltins
+PARAMS(
+    jobject resultsBuff,
+    jint count,
+    jobject orderBuff,
+    jobject groupsBuff
+) {
+    bool valid = buffFits(
+            env, resultsBuff, count, sizeof(bigton_exec_result_t)
+        )
+        && buffFits(env, orderBuff, count, sizeof(uint32_t))
+        && buffFits(env, groupsBuff, count, sizeof(bigton_builtin_group_t));
+    if (!valid) { return 0; }
+    const bigton_exec_result_t *results
+        = (*env)->GetDirectBufferAddress(env, resultsBuff);
+    uint32_t *order = (*env)->GetDirectBufferAddress(env, orderBuff);
+    bigton_builtin_group_t *groups
+        = (*env)->GetDirectBufferAddress(env, groupsBuff);
+    return (jint) bigtonGroupAwaitingBuiltins(
+        results, (size_t) count, order, groups
+    );
+}
+
+// Returns whether the given group and argument count are in bounds of the
+// given buffers, which hold 'perRuntime' elements for each runtime.
+static bool isValidGroup(
+    JNIEnv *env, jobject orderBuff, jint groupStart, jint groupCount,
+    jint argc, jobject typesBuff, jobject valuesBuff, jlong perRuntime
+) {
+    if (groupStart < 0 || groupCount < 0 || argc < 0) { return false; }
+    jlong end = (jlong) groupStart + (jlong) groupCount;
+    jlong count = (jlong) groupCount * perRuntime;
+    return buffFits(env, orderBuff, end, sizeof(uint32_t))
+        && buffFits(env, typesBuff, count, sizeof(uint8_t))
+        && buffFits(env, valuesBuff, count, sizeof(bigton_value_t));
+}
+
+static size_t unpackChunk(
+    const jlong *handles, const uint32_t *order, size_t start, size_t end,
+    bigton_runtime_state_t **chunk
+) {
+    size_t chunkSize = end - start;
+    if (chunkSize > DISPATCH_CHUNK_SIZE) {
+        chunkSize = DISPATCH_CHUNK_SIZE;
+    }
+    for (size_t i = 0; i < chunkSize; i += 1) {
+        UNPACK(handles[order[start + i]], bigton_runtime_state_t, r);
+        chunk[i] = r;
+    }
+    return chunkSize;
+}
+
+// external fun gatherArgs(
+//     runtimeHandlesBuf: ByteBuffer,
+//     orderBuf: ByteBuffer,
+//     groupStart: Int,
+//     groupCount: Int,
+//     argc: Int,
+//     argTypesBuf: ByteBuffer,
+//     argValuesBuf: ByteBuffer
+// )
+JNIEXPORT void JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonDispatchN_gatherArgs
+PARAMS(
+    jobject runtimeHandlesBuff,
+    jobject orderBuff,
+    jint groupStart,
+    jint groupCount,
+    jint argc,
+    jobject argTypesBuff,
+    jobject argValuesBuff
+) {
+    bool valid = isValidGroup(
+        env, orderBuff, groupStart, groupCount, argc,
+        argTypesBuff, argValuesBuff, (jlong) argc
+    );
+    if (!valid) { return; }
+    const jlong *handles
+        = (*env)->GetDirectBufferAddress(env, runtimeHandlesBuff);
+    const uint32_t *order = (*env)->GetDirectBufferAddress(env, orderBuff);
+    uint8_t *argTypes = (*env)->GetDirectBufferAddress(env, argTypesBuff);
+    bigton_value_t *argValues
+        = (*env)->GetDirectBufferAddress(env, argValuesBuff);
+    size_t start = (size_t) groupStart;
+    size_t end = start + (size_t) groupCount;
+    bigton_runtime_state_t *chunk[DISPATCH_CHUNK_SIZE];
+    for (size_t i = start; i < end; ) {
+        size_t chunkSize = unpackChunk(handles, order, i, end, chunk);
+        size_t offset = i - start;
+        bigtonGatherBuiltinArgs(
+            chunk, chunkSize, (uint32_t) argc, (size_t) groupCount,
+            argTypes + offset, argValues + offset
+        );
+        i += chunkSize;
+    }
+}
+
+// external fun scatterResults(
+//     runtimeHandlesBuf: ByteBuffer,
+//     orderBuf: ByteBuffer,
+//     groupStart: Int,
+//     groupCount: Int,
+//     argc: Int,
+//     resultTypesBuf: ByteBuffer,
+//     resultValuesBuf: ByteBuffer
+// )
+JNIEXPORT void JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonDispatchN_scatterResults
+PARAMS(
+    jobject runtimeHandlesBuff,
+    jobject orderBuff,
+    jint groupStart,
+    jint groupCount,
+    jint argc,
+    jobject resultTypesBuff,
+    jobject resultValuesBuff
+) {
+    bool valid = isValidGroup(
+        env, orderBuff, groupStart, groupCount, argc,
+        resultTypesBuff, resultValuesBuff, 1
+    );
+    if (!valid) { return; }
+    const jlong *handles
+        = (*env)->GetDirectBufferAddress(env, runtimeHandlesBuff);
+    const uint32_t *order = (*env)->GetDirectBufferAddress(env, orderBuff);
+    const uint8_t *resultTypes
+        = (*env)->GetDirectBufferAddress(env, resultTypesBuff);
+    const bigton_value_t *resultValues
+        = (*env)->GetDirectBufferAddress(env, resultValuesBuff);
+    size_t start = (size_t) groupStart;
+    size_t end = start + (size_t) groupCount;
+    bigton_runtime_state_t *chunk[DISPATCH_CHUNK_SIZE];
+    for (size_t i = start; i < end; ) {
+        size_t chunkSize = unpackChunk(handles, order, i, end, chunk);
+        size_t offset = i - start;
+        bigtonScatterBuiltinResults(
+            chunk, chunkSize, (uint32_t) argc,
+            resultTypes + offset, resultValues + offset
+        );
+        i += chunkSize;
+    }
+}
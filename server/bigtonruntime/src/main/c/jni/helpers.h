@@ -11,11 +11,26 @@
 
 #define UNPACK(valueHandle, T, value) \
     T *value = (T *) (intptr_t) (valueHandle)
+// Unpacks a runtime that is about to have its buffers accessed, waking it
+// up if it is hibernated (see 'bigtonHibernate').
+#define UNPACK_RUNTIME(runtimeHandle, r) \
+    UNPACK(runtimeHandle, bigton_runtime_state_t, r); \
+    if ((r)->hibernated != NULL) { bigtonWake(r); }
 #define AS_HANDLE(value) \
     (jlong) (intptr_t) (value)
 
 
-#define MALLOC_VALUE(value) \
-    bigton_tagged_value_t *value = malloc(sizeof(bigton_tagged_value_t))
+// Values handed out to the host are host values (see 'bigton_host_value_t')
+// linked to the runtime they belong to (NULL for values that do not
+// reference any buffers). The runtime is needed to resolve objects and
+// arrays shared with forked runtimes (see 'bigtonObjectRead'), and updates
+// the value when it is compacted. The tagged value is the first member,
+// meaning that handles may also be unpacked as 'bigton_tagged_value_t'.
+#define VALUE_RUNTIME(value) \
+    (((bigton_host_value_t *) (value))->r)
+
+#define MALLOC_VALUE(value, runtime) \
+    bigton_tagged_value_t *value = malloc(sizeof(bigton_host_value_t)); \
+    bigtonHostValueAttach((runtime), (bigton_host_value_t *) value)
 
 #endif
\ No newline at end of file
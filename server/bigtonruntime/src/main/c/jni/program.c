@@ -0,0 +1,53 @@
+
+#include "generated/kotlin/main/schwalbe_ventura_bigton_runtime_BigtonProgramN.h"
+#include <bigton/runtime.h>
+#include "helpers.h"
+
+// external fun load(
+//     rawProgramBuf: ByteBuffer,
+//     rawProgramOffset: Int,
+//     rawProgramLength: Int
+// ): Long
+JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonProgramN_load
+PARAMS(
+    jobject rawProgramBuff,
+    jint rawProgramOffset,
+    jint rawProgramLength
+) {
+    const uint8_t *rawProgram
+        = (*env)->GetDirectBufferAddress(env, rawProgramBuff)
+        + (size_t) rawProgramOffset;
+    bigton_program_image_t *image
+        = bigtonImageLoadShared(rawProgram, (size_t) rawProgramLength);
+    return AS_HANDLE(image);
+}
+
+// external fun free(programHandle: Long)
+JNIEXPORT void JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonProgramN_free
+PARAMS(jlong programHandle) {
+    UNPACK(programHandle, bigton_program_image_t, image);
+    bigtonImageRcDecr(image);
+}
+
+// external fun getError(programHandle: Long): Int
+JNIEXPORT jint JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonProgramN_getError
+PARAMS(jlong programHandle) {
+    UNPACK(programHandle, bigton_program_image_t, image);
+    return (jint) image->error;
+}
+
+// external fun getHash(programHandle: Long): Long
+JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonProgramN_getHash
+PARAMS(jlong programHandle) {
+    UNPACK(programHandle, bigton_program_image_t, image);
+    return (jlong) image->hash;
+}
+
+// external fun loadFile(path: String): Long
+JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonProgramN_loadFile
+PARAMS(jstring path) {
+    const char *pathChars = (*env)->GetStringUTFChars(env, path, NULL);
+    bigton_program_image_t *image = bigtonImageLoadFile(pathChars);
+    (*env)->ReleaseStringUTFChars(env, path, pathChars);
+    return AS_HANDLE(image);
+}
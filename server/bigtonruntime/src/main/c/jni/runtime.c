@@ -2,10 +2,75 @@
 #include "generated/kotlin/main/schwalbe_ventura_bigton_runtime_BigtonRuntimeN.h"
 #include <bigton/values.h>
 #include <bigton/runtime.h>
+#include <bigton/snapshot.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include "helpers.h"
 
+// Runtimes freed by the host are reset and kept for reuse by runtimes later
+// created from the same image, which avoids allocating the runtime and
+// growing its stacks again each time a program is restarted. Pooled runtimes
+// keep their image alive, and are evicted oldest first once the pool is full.
+#define MAX_POOLED_RUNTIMES 64
+// Runtimes still using more memory than this after being reset are not kept.
+#define MAX_POOLED_RUNTIME_SIZE (1 << 20)
+
+static pthread_mutex_t runtimePoolLock = PTHREAD_MUTEX_INITIALIZER;
+static size_t pooledRuntimesCount = 0;
+static bigton_runtime_state_t *pooledRuntimes[MAX_POOLED_RUNTIMES];
+
+static bigton_runtime_state_t *acquireRuntime(
+    const bigton_runtime_settings_t *settings, bigton_program_image_t *image
+) {
+    bigton_runtime_state_t *r = NULL;
+    pthread_mutex_lock(&runtimePoolLock);
+    for (size_t i = pooledRuntimesCount; i > 0; i -= 1) {
+        if (pooledRuntimes[i - 1]->image != image) { continue; }
+        r = pooledRuntimes[i - 1];
+        memmove(
+            pooledRuntimes + i - 1, pooledRuntimes + i,
+            sizeof(bigton_runtime_state_t *) * (pooledRuntimesCount - i)
+        );
+        pooledRuntimesCount -= 1;
+        break;
+    }
+    pthread_mutex_unlock(&runtimePoolLock);
+    if (r != NULL) {
+        bigtonResetPrepared(r, settings);
+        return r;
+    }
+    r = malloc(sizeof(bigton_runtime_state_t));
+    bigtonInitPrepared(r, settings, image);
+    return r;
+}
+
+static void releaseRuntime(bigton_runtime_state_t *r) {
+    bigtonReset(r);
+    if (r->image == NULL || r->b.totalSizeBytes > MAX_POOLED_RUNTIME_SIZE) {
+        bigtonFree(r);
+        free(r);
+        return;
+    }
+    bigton_runtime_state_t *evicted = NULL;
+    pthread_mutex_lock(&runtimePoolLock);
+    if (pooledRuntimesCount == MAX_POOLED_RUNTIMES) {
+        evicted = pooledRuntimes[0];
+        pooledRuntimesCount -= 1;
+        memmove(
+            pooledRuntimes, pooledRuntimes + 1,
+            sizeof(bigton_runtime_state_t *) * pooledRuntimesCount
+        );
+    }
+    pooledRuntimes[pooledRuntimesCount] = r;
+    pooledRuntimesCount += 1;
+    pthread_mutex_unlock(&runtimePoolLock);
+    if (evicted != NULL) {
+        bigtonFree(evicted);
+        free(evicted);
+    }
+}
+
 // external fun create(
 //     rawProgramBuf: ByteBuffer,
 //     rawProgramOffset: Int,
@@ -13,7 +78,8 @@
 //     tickInstructionLimit: Long,
 //     memoryUsageLimit: Long,
 //     maxCallDepth: Int,
-//     maxTupleSize: Int
+//     maxTupleSize: Int,
+//     tickFreeBudget: Long
 // ): Long
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_create
 PARAMS(
@@ -23,25 +89,52 @@ PARAMS(
     jlong tickInstructionLimit,
     jlong memoryUsageLimit,
     jint maxCallDepth,
-    jint maxTupleSize
+    jint maxTupleSize,
+    jlong tickFreeBudget
 ) {
-    const uint8_t *rawJProgram
+    const uint8_t *rawProgram
         = (*env)->GetDirectBufferAddress(env, rawProgramBuff)
         + (size_t) rawProgramOffset;
-    const uint8_t *rawProgram = malloc((size_t) rawProgramLength);
-    memcpy(rawProgram, rawJProgram, (size_t) rawProgramLength);
     bigton_runtime_settings_t settings = (bigton_runtime_settings_t) {
         .tickInstructionLimit = tickInstructionLimit,
         .memoryUsageLimit = memoryUsageLimit,
         .maxCallDepth = maxCallDepth,
-        .maxTupleSize = maxTupleSize
+        .maxTupleSize = maxTupleSize,
+        .tickFreeBudget = tickFreeBudget
     };
-    bigton_parsed_program_t p;
-    bigton_error_t parseError = BIGTONE_NONE;
-    bigtonParseProgram(rawProgram, (size_t) rawProgramLength, &p, &parseError);
-    bigton_runtime_state_t *r = malloc(sizeof(bigton_runtime_state_t));
-    bigtonInit(r, &settings, &p);
-    r->error = r->error || parseError;
+    bigton_program_image_t *image
+        = bigtonImageLoadShared(rawProgram, (size_t) rawProgramLength);
+    bigton_runtime_state_t *r = acquireRuntime(&settings, image);
+    bigtonImageRcDecr(image);
+    return AS_HANDLE(r);
+}
+
+// external fun createFromProgram(
+//     programHandle: Long,
+//     tickInstructionLimit: Long,
+//     memoryUsageLimit: Long,
+//     maxCallDepth: Int,
+//     maxTupleSize: Int,
+//     tickFreeBudget: Long
+// ): Long
+JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_createFromProgram
+PARAMS(
+    jlong programHandle,
+    jlong tickInstructionLimit,
+    jlong memoryUsageLimit,
+    jint maxCallDepth,
+    jint maxTupleSize,
+    jlong tickFreeBudget
+) {
+    UNPACK(programHandle, bigton_program_image_t, image);
+    bigton_runtime_settings_t settings = (bigton_runtime_settings_t) {
+        .tickInstructionLimit = tickInstructionLimit,
+        .memoryUsageLimit = memoryUsageLimit,
+        .maxCallDepth = maxCallDepth,
+        .maxTupleSize = maxTupleSize,
+        .tickFreeBudget = tickFreeBudget
+    };
+    bigton_runtime_state_t *r = acquireRuntime(&settings, image);
     return AS_HANDLE(r);
 }
 
@@ -49,8 +142,95 @@ PARAMS(
 JNIEXPORT void JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_free
 PARAMS(jlong runtimeHandle) {
     UNPACK(runtimeHandle, bigton_runtime_state_t, r);
-    free(r->program.rawProgramBuffer);
-    free(r);
+    releaseRuntime(r);
+}
+
+// external fun fork(runtimeHandle: Long): Long
+JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_fork
+PARAMS(jlong runtimeHandle) {
+    UNPACK(runtimeHandle, bigton_runtime_state_t, src);
+    bigton_runtime_state_t *r = malloc(sizeof(bigton_runtime_state_t));
+    bigtonFork(src, r);
+    return AS_HANDLE(r);
+}
+
+// external fun restore(programHandle: Long, snapshot: ByteArray): Long
+JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_restore
+PARAMS(jlong programHandle, jbyteArray snapshot) {
+    UNPACK(programHandle, bigton_program_image_t, image);
+    jsize snapshotSize = (*env)->GetArrayLength(env, snapshot);
+    uint8_t *snapshotData = malloc((size_t) snapshotSize);
+    (*env)->GetByteArrayRegion(
+        env, snapshot, 0, snapshotSize, (jbyte *) snapshotData
+    );
+    bigton_runtime_state_t *r = malloc(sizeof(bigton_runtime_state_t));
+    bigtonRestore(r, image, snapshotData, (size_t) snapshotSize);
+    free(snapshotData);
+    return AS_HANDLE(r);
+}
+
+// external fun snapshot(runtimeHandle: Long): ByteArray
+JNIEXPORT jbyteArray JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_snapshot
+PARAMS(jlong runtimeHandle) {
+    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    size_t snapshotSize;
+    uint8_t *snapshotData = bigtonSnapshot(r, &snapshotSize);
+    jbyteArray snapshot = (*env)->NewByteArray(env, (jsize) snapshotSize);
+    (*env)->SetByteArrayRegion(
+        env, snapshot, 0, (jsize) snapshotSize, (const jbyte *) snapshotData
+    );
+    free(snapshotData);
+    return snapshot;
+}
+
+// external fun hibernate(runtimeHandle: Long, compress: Boolean): Boolean
+JNIEXPORT jboolean JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_hibernate
+PARAMS(jlong runtimeHandle, jboolean compress) {
+    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    return bigtonHibernate(r, compress);
+}
+
+// external fun isHibernated(runtimeHandle: Long): Boolean
+JNIEXPORT jboolean JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_isHibernated
+PARAMS(jlong runtimeHandle) {
+    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    return r->hibernated != NULL;
+}
+
+// external fun compact(runtimeHandle: Long): LongArray
+JNIEXPORT jlongArray JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_compact
+PARAMS(jlong runtimeHandle) {
+    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    bigton_compact_stats_t stats = bigtonCompact(r);
+    jlong result[4] = {
+        (jlong) stats.movedBuffers, (jlong) stats.movedBytes,
+        (jlong) stats.reclaimedBytes, (jlong) stats.elapsedNanos
+    };
+    jlongArray resultArr = (*env)->NewLongArray(env, 4);
+    (*env)->SetLongArrayRegion(env, resultArr, 0, 4, result);
+    return resultArr;
+}
+
+// external fun collectCycles(runtimeHandle: Long): Boolean
+JNIEXPORT jboolean JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_collectCycles
+PARAMS(jlong runtimeHandle) {
+    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    return bigtonCollectCycles(r, SIZE_MAX);
+}
+
+// external fun getCycleStats(runtimeHandle: Long): LongArray
+JNIEXPORT jlongArray JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_getCycleStats
+PARAMS(jlong runtimeHandle) {
+    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    bigton_cycle_stats_t stats = r->cycles.stats;
+    jlong result[6] = {
+        (jlong) stats.collections, (jlong) stats.abortedCollections,
+        (jlong) stats.collectedCycles, (jlong) stats.collectedValues,
+        (jlong) stats.totalPauseNanos, (jlong) stats.maxPauseNanos
+    };
+    jlongArray resultArr = (*env)->NewLongArray(env, 6);
+    (*env)->SetLongArrayRegion(env, resultArr, 0, 6, result);
+    return resultArr;
 }
 
 // external fun debugLoadedProgram(runtimeHandle: Long)
@@ -65,7 +245,7 @@ PARAMS(jlong runtimeHandle) {
 // )
 JNIEXPORT void JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_addLogLine
 PARAMS(jlong runtimeHandle, jlong stringValueHandle) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    UNPACK_RUNTIME(runtimeHandle, r);
     UNPACK(stringValueHandle, bigton_tagged_value_t, lineValue);
     bigtonValRcIncr(*lineValue);
     bigtonLogLine(r, lineValue->v.s);
@@ -74,14 +254,14 @@ PARAMS(jlong runtimeHandle, jlong stringValueHandle) {
 // external fun getLogLineCount(runtimeHandle: Long): Int
 JNIEXPORT jint JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_getLogLineCount
 PARAMS(jlong runtimeHandle) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    UNPACK_RUNTIME(runtimeHandle, r);
     return (jint) r->logsCount;
 }
 
 // external fun getLogLineAt(runtimeHandle: Long, i: Int): String
 JNIEXPORT jstring JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_getLogLineAt
 PARAMS(jlong runtimeHandle, jint i) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    UNPACK_RUNTIME(runtimeHandle, r);
     bigton_string_t *s = r->logs[i];
     return (*env)->NewString(
         env, (const jchar *) s->content, (jsize) s->length
@@ -91,7 +271,7 @@ PARAMS(jlong runtimeHandle, jint i) {
 // external fun clearLogLines(runtimeHandle: Long)
 JNIEXPORT void JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_clearLogLines
 PARAMS(jlong runtimeHandle) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    UNPACK_RUNTIME(runtimeHandle, r);
     size_t count = r->logsCount;
     bigton_string_t **logs = r->logs;
     for (size_t i = 0; i < count; i += 1) {
@@ -103,49 +283,49 @@ PARAMS(jlong runtimeHandle) {
 // external fun getBacktraceLength(runtimeHandle: Long): Int
 JNIEXPORT jint JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_getBacktraceLength
 PARAMS(jlong runtimeHandle) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    UNPACK_RUNTIME(runtimeHandle, r);
     return (jint) r->traceCount;
 }
 
 // external fun getBacktraceName(runtimeHandle: Long, i: Int): Int
 JNIEXPORT jint JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_getBacktraceName
 PARAMS(jlong runtimeHandle, jint i) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    UNPACK_RUNTIME(runtimeHandle, r);
     return (jint) r->trace[i].name;
 }
 
 // external fun getBacktraceDeclFile(runtimeHandle: Long, i: Int): Int
 JNIEXPORT jint JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_getBacktraceDeclFile
 PARAMS(jlong runtimeHandle, jint i) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    UNPACK_RUNTIME(runtimeHandle, r);
     return (jint) r->trace[i].definedAt.file;
 }
 
 // external fun getBacktraceDeclLine(runtimeHandle: Long, i: Int): Int
 JNIEXPORT jint JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_getBacktraceDeclLine
 PARAMS(jlong runtimeHandle, jint i) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    UNPACK_RUNTIME(runtimeHandle, r);
     return (jint) r->trace[i].definedAt.line;
 }
 
 // external fun getBacktraceFromFile(runtimeHandle: Long, i: Int): Int
 JNIEXPORT jint JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_getBacktraceFromFile
 PARAMS(jlong runtimeHandle, jint i) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    UNPACK_RUNTIME(runtimeHandle, r);
     return (jint) r->trace[i].calledFrom.file;
 }
 
 // external fun getBacktraceFromLine(runtimeHandle: Long, i: Int): Int
 JNIEXPORT jint JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_getBacktraceFromLine
 PARAMS(jlong runtimeHandle, jint i) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    UNPACK_RUNTIME(runtimeHandle, r);
     return (jint) r->trace[i].calledFrom.line;
 }
 
 // external fun stackPush(runtimeHandle: Long, valueHandle: Long)
 JNIEXPORT void JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_stackPush
 PARAMS(jlong runtimeHandle, jlong valueHandle) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    UNPACK_RUNTIME(runtimeHandle, r);
     UNPACK(valueHandle, bigton_tagged_value_t, value);
     bigtonValRcIncr(*value);
     bigtonStackPush(&r->stack, *value, r);
@@ -154,9 +334,9 @@ PARAMS(jlong runtimeHandle, jlong valueHandle) {
 // external fun stackPop(runtimeHandle: Long): Long
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_stackPop
 PARAMS(jlong runtimeHandle) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    UNPACK_RUNTIME(runtimeHandle, r);
     if (r->stack.count == 0) { return 0; }
-    MALLOC_VALUE(value);
+    MALLOC_VALUE(value, r);
     *value = bigtonStackPop(&r->stack, r);
     return AS_HANDLE(value);
 }
@@ -164,15 +344,15 @@ PARAMS(jlong runtimeHandle) {
 // external fun getStackLength(runtimeHandle: Long): Int
 JNIEXPORT jint JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_getStackLength
 PARAMS(jlong runtimeHandle) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    UNPACK_RUNTIME(runtimeHandle, r);
     return (jint) r->stack.count;
 }
 
 // external fun getStackAt(runtimeHandle: Long, i: Int): Long
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_getStackAt
 PARAMS(jlong runtimeHandle, jint i) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
-    MALLOC_VALUE(value);
+    UNPACK_RUNTIME(runtimeHandle, r);
+    MALLOC_VALUE(value, r);
     *value = bigtonStackAt(&r->stack, (size_t) i, r);
     bigtonValRcIncr(*value);
     return AS_HANDLE(value);
@@ -214,9 +394,17 @@ PARAMS(jlong runtimeHandle) {
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_getUsedMemory
 PARAMS(jlong runtimeHandle) {
     UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    if (r->hibernated != NULL) { return (jlong) r->hibernated->usedMemory; }
     return (jlong) r->b.totalSizeBytes;
 }
 
+// external fun getPeakMemory(runtimeHandle: Long): Long
+JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_getPeakMemory
+PARAMS(jlong runtimeHandle) {
+    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    return (jlong) r->b.peakSizeBytes;
+}
+
 // external fun getUsedInstrCost(runtimeHandle: Long): Long
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_getUsedInstrCost
 PARAMS(jlong runtimeHandle) {
@@ -234,7 +422,7 @@ PARAMS(jlong runtimeHandle) {
 // external fun setError(runtimeHandle: Long, error: Int)
 JNIEXPORT void JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_setError
 PARAMS(jlong runtimeHandle, jint error) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    UNPACK_RUNTIME(runtimeHandle, r);
     r->error = (bigton_error_t) error;
 }
 
@@ -257,4 +445,38 @@ JNIEXPORT jint JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_execu
 PARAMS(jlong runtimeHandle) {
     UNPACK(runtimeHandle, bigton_runtime_state_t, r);
     return (jint) bigtonExecBatch(r);
-}
\ No newline at end of file
+}
+
+#define EXEC_MANY_CHUNK_SIZE 64
+
+// external fun executeMany(
+//     runtimeHandlesBuf: ByteBuffer,
+//     count: Int,
+//     startTick: Boolean,
+//     resultsBuf: ByteBuffer
+// )
+JNIEXPORT void JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonRuntimeN_executeMany
+PARAMS(
+    jobject runtimeHandlesBuff,
+    jint count,
+    jboolean startTick,
+    jobject resultsBuff
+) {
+    const jlong *handles
+        = (*env)->GetDirectBufferAddress(env, runtimeHandlesBuff);
+    bigton_exec_result_t *results
+        = (*env)->GetDirectBufferAddress(env, resultsBuff);
+    bigton_runtime_state_t *chunk[EXEC_MANY_CHUNK_SIZE];
+    for (size_t start = 0; start < (size_t) count; ) {
+        size_t chunkSize = (size_t) count - start;
+        if (chunkSize > EXEC_MANY_CHUNK_SIZE) {
+            chunkSize = EXEC_MANY_CHUNK_SIZE;
+        }
+        for (size_t i = 0; i < chunkSize; i += 1) {
+            UNPACK(handles[start + i], bigton_runtime_state_t, r);
+            chunk[i] = r;
+        }
+        bigtonExecMany(chunk, chunkSize, startTick, results + start);
+        start += chunkSize;
+    }
+}
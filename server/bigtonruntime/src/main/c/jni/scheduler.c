@@ -0,0 +1,115 @@
+
+#include "generated/kotlin/main/schwalbe_ventura_bigton_runtime_BigtonSchedulerN.h"
+#include <bigton/runtime.h>
+#include <bigton/scheduler.h>
+#include <bigton/snapshot.h>
+#include <stdlib.h>
+#include "helpers.h"
+
+typedef struct JniScheduler {
+    bigton_scheduler_t *s;
+    size_t runtimesCapacity;
+    bigton_runtime_state_t **runtimes;
+} jni_scheduler_t;
+
+// external fun create(numThreads: Int): Long
+JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonSchedulerN_create
+PARAMS(jint numThreads) {
+    jni_scheduler_t *js = malloc(sizeof(jni_scheduler_t));
+    js->s = bigtonSchedulerCreate((uint32_t) numThreads);
+    js->runtimesCapacity = 0;
+    js->runtimes = NULL;
+    return AS_HANDLE(js);
+}
+
+// external fun free(schedulerHandle: Long)
+JNIEXPORT void JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonSchedulerN_free
+PARAMS(jlong schedulerHandle) {
+    UNPACK(schedulerHandle, jni_scheduler_t, js);
+    bigtonSchedulerFree(js->s);
+    free(js->runtimes);
+    free(js);
+}
+
+// external fun getNumThreads(schedulerHandle: Long): Int
+JNIEXPORT jint JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonSchedulerN_getNumThreads
+PARAMS(jlong schedulerHandle) {
+    UNPACK(schedulerHandle, jni_scheduler_t, js);
+    return (jint) bigtonSchedulerNumThreads(js->s);
+}
+
+static void collectRuntimes(
+    jni_scheduler_t *js, const jlong *handles, size_t count
+) {
+    if (count > js->runtimesCapacity) {
+        js->runtimesCapacity = count;
+        js->runtimes = realloc(
+            js->runtimes,
+            sizeof(bigton_runtime_state_t *) * js->runtimesCapacity
+        );
+    }
+    for (size_t i = 0; i < count; i += 1) {
+        UNPACK(handles[i], bigton_runtime_state_t, r);
+        js->runtimes[i] = r;
+    }
+}
+
+// external fun execute(
+//     schedulerHandle: Long,
+//     runtimeHandlesBuf: ByteBuffer,
+//     count: Int,
+//     startTick: Boolean,
+//     resultsBuf: ByteBuffer
+// )
+JNIEXPORT void JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonSchedulerN_execute
+PARAMS(
+    jlong schedulerHandle,
+    jobject runtimeHandlesBuff,
+    jint count,
+    jboolean startTick,
+    jobject resultsBuff
+) {
+    UNPACK(schedulerHandle, jni_scheduler_t, js);
+    const jlong *handles
+        = (*env)->GetDirectBufferAddress(env, runtimeHandlesBuff);
+    bigton_exec_result_t *results
+        = (*env)->GetDirectBufferAddress(env, resultsBuff);
+    collectRuntimes(js, handles, (size_t) count);
+    bigtonSchedulerRun(js->s, js->runtimes, (size_t) count, startTick, results);
+}
+
+// external fun snapshotMany(
+//     schedulerHandle: Long,
+//     runtimeHandles: LongArray
+// ): Array<ByteArray>
+JNIEXPORT jobjectArray JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonSchedulerN_snapshotMany
+PARAMS(jlong schedulerHandle, jlongArray runtimeHandles) {
+    UNPACK(schedulerHandle, jni_scheduler_t, js);
+    jsize count = (*env)->GetArrayLength(env, runtimeHandles);
+    jlong *handles
+        = (*env)->GetLongArrayElements(env, runtimeHandles, NULL);
+    collectRuntimes(js, handles, (size_t) count);
+    (*env)->ReleaseLongArrayElements(env, runtimeHandles, handles, JNI_ABORT);
+    uint8_t **snapshotData = malloc(sizeof(uint8_t *) * (size_t) count);
+    size_t *snapshotSizes = malloc(sizeof(size_t) * (size_t) count);
+    bigtonSnapshotMany(
+        js->s, (const bigton_runtime_state_t *const *) js->runtimes,
+        (size_t) count, snapshotData, snapshotSizes
+    );
+    jclass byteArrayCls = (*env)->FindClass(env, "[B");
+    jobjectArray snapshots
+        = (*env)->NewObjectArray(env, count, byteArrayCls, NULL);
+    for (jsize i = 0; i < count; i += 1) {
+        jsize size = (jsize) snapshotSizes[i];
+        jbyteArray snapshot = (*env)->NewByteArray(env, size);
+        (*env)->SetByteArrayRegion(
+            env, snapshot, 0, size, (const jbyte *) snapshotData[i]
+        );
+        (*env)->SetObjectArrayElement(env, snapshots, i, snapshot);
+        (*env)->DeleteLocalRef(env, snapshot);
+        free(snapshotData[i]);
+    }
+    free(snapshotData);
+    free(snapshotSizes);
+    return snapshots;
+}
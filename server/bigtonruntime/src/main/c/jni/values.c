@@ -2,6 +2,7 @@
 #include "generated/kotlin/main/schwalbe_ventura_bigton_runtime_BigtonValueN.h"
 #include <bigton/values.h>
 #include <bigton/runtime.h>
+#include <bigton/snapshot.h>
 #include <stdlib.h>
 #include <string.h>
 #include "helpers.h"
@@ -10,6 +11,7 @@
 JNIEXPORT void JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_free
 PARAMS(jlong valueHandle) {
     UNPACK(valueHandle, bigton_tagged_value_t, value);
+    bigtonHostValueDetach((bigton_host_value_t *) value);
     bigtonValRcDecr(*value);
     free(value);
 }
@@ -21,10 +23,20 @@ PARAMS(jlong valueHandle) {
     return (jint) value->t;
 }
 
+// external fun valuesEqual(
+//     handleA: Long, handleB: Long
+// ): Boolean
+JNIEXPORT jboolean JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_valuesEqual
+PARAMS(jlong valueHandleA, jlong valueHandleB) {
+    UNPACK(valueHandleA, bigton_tagged_value_t, a);
+    UNPACK(valueHandleB, bigton_tagged_value_t, b);
+    return valuesEqual(*a, *b);
+}
+
 // external fun createNull(): Long
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_createNull
 NO_PARAMS() {
-    MALLOC_VALUE(value);
+    MALLOC_VALUE(value, NULL);
     value->t = BIGTON_NULL;
     return AS_HANDLE(value);
 }
@@ -32,7 +44,7 @@ NO_PARAMS() {
 // external fun createInt(value: Long): Long
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_createInt
 PARAMS(jlong containedValue) {
-    MALLOC_VALUE(value);
+    MALLOC_VALUE(value, NULL);
     value->t = BIGTON_INT;
     value->v.i = (bigton_int_t) containedValue;
     return AS_HANDLE(value);
@@ -48,7 +60,7 @@ PARAMS(jlong valueHandle) {
 // external fun createFloat(value: Double): Long
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_createFloat
 PARAMS(jdouble containedValue) {
-    MALLOC_VALUE(value);
+    MALLOC_VALUE(value, NULL);
     value->t = BIGTON_FLOAT;
     value->v.f = (bigton_float_t) containedValue;
     return AS_HANDLE(value);
@@ -64,16 +76,17 @@ PARAMS(jlong valueHandle) {
 // external fun createString(value: String, runtimeHandle: Long): Long
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_createString
 PARAMS(jstring containedValue, jlong runtimeHandle) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
+    UNPACK_RUNTIME(runtimeHandle, r);
     if (containedValue == NULL) { return 0; }
     jsize charLength = (*env)->GetStringLength(env, containedValue);
     const jchar *chars = (*env)->GetStringChars(env, containedValue, NULL);
     if (chars == NULL) { return 0; }
-    bigton_string_t *s = bigtonAllocString(
-        &r->b, (uint64_t) charLength, (const bigton_char_t *) chars
+    bigton_string_t *s = bigtonAllocValueString(
+        r, (uint64_t) charLength, (const bigton_char_t *) chars
     );
     (*env)->ReleaseStringChars(env, containedValue, chars);
-    MALLOC_VALUE(value);
+    if (s == NULL) { return 0; }
+    MALLOC_VALUE(value, r);
     value->t = BIGTON_STRING;
     value->v.s = s;
     return AS_HANDLE(value);
@@ -101,21 +114,10 @@ JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_concat
 PARAMS(jlong handleA, jlong handleB, jlong runtimeHandle) {
     UNPACK(handleA, bigton_tagged_value_t, valueA);
     UNPACK(handleB, bigton_tagged_value_t, valueB);
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
-    bigton_string_t *a = valueA->v.s;
-    bigton_string_t *b = valueB->v.s;
-    uint32_t newLengthChars = a->length + b->length;
-    size_t newLengthBytes = sizeof(bigton_char_t) * newLengthChars;
-    bigton_char_t *newContent = bigtonAllocNullableBuff(&r->b, newLengthBytes);
-    bigton_char_t *aDestStart = newContent;
-    memcpy(aDestStart, a->content, sizeof(bigton_char_t) * a->length);
-    bigton_char_t *bDestStart = aDestStart + a->length;
-    memcpy(bDestStart, b->content, sizeof(bigton_char_t) * b->length);
-    bigton_string_t *c = bigtonAllocBuff(&r->b, sizeof(bigton_string_t));
-    c->rc = BIGTON_RC_INIT;
-    c->content = newContent;
-    c->length = newLengthChars;
-    MALLOC_VALUE(valueC);
+    UNPACK_RUNTIME(runtimeHandle, r);
+    bigton_string_t *c = bigtonStringConcat(r, valueA->v.s, valueB->v.s);
+    if (c == NULL) { return 0; }
+    MALLOC_VALUE(valueC, r);
     valueC->t = BIGTON_STRING;
     valueC->v.s = c;
     return AS_HANDLE(valueC);
@@ -127,35 +129,52 @@ PARAMS(jlong handleA, jlong handleB, jlong runtimeHandle) {
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_sliceString
 PARAMS(jlong valueHandle, jint startIdx, jint endIdx, jlong runtimeHandle) {
     UNPACK(valueHandle, bigton_tagged_value_t, value);
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
-    uint32_t resLength = endIdx - startIdx;
-    const bigton_char_t *resContent = value->v.s->content + startIdx;
-    MALLOC_VALUE(result);
+    UNPACK_RUNTIME(runtimeHandle, r);
+    bigton_string_t *s = bigtonStringSlice(
+        r, value->v.s, (size_t) startIdx, (size_t) endIdx
+    );
+    if (s == NULL) { return 0; }
+    MALLOC_VALUE(result, r);
     result->t = BIGTON_STRING;
-    result->v.s = bigtonAllocString(&r->b, resLength, resContent);
+    result->v.s = s;
     return AS_HANDLE(result);
 }
 
+// Allocates the buffers of a tuple or array with the given length (element
+// types, element values and the value itself), returning false if that would
+// exceed the memory usage limit of the runtime.
+static bool allocAggregate(
+    bigton_runtime_state_t *r, size_t length, size_t valueSize,
+    void **buffers
+) {
+    size_t sizes[] = {
+        sizeof(bigton_value_type_t) * length,
+        sizeof(bigton_value_t) * length,
+        valueSize
+    };
+    return bigtonAllocValueBuffs(r, 3, sizes, buffers);
+}
+
 // external fun createTuple(length: Int, runtimeHandle: Long): Long
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_createTuple
 PARAMS(jint length, jlong runtimeHandle) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
-    bigton_value_type_t *valueTypes = bigtonAllocNullableBuff(
-        &r->b, sizeof(bigton_value_type_t) * (size_t) length
-    );
-    bigton_value_t *values = bigtonAllocNullableBuff(
-        &r->b, sizeof(bigton_value_t) * (size_t) length
-    );
+    UNPACK_RUNTIME(runtimeHandle, r);
+    void *buffers[3];
+    if (!allocAggregate(r, (size_t) length, sizeof(bigton_tuple_t), buffers)) {
+        return 0;
+    }
+    bigton_value_type_t *valueTypes = buffers[0];
+    bigton_value_t *values = buffers[1];
     for (size_t i = 0; i < (size_t) length; i += 1) {
         valueTypes[i] = BIGTON_NULL;
     }
-    bigton_tuple_t *t = bigtonAllocBuff(&r->b, sizeof(bigton_tuple_t));
+    bigton_tuple_t *t = buffers[2];
     t->rc = BIGTON_RC_INIT;
     t->flatLength = (uint32_t) length;
     t->length = (uint32_t) length;
     t->valueTypes = valueTypes;
     t->values = values;
-    MALLOC_VALUE(value);
+    MALLOC_VALUE(value, r);
     value->t = BIGTON_TUPLE;
     value->v.t = t;
     return AS_HANDLE(value);
@@ -213,7 +232,7 @@ JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_getTup
 PARAMS(jlong valueHandle, jint i) {
     UNPACK(valueHandle, bigton_tagged_value_t, value);
     bigton_tuple_t *t = value->v.t;
-    MALLOC_VALUE(containedValue);
+    MALLOC_VALUE(containedValue, VALUE_RUNTIME(value));
     containedValue->t = t->valueTypes[i];
     containedValue->v = t->values[i];
     bigtonValRcIncr(*containedValue);
@@ -283,8 +302,8 @@ PARAMS(jlong valueHandle, jint propId, jlong runtimeHandle) {
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_getObjectPropValue
 PARAMS(jlong valueHandle, jint propId) {
     UNPACK(valueHandle, bigton_tagged_value_t, value);
-    bigton_object_t *o = value->v.o;
-    MALLOC_VALUE(containedValue);
+    bigton_object_t *o = bigtonObjectRead(VALUE_RUNTIME(value), value->v.o);
+    MALLOC_VALUE(containedValue, VALUE_RUNTIME(value));
     containedValue->t = o->memberTypes[propId];
     containedValue->v = o->memberValues[propId];
     bigtonValRcIncr(*containedValue);
@@ -293,12 +312,13 @@ PARAMS(jlong valueHandle, jint propId) {
 
 // external fun setObjectPropValue(
 //     handle: Long, propHandle: Int, valueHandle: Long
-// )
-JNIEXPORT void JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_setObjectPropValue
+// ): Boolean
+JNIEXPORT jboolean JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_setObjectPropValue
 PARAMS(jlong valueHandle, jint propId, jlong containedValueHandle) {
     UNPACK(valueHandle, bigton_tagged_value_t, value);
     UNPACK(containedValueHandle, bigton_tagged_value_t, containedValue);
-    bigton_object_t *o = value->v.o;
+    bigton_object_t *o = bigtonObjectWrite(VALUE_RUNTIME(value), value->v.o);
+    if (o == NULL) { return false; }
     bigton_value_type_t *memTypes = (bigton_value_type_t *) o->memberTypes;
     bigton_value_t *memValues = (bigton_value_t *) o->memberValues;
     bigtonValRcDecr((bigton_tagged_value_t) {
@@ -307,28 +327,32 @@ PARAMS(jlong valueHandle, jint propId, jlong containedValueHandle) {
     bigtonValRcIncr(*containedValue);
     memTypes[propId] = containedValue->t;
     memValues[propId] = containedValue->v;
+    return true;
 }
 
 // external fun createArray(length: Int, runtimeHandle: Long): Long
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_createArray
 PARAMS(jint length, jlong runtimeHandle) {
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
-    bigton_value_type_t *valueTypes = bigtonAllocNullableBuff(
-        &r->b, sizeof(bigton_value_type_t) * (size_t) length
-    );
-    bigton_value_t *values = bigtonAllocNullableBuff(
-        &r->b, sizeof(bigton_value_t) * (size_t) length
-    );
+    UNPACK_RUNTIME(runtimeHandle, r);
+    void *buffers[3];
+    if (!allocAggregate(r, (size_t) length, sizeof(bigton_array_t), buffers)) {
+        return 0;
+    }
+    bigton_value_type_t *valueTypes = buffers[0];
+    bigton_value_t *values = buffers[1];
     for (size_t i = 0; i < (size_t) length; i += 1) {
         valueTypes[i] = BIGTON_NULL;
     }
-    bigton_array_t *a = bigtonAllocBuff(&r->b, sizeof(bigton_array_t));
+    bigton_array_t *a = buffers[2];
     a->rc = BIGTON_RC_INIT;
+    a->hash = bigtonNextValueHash(r);
     a->capacity = (uint32_t) length;
     a->length = (uint32_t) length;
+    a->packedType = BIGTON_NULL;
     a->elementTypes = valueTypes;
     a->elementValues = values;
-    MALLOC_VALUE(value);
+    a->viewed = NULL;
+    MALLOC_VALUE(value, r);
     value->t = BIGTON_ARRAY;
     value->v.a = a;
     return AS_HANDLE(value);
@@ -338,84 +362,47 @@ PARAMS(jint length, jlong runtimeHandle) {
 JNIEXPORT jint JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_getArrayLength
 PARAMS(jlong valueHandle) {
     UNPACK(valueHandle, bigton_tagged_value_t, value);
-    return (jint) value->v.a->length;
+    return (jint) bigtonArrayRead(VALUE_RUNTIME(value), value->v.a)->length;
 }
 
-// external fun setArrayAt(handle: Long, index: Int, valueHandle: Long)
-JNIEXPORT void JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_setArrayAt
+// external fun setArrayAt(
+//     handle: Long, index: Int, valueHandle: Long
+// ): Boolean
+JNIEXPORT jboolean JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_setArrayAt
 PARAMS(jlong valueHandle, jint i, jlong containedValueHandle) {
     UNPACK(valueHandle, bigton_tagged_value_t, value);
     UNPACK(containedValueHandle, bigton_tagged_value_t, containedValue);
-    bigton_array_t *a = value->v.a;
-    bigton_value_type_t *elemTypes = (bigton_value_type_t *) a->elementTypes;
-    bigton_value_t *elemValues = (bigton_value_t *) a->elementValues;
-    bigtonValRcDecr((bigton_tagged_value_t) {
-        .t = elemTypes[i], .v = elemValues[i]
-    });
+    bigton_array_t *a = bigtonArrayWrite(VALUE_RUNTIME(value), value->v.a);
+    if (a == NULL) { return false; }
+    bigton_error_t error = BIGTONE_NONE;
     bigtonValRcIncr(*containedValue);
-    elemTypes[i] = containedValue->t;
-    elemValues[i] = containedValue->v;
+    bigtonValRcDecr(bigtonArraySet(a, i, *containedValue, &error));
+    return error == BIGTONE_NONE;
 }
 
 // external fun insertArrayAt(
 //     handle: Long, index: Int, valueHandle: Long, runtimeHandle: Long
-// )
-JNIEXPORT void JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_insertArrayAt
+// ): Boolean
+JNIEXPORT jboolean JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_insertArrayAt
 PARAMS(jlong valueHandle, jint i, jlong insertValueHandle, jlong runtimeHandle) {
     UNPACK(valueHandle, bigton_tagged_value_t, value);
     UNPACK(insertValueHandle, bigton_tagged_value_t, insertValue);
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
-    bigton_array_t *a = value->v.a;
-    if (a->length + 1 > a->capacity) {
-        a->capacity += 4;
-        a->elementTypes = bigtonReallocNullableBuff(
-            &r->b, a->elementTypes, sizeof(bigton_value_type_t) * a->capacity
-        );
-        a->elementValues = bigtonReallocNullableBuff(
-            &r->b, a->elementValues, sizeof(bigton_value_t) * a->capacity
-        );
-    }
-    bigton_value_type_t *elemTypes = a->elementTypes;
-    bigton_value_t *elemValues = a->elementValues;
-    uint32_t numShifted = a->length - i;
-    if (numShifted != 0) {
-        memmove(
-            elemTypes + i + 1, elemTypes + i,
-            sizeof(bigton_value_type_t) * numShifted
-        );
-        memmove(
-            elemValues + i + 1, elemValues + i,
-            sizeof(bigton_value_t) * numShifted
-        );
-    }
+    UNPACK_RUNTIME(runtimeHandle, r);
+    bigton_array_t *a = bigtonArrayWrite(r, value->v.a);
+    if (a == NULL) { return false; }
+    if (!bigtonArrayInsert(r, a, (size_t) i, *insertValue)) { return false; }
     bigtonValRcIncr(*insertValue);
-    elemTypes[i] = insertValue->t;
-    elemValues[i] = insertValue->v;
-    a->length += 1;
+    return true;
 }
 
 // external fun removeArrayAt(handle: Long, index: Int): Long
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_removeArrayAt
 PARAMS(jlong valueHandle, jint i) {
     UNPACK(valueHandle, bigton_tagged_value_t, value);
-    bigton_array_t *a = value->v.a;
-    bigton_value_type_t *elemTypes = a->elementTypes;
-    bigton_value_t *elemValues = a->elementValues;
-    MALLOC_VALUE(removed);
-    removed->t = elemTypes[i];
-    removed->v = elemValues[i];
-    uint32_t numShifted = a->length - i - 1;
-    if (numShifted != 0) {
-        memmove(
-            elemTypes + i, elemTypes + i + 1,
-            sizeof(bigton_value_type_t) * numShifted
-        );
-        memmove(
-            elemValues + i, elemValues + i + 1,
-            sizeof(bigton_value_t) * numShifted
-        );
-    }
-    a->length -= 1;
+    bigton_array_t *a = bigtonArrayWrite(VALUE_RUNTIME(value), value->v.a);
+    if (a == NULL) { return 0; }
+    MALLOC_VALUE(removed, VALUE_RUNTIME(value));
+    *removed = bigtonArrayRemove(a, (size_t) i);
     return AS_HANDLE(removed);
 }
 
@@ -423,14 +410,41 @@ PARAMS(jlong valueHandle, jint i) {
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_getArrayAt
 PARAMS(jlong valueHandle, jint i) {
     UNPACK(valueHandle, bigton_tagged_value_t, value);
-    bigton_array_t *a = value->v.a;
-    MALLOC_VALUE(containedValue);
-    containedValue->t = a->elementTypes[i];
+    bigton_array_t *a = bigtonArrayRead(VALUE_RUNTIME(value), value->v.a);
+    MALLOC_VALUE(containedValue, VALUE_RUNTIME(value));
+    containedValue->t = bigtonArrayTypeAt(a, (size_t) i);
     containedValue->v = a->elementValues[i];
     bigtonValRcIncr(*containedValue);
     return AS_HANDLE(containedValue);
 }
 
+static void concatPacked(
+    bigton_value_t *dest, const bigton_array_t *a, const bigton_array_t *b
+) {
+    if (a->length > 0) {
+        memcpy(dest, a->elementValues, sizeof(bigton_value_t) * a->length);
+    }
+    if (b->length > 0) {
+        memcpy(
+            dest + a->length, b->elementValues,
+            sizeof(bigton_value_t) * b->length
+        );
+    }
+}
+
+static void concatElements(
+    bigton_value_type_t *destTypes, bigton_value_t *destValues,
+    const bigton_array_t *src, size_t destOffset
+) {
+    for (size_t i = 0; i < src->length; i += 1) {
+        bigton_value_type_t t = bigtonArrayTypeAt(src, i);
+        bigton_value_t v = src->elementValues[i];
+        bigtonValRcIncr((bigton_tagged_value_t) { .t = t, .v = v });
+        destTypes[destOffset + i] = t;
+        destValues[destOffset + i] = v;
+    }
+}
+
 // external fun concatArrays(
 //     handleA: Long, handleB: Long, runtimeHandle: Long
 // ): Long
@@ -438,39 +452,40 @@ JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_concat
 PARAMS(jlong handleA, jlong handleB, jlong runtimeHandle) {
     UNPACK(handleA, bigton_tagged_value_t, valueA);
     UNPACK(handleB, bigton_tagged_value_t, valueB);
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
-    bigton_array_t *a = valueA->v.a;
-    bigton_array_t *b = valueB->v.a;
-    uint32_t newLength = a->length + b->length;
-    bigton_value_type_t *newElemTypes = bigtonAllocNullableBuff(
-        &r->b, sizeof(bigton_value_type_t) * newLength
-    );
-    bigton_value_t *newElemValues = bigtonAllocNullableBuff(
-        &r->b, sizeof(bigton_value_t) * newLength
-    );
-    for (size_t i = 0; i < a->length; i += 1) {
-        bigton_value_type_t t = a->elementTypes[i];
-        bigton_value_t v = a->elementValues[i];
-        bigtonValRcIncr((bigton_tagged_value_t) { .t = t, .v = v });
-        newElemTypes[i] = t;
-        newElemValues[i] = v;
-    }
-    size_t bDestOffset = a->length;
-    for (size_t i = 0; i < b->length; i += 1) {
-        bigton_value_type_t t = b->elementTypes[i];
-        bigton_value_t v = b->elementValues[i];
-        bigtonValRcIncr((bigton_tagged_value_t) { .t = t, .v = v });
-        size_t di = i + bDestOffset;
-        newElemTypes[di] = t;
-        newElemValues[di] = v;
+    UNPACK_RUNTIME(runtimeHandle, r);
+    bigton_array_t *a = bigtonArrayRead(r, valueA->v.a);
+    bigton_array_t *b = bigtonArrayRead(r, valueB->v.a);
+    size_t newLength = (size_t) a->length + b->length;
+    // empty arrays do not prevent the result from being packed
+    bigton_value_type_t packedType = a->length == 0 ? b->packedType
+        : b->length == 0 || a->packedType == b->packedType ? a->packedType
+        : BIGTON_NULL;
+    bool isPacked = packedType != BIGTON_NULL;
+    size_t sizes[] = {
+        isPacked ? 0 : sizeof(bigton_value_type_t) * newLength,
+        sizeof(bigton_value_t) * newLength,
+        sizeof(bigton_array_t)
+    };
+    void *buffers[3];
+    if (!bigtonAllocValueBuffs(r, 3, sizes, buffers)) { return 0; }
+    bigton_value_type_t *newElemTypes = buffers[0];
+    bigton_value_t *newElemValues = buffers[1];
+    if (isPacked) {
+        concatPacked(newElemValues, a, b);
+    } else {
+        concatElements(newElemTypes, newElemValues, a, 0);
+        concatElements(newElemTypes, newElemValues, b, a->length);
     }
-    bigton_array_t *c = bigtonAllocBuff(&r->b, sizeof(bigton_array_t));
+    bigton_array_t *c = buffers[2];
     c->rc = BIGTON_RC_INIT;
-    c->length = newLength;
-    c->capacity = newLength;
+    c->hash = bigtonNextValueHash(r);
+    c->length = (uint32_t) newLength;
+    c->capacity = (uint32_t) newLength;
+    c->packedType = packedType;
     c->elementTypes = newElemTypes;
     c->elementValues = newElemValues;
-    MALLOC_VALUE(valueC);
+    c->viewed = NULL;
+    MALLOC_VALUE(valueC, r);
     valueC->t = BIGTON_ARRAY;
     valueC->v.a = c;
     return AS_HANDLE(valueC);
@@ -482,33 +497,102 @@ PARAMS(jlong handleA, jlong handleB, jlong runtimeHandle) {
 JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_sliceArray
 PARAMS(jlong valueHandle, jint startIdx, jint endIdx, jlong runtimeHandle) {
     UNPACK(valueHandle, bigton_tagged_value_t, value);
-    UNPACK(runtimeHandle, bigton_runtime_state_t, r);
-    bigton_array_t *src = value->v.a;
-    bigton_value_type_t *srcElemTypes = src->elementTypes;
-    bigton_value_t *srcElemValues = src->elementValues;
-    uint32_t resLength = endIdx - startIdx;
-    bigton_value_type_t *resElemTypes = bigtonAllocNullableBuff(
-        &r->b, sizeof(bigton_value_type_t) * resLength
-    );
-    bigton_value_t *resElemValues = bigtonAllocNullableBuff(
-        &r->b, sizeof(bigton_value_t) * resLength
+    UNPACK_RUNTIME(runtimeHandle, r);
+    bigton_array_t *res = bigtonArraySlice(
+        r, value->v.a, (size_t) startIdx, (size_t) endIdx
     );
-    for(size_t di = 0; di < resLength; di += 1) {
-        size_t i = startIdx + di;
-        bigton_value_type_t t = srcElemTypes[i];
-        bigton_value_t v = srcElemValues[i];
-        bigtonValRcIncr((bigton_tagged_value_t) { .t = t, .v = v });
-        resElemTypes[di] = t;
-        resElemValues[di] = v;
-    }
-    bigton_array_t *res = bigtonAllocBuff(&r->b, sizeof(bigton_array_t));
-    res->rc = BIGTON_RC_INIT;
-    res->length = resLength;
-    res->capacity = resLength;
-    res->elementTypes = resElemTypes;
-    res->elementValues = resElemValues;
-    MALLOC_VALUE(resValue);
+    if (res == NULL) { return 0; }
+    MALLOC_VALUE(resValue, r);
     resValue->t = BIGTON_ARRAY;
     resValue->v.a = res;
     return AS_HANDLE(resValue);
-}
\ No newline at end of file
+}
+// external fun createMap(runtimeHandle: Long): Long
+JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_createMap
+PARAMS(jlong runtimeHandle) {
+    UNPACK_RUNTIME(runtimeHandle, r);
+    bigton_map_t *m = bigtonMapCreate(r);
+    if (m == NULL) { return 0; }
+    MALLOC_VALUE(value, r);
+    value->t = BIGTON_MAP;
+    value->v.m = m;
+    return AS_HANDLE(value);
+}
+
+// external fun getMapLength(handle: Long): Int
+JNIEXPORT jint JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_getMapLength
+PARAMS(jlong valueHandle) {
+    UNPACK(valueHandle, bigton_tagged_value_t, value);
+    return (jint) bigtonMapRead(VALUE_RUNTIME(value), value->v.m)->length;
+}
+
+// external fun hasMapKey(handle: Long, keyHandle: Long): Boolean
+JNIEXPORT jboolean JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_hasMapKey
+PARAMS(jlong valueHandle, jlong keyHandle) {
+    UNPACK(valueHandle, bigton_tagged_value_t, value);
+    UNPACK(keyHandle, bigton_tagged_value_t, key);
+    bigton_map_t *m = bigtonMapRead(VALUE_RUNTIME(value), value->v.m);
+    return bigtonMapFind(m, *key) < m->capacity;
+}
+
+// external fun getMapValue(handle: Long, keyHandle: Long): Long
+JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_getMapValue
+PARAMS(jlong valueHandle, jlong keyHandle) {
+    UNPACK(valueHandle, bigton_tagged_value_t, value);
+    UNPACK(keyHandle, bigton_tagged_value_t, key);
+    bigton_map_t *m = bigtonMapRead(VALUE_RUNTIME(value), value->v.m);
+    size_t slot = bigtonMapFind(m, *key);
+    if (slot == m->capacity) { return 0; }
+    MALLOC_VALUE(containedValue, VALUE_RUNTIME(value));
+    *containedValue = bigtonMapValueAt(m, slot);
+    bigtonValRcIncr(*containedValue);
+    return AS_HANDLE(containedValue);
+}
+
+// external fun setMapValue(
+//     handle: Long, keyHandle: Long, valueHandle: Long, runtimeHandle: Long
+// ): Boolean
+JNIEXPORT jboolean JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_setMapValue
+PARAMS(jlong mapHandle, jlong keyHandle, jlong valueHandle, jlong runtimeHandle) {
+    UNPACK(mapHandle, bigton_tagged_value_t, map);
+    UNPACK(keyHandle, bigton_tagged_value_t, key);
+    UNPACK(valueHandle, bigton_tagged_value_t, value);
+    UNPACK_RUNTIME(runtimeHandle, r);
+    bigton_map_t *m = bigtonMapWrite(r, map->v.m);
+    if (m == NULL) { return false; }
+    bigtonValRcIncr(*key);
+    bigtonValRcIncr(*value);
+    if (bigtonMapSet(r, m, *key, *value)) { return true; }
+    bigtonValRcDecr(*key);
+    bigtonValRcDecr(*value);
+    return false;
+}
+
+// external fun removeMapValue(handle: Long, keyHandle: Long): Long
+// (0 if the key is not in the map, or if it could not be removed because the
+// memory usage limit would have been exceeded)
+JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_removeMapValue
+PARAMS(jlong valueHandle, jlong keyHandle) {
+    UNPACK(valueHandle, bigton_tagged_value_t, value);
+    UNPACK(keyHandle, bigton_tagged_value_t, key);
+    bigton_map_t *m = bigtonMapWrite(VALUE_RUNTIME(value), value->v.m);
+    if (m == NULL) { return 0; }
+    size_t slot = bigtonMapFind(m, *key);
+    if (slot == m->capacity) { return 0; }
+    MALLOC_VALUE(removed, VALUE_RUNTIME(value));
+    *removed = bigtonMapRemove(m, slot);
+    return AS_HANDLE(removed);
+}
+
+// external fun getMapKeys(handle: Long, runtimeHandle: Long): Long
+JNIEXPORT jlong JNICALL Java_schwalbe_ventura_bigton_runtime_BigtonValueN_getMapKeys
+PARAMS(jlong valueHandle, jlong runtimeHandle) {
+    UNPACK(valueHandle, bigton_tagged_value_t, value);
+    UNPACK_RUNTIME(runtimeHandle, r);
+    bigton_array_t *keys = bigtonMapKeys(r, bigtonMapRead(r, value->v.m));
+    if (keys == NULL) { return 0; }
+    MALLOC_VALUE(keysValue, r);
+    keysValue->t = BIGTON_ARRAY;
+    keysValue->v.a = keys;
+    return AS_HANDLE(keysValue);
+}
@@ -0,0 +1,474 @@
+
+#include <bigton/runtime.h>
+#include <bigton/util.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Compaction first collects all buffers reachable from the runtime in
+// traversal order (a container is always followed by the buffers holding its
+// contents), then allocates all of them in a single arena and copies their
+// contents, and finally updates all references to the moved buffers.
+// Values waiting to be freed and values only kept alive by reference cycles
+// are freed beforehand, since they would otherwise keep referencing the old
+// locations of moved buffers.
+
+
+typedef enum BigtonCompactKind {
+    BIGTONCK_RAW,
+    BIGTONCK_STRING,
+    BIGTONCK_TUPLE,
+    BIGTONCK_OBJECT,
+    BIGTONCK_ARRAY,
+    BIGTONCK_MAP
+} bigton_compact_kind_t;
+
+typedef struct BigtonCompactEntry {
+    const void *old;
+    void *moved;
+    size_t newSize;
+    bigton_compact_kind_t kind;
+} bigton_compact_entry_t;
+
+typedef struct BigtonCompactor {
+    bigton_runtime_state_t *r;
+    size_t entriesCapacity;
+    size_t entriesCount;
+    bigton_compact_entry_t *entries;
+    // maps the old location of each collected buffer to its entry
+    size_t mapCapacity;
+    const void **mapKeys;
+    size_t *mapEntries;
+    size_t pendingCapacity;
+    size_t pendingCount;
+    bigton_tagged_value_t *pending;
+} bigton_compactor_t;
+
+
+static size_t mapSlotOf(const bigton_compactor_t *c, const void *key) {
+    size_t slot = bigtonHashPointer(key, c->mapCapacity);
+    while (c->mapKeys[slot] != NULL && c->mapKeys[slot] != key) {
+        slot = (slot + 1) & (c->mapCapacity - 1);
+    }
+    return slot;
+}
+
+static void growMap(bigton_compactor_t *c) {
+    size_t oldCapacity = c->mapCapacity;
+    const void **oldKeys = c->mapKeys;
+    size_t *oldEntries = c->mapEntries;
+    c->mapCapacity = oldCapacity == 0 ? 256 : oldCapacity * 2;
+    c->mapKeys = bigtonCheckAllocated(
+        calloc(c->mapCapacity, sizeof(const void *))
+    );
+    c->mapEntries = bigtonCheckAllocated(
+        malloc(sizeof(size_t) * c->mapCapacity)
+    );
+    for (size_t i = 0; i < oldCapacity; i += 1) {
+        if (oldKeys[i] == NULL) { continue; }
+        size_t slot = mapSlotOf(c, oldKeys[i]);
+        c->mapKeys[slot] = oldKeys[i];
+        c->mapEntries[slot] = oldEntries[i];
+    }
+    free(oldKeys);
+    free(oldEntries);
+}
+
+// Collects the given buffer, returning false if it has already been
+// collected or may not be moved.
+static bool collect(
+    bigton_compactor_t *c, const void *buffer, size_t newSize,
+    bigton_compact_kind_t kind
+) {
+    if (buffer == NULL || bigtonBuffIsShared(buffer)) { return false; }
+    if ((c->entriesCount + 1) * 2 > c->mapCapacity) { growMap(c); }
+    size_t slot = mapSlotOf(c, buffer);
+    if (c->mapKeys[slot] != NULL) { return false; }
+    c->mapKeys[slot] = buffer;
+    c->mapEntries[slot] = c->entriesCount;
+    if (c->entriesCount >= c->entriesCapacity) {
+        c->entriesCapacity = c->entriesCapacity == 0
+            ? 256 : c->entriesCapacity * 2;
+        c->entries = bigtonCheckAllocated(realloc(
+            c->entries, sizeof(bigton_compact_entry_t) * c->entriesCapacity
+        ));
+    }
+    c->entries[c->entriesCount] = (bigton_compact_entry_t) {
+        .old = buffer,
+        .moved = NULL,
+        .newSize = newSize,
+        .kind = kind
+    };
+    c->entriesCount += 1;
+    return true;
+}
+
+// Buffers of size zero are not moved, since moving them would replace them
+// with NULL (which is only expected for the contents of arrays).
+static void collectSameSize(bigton_compactor_t *c, const void *buffer) {
+    if (buffer == NULL) { return; }
+    size_t sizeBytes = BIGTON_BUFF_HEADER(buffer)->sizeBytes;
+    if (sizeBytes == 0) { return; }
+    collect(c, buffer, sizeBytes, BIGTONCK_RAW);
+}
+
+static void pushPending(bigton_compactor_t *c, bigton_tagged_value_t v) {
+    if (c->pendingCount >= c->pendingCapacity) {
+        c->pendingCapacity = c->pendingCapacity == 0
+            ? 64 : c->pendingCapacity * 2;
+        c->pending = bigtonCheckAllocated(realloc(
+            c->pending, sizeof(bigton_tagged_value_t) * c->pendingCapacity
+        ));
+    }
+    c->pending[c->pendingCount] = v;
+    c->pendingCount += 1;
+}
+
+static void pushValues(
+    bigton_compactor_t *c, size_t count,
+    const bigton_value_type_t *types, const bigton_value_t *values
+) {
+    // pushed in reverse, so that values are visited in order
+    for (size_t i = count; i > 0; i -= 1) {
+        bigton_value_type_t t = types[i - 1];
+        if (t == BIGTON_NULL || t == BIGTON_INT || t == BIGTON_FLOAT) {
+            continue;
+        }
+        pushPending(c, (bigton_tagged_value_t) {
+            .t = t, .v = values[i - 1]
+        });
+    }
+}
+
+static void visit(bigton_compactor_t *c, bigton_tagged_value_t v) {
+    switch (v.t) {
+        case BIGTON_STRING: {
+            const bigton_string_t *s = v.v.s;
+            if (!collect(c, s, sizeof(bigton_string_t), BIGTONCK_STRING)) {
+                return;
+            }
+            if (s->viewed != NULL) {
+                pushPending(c, BIGTON_STRING_VALUE(s->viewed));
+                return;
+            }
+            // the unused capacity of the string is released
+            collect(
+                c, s->content, sizeof(bigton_char_t) * s->usedLength,
+                BIGTONCK_RAW
+            );
+            return;
+        }
+        case BIGTON_TUPLE: {
+            const bigton_tuple_t *t = v.v.t;
+            if (!collect(c, t, sizeof(bigton_tuple_t), BIGTONCK_TUPLE)) {
+                return;
+            }
+            collectSameSize(c, t->valueTypes);
+            collectSameSize(c, t->values);
+            pushValues(c, t->length, t->valueTypes, t->values);
+            return;
+        }
+        case BIGTON_OBJECT: {
+            // objects shared with other runtimes are not moved, but the
+            // copies the runtime has made of them are
+            const bigton_object_t *o = bigtonObjectRead(c->r, v.v.o);
+            if (!collect(c, o, sizeof(bigton_object_t), BIGTONCK_OBJECT)) {
+                return;
+            }
+            collectSameSize(c, o->memberTypes);
+            collectSameSize(c, o->memberValues);
+            pushValues(
+                c, o->shape->propCount, o->memberTypes, o->memberValues
+            );
+            return;
+        }
+        case BIGTON_ARRAY: {
+            const bigton_array_t *a = bigtonArrayRead(c->r, v.v.a);
+            if (!collect(c, a, sizeof(bigton_array_t), BIGTONCK_ARRAY)) {
+                return;
+            }
+            if (a->viewed != NULL) {
+                pushPending(c, BIGTON_ARRAY_VALUE(a->viewed));
+                return;
+            }
+            // the unused capacity of the array is released
+            collect(
+                c, a->elementTypes,
+                sizeof(bigton_value_type_t) * a->length, BIGTONCK_RAW
+            );
+            collect(
+                c, a->elementValues,
+                sizeof(bigton_value_t) * a->length, BIGTONCK_RAW
+            );
+            if (a->packedType != BIGTON_NULL) { return; }
+            pushValues(c, a->length, a->elementTypes, a->elementValues);
+            return;
+        }
+        case BIGTON_MAP: {
+            const bigton_map_t *m = bigtonMapRead(c->r, v.v.m);
+            if (!collect(c, m, sizeof(bigton_map_t), BIGTONCK_MAP)) {
+                return;
+            }
+            collectSameSize(c, m->slotHashes);
+            collectSameSize(c, m->slotTypes);
+            collectSameSize(c, m->slotValues);
+            pushValues(
+                c, (size_t) m->capacity * 2, m->slotTypes, m->slotValues
+            );
+            return;
+        }
+        default:
+            return;
+    }
+}
+
+static void visitPending(bigton_compactor_t *c) {
+    while (c->pendingCount > 0) {
+        c->pendingCount -= 1;
+        visit(c, c->pending[c->pendingCount]);
+    }
+}
+
+static void visitValues(
+    bigton_compactor_t *c, size_t count,
+    const bigton_value_type_t *types, const bigton_value_t *values
+) {
+    pushValues(c, count, types, values);
+    visitPending(c);
+}
+
+static void collectRoots(bigton_compactor_t *c) {
+    bigton_runtime_state_t *r = c->r;
+    collectSameSize(c, r->globalTypes);
+    collectSameSize(c, r->globalValues);
+    collectSameSize(c, r->constStrings);
+    collectSameSize(c, r->stack.types);
+    collectSameSize(c, r->stack.values);
+    collectSameSize(c, r->locals.types);
+    collectSameSize(c, r->locals.values);
+    collectSameSize(c, r->scopes);
+    collectSameSize(c, r->trace);
+    collectSameSize(c, r->logs);
+    collectSameSize(c, r->cow.keys);
+    collectSameSize(c, r->cow.copies);
+    visitValues(c, r->program.numGlobals, r->globalTypes, r->globalValues);
+    visitValues(c, r->stack.count, r->stack.types, r->stack.values);
+    visitValues(c, r->locals.count, r->locals.types, r->locals.values);
+    for (size_t i = 0; i < r->logsCount; i += 1) {
+        visit(c, BIGTON_STRING_VALUE(r->logs[i]));
+    }
+    for (size_t i = 0; i < r->program.numConstStrings; i += 1) {
+        if (r->constStrings[i] == NULL) { continue; }
+        visit(c, BIGTON_STRING_VALUE(r->constStrings[i]));
+    }
+    for (
+        bigton_host_value_t *h = r->hostValues;
+        h != NULL; h = h->next
+    ) {
+        visit(c, h->value);
+        visitPending(c);
+    }
+}
+
+
+// Returns the new location of the given buffer, or the buffer itself if it
+// has not been moved.
+static void *forward(const bigton_compactor_t *c, const void *buffer) {
+    if (buffer == NULL || c->mapCapacity == 0) { return (void *) buffer; }
+    size_t slot = mapSlotOf(c, buffer);
+    if (c->mapKeys[slot] == NULL) { return (void *) buffer; }
+    return c->entries[c->mapEntries[slot]].moved;
+}
+
+static void forwardValues(
+    const bigton_compactor_t *c, size_t count,
+    const bigton_value_type_t *types, bigton_value_t *values
+) {
+    for (size_t i = 0; i < count; i += 1) {
+        switch (types[i]) {
+            case BIGTON_STRING:
+            case BIGTON_TUPLE:
+            case BIGTON_OBJECT:
+            case BIGTON_ARRAY:
+            case BIGTON_MAP:
+                // all object types are pointers at the same location
+                values[i].s = forward(c, values[i].s);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void forwardEntry(
+    const bigton_compactor_t *c, const bigton_compact_entry_t *e
+) {
+    switch (e->kind) {
+        case BIGTONCK_STRING: {
+            bigton_string_t *s = e->moved;
+            if (s->viewed != NULL) {
+                // the old location of the viewed string is only freed at the
+                // end, and still points to the old location of the content
+                size_t offset = (size_t) (s->content - s->viewed->content);
+                s->content = (const bigton_char_t *)
+                    forward(c, s->viewed->content) + offset;
+                s->viewed = forward(c, s->viewed);
+                return;
+            }
+            s->content = forward(c, s->content);
+            return;
+        }
+        case BIGTONCK_TUPLE: {
+            bigton_tuple_t *t = e->moved;
+            t->valueTypes = forward(c, t->valueTypes);
+            t->values = forward(c, t->values);
+            forwardValues(
+                c, t->length, t->valueTypes, (bigton_value_t *) t->values
+            );
+            return;
+        }
+        case BIGTONCK_OBJECT: {
+            bigton_object_t *o = e->moved;
+            o->memberTypes = forward(c, o->memberTypes);
+            o->memberValues = forward(c, o->memberValues);
+            forwardValues(
+                c, o->shape->propCount, o->memberTypes, o->memberValues
+            );
+            return;
+        }
+        case BIGTONCK_ARRAY: {
+            bigton_array_t *a = e->moved;
+            if (a->viewed != NULL) {
+                // same as for strings, the elements are referenced (and
+                // forwarded) by the viewed array
+                size_t offset = (size_t)
+                    (a->elementValues - a->viewed->elementValues);
+                if (a->elementTypes != NULL) {
+                    a->elementTypes = (bigton_value_type_t *)
+                        forward(c, a->viewed->elementTypes) + offset;
+                }
+                a->elementValues = (bigton_value_t *)
+                    forward(c, a->viewed->elementValues) + offset;
+                a->viewed = forward(c, a->viewed);
+                return;
+            }
+            a->capacity = a->length;
+            a->elementTypes = forward(c, a->elementTypes);
+            a->elementValues = forward(c, a->elementValues);
+            if (a->packedType != BIGTON_NULL) { return; }
+            forwardValues(c, a->length, a->elementTypes, a->elementValues);
+            return;
+        }
+        case BIGTONCK_MAP: {
+            bigton_map_t *m = e->moved;
+            m->slotHashes = forward(c, m->slotHashes);
+            m->slotTypes = forward(c, m->slotTypes);
+            m->slotValues = forward(c, m->slotValues);
+            forwardValues(
+                c, (size_t) m->capacity * 2, m->slotTypes, m->slotValues
+            );
+            return;
+        }
+        default:
+            return;
+    }
+}
+
+static void forwardRoots(const bigton_compactor_t *c) {
+    bigton_runtime_state_t *r = c->r;
+    r->globalTypes = forward(c, r->globalTypes);
+    r->globalValues = forward(c, r->globalValues);
+    r->constStrings = forward(c, r->constStrings);
+    r->stack.types = forward(c, r->stack.types);
+    r->stack.values = forward(c, r->stack.values);
+    r->locals.types = forward(c, r->locals.types);
+    r->locals.values = forward(c, r->locals.values);
+    r->scopes = forward(c, r->scopes);
+    r->trace = forward(c, r->trace);
+    r->logs = forward(c, r->logs);
+    r->cow.keys = forward(c, r->cow.keys);
+    r->cow.copies = forward(c, r->cow.copies);
+    forwardValues(c, r->program.numGlobals, r->globalTypes, r->globalValues);
+    forwardValues(c, r->stack.count, r->stack.types, r->stack.values);
+    forwardValues(c, r->locals.count, r->locals.types, r->locals.values);
+    for (size_t i = 0; i < r->logsCount; i += 1) {
+        r->logs[i] = forward(c, r->logs[i]);
+    }
+    for (size_t i = 0; i < r->program.numConstStrings; i += 1) {
+        r->constStrings[i] = forward(c, r->constStrings[i]);
+    }
+    // keys are shared and never moved
+    for (size_t i = 0; i < r->cow.capacity; i += 1) {
+        if (r->cow.keys[i] == NULL) { continue; }
+        r->cow.copies[i] = forward(c, r->cow.copies[i]);
+    }
+    for (
+        bigton_host_value_t *h = r->hostValues;
+        h != NULL; h = h->next
+    ) {
+        forwardValues(c, 1, &h->value.t, &h->value.v);
+    }
+}
+
+
+bigton_compact_stats_t bigtonCompact(bigton_runtime_state_t *r) {
+    uint64_t start = bigtonNanosNow();
+    bigton_compact_stats_t stats = (bigton_compact_stats_t) {
+        .movedBuffers = 0,
+        .movedBytes = 0,
+        .reclaimedBytes = 0,
+        .elapsedNanos = 0
+    };
+    if (r->hibernated != NULL) { return stats; }
+    bigtonFreePending(&r->b, SIZE_MAX);
+    bigtonCollectCycles(r, SIZE_MAX);
+    bigton_compactor_t c = (bigton_compactor_t) {
+        .r = r,
+        .entriesCapacity = 0,
+        .entriesCount = 0,
+        .entries = NULL,
+        .mapCapacity = 0,
+        .mapKeys = NULL,
+        .mapEntries = NULL,
+        .pendingCapacity = 0,
+        .pendingCount = 0,
+        .pending = NULL
+    };
+    collectRoots(&c);
+    size_t sizeBefore = r->b.totalSizeBytes;
+    size_t *sizes = bigtonCheckAllocated(
+        malloc(sizeof(size_t) * (c.entriesCount + 1))
+    );
+    void **moved = bigtonCheckAllocated(
+        malloc(sizeof(void *) * (c.entriesCount + 1))
+    );
+    for (size_t i = 0; i < c.entriesCount; i += 1) {
+        sizes[i] = c.entries[i].newSize;
+    }
+    bigtonAllocArena(&r->b, c.entriesCount, sizes, moved);
+    for (size_t i = 0; i < c.entriesCount; i += 1) {
+        bigton_compact_entry_t *e = &c.entries[i];
+        e->moved = moved[i];
+        if (e->moved != NULL) {
+            memcpy(e->moved, e->old, e->newSize);
+            stats.movedBuffers += 1;
+            stats.movedBytes += e->newSize;
+        }
+    }
+    for (size_t i = 0; i < c.entriesCount; i += 1) {
+        if (c.entries[i].moved == NULL) { continue; }
+        forwardEntry(&c, &c.entries[i]);
+    }
+    forwardRoots(&c);
+    for (size_t i = 0; i < c.entriesCount; i += 1) {
+        bigtonFreeBuff(c.entries[i].old);
+    }
+    stats.reclaimedBytes = sizeBefore - r->b.totalSizeBytes;
+    free(sizes);
+    free(moved);
+    free(c.entries);
+    free(c.mapKeys);
+    free(c.mapEntries);
+    free(c.pending);
+    stats.elapsedNanos = bigtonNanosNow() - start;
+    return stats;
+}
@@ -0,0 +1,93 @@
+
+#include <bigton/compress.h>
+#include <bigton/encoding.h>
+
+#define MIN_MATCH 4
+#define HASH_BITS 13
+#define MAX_OFFSET (1 << 16)
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(uint32_t));
+    return v;
+}
+
+static size_t hashAt(const uint8_t *p) {
+    return (size_t) ((read32(p) * 2654435761U) >> (32 - HASH_BITS));
+}
+
+uint8_t *bigtonCompress(const uint8_t *data, size_t size, size_t *sizeOut) {
+    bigton_writer_t out = BIGTON_WRITER_INIT;
+    bigtonWriterReserve(&out, size / 2 + 16);
+    // positions are stored plus one, so that zero means "no position"
+    size_t *table = calloc((size_t) 1 << HASH_BITS, sizeof(size_t));
+    size_t literalStart = 0;
+    size_t i = 0;
+    while (size >= MIN_MATCH && i <= size - MIN_MATCH) {
+        size_t h = hashAt(data + i);
+        size_t candidate = table[h];
+        table[h] = i + 1;
+        bool isMatch = candidate != 0
+            && i - (candidate - 1) <= MAX_OFFSET
+            && read32(data + candidate - 1) == read32(data + i);
+        if (!isMatch) {
+            i += 1;
+            continue;
+        }
+        size_t matchStart = candidate - 1;
+        size_t length = MIN_MATCH;
+        while (
+            i + length < size && data[matchStart + length] == data[i + length]
+        ) {
+            length += 1;
+        }
+        bigtonWriteVarint(&out, i - literalStart);
+        bigtonWriteBytes(&out, data + literalStart, i - literalStart);
+        bigtonWriteVarint(&out, length - MIN_MATCH);
+        bigtonWriteVarint(&out, i - matchStart);
+        i += length;
+        literalStart = i;
+    }
+    bigtonWriteVarint(&out, size - literalStart);
+    bigtonWriteBytes(&out, data + literalStart, size - literalStart);
+    free(table);
+    *sizeOut = out.size;
+    return out.data;
+}
+
+uint8_t *bigtonDecompress(
+    const uint8_t *compressed, size_t compressedSize, size_t rawSize
+) {
+    bigton_reader_t in = {
+        .p = compressed, .end = compressed + compressedSize, .failed = false
+    };
+    uint8_t *out = malloc(rawSize == 0 ? 1 : rawSize);
+    size_t outSize = 0;
+    for (;;) {
+        uint64_t literalLength = bigtonReadVarint(&in);
+        bool validLiteral = !in.failed
+            && literalLength <= (uint64_t) (in.end - in.p)
+            && literalLength <= rawSize - outSize;
+        if (!validLiteral) { break; }
+        memcpy(out + outSize, in.p, (size_t) literalLength);
+        in.p += literalLength;
+        outSize += (size_t) literalLength;
+        if (in.p == in.end) {
+            if (outSize == rawSize) { return out; }
+            break;
+        }
+        uint64_t length = bigtonReadVarint(&in) + MIN_MATCH;
+        uint64_t offset = bigtonReadVarint(&in);
+        bool validMatch = !in.failed
+            && offset != 0 && offset <= outSize
+            && length <= rawSize - outSize;
+        if (!validMatch) { break; }
+        // matches may overlap with the bytes they produce
+        for (size_t j = 0; j < (size_t) length; j += 1) {
+            out[outSize + j] = out[outSize - (size_t) offset + j];
+        }
+        outSize += (size_t) length;
+    }
+    free(out);
+    return NULL;
+}
@@ -0,0 +1,427 @@
+
+#include <bigton/runtime.h>
+#include <bigton/util.h>
+#include <stdlib.h>
+
+// Synchronous cycle collection by trial deletion (Bacon and Rajan, 2001).
+// Reference cycles can only pass through tuples, objects, arrays and maps,
+// which are recorded as possible cycle roots whenever their reference count is
+// decremented without reaching zero. Collecting then happens in three phases:
+//
+// 1. Mark: starting from the roots, all reachable values are colored gray and
+//    the reference counts of their children are decremented, removing all
+//    references that originate from within the traversed values.
+// 2. Scan: gray values with a remaining (external) reference count are
+//    reachable from the outside, which is why they (and all values reachable
+//    from them) are colored black again and have their references restored.
+//    All other gray values are colored white.
+// 3. Collect: all white values are garbage and are freed.
+//
+// Values shared with other runtimes (see 'bigtonFork') are neither reference
+// counted nor traversed. All traversals use explicit stacks, since values may
+// be nested arbitrarily deep.
+
+
+typedef enum BigtonCycleColor {
+    BIGTONCC_BLACK = 0,
+    BIGTONCC_GRAY = 1,
+    BIGTONCC_WHITE = 2
+} bigton_cycle_color_t;
+
+// Number of possible cycle roots at which collecting is due regardless of
+// the memory usage of the runtime.
+#define CYCLE_ROOTS_TRIGGER 1024
+// Maximum number of possible cycle roots of a single owner, dictated by the
+// size of 'bigton_rc_t.rootIdx'.
+#define MAX_CYCLE_ROOTS ((1 << 30) - 1)
+
+
+static bool isCollectable(bigton_tagged_value_t v) {
+    switch (v.t) {
+        case BIGTON_TUPLE: return !bigtonBuffIsShared(v.v.t);
+        case BIGTON_OBJECT: return !bigtonBuffIsShared(v.v.o);
+        case BIGTON_ARRAY: return !bigtonBuffIsShared(v.v.a);
+        case BIGTON_MAP: return !bigtonBuffIsShared(v.v.m);
+        default: return false;
+    }
+}
+
+// May only be called for tuples, objects, arrays and maps.
+static bigton_rc_t *rcOf(bigton_tagged_value_t v) {
+    switch (v.t) {
+        case BIGTON_TUPLE: return &v.v.t->rc;
+        case BIGTON_OBJECT: return &v.v.o->rc;
+        case BIGTON_MAP: return &v.v.m->rc;
+        default: return &v.v.a->rc;
+    }
+}
+
+static const bigton_value_type_t viewedType = BIGTON_ARRAY;
+
+static size_t childrenOf(
+    bigton_tagged_value_t v,
+    const bigton_value_type_t **types, const bigton_value_t **values
+) {
+    switch (v.t) {
+        case BIGTON_TUPLE:
+            *types = v.v.t->valueTypes;
+            *values = v.v.t->values;
+            return v.v.t->length;
+        case BIGTON_OBJECT:
+            *types = v.v.o->memberTypes;
+            *values = v.v.o->memberValues;
+            return v.v.o->shape->propCount;
+        case BIGTON_ARRAY:
+            if (v.v.a->viewed != NULL) {
+                // views only reference the array holding their elements
+                *types = &viewedType;
+                *values = (const bigton_value_t *) &v.v.a->viewed;
+                return 1;
+            }
+            // packed arrays only hold ints or floats
+            if (v.v.a->packedType != BIGTON_NULL) { return 0; }
+            *types = v.v.a->elementTypes;
+            *values = v.v.a->elementValues;
+            return v.v.a->length;
+        case BIGTON_MAP:
+            // empty slots hold null
+            *types = v.v.m->slotTypes;
+            *values = v.v.m->slotValues;
+            return (size_t) v.v.m->capacity * 2;
+        default:
+            return 0;
+    }
+}
+
+static bigton_buff_owner_t *ownerOf(bigton_tagged_value_t v) {
+    return BIGTON_BUFF_HEADER(v.v.t)->owner;
+}
+
+
+void bigtonCycleRootsAdd(bigton_tagged_value_t value) {
+    bigton_cycle_roots_t *roots = &ownerOf(value)->cycleRoots;
+    if (roots->count >= MAX_CYCLE_ROOTS) { return; }
+    if (roots->count >= roots->capacity) {
+        roots->capacity = roots->capacity == 0 ? 64 : roots->capacity * 2;
+        roots->values = bigtonCheckAllocated(realloc(
+            roots->values, sizeof(bigton_tagged_value_t) * roots->capacity
+        ));
+    }
+    roots->values[roots->count] = value;
+    roots->count += 1;
+    rcOf(value)->rootIdx = (uint32_t) roots->count;
+}
+
+void bigtonCycleRootsRemove(bigton_tagged_value_t value) {
+    bigton_cycle_roots_t *roots = &ownerOf(value)->cycleRoots;
+    bigton_rc_t *rc = rcOf(value);
+    size_t i = rc->rootIdx - 1;
+    rc->rootIdx = 0;
+    roots->count -= 1;
+    if (i == roots->count) { return; }
+    bigton_tagged_value_t last = roots->values[roots->count];
+    roots->values[i] = last;
+    rcOf(last)->rootIdx = (uint32_t) (i + 1);
+}
+
+
+typedef struct BigtonCycleStack {
+    size_t capacity;
+    size_t count;
+    bigton_tagged_value_t *values;
+} bigton_cycle_stack_t;
+
+static void stackPush(bigton_cycle_stack_t *s, bigton_tagged_value_t v) {
+    if (s->count >= s->capacity) {
+        s->capacity = s->capacity == 0 ? 64 : s->capacity * 2;
+        s->values = bigtonCheckAllocated(realloc(
+            s->values, sizeof(bigton_tagged_value_t) * s->capacity
+        ));
+    }
+    s->values[s->count] = v;
+    s->count += 1;
+}
+
+typedef struct BigtonCycleCollection {
+    // possible cycle roots taken from the owner for this collection
+    size_t rootsCount;
+    bigton_tagged_value_t *roots;
+    bigton_cycle_stack_t pending;
+    bigton_cycle_stack_t garbage;
+    size_t visited;
+} bigton_cycle_collection_t;
+
+// Colors all values reachable from the roots that are not gray already
+// gray, decrementing the reference counts of their children. A value is only
+// colored gray once the counts of all of its children have been decremented.
+// Returns false (and stops) if more than 'budget' values would be visited.
+static bool markGray(bigton_cycle_collection_t *c, size_t budget) {
+    for (size_t i = 0; i < c->rootsCount; i += 1) {
+        stackPush(&c->pending, c->roots[i]);
+        while (c->pending.count > 0) {
+            c->pending.count -= 1;
+            bigton_tagged_value_t v = c->pending.values[c->pending.count];
+            bigton_rc_t *rc = rcOf(v);
+            if (rc->color == BIGTONCC_GRAY) { continue; }
+            if (c->visited >= budget) {
+                c->pending.count = 0;
+                return false;
+            }
+            c->visited += 1;
+            rc->color = BIGTONCC_GRAY;
+            const bigton_value_type_t *types;
+            const bigton_value_t *values;
+            size_t count = childrenOf(v, &types, &values);
+            for (size_t j = 0; j < count; j += 1) {
+                bigton_tagged_value_t child = (bigton_tagged_value_t) {
+                    .t = types[j], .v = values[j]
+                };
+                if (!isCollectable(child)) { continue; }
+                bigton_rc_t *childRc = rcOf(child);
+                childRc->count -= 1;
+                if (childRc->color != BIGTONCC_GRAY) {
+                    stackPush(&c->pending, child);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Colors the given value and all values reachable from it that are not black
+// black, restoring the reference counts of their children.
+static void scanBlack(
+    bigton_cycle_collection_t *c, bigton_tagged_value_t start
+) {
+    stackPush(&c->pending, start);
+    while (c->pending.count > 0) {
+        c->pending.count -= 1;
+        bigton_tagged_value_t v = c->pending.values[c->pending.count];
+        bigton_rc_t *rc = rcOf(v);
+        if (rc->color == BIGTONCC_BLACK) { continue; }
+        rc->color = BIGTONCC_BLACK;
+        const bigton_value_type_t *types;
+        const bigton_value_t *values;
+        size_t count = childrenOf(v, &types, &values);
+        for (size_t j = 0; j < count; j += 1) {
+            bigton_tagged_value_t child = (bigton_tagged_value_t) {
+                .t = types[j], .v = values[j]
+            };
+            if (!isCollectable(child)) { continue; }
+            bigton_rc_t *childRc = rcOf(child);
+            childRc->count += 1;
+            if (childRc->color != BIGTONCC_BLACK) {
+                stackPush(&c->pending, child);
+            }
+        }
+    }
+}
+
+static void scan(bigton_cycle_collection_t *c) {
+    bigton_cycle_stack_t whiteCandidates = (bigton_cycle_stack_t) {
+        .capacity = 0, .count = 0, .values = NULL
+    };
+    for (size_t i = 0; i < c->rootsCount; i += 1) {
+        stackPush(&whiteCandidates, c->roots[i]);
+        while (whiteCandidates.count > 0) {
+            whiteCandidates.count -= 1;
+            bigton_tagged_value_t v
+                = whiteCandidates.values[whiteCandidates.count];
+            bigton_rc_t *rc = rcOf(v);
+            if (rc->color != BIGTONCC_GRAY) { continue; }
+            if (rc->count > 0) {
+                scanBlack(c, v);
+                continue;
+            }
+            rc->color = BIGTONCC_WHITE;
+            const bigton_value_type_t *types;
+            const bigton_value_t *values;
+            size_t count = childrenOf(v, &types, &values);
+            for (size_t j = 0; j < count; j += 1) {
+                bigton_tagged_value_t child = (bigton_tagged_value_t) {
+                    .t = types[j], .v = values[j]
+                };
+                if (isCollectable(child)) {
+                    stackPush(&whiteCandidates, child);
+                }
+            }
+        }
+    }
+    free(whiteCandidates.values);
+}
+
+// Moves all white values reachable from the roots to the garbage (coloring
+// them black, so that each is only added once), and returns the number of
+// roots that were garbage and not reachable from any other garbage root.
+static size_t collectWhite(bigton_cycle_collection_t *c) {
+    size_t cycles = 0;
+    for (size_t i = 0; i < c->rootsCount; i += 1) {
+        bigton_rc_t *rootRc = rcOf(c->roots[i]);
+        if (rootRc->color != BIGTONCC_WHITE) { continue; }
+        cycles += 1;
+        rootRc->color = BIGTONCC_BLACK;
+        stackPush(&c->pending, c->roots[i]);
+        while (c->pending.count > 0) {
+            c->pending.count -= 1;
+            bigton_tagged_value_t v = c->pending.values[c->pending.count];
+            stackPush(&c->garbage, v);
+            const bigton_value_type_t *types;
+            const bigton_value_t *values;
+            size_t count = childrenOf(v, &types, &values);
+            for (size_t j = 0; j < count; j += 1) {
+                bigton_tagged_value_t child = (bigton_tagged_value_t) {
+                    .t = types[j], .v = values[j]
+                };
+                if (!isCollectable(child)) { continue; }
+                bigton_rc_t *childRc = rcOf(child);
+                if (childRc->color != BIGTONCC_WHITE) { continue; }
+                childRc->color = BIGTONCC_BLACK;
+                stackPush(&c->pending, child);
+            }
+        }
+    }
+    return cycles;
+}
+
+// Releases the values referenced by a garbage value that are not collectable
+// (and have therefore not been traversed). Collectable values referenced by
+// garbage are either garbage themselves or already had their reference counts
+// decremented while marking.
+static void releaseGarbageChildren(bigton_tagged_value_t v) {
+    if (rcOf(v)->rootIdx != 0) { bigtonCycleRootsRemove(v); }
+    const bigton_value_type_t *types;
+    const bigton_value_t *values;
+    size_t count = childrenOf(v, &types, &values);
+    for (size_t j = 0; j < count; j += 1) {
+        bigton_tagged_value_t child = (bigton_tagged_value_t) {
+            .t = types[j], .v = values[j]
+        };
+        if (!isCollectable(child)) { bigtonValRcDecr(child); }
+    }
+}
+
+static void freeGarbage(bigton_tagged_value_t v) {
+    switch (v.t) {
+        case BIGTON_TUPLE:
+            bigtonFreeNullableBuff(v.v.t->valueTypes);
+            bigtonFreeNullableBuff(v.v.t->values);
+            bigtonFreeBuff(v.v.t);
+            break;
+        case BIGTON_OBJECT:
+            bigtonFreeNullableBuff(v.v.o->memberTypes);
+            bigtonFreeNullableBuff(v.v.o->memberValues);
+            bigtonFreeBuff(v.v.o);
+            break;
+        case BIGTON_MAP:
+            bigtonFreeNullableBuff(v.v.m->slotHashes);
+            bigtonFreeNullableBuff(v.v.m->slotTypes);
+            bigtonFreeNullableBuff(v.v.m->slotValues);
+            bigtonFreeBuff(v.v.m);
+            break;
+        default:
+            if (v.v.a->viewed == NULL) {
+                bigtonFreeNullableBuff(v.v.a->elementTypes);
+                bigtonFreeNullableBuff(v.v.a->elementValues);
+            }
+            bigtonFreeBuff(v.v.a);
+            break;
+    }
+}
+
+
+static bool collectCycles(
+    bigton_runtime_state_t *r, size_t budget, size_t *visited
+) {
+    uint64_t start = bigtonNanosNow();
+    bigton_cycle_roots_t *ownerRoots = &r->b.cycleRoots;
+    // the most recent roots are taken first, with at most one root for each
+    // value that may be visited
+    size_t takenCount = ownerRoots->count < budget
+        ? ownerRoots->count : budget;
+    bigton_cycle_collection_t c = (bigton_cycle_collection_t) {
+        .rootsCount = 0,
+        .roots = takenCount == 0 ? NULL : bigtonCheckAllocated(
+            malloc(sizeof(bigton_tagged_value_t) * takenCount)
+        ),
+        .pending = (bigton_cycle_stack_t) {
+            .capacity = 0, .count = 0, .values = NULL
+        },
+        .garbage = (bigton_cycle_stack_t) {
+            .capacity = 0, .count = 0, .values = NULL
+        },
+        .visited = 0
+    };
+    // roots may have become shared since they were recorded, and shared
+    // values may no longer be modified
+    for (size_t i = 0; i < takenCount; i += 1) {
+        ownerRoots->count -= 1;
+        bigton_tagged_value_t root = ownerRoots->values[ownerRoots->count];
+        if (!isCollectable(root)) { continue; }
+        rcOf(root)->rootIdx = 0;
+        c.roots[c.rootsCount] = root;
+        c.rootsCount += 1;
+    }
+    bigton_cycle_stats_t *stats = &r->cycles.stats;
+    bool completed = markGray(&c, budget);
+    if (completed) {
+        scan(&c);
+        stats->collectedCycles += collectWhite(&c);
+        stats->collectedValues += c.garbage.count;
+        // garbage may reference other garbage, which is why nothing is freed
+        // before all references have been released
+        for (size_t i = 0; i < c.garbage.count; i += 1) {
+            releaseGarbageChildren(c.garbage.values[i]);
+        }
+        for (size_t i = 0; i < c.garbage.count; i += 1) {
+            freeGarbage(c.garbage.values[i]);
+        }
+        stats->collections += 1;
+    } else {
+        // every gray value is reachable from a root through gray values,
+        // meaning that coloring the roots black restores all counts
+        for (size_t i = 0; i < c.rootsCount; i += 1) {
+            scanBlack(&c, c.roots[i]);
+            bigtonCycleRootsAdd(c.roots[i]);
+        }
+        stats->abortedCollections += 1;
+    }
+    free(c.roots);
+    free(c.pending.values);
+    free(c.garbage.values);
+    uint64_t pause = bigtonNanosNow() - start;
+    stats->totalPauseNanos += pause;
+    if (pause > stats->maxPauseNanos) { stats->maxPauseNanos = pause; }
+    *visited = c.visited;
+    return completed;
+}
+
+bool bigtonCollectCycles(bigton_runtime_state_t *r, size_t budget) {
+    if (r->hibernated != NULL || r->b.cycleRoots.count == 0) { return true; }
+    size_t visited;
+    bool completed = collectCycles(r, budget, &visited);
+    return completed && r->b.cycleRoots.count == 0;
+}
+
+void bigtonCollectCyclesIfDue(bigton_runtime_state_t *r) {
+    bigton_cycle_collector_t *c = &r->cycles;
+    if (r->b.cycleRoots.count == 0) { return; }
+    c->credit += BIGTON_CYCLE_CREDIT_PER_TICK;
+    if (c->credit > BIGTON_MAX_CYCLE_CREDIT) {
+        c->credit = BIGTON_MAX_CYCLE_CREDIT;
+    }
+    bool isDue = r->b.totalSizeBytes >= r->settings.memoryUsageLimit / 2
+        || r->b.cycleRoots.count >= CYCLE_ROOTS_TRIGGER;
+    if (!isDue || c->credit < c->requiredCredit) { return; }
+    size_t visited;
+    if (collectCycles(r, c->credit, &visited)) {
+        c->credit -= visited;
+        c->requiredCredit = 0;
+        return;
+    }
+    // the next attempt is postponed until it may visit twice as many values
+    c->requiredCredit = c->credit * 2;
+    if (c->requiredCredit > BIGTON_MAX_CYCLE_CREDIT) {
+        c->requiredCredit = BIGTON_MAX_CYCLE_CREDIT;
+    }
+    c->credit = 0;
+}
@@ -111,6 +111,38 @@ static void bigtonDebugPrintInstr(
             printf("CALL_BUILTIN id=%" PRIu32, a.calledBuiltin);
             break;
         case BIGTONIR_RETURN: printf("RETURN"); break;
+        case BIGTONIR_ARRAY_PUSH: printf("ARRAY_PUSH"); break;
+        case BIGTONIR_ARRAY_POP: printf("ARRAY_POP"); break;
+        case BIGTONIR_ARRAY_LENGTH: printf("ARRAY_LENGTH"); break;
+        case BIGTONIR_ARRAY_INSERT: printf("ARRAY_INSERT"); break;
+        case BIGTONIR_ARRAY_REMOVE: printf("ARRAY_REMOVE"); break;
+        case BIGTONIR_ARRAY_SUM: printf("ARRAY_SUM"); break;
+        case BIGTONIR_ARRAY_MIN: printf("ARRAY_MIN"); break;
+        case BIGTONIR_ARRAY_MAX: printf("ARRAY_MAX"); break;
+        case BIGTONIR_ARRAY_ARGMIN: printf("ARRAY_ARGMIN"); break;
+        case BIGTONIR_ARRAY_SCALE: printf("ARRAY_SCALE"); break;
+        case BIGTONIR_ARRAY_ADD: printf("ARRAY_ADD"); break;
+        case BIGTONIR_ARRAY_DOT: printf("ARRAY_DOT"); break;
+        case BIGTONIR_ARRAY_SORT: printf("ARRAY_SORT"); break;
+        case BIGTONIR_ARRAY_BINARY_SEARCH:
+            printf("ARRAY_BINARY_SEARCH");
+            break;
+        case BIGTONIR_ARRAY_INDEX_OF: printf("ARRAY_INDEX_OF"); break;
+        case BIGTONIR_ARRAY_CONTAINS: printf("ARRAY_CONTAINS"); break;
+        case BIGTONIR_MAP_CREATE: printf("MAP_CREATE"); break;
+        case BIGTONIR_MAP_GET: printf("MAP_GET"); break;
+        case BIGTONIR_MAP_SET: printf("MAP_SET"); break;
+        case BIGTONIR_MAP_HAS: printf("MAP_HAS"); break;
+        case BIGTONIR_MAP_KEYS: printf("MAP_KEYS"); break;
+        case BIGTONIR_TUPLE_ADD: printf("TUPLE_ADD"); break;
+        case BIGTONIR_TUPLE_SUBTRACT: printf("TUPLE_SUBTRACT"); break;
+        case BIGTONIR_TUPLE_MULTIPLY: printf("TUPLE_MULTIPLY"); break;
+        case BIGTONIR_TUPLE_DIVIDE: printf("TUPLE_DIVIDE"); break;
+        case BIGTONIR_FOR_RANGE:
+            printf("FOR_RANGE len=%" PRIu32, a.rangeLoopLength);
+            break;
+        case BIGTONIR_MAP_SIZE: printf("MAP_SIZE"); break;
+        case BIGTONIR_MAP_REMOVE: printf("MAP_REMOVE"); break;
     }
     putchar('\n');
 }
@@ -0,0 +1,95 @@
+
+#define BIGTON_ERROR_MACROS
+#include <bigton/runtime.h>
+#include <bigton/dispatch.h>
+#include <stdlib.h>
+
+static int compareGroupKeys(const void *a, const void *b) {
+    uint64_t ka = *((const uint64_t *) a);
+    uint64_t kb = *((const uint64_t *) b);
+    return (ka > kb) - (ka < kb);
+}
+
+size_t bigtonGroupAwaitingBuiltins(
+    const bigton_exec_result_t *results, size_t count,
+    uint32_t *order, bigton_builtin_group_t *groups
+) {
+    // builtin id in the upper half and runtime index in the lower half,
+    // making the order within each group match the order of the runtimes
+    uint64_t *keys = bigtonCheckAllocated(
+        malloc(sizeof(uint64_t) * (count == 0 ? 1 : count))
+    );
+    size_t numAwaiting = 0;
+    for (size_t i = 0; i < count; i += 1) {
+        if (results[i].status != BIGTONST_EXEC_BUILTIN_FUN) { continue; }
+        uint64_t builtinId = (uint64_t) results[i].awaitingBuiltinFun;
+        keys[numAwaiting] = (builtinId << 32) | (uint64_t) i;
+        numAwaiting += 1;
+    }
+    qsort(keys, numAwaiting, sizeof(uint64_t), &compareGroupKeys);
+    size_t numGroups = 0;
+    for (size_t i = 0; i < numAwaiting; i += 1) {
+        bigton_slot_t builtinId = (bigton_slot_t) (keys[i] >> 32);
+        order[i] = (uint32_t) keys[i];
+        bool newGroup = numGroups == 0
+            || groups[numGroups - 1].builtinId != builtinId;
+        if (newGroup) {
+            groups[numGroups] = (bigton_builtin_group_t) {
+                .builtinId = builtinId, .start = (uint32_t) i, .count = 0
+            };
+            numGroups += 1;
+        }
+        groups[numGroups - 1].count += 1;
+    }
+    free(keys);
+    return numGroups;
+}
+
+static bool isScalarType(bigton_value_type_t t) {
+    return t == BIGTON_NULL || t == BIGTON_INT || t == BIGTON_FLOAT;
+}
+
+void bigtonGatherBuiltinArgs(
+    bigton_runtime_state_t *const *runtimes, size_t count, uint32_t argc,
+    size_t stride, uint8_t *argTypes, bigton_value_t *argValues
+) {
+    for (size_t i = 0; i < count; i += 1) {
+        bigton_runtime_state_t *r = runtimes[i];
+        size_t stackLen = r->stack.count;
+        for (uint32_t a = 0; a < argc; a += 1) {
+            size_t dest = (a * stride) + i;
+            if (stackLen < argc) {
+                argTypes[dest] = BIGTON_DISPATCH_SKIP;
+                argValues[dest].i = 0;
+                continue;
+            }
+            size_t src = stackLen - argc + a;
+            bigton_value_type_t t = r->stack.types[src];
+            argTypes[dest] = (uint8_t) t;
+            if (isScalarType(t)) {
+                argValues[dest] = r->stack.values[src];
+            } else {
+                argValues[dest].i = 0;
+            }
+        }
+    }
+}
+
+void bigtonScatterBuiltinResults(
+    bigton_runtime_state_t *const *runtimes, size_t count, uint32_t argc,
+    const uint8_t *resultTypes, const bigton_value_t *resultValues
+) {
+    for (size_t i = 0; i < count; i += 1) {
+        bigton_value_type_t t = (bigton_value_type_t) resultTypes[i];
+        if (!isScalarType(t)) { continue; }
+        bigton_runtime_state_t *r = runtimes[i];
+        if (r->stack.count < argc) { continue; }
+        for (uint32_t a = 0; a < argc; a += 1) {
+            bigtonValRcDecr(bigtonStackPop(&r->stack, r));
+            if (HAS_ERROR(r)) { break; }
+        }
+        if (HAS_ERROR(r)) { continue; }
+        bigton_tagged_value_t result = { .t = t, .v = resultValues[i] };
+        bigtonStackPush(&r->stack, result, r);
+    }
+}
@@ -4,6 +4,8 @@
 #include <bigton/ir.h>
 #include <bigton/error.h>
 #include <bigton/runtime.h>
+#include <bigton/snapshot.h>
+#include <bigton/kernels.h>
 #include <stdbool.h>
 #include <string.h>
 #include <math.h>
@@ -22,10 +24,17 @@ void bigtonLogLine(bigton_runtime_state_t *r, bigton_string_t *line) {
         return; 
     }
     if (count + 1 > r->logsCapacity) {
-        r->logsCapacity += 8;
-        r->logs = bigtonReallocNullableBuff(
-            &r->b, r->logs, sizeof(bigton_string_t *) * r->logsCapacity
+        size_t capacity = r->logsCapacity + 8;
+        void *logs = r->logs;
+        bool grown = bigtonReallocValueBuff(
+            r, &logs, sizeof(bigton_string_t *) * capacity
         );
+        r->logs = logs;
+        if (!grown) {
+            bigtonValRcDecr(BIGTON_STRING_VALUE(line));
+            return;
+        }
+        r->logsCapacity = capacity;
     }
     r->logs[count] = line;
     r->logsCount += 1;
@@ -34,10 +43,14 @@ void bigtonLogLine(bigton_runtime_state_t *r, bigton_string_t *line) {
 void bigtonTracePush(bigton_runtime_state_t *r, bigton_trace_call_t t) {
     size_t oldCount = r->traceCount;
     if (oldCount >= r->traceCapacity) {
-        r->traceCapacity += 8;
-        r->trace = bigtonReallocNullableBuff(
-            &r->b, r->trace, sizeof(bigton_trace_call_t) * r->traceCapacity
+        size_t capacity = r->traceCapacity + 8;
+        void *trace = r->trace;
+        bool grown = bigtonReallocValueBuff(
+            r, &trace, sizeof(bigton_trace_call_t) * capacity
         );
+        r->trace = trace;
+        if (!grown) { return; }
+        r->traceCapacity = capacity;
     }
     r->trace[oldCount] = t;
     r->traceCount += 1;
@@ -55,13 +68,21 @@ void bigtonStackPush(
 ) {
     size_t oldCount = s->count;
     if (oldCount >= s->capacity) {
-        s->capacity += 16;
-        s->types = bigtonReallocNullableBuff(
-            &r->b, s->types, sizeof(bigton_value_type_t) * s->capacity
-        );
-        s->values = bigtonReallocNullableBuff(
-            &r->b, s->values, sizeof(bigton_value_t) * s->capacity
+        size_t capacity = s->capacity + 16;
+        void *types = s->types;
+        void *values = s->values;
+        bool grown = bigtonReallocValueBuff(
+            r, &types, sizeof(bigton_value_type_t) * capacity
+        ) && bigtonReallocValueBuff(
+            r, &values, sizeof(bigton_value_t) * capacity
         );
+        s->types = types;
+        s->values = values;
+        if (!grown) {
+            bigtonValRcDecr(value);
+            return;
+        }
+        s->capacity = capacity;
     }
     s->types[oldCount] = value.t;
     s->values[oldCount] = value.v;
@@ -114,10 +135,14 @@ bigton_tagged_value_t bigtonStackPop(
 void bigtonScopePush(bigton_runtime_state_t *r, bigton_scope_t scope) {
     size_t oldCount = r->scopesCount;
     if (oldCount >= r->scopesCapacity) {
-        r->scopesCapacity += 8;
-        r->scopes = bigtonReallocNullableBuff(
-            &r->b, r->scopes, sizeof(bigton_scope_t) * r->scopesCapacity
+        size_t capacity = r->scopesCapacity + 8;
+        void *scopes = r->scopes;
+        bool grown = bigtonReallocValueBuff(
+            r, &scopes, sizeof(bigton_scope_t) * capacity
         );
+        r->scopes = scopes;
+        if (!grown) { return; }
+        r->scopesCapacity = capacity;
     }
     r->scopes[oldCount] = scope;
     r->scopesCount = oldCount + 1;
@@ -139,6 +164,33 @@ static void bigtonScopeReset(bigton_runtime_state_t *r, bigton_scope_t *s) {
     s->numLocals = 0;
 }
 
+// Advances the range loop that is the current scope to its next iteration,
+// freeing the locals declared by its body, or ends the loop once the
+// induction variable reaches the bound.
+static void stepRange(bigton_runtime_state_t *r, bigton_scope_t *s) {
+    while (s->numLocals > BIGTON_RANGE_LOCALS) {
+        bigtonValRcDecr(bigtonStackPop(&r->locals, r));
+        s->numLocals -= 1;
+    }
+    size_t idx = r->locals.count - 1;
+    bigton_tagged_value_t iv = bigtonStackAt(&r->locals, idx, r);
+    bigton_tagged_value_t end = bigtonStackAt(&r->locals, idx - 1, r);
+    if (HAS_ERROR(r)) { return; }
+    if (iv.t != BIGTON_INT || end.t != BIGTON_INT) {
+        r->error = BIGTONE_OPERAND_NOT_INTEGER;
+        return;
+    }
+    r->accCost += BIGTON_RANGE_STEP_COST + BIGTON_RANGE_CHECK_COST;
+    bigton_int_t next = (bigton_int_t) ((uint64_t) iv.v.i + 1);
+    if (next >= end.v.i) {
+        r->currentInstr = s->after;
+        bigtonScopePop(r);
+        return;
+    }
+    bigtonStackSet(&r->locals, idx, BIGTON_INT_VALUE(next), r);
+    r->currentInstr = s->start;
+}
+
 void bigtonScopePop(bigton_runtime_state_t *r) {
     size_t oldCount = r->scopesCount;
     if (oldCount == 0) {
@@ -195,6 +247,104 @@ static void assertGlobalVarValid(bigton_runtime_state_t *r, bigton_slot_t id) {
     bigtonValRcDecr(av); \
     bigtonValRcDecr(bv);
 
+// Returns the value paired with the member at the given index of the other
+// operand of a tuple arithmetic instruction.
+static inline bigton_tagged_value_t tupleOperandAt(
+    bigton_tagged_value_t v, size_t i
+) {
+    if (v.t != BIGTON_TUPLE) { return v; }
+    return (bigton_tagged_value_t) {
+        .t = v.v.t->valueTypes[i], .v = v.v.t->values[i]
+    };
+}
+
+// Allocates the result of a tuple arithmetic instruction (see
+// 'BIGTONIR_TUPLE_ADD') with the types of all members already set, or returns
+// NULL if the operands can not be combined. Since all members are numbers,
+// the flat length of the result is the same as its length.
+static bigton_tuple_t *allocTupleArithmeticResult(
+    bigton_runtime_state_t *r, bigton_tagged_value_t av,
+    bigton_tagged_value_t bv
+) {
+    if (HAS_ERROR(r)) { return NULL; }
+    bool aIsTuple = av.t == BIGTON_TUPLE;
+    bool bIsTuple = bv.t == BIGTON_TUPLE;
+    if (!aIsTuple && !bIsTuple) {
+        r->error = BIGTONE_OPERAND_NOT_TUPLE;
+        return NULL;
+    }
+    size_t length = aIsTuple ? av.v.t->length : bv.v.t->length;
+    if (aIsTuple && bIsTuple && bv.v.t->length != length) {
+        r->error = BIGTONE_TUPLE_LENGTH_MISMATCH;
+        return NULL;
+    }
+    for (size_t i = 0; i < length; i += 1) {
+        bigton_value_type_t at = tupleOperandAt(av, i).t;
+        bigton_value_type_t bt = tupleOperandAt(bv, i).t;
+        bool isNumeric = at == bt
+            && (at == BIGTON_INT || at == BIGTON_FLOAT);
+        if (!isNumeric) {
+            r->error = BIGTONE_OPERANDS_NOT_NUMBERS;
+            return NULL;
+        }
+    }
+    size_t sizes[] = {
+        sizeof(bigton_value_type_t) * length,
+        sizeof(bigton_value_t) * length,
+        sizeof(bigton_tuple_t)
+    };
+    void *buffers[3];
+    if (!bigtonAllocValueArena(r, 3, sizes, buffers)) { return NULL; }
+    bigton_value_type_t *memberTypes = buffers[0];
+    for (size_t i = 0; i < length; i += 1) {
+        memberTypes[i] = tupleOperandAt(av, i).t;
+    }
+    bigton_tuple_t *tuple = buffers[2];
+    tuple->rc = BIGTON_RC_INIT;
+    tuple->length = (uint32_t) length;
+    tuple->flatLength = (uint32_t) length;
+    tuple->valueTypes = memberTypes;
+    tuple->values = buffers[1];
+    r->accCost += length / BIGTON_KERNEL_ELEMS_PER_COST;
+    return tuple;
+}
+
+// Same as 'ARITHMETIC_BIOP_INSTR', but applied to each pair of members (see
+// 'BIGTONIR_TUPLE_ADD'). The member types are checked before the result is
+// allocated, meaning that the loop only needs to check for division by zero.
+#define TUPLE_ARITHMETIC_INSTR(iop, fop, dbz) \
+    bigton_tagged_value_t bv = bigtonStackPop(&r->stack, r); \
+    bigton_tagged_value_t av = bigtonStackPop(&r->stack, r); \
+    bigton_tuple_t *result = allocTupleArithmeticResult(r, av, bv); \
+    if (result != NULL) { \
+        bigton_value_t *members = (bigton_value_t *) result->values; \
+        for (size_t i = 0; i < result->length; i += 1) { \
+            bigton_tagged_value_t am = tupleOperandAt(av, i); \
+            bigton_tagged_value_t bm = tupleOperandAt(bv, i); \
+            if (am.t == BIGTON_INT) { \
+                uint64_t a = (uint64_t) am.v.i; \
+                uint64_t b = (uint64_t) bm.v.i; \
+                if (dbz) { \
+                    r->error = BIGTONE_INT_DIVISION_BY_ZERO; \
+                    break; \
+                } \
+                uint64_t c = iop; \
+                members[i].i = (bigton_int_t) c; \
+            } else { \
+                double a = am.v.f; \
+                double b = bm.v.f; \
+                members[i].f = fop; \
+            } \
+        } \
+        if (!HAS_ERROR(r)) { \
+            bigtonStackPush(&r->stack, BIGTON_TUPLE_VALUE(result), r); \
+        } else { \
+            bigtonValRcDecr(BIGTON_TUPLE_VALUE(result)); \
+        } \
+    } \
+    bigtonValRcDecr(av); \
+    bigtonValRcDecr(bv);
+
 bool valuesEqual(bigton_tagged_value_t a, bigton_tagged_value_t b) {
     if (a.t != b.t) { return false; }
     switch (a.t) {
@@ -202,7 +352,13 @@ bool valuesEqual(bigton_tagged_value_t a, bigton_tagged_value_t b) {
         case BIGTON_INT: return a.v.i == b.v.i;
         case BIGTON_FLOAT: return a.v.f == b.v.f;
         case BIGTON_STRING: {
+            if (a.v.s == b.v.s) { return true; }
             if (a.v.s->length != b.v.s->length) { return false; }
+            // hashes are only compared if both have already been computed,
+            // since computing them would cost as much as comparing the chars
+            uint32_t ah = a.v.s->hash;
+            uint32_t bh = b.v.s->hash;
+            if (ah != 0 && bh != 0 && ah != bh) { return false; }
             size_t lengthBytes = sizeof(bigton_char_t) * a.v.s->length;
             return memcmp(a.v.s->content, b.v.s->content, lengthBytes) == 0;
         }
@@ -225,6 +381,7 @@ bool valuesEqual(bigton_tagged_value_t a, bigton_tagged_value_t b) {
         }
         case BIGTON_OBJECT: return a.v.o == b.v.o;
         case BIGTON_ARRAY: return a.v.a == b.v.a;
+        case BIGTON_MAP: return a.v.m == b.v.m;
     }
 }
 
@@ -240,11 +397,32 @@ bool valueIsTruthy(bigton_tagged_value_t x) {
         case BIGTON_TUPLE:
         case BIGTON_OBJECT:
         case BIGTON_ARRAY:
+        case BIGTON_MAP:
             return true;
     }
 }
 
+// Returns the type an array made from the top 'length' values of the stack
+// can be packed with, or 'BIGTON_NULL' if it can not be packed.
+static bigton_value_type_t arrayPackedType(
+    const bigton_runtime_state_t *r, size_t length
+) {
+    if (length == 0 || length > r->stack.count) { return BIGTON_NULL; }
+    const bigton_value_type_t *types
+        = r->stack.types + (r->stack.count - length);
+    bigton_value_type_t t = types[0];
+    if (t != BIGTON_INT && t != BIGTON_FLOAT) { return BIGTON_NULL; }
+    for (size_t i = 1; i < length; i += 1) {
+        if (types[i] != t) { return BIGTON_NULL; }
+    }
+    return t;
+}
+
 bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
+    if (r->b.totalSizeBytes > r->settings.memoryUsageLimit) {
+        bigtonFreePending(&r->b, SIZE_MAX);
+        bigtonCollectCycles(r, BIGTON_MAX_CYCLE_CREDIT);
+    }
     if (r->b.totalSizeBytes > r->settings.memoryUsageLimit) {
         r->error = BIGTONE_EXCEEDED_MEMORY_LIMIT;
         return BIGTONST_ERROR;
@@ -278,6 +456,10 @@ bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
                 r->currentInstr = scope->after;
                 bigtonScopePop(r);
                 return BIGTONST_CONTINUE;
+            case BIGTONSC_RANGE:
+                stepRange(r, scope);
+                if (HAS_ERROR(r)) { return BIGTONST_ERROR; }
+                return BIGTONST_CONTINUE;
         }
     }
     if (instrIdx >= r->program.numInstrs) {
@@ -317,21 +499,25 @@ bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
             break;
         }
         case BIGTONIR_LOAD_STRING: {
-            bigtonStackPush(
-                &r->stack,
-                BIGTON_STRING_VALUE(
-                    bigtonAllocConstString(r, instrArgs.loadString)
-                ),
-                r
-            );
+            bigton_string_t *s
+                = bigtonLoadConstString(r, instrArgs.loadString);
+            if (s == NULL) { return BIGTONST_ERROR; }
+            bigtonStackPush(&r->stack, BIGTON_STRING_VALUE(s), r);
             break;
         }
         case BIGTONIR_LOAD_TUPLE: {
             size_t length = instrArgs.loadTupleLength;
-            bigton_value_type_t *memberTypes
-                = bigtonAllocBuff(&r->b, sizeof(bigton_value_type_t) * length);
-            bigton_value_t *memberValues
-                = bigtonAllocBuff(&r->b, sizeof(bigton_value_t) * length);
+            size_t sizes[] = {
+                sizeof(bigton_value_type_t) * length,
+                sizeof(bigton_value_t) * length,
+                sizeof(bigton_tuple_t)
+            };
+            void *buffers[3];
+            if (!bigtonAllocValueBuffs(r, 3, sizes, buffers)) {
+                return BIGTONST_ERROR;
+            }
+            bigton_value_type_t *memberTypes = buffers[0];
+            bigton_value_t *memberValues = buffers[1];
             size_t flatLength = 0;
             for (int64_t i = length - 1; i >= 0; i -= 1) {
                 bigton_tagged_value_t mv = bigtonStackPop(&r->stack, r);
@@ -342,8 +528,7 @@ bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
             if (!HAS_ERROR(r) && flatLength > r->settings.maxTupleSize) {
                 r->error = BIGTONE_TUPLE_TOO_BIG;
             }
-            bigton_tuple_t *tuple
-                = bigtonAllocBuff(&r->b, sizeof(bigton_tuple_t));
+            bigton_tuple_t *tuple = buffers[2];
             tuple->rc = BIGTON_RC_INIT;
             tuple->length = (uint32_t) length;
             tuple->flatLength = (uint32_t) flatLength;
@@ -369,20 +554,25 @@ bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
             const bigton_shape_prop_t *props
                 = r->program.props + shape->firstPropOffset;
             size_t propCount = shape->propCount;
-            bigton_value_type_t *memberTypes = bigtonAllocNullableBuff(
-                &r->b, sizeof(bigton_value_type_t) * propCount
-            );
-            bigton_value_t *memberValues = bigtonAllocNullableBuff(
-                &r->b, sizeof(bigton_value_t) * propCount
-            );
+            size_t sizes[] = {
+                sizeof(bigton_value_type_t) * propCount,
+                sizeof(bigton_value_t) * propCount,
+                sizeof(bigton_object_t)
+            };
+            void *buffers[3];
+            if (!bigtonAllocValueBuffs(r, 3, sizes, buffers)) {
+                return BIGTONST_ERROR;
+            }
+            bigton_value_type_t *memberTypes = buffers[0];
+            bigton_value_t *memberValues = buffers[1];
             for (int64_t i = (int64_t) propCount - 1; i >= 0; i -= 1) {
                 bigton_tagged_value_t mv = bigtonStackPop(&r->stack, r);
                 memberTypes[i] = mv.t;
                 memberValues[i] = mv.v;
             }
-            bigton_object_t *o
-                = bigtonAllocBuff(&r->b, sizeof(bigton_object_t));
+            bigton_object_t *o = buffers[2];
             o->rc = BIGTON_RC_INIT;
+            o->hash = bigtonNextValueHash(r);
             o->shape = shape;
             o->memberTypes = memberTypes;
             o->memberValues = memberValues;
@@ -391,24 +581,33 @@ bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
         }
         case BIGTONIR_LOAD_ARRAY: {
             size_t length = instrArgs.loadArrayLength;
-            bigton_value_type_t *elementTypes = bigtonAllocNullableBuff(
-                &r->b, sizeof(bigton_value_type_t) * length
-            );
-            bigton_value_t *elementValues = bigtonAllocNullableBuff(
-                &r->b, sizeof(bigton_value_t) * length
-            );
+            bigton_value_type_t packedType = arrayPackedType(r, length);
+            bool isPacked = packedType != BIGTON_NULL;
+            size_t sizes[] = {
+                isPacked ? 0 : sizeof(bigton_value_type_t) * length,
+                sizeof(bigton_value_t) * length,
+                sizeof(bigton_array_t)
+            };
+            void *buffers[3];
+            if (!bigtonAllocValueBuffs(r, 3, sizes, buffers)) {
+                return BIGTONST_ERROR;
+            }
+            bigton_value_type_t *elementTypes = buffers[0];
+            bigton_value_t *elementValues = buffers[1];
             for (int64_t i = length - 1; i >= 0; i -= 1) {
                 bigton_tagged_value_t ev = bigtonStackPop(&r->stack, r);
-                elementTypes[i] = ev.t;
+                if (!isPacked) { elementTypes[i] = ev.t; }
                 elementValues[i] = ev.v;
             }
-            bigton_array_t *array
-                = bigtonAllocBuff(&r->b, sizeof(bigton_array_t));
+            bigton_array_t *array = buffers[2];
             array->rc = BIGTON_RC_INIT;
+            array->hash = bigtonNextValueHash(r);
             array->capacity = (uint32_t) length;
             array->length = (uint32_t) length;
+            array->packedType = packedType;
             array->elementTypes = elementTypes;
             array->elementValues = elementValues;
+            array->viewed = NULL;
             bigtonStackPush(&r->stack, BIGTON_ARRAY_VALUE(array), r);
             break;
         }
@@ -429,12 +628,13 @@ bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
         case BIGTONIR_LOAD_OBJECT_MEMBER: {
             bigton_tagged_value_t o = bigtonStackPop(&r->stack, r);
             if (o.t == BIGTON_OBJECT) {
+                bigton_object_t *obj = bigtonObjectRead(r, o.v.o);
                 size_t i = bigtonObjectFindMem(
-                    o.v.o, instrArgs.loadObjectMemName,
+                    obj, instrArgs.loadObjectMemName,
                     r->program.props, r->program.numProps, &r->error
                 );
                 if (!HAS_ERROR(r)) {
-                    bigton_tagged_value_t mem = bigtonObjectAt(o.v.o, i);
+                    bigton_tagged_value_t mem = bigtonObjectAt(obj, i);
                     bigtonValRcIncr(mem);
                     bigtonStackPush(&r->stack, mem, r);
                 }
@@ -449,8 +649,9 @@ bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
             bigton_tagged_value_t av = bigtonStackPop(&r->stack, r);
             if (av.t == BIGTON_ARRAY) {
                 if (iv.t == BIGTON_INT) {
-                    bigton_tagged_value_t ev
-                        = bigtonArrayAt(av.v.a, iv.v.i, &r->error);
+                    bigton_tagged_value_t ev = bigtonArrayAt(
+                        bigtonArrayRead(r, av.v.a), iv.v.i, &r->error
+                    );
                     bigtonValRcIncr(ev);
                     bigtonStackPush(&r->stack, ev, r);
                 } else if (!HAS_ERROR(r)) {
@@ -633,12 +834,18 @@ bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
             bigton_tagged_value_t v = bigtonStackPop(&r->stack, r);
             bigton_tagged_value_t o = bigtonStackPop(&r->stack, r);
             if (o.t == BIGTON_OBJECT) {
+                bigton_object_t *obj = bigtonObjectWrite(r, o.v.o);
+                if (obj == NULL) {
+                    bigtonValRcDecr(o);
+                    bigtonValRcDecr(v);
+                    break;
+                }
                 size_t i = bigtonObjectFindMem(
-                    o.v.o, instrArgs.storeObjectMemName,
+                    obj, instrArgs.storeObjectMemName,
                     r->program.props, r->program.numProps, &r->error
                 );
                 if (!HAS_ERROR(r)) {
-                    bigton_tagged_value_t oldMv = bigtonObjectSet(o.v.o, i, v);
+                    bigton_tagged_value_t oldMv = bigtonObjectSet(obj, i, v);
                     bigtonValRcDecr(oldMv);
                 }
             } else if (!HAS_ERROR(r)) {
@@ -653,8 +860,9 @@ bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
             bigton_tagged_value_t a = bigtonStackPop(&r->stack, r);
             if (a.t == BIGTON_ARRAY) {
                 if (i.t == BIGTON_INT) {
-                    bigton_tagged_value_t oldEv
-                        = bigtonArraySet(a.v.a, i.v.i, v, &r->error);
+                    bigton_array_t *arr = bigtonArrayWrite(r, a.v.a);
+                    bigton_tagged_value_t oldEv = arr == NULL
+                        ? v : bigtonArraySet(arr, i.v.i, v, &r->error);
                     bigtonValRcDecr(oldEv);
                 } else if (!HAS_ERROR(r)) {
                     r->error = BIGTONE_OPERAND_NOT_INTEGER;
@@ -707,6 +915,35 @@ bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
             });
             break;
         }
+        case BIGTONIR_FOR_RANGE: {
+            bigton_tagged_value_t end = bigtonStackPop(&r->stack, r);
+            bigton_tagged_value_t start = bigtonStackPop(&r->stack, r);
+            if (HAS_ERROR(r)) { return BIGTONST_ERROR; }
+            if (start.t != BIGTON_INT || end.t != BIGTON_INT) {
+                r->error = BIGTONE_OPERAND_NOT_INTEGER;
+                bigtonValRcDecr(start);
+                bigtonValRcDecr(end);
+                return BIGTONST_ERROR;
+            }
+            bigton_instr_idx_t bodyStart = instrIdx + 1;
+            bigton_instr_idx_t after = bodyStart + instrArgs.rangeLoopLength;
+            r->accCost += 1 + BIGTON_RANGE_CHECK_COST;
+            if (start.v.i >= end.v.i) {
+                r->currentInstr = after;
+                return BIGTONST_CONTINUE;
+            }
+            bigtonStackPush(&r->locals, end, r);
+            bigtonStackPush(&r->locals, start, r);
+            bigtonScopePush(r, (bigton_scope_t) {
+                .type = BIGTONSC_RANGE,
+                .start = bodyStart,
+                .end = after,
+                .after = after,
+                .numLocals = BIGTON_RANGE_LOCALS
+            });
+            r->currentInstr = bodyStart;
+            return BIGTONST_CONTINUE;
+        }
         case BIGTONIR_CONTINUE: {
             while (true) {
                 bigton_scope_t *currScope = bigtonScopeCurr(r);
@@ -716,6 +953,7 @@ bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
                         break;
                     case BIGTONSC_LOOP:
                     case BIGTONSC_TICK:
+                    case BIGTONSC_RANGE:
                         r->currentInstr = currScope->end;
                         return BIGTONST_CONTINUE;
                     case BIGTONSC_IF:
@@ -736,6 +974,7 @@ bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
                         break;
                     case BIGTONSC_LOOP:
                     case BIGTONSC_TICK:
+                    case BIGTONSC_RANGE:
                         r->currentInstr = currScope->after;
                         bigtonScopePop(r);
                         return BIGTONST_CONTINUE;
@@ -803,6 +1042,7 @@ bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
                     case BIGTONSC_LOOP:
                     case BIGTONSC_TICK:
                     case BIGTONSC_IF:
+                    case BIGTONSC_RANGE:
                         bigtonScopePop(r);
                         currScope = bigtonScopeCurr(r);
                         if (HAS_ERROR(r)) { return BIGTONST_ERROR; }
@@ -811,6 +1051,232 @@ bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
             }
             break;
         }
+
+        case BIGTONIR_ARRAY_PUSH: {
+            bigton_tagged_value_t v = bigtonStackPop(&r->stack, r);
+            bigton_tagged_value_t av = bigtonStackPop(&r->stack, r);
+            if (av.t == BIGTON_ARRAY) {
+                bigton_array_t *a = bigtonArrayWrite(r, av.v.a);
+                if (a != NULL && bigtonArrayInsert(r, a, a->length, v)) {
+                    v = BIGTON_NULL_VALUE;
+                }
+            } else if (!HAS_ERROR(r)) {
+                r->error = BIGTONE_OPERAND_NOT_ARRAY;
+            }
+            bigtonValRcDecr(av);
+            bigtonValRcDecr(v);
+            bigtonStackPush(&r->stack, BIGTON_NULL_VALUE, r);
+            break;
+        }
+        case BIGTONIR_ARRAY_POP: {
+            bigton_tagged_value_t av = bigtonStackPop(&r->stack, r);
+            if (av.t == BIGTON_ARRAY) {
+                bigton_array_t *a = bigtonArrayWrite(r, av.v.a);
+                if (a == NULL) {
+                    // memory usage limit exceeded, error already set
+                } else if (a->length > 0) {
+                    bigton_tagged_value_t ev
+                        = bigtonArrayRemove(a, a->length - 1);
+                    bigtonStackPush(&r->stack, ev, r);
+                } else {
+                    r->error = BIGTONE_ARRAY_INDEX_OOB;
+                }
+            } else if (!HAS_ERROR(r)) {
+                r->error = BIGTONE_OPERAND_NOT_ARRAY;
+            }
+            bigtonValRcDecr(av);
+            break;
+        }
+        case BIGTONIR_ARRAY_LENGTH: {
+            bigton_tagged_value_t av = bigtonStackPop(&r->stack, r);
+            if (av.t == BIGTON_ARRAY) {
+                bigton_int_t length = bigtonArrayRead(r, av.v.a)->length;
+                bigtonStackPush(&r->stack, BIGTON_INT_VALUE(length), r);
+            } else if (!HAS_ERROR(r)) {
+                r->error = BIGTONE_OPERAND_NOT_ARRAY;
+            }
+            bigtonValRcDecr(av);
+            break;
+        }
+        case BIGTONIR_ARRAY_INSERT: {
+            bigton_tagged_value_t v = bigtonStackPop(&r->stack, r);
+            bigton_tagged_value_t iv = bigtonStackPop(&r->stack, r);
+            bigton_tagged_value_t av = bigtonStackPop(&r->stack, r);
+            if (av.t == BIGTON_ARRAY) {
+                if (iv.t == BIGTON_INT) {
+                    bigton_array_t *a = bigtonArrayWrite(r, av.v.a);
+                    bigton_int_t i = iv.v.i;
+                    if (a == NULL) {
+                        // memory usage limit exceeded, error already set
+                    } else if (i < 0 || (size_t) i > a->length) {
+                        r->error = BIGTONE_ARRAY_INDEX_OOB;
+                    } else if (bigtonArrayInsert(r, a, (size_t) i, v)) {
+                        v = BIGTON_NULL_VALUE;
+                    }
+                } else if (!HAS_ERROR(r)) {
+                    r->error = BIGTONE_OPERAND_NOT_INTEGER;
+                }
+            } else if (!HAS_ERROR(r)) {
+                r->error = BIGTONE_OPERAND_NOT_ARRAY;
+            }
+            bigtonValRcDecr(av);
+            bigtonValRcDecr(iv);
+            bigtonValRcDecr(v);
+            bigtonStackPush(&r->stack, BIGTON_NULL_VALUE, r);
+            break;
+        }
+        case BIGTONIR_ARRAY_REMOVE: {
+            bigton_tagged_value_t iv = bigtonStackPop(&r->stack, r);
+            bigton_tagged_value_t av = bigtonStackPop(&r->stack, r);
+            if (av.t == BIGTON_ARRAY) {
+                if (iv.t == BIGTON_INT) {
+                    bigton_array_t *a = bigtonArrayWrite(r, av.v.a);
+                    bigton_int_t i = iv.v.i;
+                    if (a == NULL) {
+                        // memory usage limit exceeded, error already set
+                    } else if (i < 0 || (size_t) i >= a->length) {
+                        r->error = BIGTONE_ARRAY_INDEX_OOB;
+                    } else {
+                        bigton_tagged_value_t ev
+                            = bigtonArrayRemove(a, (size_t) i);
+                        bigtonStackPush(&r->stack, ev, r);
+                    }
+                } else if (!HAS_ERROR(r)) {
+                    r->error = BIGTONE_OPERAND_NOT_INTEGER;
+                }
+            } else if (!HAS_ERROR(r)) {
+                r->error = BIGTONE_OPERAND_NOT_ARRAY;
+            }
+            bigtonValRcDecr(av);
+            bigtonValRcDecr(iv);
+            break;
+        }
+        case BIGTONIR_ARRAY_SUM:
+        case BIGTONIR_ARRAY_MIN:
+        case BIGTONIR_ARRAY_MAX:
+        case BIGTONIR_ARRAY_ARGMIN:
+        case BIGTONIR_ARRAY_SCALE:
+        case BIGTONIR_ARRAY_ADD:
+        case BIGTONIR_ARRAY_DOT:
+        case BIGTONIR_ARRAY_SORT:
+        case BIGTONIR_ARRAY_BINARY_SEARCH:
+        case BIGTONIR_ARRAY_INDEX_OF:
+        case BIGTONIR_ARRAY_CONTAINS: {
+            bigtonExecArrayKernel(r, instrType);
+            break;
+        }
+
+        case BIGTONIR_MAP_CREATE: {
+            bigton_map_t *m = bigtonMapCreate(r);
+            if (m != NULL) {
+                bigtonStackPush(&r->stack, BIGTON_MAP_VALUE(m), r);
+            }
+            break;
+        }
+        case BIGTONIR_MAP_GET:
+        case BIGTONIR_MAP_HAS: {
+            bigton_tagged_value_t key = bigtonStackPop(&r->stack, r);
+            bigton_tagged_value_t mv = bigtonStackPop(&r->stack, r);
+            if (mv.t == BIGTON_MAP) {
+                const bigton_map_t *m = bigtonMapRead(r, mv.v.m);
+                size_t slot = bigtonMapFind(m, key);
+                bool found = slot < m->capacity;
+                if (instrType == BIGTONIR_MAP_HAS) {
+                    bigtonStackPush(&r->stack, BIGTON_INT_VALUE(found), r);
+                } else if (found) {
+                    bigton_tagged_value_t v = bigtonMapValueAt(m, slot);
+                    bigtonValRcIncr(v);
+                    bigtonStackPush(&r->stack, v, r);
+                } else {
+                    bigtonStackPush(&r->stack, BIGTON_NULL_VALUE, r);
+                }
+            } else if (!HAS_ERROR(r)) {
+                r->error = BIGTONE_OPERAND_NOT_MAP;
+            }
+            bigtonValRcDecr(mv);
+            bigtonValRcDecr(key);
+            break;
+        }
+        case BIGTONIR_MAP_SET: {
+            bigton_tagged_value_t v = bigtonStackPop(&r->stack, r);
+            bigton_tagged_value_t key = bigtonStackPop(&r->stack, r);
+            bigton_tagged_value_t mv = bigtonStackPop(&r->stack, r);
+            if (mv.t == BIGTON_MAP) {
+                bigton_map_t *m = bigtonMapWrite(r, mv.v.m);
+                if (m != NULL && bigtonMapSet(r, m, key, v)) {
+                    key = BIGTON_NULL_VALUE;
+                    v = BIGTON_NULL_VALUE;
+                }
+            } else if (!HAS_ERROR(r)) {
+                r->error = BIGTONE_OPERAND_NOT_MAP;
+            }
+            bigtonValRcDecr(mv);
+            bigtonValRcDecr(key);
+            bigtonValRcDecr(v);
+            bigtonStackPush(&r->stack, BIGTON_NULL_VALUE, r);
+            break;
+        }
+        case BIGTONIR_MAP_KEYS: {
+            bigton_tagged_value_t mv = bigtonStackPop(&r->stack, r);
+            if (mv.t == BIGTON_MAP) {
+                const bigton_map_t *m = bigtonMapRead(r, mv.v.m);
+                r->accCost += m->capacity / BIGTON_KERNEL_ELEMS_PER_COST;
+                bigton_array_t *a = bigtonMapKeys(r, m);
+                if (a != NULL) {
+                    bigtonStackPush(&r->stack, BIGTON_ARRAY_VALUE(a), r);
+                }
+            } else if (!HAS_ERROR(r)) {
+                r->error = BIGTONE_OPERAND_NOT_MAP;
+            }
+            bigtonValRcDecr(mv);
+            break;
+        }
+        case BIGTONIR_MAP_SIZE: {
+            bigton_tagged_value_t mv = bigtonStackPop(&r->stack, r);
+            if (mv.t == BIGTON_MAP) {
+                bigton_int_t size = bigtonMapRead(r, mv.v.m)->length;
+                bigtonStackPush(&r->stack, BIGTON_INT_VALUE(size), r);
+            } else if (!HAS_ERROR(r)) {
+                r->error = BIGTONE_OPERAND_NOT_MAP;
+            }
+            bigtonValRcDecr(mv);
+            break;
+        }
+        case BIGTONIR_MAP_REMOVE: {
+            bigton_tagged_value_t key = bigtonStackPop(&r->stack, r);
+            bigton_tagged_value_t mv = bigtonStackPop(&r->stack, r);
+            if (mv.t == BIGTON_MAP) {
+                bigton_map_t *m = bigtonMapWrite(r, mv.v.m);
+                if (m != NULL) {
+                    size_t slot = bigtonMapFind(m, key);
+                    bigton_tagged_value_t v = slot == m->capacity
+                        ? BIGTON_NULL_VALUE : bigtonMapRemove(m, slot);
+                    bigtonStackPush(&r->stack, v, r);
+                }
+            } else if (!HAS_ERROR(r)) {
+                r->error = BIGTONE_OPERAND_NOT_MAP;
+            }
+            bigtonValRcDecr(mv);
+            bigtonValRcDecr(key);
+            break;
+        }
+
+        case BIGTONIR_TUPLE_ADD: {
+            TUPLE_ARITHMETIC_INSTR(a + b, a + b, false)
+            break;
+        }
+        case BIGTONIR_TUPLE_SUBTRACT: {
+            TUPLE_ARITHMETIC_INSTR(a - b, a - b, false)
+            break;
+        }
+        case BIGTONIR_TUPLE_MULTIPLY: {
+            TUPLE_ARITHMETIC_INSTR(a * b, a * b, false)
+            break;
+        }
+        case BIGTONIR_TUPLE_DIVIDE: {
+            TUPLE_ARITHMETIC_INSTR(a / b, a / b, b == 0)
+            break;
+        }
     }
     r->currentInstr += 1;
     r->accCost += 1;
@@ -818,10 +1284,22 @@ bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r) {
 }
 
 void bigtonStartTick(bigton_runtime_state_t *r) {
+    if (r->hibernated != NULL) { bigtonWake(r); }
     r->accCost = 0;
+    bigtonFreePending(&r->b, r->settings.tickFreeBudget);
+    bigtonCollectCyclesIfDue(r);
 }
 
 bigton_exec_status_t bigtonExecBatch(bigton_runtime_state_t *r) {
+    if (r->hibernated != NULL) { bigtonWake(r); }
+    if (r->preparedStatus != BIGTONST_CONTINUE) {
+        bigton_exec_status_t status = r->preparedStatus;
+        r->preparedStatus = BIGTONST_CONTINUE;
+        r->accCost = r->preparedCost;
+        return status;
+    }
+    // for example set by the host while executing a builtin function
+    if (HAS_ERROR(r)) { return BIGTONST_ERROR; }
     while (true) {
         bigton_exec_status_t status = bigtonExecInstr(r);
         if (HAS_ERROR(r)) {
@@ -832,3 +1310,27 @@ bigton_exec_status_t bigtonExecBatch(bigton_runtime_state_t *r) {
         }
     }
 }
+
+bigton_exec_result_t bigtonExecUntilYield(
+    bigton_runtime_state_t *r, bool startTick
+) {
+    if (startTick) {
+        bigtonStartTick(r);
+    }
+    bigton_exec_status_t status = bigtonExecBatch(r);
+    return (bigton_exec_result_t) {
+        .status = (uint32_t) status,
+        .awaitingBuiltinFun = r->awaitingBuiltinFun,
+        .logsCount = (uint32_t) r->logsCount,
+        .error = (uint32_t) r->error
+    };
+}
+
+void bigtonExecMany(
+    bigton_runtime_state_t *const *runtimes, size_t count, bool startTick,
+    bigton_exec_result_t *results
+) {
+    for (size_t i = 0; i < count; i += 1) {
+        results[i] = bigtonExecUntilYield(runtimes[i], startTick);
+    }
+}
@@ -0,0 +1,390 @@
+
+#define BIGTON_ERROR_MACROS
+#include <bigton/runtime.h>
+#include <bigton/snapshot.h>
+#include <bigton/util.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Forking freezes all buffers of the source runtime (see 'bigtonBuffIsShared')
+// and gives both runtimes private copies of their stacks, locals, scopes,
+// trace, logs, globals and loaded constant strings. From then on, neither
+// runtime modifies the shared objects or arrays - the first modification of
+// one by a runtime instead creates a private copy, which is recorded in the
+// copy-on-write map of the runtime. Since the values referencing the shared
+// object still point to the original, all accesses to the contents of objects
+// and arrays need to be resolved using the 'bigtonXxxRead' and
+// 'bigtonXxxWrite' functions.
+
+
+static void *cowFind(const bigton_cow_map_t *m, const void *key) {
+    if (m->count == 0) { return NULL; }
+    size_t slot = bigtonHashPointer(key, m->capacity);
+    while (m->keys[slot] != NULL) {
+        if (m->keys[slot] == key) { return m->copies[slot]; }
+        slot = (slot + 1) & (m->capacity - 1);
+    }
+    return NULL;
+}
+
+static size_t cowSlotOf(const bigton_cow_map_t *m, const void *key) {
+    size_t slot = bigtonHashPointer(key, m->capacity);
+    while (m->keys[slot] != NULL && m->keys[slot] != key) {
+        slot = (slot + 1) & (m->capacity - 1);
+    }
+    return slot;
+}
+
+static bool cowGrow(bigton_runtime_state_t *r) {
+    bigton_cow_map_t *m = &r->cow;
+    size_t oldCapacity = m->capacity;
+    size_t capacity = oldCapacity == 0 ? 16 : oldCapacity * 2;
+    size_t sizes[] = {
+        sizeof(const void *) * capacity, sizeof(void *) * capacity
+    };
+    void *buffers[2];
+    if (!bigtonAllocValueBuffs(r, 2, sizes, buffers)) { return false; }
+    const void **oldKeys = m->keys;
+    void **oldCopies = m->copies;
+    m->capacity = capacity;
+    m->keys = buffers[0];
+    m->copies = buffers[1];
+    memset(m->keys, 0, sizeof(const void *) * m->capacity);
+    for (size_t i = 0; i < oldCapacity; i += 1) {
+        if (oldKeys[i] == NULL) { continue; }
+        size_t slot = cowSlotOf(m, oldKeys[i]);
+        m->keys[slot] = oldKeys[i];
+        m->copies[slot] = oldCopies[i];
+    }
+    bigtonFreeNullableBuff(oldKeys);
+    bigtonFreeNullableBuff(oldCopies);
+    return true;
+}
+
+// Makes sure that another key can be inserted using 'cowInsert'.
+static bool cowReserve(bigton_runtime_state_t *r) {
+    if ((r->cow.count + 1) * 2 <= r->cow.capacity) { return true; }
+    return cowGrow(r);
+}
+
+// Any copy previously stored for the key is shared, and therefore does not
+// need to be released.
+static void cowInsert(
+    bigton_runtime_state_t *r, const void *key, void *copy
+) {
+    bigton_cow_map_t *m = &r->cow;
+    size_t slot = cowSlotOf(m, key);
+    if (m->keys[slot] == NULL) {
+        m->keys[slot] = key;
+        m->count += 1;
+    }
+    m->copies[slot] = copy;
+}
+
+static void *dupNullableBuff(bigton_buff_owner_t *o, const void *buffer) {
+    if (buffer == NULL) { return NULL; }
+    size_t sizeBytes = BIGTON_BUFF_HEADER(buffer)->sizeBytes;
+    void *copy = bigtonAllocNullableBuff(o, sizeBytes);
+    memcpy(copy, buffer, sizeBytes);
+    return copy;
+}
+
+static size_t nullableBuffSize(const void *buffer) {
+    return buffer == NULL ? 0 : BIGTON_BUFF_HEADER(buffer)->sizeBytes;
+}
+
+// Copies the contents of 'src' into 'dest', which has been allocated with the
+// size returned by 'nullableBuffSize' (and is therefore NULL if 'src' is).
+static void *copyNullableBuff(void *dest, const void *src) {
+    if (src != NULL) {
+        memcpy(dest, src, BIGTON_BUFF_HEADER(src)->sizeBytes);
+    }
+    return dest;
+}
+
+static void incrAll(
+    size_t count, const bigton_value_type_t *types, const bigton_value_t *values
+) {
+    for (size_t i = 0; i < count; i += 1) {
+        bigtonValRcIncr((bigton_tagged_value_t) {
+            .t = types[i], .v = values[i]
+        });
+    }
+}
+
+
+bigton_object_t *bigtonObjectRead(
+    const bigton_runtime_state_t *r, bigton_object_t *o
+) {
+    bool mayBeCopied = r != NULL && r->cow.count > 0
+        && bigtonBuffIsShared(o);
+    if (!mayBeCopied) { return o; }
+    bigton_object_t *copy = cowFind(&r->cow, o);
+    return copy == NULL ? o : copy;
+}
+
+bigton_object_t *bigtonObjectWrite(
+    bigton_runtime_state_t *r, bigton_object_t *o
+) {
+    if (r == NULL || !bigtonBuffIsShared(o)) { return o; }
+    bigton_object_t *current = cowFind(&r->cow, o);
+    if (current != NULL && !bigtonBuffIsShared(current)) { return current; }
+    if (current == NULL) { current = o; }
+    if (!cowReserve(r)) { return NULL; }
+    size_t sizes[] = {
+        sizeof(bigton_object_t),
+        nullableBuffSize(current->memberTypes),
+        nullableBuffSize(current->memberValues)
+    };
+    void *buffers[3];
+    if (!bigtonAllocValueBuffs(r, 3, sizes, buffers)) { return NULL; }
+    bigton_object_t *copy = buffers[0];
+    copy->rc = BIGTON_RC_INIT;
+    copy->hash = current->hash;
+    copy->shape = current->shape;
+    copy->memberTypes = copyNullableBuff(buffers[1], current->memberTypes);
+    copy->memberValues = copyNullableBuff(buffers[2], current->memberValues);
+    incrAll(current->shape->propCount, copy->memberTypes, copy->memberValues);
+    cowInsert(r, o, copy);
+    return copy;
+}
+
+bigton_array_t *bigtonArrayRead(
+    const bigton_runtime_state_t *r, bigton_array_t *a
+) {
+    bool mayBeCopied = r != NULL && r->cow.count > 0
+        && bigtonBuffIsShared(a);
+    if (!mayBeCopied) { return a; }
+    bigton_array_t *copy = cowFind(&r->cow, a);
+    return copy == NULL ? a : copy;
+}
+
+// Writes the sizes of the two buffers 'copyElements' needs for copying the
+// elements of 'src' to 'sizes'. Copies of views do not have any unused
+// capacity.
+static void elementBuffSizes(const bigton_array_t *src, size_t *sizes) {
+    if (src->viewed == NULL) {
+        sizes[0] = nullableBuffSize(src->elementTypes);
+        sizes[1] = nullableBuffSize(src->elementValues);
+        return;
+    }
+    size_t length = src->length;
+    sizes[0] = src->elementTypes == NULL
+        ? 0 : sizeof(bigton_value_type_t) * length;
+    sizes[1] = sizeof(bigton_value_t) * length;
+}
+
+// Gives 'dest' the given buffers (allocated using the sizes written by
+// 'elementBuffSizes') as its own copies of the buffers holding the elements of
+// 'src' (which may be the same array), incrementing the reference counts of
+// all elements.
+static void copyElements(
+    bigton_array_t *dest, const bigton_array_t *src, void **buffers
+) {
+    size_t length = src->length;
+    const bigton_value_type_t *types = src->elementTypes;
+    const bigton_value_t *values = src->elementValues;
+    if (src->viewed == NULL) {
+        dest->capacity = src->capacity;
+        dest->elementTypes = copyNullableBuff(buffers[0], types);
+        dest->elementValues = copyNullableBuff(buffers[1], values);
+    } else {
+        dest->capacity = (uint32_t) length;
+        dest->elementTypes = buffers[0];
+        dest->elementValues = buffers[1];
+        if (types != NULL && length > 0) {
+            memcpy(
+                dest->elementTypes, types,
+                sizeof(bigton_value_type_t) * length
+            );
+        }
+        if (length > 0) {
+            memcpy(
+                dest->elementValues, values, sizeof(bigton_value_t) * length
+            );
+        }
+    }
+    dest->length = (uint32_t) length;
+    dest->packedType = src->packedType;
+    dest->viewed = NULL;
+    if (dest->packedType == BIGTON_NULL) {
+        incrAll(length, dest->elementTypes, dest->elementValues);
+    }
+}
+
+bigton_array_t *bigtonArrayWrite(
+    bigton_runtime_state_t *r, bigton_array_t *a
+) {
+    if (!bigtonBuffIsShared(a)) {
+        bigton_array_t *viewed = a->viewed;
+        if (viewed != NULL) {
+            size_t sizes[2];
+            void *buffers[2];
+            elementBuffSizes(a, sizes);
+            bool allocated = r != NULL
+                ? bigtonAllocValueBuffs(r, 2, sizes, buffers)
+                : bigtonTryAllocBuffs(
+                    BIGTON_BUFF_HEADER(a)->owner, 2, sizes, buffers
+                );
+            if (!allocated) { return NULL; }
+            copyElements(a, a, buffers);
+            bigtonValRcDecr(BIGTON_ARRAY_VALUE(viewed));
+        }
+        return a;
+    }
+    if (r == NULL) { return a; }
+    bigton_array_t *current = cowFind(&r->cow, a);
+    if (current != NULL && !bigtonBuffIsShared(current)) {
+        return bigtonArrayWrite(r, current);
+    }
+    if (current == NULL) { current = a; }
+    if (!cowReserve(r)) { return NULL; }
+    size_t sizes[3] = { sizeof(bigton_array_t) };
+    elementBuffSizes(current, sizes + 1);
+    void *buffers[3];
+    if (!bigtonAllocValueBuffs(r, 3, sizes, buffers)) { return NULL; }
+    bigton_array_t *copy = buffers[0];
+    copy->rc = BIGTON_RC_INIT;
+    copy->hash = current->hash;
+    copyElements(copy, current, buffers + 1);
+    cowInsert(r, a, copy);
+    return copy;
+}
+
+bigton_map_t *bigtonMapRead(
+    const bigton_runtime_state_t *r, bigton_map_t *m
+) {
+    bool mayBeCopied = r != NULL && r->cow.count > 0
+        && bigtonBuffIsShared(m);
+    if (!mayBeCopied) { return m; }
+    bigton_map_t *copy = cowFind(&r->cow, m);
+    return copy == NULL ? m : copy;
+}
+
+bigton_map_t *bigtonMapWrite(bigton_runtime_state_t *r, bigton_map_t *m) {
+    if (r == NULL || !bigtonBuffIsShared(m)) { return m; }
+    bigton_map_t *current = cowFind(&r->cow, m);
+    if (current != NULL && !bigtonBuffIsShared(current)) { return current; }
+    if (current == NULL) { current = m; }
+    if (!cowReserve(r)) { return NULL; }
+    size_t sizes[] = {
+        sizeof(bigton_map_t),
+        nullableBuffSize(current->slotHashes),
+        nullableBuffSize(current->slotTypes),
+        nullableBuffSize(current->slotValues)
+    };
+    void *buffers[4];
+    if (!bigtonAllocValueBuffs(r, 4, sizes, buffers)) { return NULL; }
+    bigton_map_t *copy = buffers[0];
+    copy->rc = BIGTON_RC_INIT;
+    copy->hash = current->hash;
+    copy->capacity = current->capacity;
+    copy->length = current->length;
+    copy->slotHashes = copyNullableBuff(buffers[1], current->slotHashes);
+    copy->slotTypes = copyNullableBuff(buffers[2], current->slotTypes);
+    copy->slotValues = copyNullableBuff(buffers[3], current->slotValues);
+    incrAll(
+        (size_t) current->capacity * 2, copy->slotTypes, copy->slotValues
+    );
+    cowInsert(r, m, copy);
+    return copy;
+}
+
+
+void bigtonSharedHeapRcDecr(bigton_shared_heap_t *h) {
+    while (h != NULL) {
+        if (atomic_fetch_sub(&h->rc, 1) != 1) { return; }
+        bigton_shared_heap_t *parent = h->parent;
+        bigtonFreeAll(&h->b);
+        free(h);
+        h = parent;
+    }
+}
+
+// Replaces all buffers of 'r' that are not part of its heap with copies
+// allocated in 'o', keeping their capacities.
+// At the time of forking all values are shared, which is why the values
+// contained in the copied buffers do not need to be reference counted.
+static void dupStructures(bigton_runtime_state_t *r, bigton_buff_owner_t *o) {
+    r->globalTypes = dupNullableBuff(o, r->globalTypes);
+    r->globalValues = dupNullableBuff(o, r->globalValues);
+    r->constStrings = dupNullableBuff(o, r->constStrings);
+    r->logs = dupNullableBuff(o, r->logs);
+    r->trace = dupNullableBuff(o, r->trace);
+    r->stack.types = dupNullableBuff(o, r->stack.types);
+    r->stack.values = dupNullableBuff(o, r->stack.values);
+    r->scopes = dupNullableBuff(o, r->scopes);
+    r->locals.types = dupNullableBuff(o, r->locals.types);
+    r->locals.values = dupNullableBuff(o, r->locals.values);
+    r->cow.keys = dupNullableBuff(o, r->cow.keys);
+    r->cow.copies = dupNullableBuff(o, r->cow.copies);
+}
+
+static void freeStructures(const bigton_runtime_state_t *r) {
+    bigtonFreeNullableBuff(r->globalTypes);
+    bigtonFreeNullableBuff(r->globalValues);
+    bigtonFreeNullableBuff(r->constStrings);
+    bigtonFreeNullableBuff(r->logs);
+    bigtonFreeNullableBuff(r->trace);
+    bigtonFreeNullableBuff(r->stack.types);
+    bigtonFreeNullableBuff(r->stack.values);
+    bigtonFreeNullableBuff(r->scopes);
+    bigtonFreeNullableBuff(r->locals.types);
+    bigtonFreeNullableBuff(r->locals.values);
+    bigtonFreeNullableBuff(r->cow.keys);
+    bigtonFreeNullableBuff(r->cow.copies);
+}
+
+void bigtonFork(bigton_runtime_state_t *src, bigton_runtime_state_t *dest) {
+    if (src->hibernated != NULL) { bigtonWake(src); }
+    if (src->forkedHeap == NULL) {
+        bigton_shared_heap_t *h = malloc(sizeof(bigton_shared_heap_t));
+        atomic_init(&h->rc, 1);
+        h->b = (bigton_buff_owner_t) {
+            .first = NULL,
+            .last = NULL,
+            .totalSizeBytes = 0,
+            .peakSizeBytes = 0,
+            .limitBytes = SIZE_MAX,
+            .nextSeq = 0,
+            .sharedBelow = 0,
+            .cycleRoots = BIGTON_CYCLE_ROOTS_INIT,
+            .freeQueue = BIGTON_FREE_QUEUE_INIT
+        };
+        h->parent = src->sharedHeap;
+        if (h->parent != NULL) { atomic_fetch_add(&h->parent->rc, 1); }
+        src->forkedHeap = h;
+    }
+    // shared values are never freed or collected
+    bigtonFreePending(&src->b, SIZE_MAX);
+    src->b.sharedBelow = src->b.nextSeq;
+    src->b.cycleRoots.count = 0;
+    // the source keeps its stacks in new buffers, since the old ones
+    // would otherwise be kept alive as part of the shared heap
+    bigton_runtime_state_t old = *src;
+    dupStructures(src, &src->b);
+    freeStructures(&old);
+    *dest = *src;
+    dest->b = (bigton_buff_owner_t) {
+        .first = NULL,
+        .last = NULL,
+        .totalSizeBytes = 0,
+        .peakSizeBytes = 0,
+        .limitBytes = src->b.limitBytes,
+        .nextSeq = 0,
+        .sharedBelow = 0,
+        .cycleRoots = BIGTON_CYCLE_ROOTS_INIT,
+        .freeQueue = BIGTON_FREE_QUEUE_INIT
+    };
+    dupStructures(dest, &dest->b);
+    // the shared heap counts towards the memory usage of both runtimes
+    dest->b.totalSizeBytes = src->b.totalSizeBytes;
+    dest->b.peakSizeBytes = src->b.totalSizeBytes;
+    if (dest->image != NULL) { bigtonImageRcIncr(dest->image); }
+    atomic_fetch_add(&src->forkedHeap->rc, 1);
+    dest->sharedHeap = src->forkedHeap;
+    dest->forkedHeap = NULL;
+    dest->hostValues = NULL;
+    dest->cycles = BIGTON_CYCLE_COLLECTOR_INIT;
+}
@@ -0,0 +1,290 @@
+
+#include <bigton/runtime.h>
+#include <bigton/encoding.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum BigtonArgKind {
+    BIGTON_ARG_NONE,
+    BIGTON_ARG_VARINT,
+    BIGTON_ARG_INT,
+    BIGTON_ARG_FLOAT,
+    BIGTON_ARG_IF,
+    BIGTON_ARG_INVALID
+} bigton_arg_kind_t;
+
+static bigton_arg_kind_t instrArgKind(bigton_instr_type_t t) {
+    switch (t) {
+        case BIGTONIR_DISCARD:
+        case BIGTONIR_LOAD_NULL:
+        case BIGTONIR_LOAD_ARRAY_ELEMENT:
+        case BIGTONIR_ADD:
+        case BIGTONIR_SUBTRACT:
+        case BIGTONIR_MULTIPLY:
+        case BIGTONIR_DIVIDE:
+        case BIGTONIR_REMAINDER:
+        case BIGTONIR_NEGATE:
+        case BIGTONIR_LESS_THAN:
+        case BIGTONIR_LESS_THAN_EQUAL:
+        case BIGTONIR_GREATER_THAN:
+        case BIGTONIR_GREATER_THAN_EQUAL:
+        case BIGTONIR_EQUAL:
+        case BIGTONIR_NOT_EQUAL:
+        case BIGTONIR_AND:
+        case BIGTONIR_OR:
+        case BIGTONIR_NOT:
+        case BIGTONIR_PUSH_LOCAL:
+        case BIGTONIR_STORE_ARRAY_ELEMENT:
+        case BIGTONIR_CONTINUE:
+        case BIGTONIR_BREAK:
+        case BIGTONIR_RETURN:
+        case BIGTONIR_ARRAY_PUSH:
+        case BIGTONIR_ARRAY_POP:
+        case BIGTONIR_ARRAY_LENGTH:
+        case BIGTONIR_ARRAY_INSERT:
+        case BIGTONIR_ARRAY_REMOVE:
+        case BIGTONIR_ARRAY_SUM:
+        case BIGTONIR_ARRAY_MIN:
+        case BIGTONIR_ARRAY_MAX:
+        case BIGTONIR_ARRAY_ARGMIN:
+        case BIGTONIR_ARRAY_SCALE:
+        case BIGTONIR_ARRAY_ADD:
+        case BIGTONIR_ARRAY_DOT:
+        case BIGTONIR_ARRAY_SORT:
+        case BIGTONIR_ARRAY_BINARY_SEARCH:
+        case BIGTONIR_ARRAY_INDEX_OF:
+        case BIGTONIR_ARRAY_CONTAINS:
+        case BIGTONIR_MAP_CREATE:
+        case BIGTONIR_MAP_GET:
+        case BIGTONIR_MAP_SET:
+        case BIGTONIR_MAP_HAS:
+        case BIGTONIR_MAP_KEYS:
+        case BIGTONIR_TUPLE_ADD:
+        case BIGTONIR_TUPLE_SUBTRACT:
+        case BIGTONIR_TUPLE_MULTIPLY:
+        case BIGTONIR_TUPLE_DIVIDE:
+        case BIGTONIR_MAP_SIZE:
+        case BIGTONIR_MAP_REMOVE:
+            return BIGTON_ARG_NONE;
+        case BIGTONIR_SOURCE_LINE:
+        case BIGTONIR_SOURCE_FILE:
+        case BIGTONIR_LOAD_STRING:
+        case BIGTONIR_LOAD_TUPLE:
+        case BIGTONIR_LOAD_OBJECT:
+        case BIGTONIR_LOAD_ARRAY:
+        case BIGTONIR_LOAD_TUPLE_MEMBER:
+        case BIGTONIR_LOAD_OBJECT_MEMBER:
+        case BIGTONIR_LOAD_GLOBAL:
+        case BIGTONIR_LOAD_LOCAL:
+        case BIGTONIR_STORE_GLOBAL:
+        case BIGTONIR_STORE_LOCAL:
+        case BIGTONIR_STORE_OBJECT_MEMBER:
+        case BIGTONIR_LOOP:
+        case BIGTONIR_TICK:
+        case BIGTONIR_FOR_RANGE:
+        case BIGTONIR_CALL:
+        case BIGTONIR_CALL_BUILTIN:
+            return BIGTON_ARG_VARINT;
+        case BIGTONIR_LOAD_INT:
+            return BIGTON_ARG_INT;
+        case BIGTONIR_LOAD_FLOAT:
+            return BIGTON_ARG_FLOAT;
+        case BIGTONIR_IF:
+            return BIGTON_ARG_IF;
+    }
+    return BIGTON_ARG_INVALID;
+}
+
+
+bool bigtonIsProgramV2(const uint8_t *rawProgram, size_t rawProgramSize) {
+    return rawProgramSize >= 4
+        && memcmp(rawProgram, BIGTON_V2_MAGIC, 4) == 0;
+}
+
+static size_t alignSize(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+uint8_t *bigtonDecodeProgramV2(
+    const uint8_t *rawProgram, size_t rawProgramSize,
+    size_t *decodedSize, bigton_error_t *e
+) {
+    if (rawProgramSize < BIGTON_V2_HEADER_SIZE) {
+        *e = BIGTONE_INT_INCOMPLETE_PROGRAM;
+        return NULL;
+    }
+    bigton_reader_t r = {
+        .p = rawProgram + 8,
+        .end = rawProgram + BIGTON_V2_HEADER_SIZE,
+        .failed = false
+    };
+    uint64_t checksum = bigtonReadFixed64(&r);
+    const uint8_t *payload = rawProgram + BIGTON_V2_HEADER_SIZE;
+    size_t payloadSize = rawProgramSize - BIGTON_V2_HEADER_SIZE;
+    bool validHeader = rawProgram[4] == BIGTON_V2_VERSION
+        && checksum == bigtonHashProgram(payload, payloadSize);
+    if (!validHeader) {
+        *e = BIGTONE_INT_CORRUPTED_PROGRAM;
+        return NULL;
+    }
+    r.p = payload;
+    r.end = payload + payloadSize;
+    bigton_program_t header;
+    memset(&header, 0, sizeof(bigton_program_t));
+    header.numInstrs            = bigtonReadVarint32(&r);
+    header.numStrings           = bigtonReadVarint32(&r);
+    header.numShapes            = bigtonReadVarint32(&r);
+    header.numFunctions         = bigtonReadVarint32(&r);
+    header.numBuiltinFunctions  = bigtonReadVarint32(&r);
+    header.numGlobalVars        = bigtonReadVarint32(&r);
+    header.numShapeProps        = bigtonReadVarint32(&r);
+    header.numConstStringChars  = bigtonReadVarint(&r);
+    header.unknownStrId         = bigtonReadVarint32(&r);
+    header.globalStart          = bigtonReadVarint32(&r);
+    header.globalLength         = bigtonReadVarint32(&r);
+    uint64_t sectionOffsets[BIGTON_V2_NUM_SECTIONS];
+    for (size_t s = 0; s < BIGTON_V2_NUM_SECTIONS; s += 1) {
+        sectionOffsets[s] = bigtonReadVarint(&r);
+    }
+    const uint8_t *sectionsStart = r.p;
+    // every element of every section takes up at least one byte,
+    // which also rules out overflows when computing the decoded size
+    bool validCounts = !r.failed
+        && header.numInstrs <= payloadSize
+        && header.numStrings <= payloadSize
+        && header.numShapes <= payloadSize
+        && header.numFunctions <= payloadSize
+        && header.numBuiltinFunctions <= payloadSize
+        && header.numShapeProps <= payloadSize
+        && header.numConstStringChars <= payloadSize;
+    if (!validCounts) {
+        *e = BIGTONE_INT_CORRUPTED_PROGRAM;
+        return NULL;
+    }
+    size_t size = sizeof(bigton_program_t);
+    size_t instrArgsOffset = size;
+    size += sizeof(bigton_instr_args_t) * header.numInstrs;
+    size_t constStringsOffset = size;
+    size += sizeof(bigton_const_string_t) * header.numStrings;
+    size_t shapesOffset = size;
+    size += sizeof(bigton_shape_t) * header.numShapes;
+    size_t functionsOffset = size;
+    size += sizeof(bigton_function_t) * header.numFunctions;
+    size_t builtinFunctionsOffset = size;
+    size += sizeof(bigton_builtin_function_t) * header.numBuiltinFunctions;
+    size_t propsOffset = size;
+    size += sizeof(bigton_shape_prop_t) * header.numShapeProps;
+    size_t charsOffset = size;
+    size += sizeof(bigton_char_t) * header.numConstStringChars;
+    size_t instrTypesOffset = size;
+    size += sizeof(bigton_instr_type_t) * header.numInstrs;
+    size = alignSize(size, 8);
+    // 'calloc' guarantees the alignment the sections of the program require
+    uint8_t *decoded = calloc(1, size);
+    // the size is derived from the header, which may not be trustworthy
+    if (decoded == NULL) {
+        *e = BIGTONE_INT_CORRUPTED_PROGRAM;
+        return NULL;
+    }
+    memcpy(decoded, &header, sizeof(bigton_program_t));
+    size_t section = 0;
+    #define BEGIN_SECTION() \
+        r.failed = r.failed \
+            || (uint64_t) (r.p - sectionsStart) != sectionOffsets[section]; \
+        section += 1;
+    BEGIN_SECTION();
+    bigton_instr_type_t *instrTypes
+        = (bigton_instr_type_t *) (decoded + instrTypesOffset);
+    if ((size_t) (r.end - r.p) < header.numInstrs) {
+        r.failed = true;
+    } else {
+        memcpy(instrTypes, r.p, header.numInstrs);
+        r.p += header.numInstrs;
+    }
+    BEGIN_SECTION();
+    bigton_instr_args_t *instrArgs
+        = (bigton_instr_args_t *) (decoded + instrArgsOffset);
+    for (size_t i = 0; i < header.numInstrs && !r.failed; i += 1) {
+        bigton_instr_args_t *arg = &instrArgs[i];
+        switch (instrArgKind(instrTypes[i])) {
+            case BIGTON_ARG_NONE:
+                break;
+            case BIGTON_ARG_VARINT:
+                // all of these arguments are 32-bit and share their storage
+                arg->sourceLine = bigtonReadVarint32(&r);
+                break;
+            case BIGTON_ARG_INT:
+                arg->loadInt = bigtonReadZigzag(&r);
+                break;
+            case BIGTON_ARG_FLOAT: {
+                uint64_t bits = bigtonReadFixed64(&r);
+                memcpy(&arg->loadFloat, &bits, sizeof(bigton_float_t));
+                break;
+            }
+            case BIGTON_ARG_IF:
+                arg->ifParams.ifBodyLength = bigtonReadVarint32(&r);
+                arg->ifParams.elseBodyLength = bigtonReadVarint32(&r);
+                break;
+            case BIGTON_ARG_INVALID:
+                r.failed = true;
+                break;
+        }
+    }
+    BEGIN_SECTION();
+    bigton_const_string_t *constStrings
+        = (bigton_const_string_t *) (decoded + constStringsOffset);
+    uint64_t nextCharOffset = 0;
+    for (size_t i = 0; i < header.numStrings; i += 1) {
+        constStrings[i].firstOffset = nextCharOffset;
+        constStrings[i].charLength = bigtonReadVarint(&r);
+        nextCharOffset += constStrings[i].charLength;
+    }
+    BEGIN_SECTION();
+    bigton_shape_t *shapes = (bigton_shape_t *) (decoded + shapesOffset);
+    uint32_t nextPropOffset = 0;
+    for (size_t i = 0; i < header.numShapes; i += 1) {
+        shapes[i].firstPropOffset = nextPropOffset;
+        shapes[i].propCount = bigtonReadVarint32(&r);
+        nextPropOffset += shapes[i].propCount;
+    }
+    BEGIN_SECTION();
+    bigton_function_t *functions
+        = (bigton_function_t *) (decoded + functionsOffset);
+    for (size_t i = 0; i < header.numFunctions; i += 1) {
+        functions[i].name = bigtonReadVarint32(&r);
+        functions[i].declSource.file = bigtonReadVarint32(&r);
+        functions[i].declSource.line = bigtonReadVarint32(&r);
+        functions[i].start = bigtonReadVarint32(&r);
+        functions[i].length = bigtonReadVarint32(&r);
+    }
+    BEGIN_SECTION();
+    bigton_builtin_function_t *builtinFunctions
+        = (bigton_builtin_function_t *) (decoded + builtinFunctionsOffset);
+    for (size_t i = 0; i < header.numBuiltinFunctions; i += 1) {
+        builtinFunctions[i].name = bigtonReadVarint32(&r);
+        builtinFunctions[i].cost = bigtonReadVarint32(&r);
+    }
+    BEGIN_SECTION();
+    bigton_shape_prop_t *props = (bigton_shape_prop_t *) (decoded + propsOffset);
+    for (size_t i = 0; i < header.numShapeProps; i += 1) {
+        props[i].name = bigtonReadVarint32(&r);
+    }
+    BEGIN_SECTION();
+    bigton_char_t *chars = (bigton_char_t *) (decoded + charsOffset);
+    for (size_t i = 0; i < header.numConstStringChars; i += 1) {
+        uint32_t c = bigtonReadVarint32(&r);
+        if (c > UINT16_MAX) { r.failed = true; }
+        chars[i] = (bigton_char_t) c;
+    }
+    #undef BEGIN_SECTION
+    bool validStrings = r.p == r.end
+        && nextCharOffset == header.numConstStringChars
+        && nextPropOffset == header.numShapeProps;
+    if (r.failed || !validStrings) {
+        free(decoded);
+        *e = BIGTONE_INT_CORRUPTED_PROGRAM;
+        return NULL;
+    }
+    *decodedSize = size;
+    return decoded;
+}
@@ -0,0 +1,221 @@
+
+#include <bigton/runtime.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+uint64_t bigtonHashProgram(const uint8_t *rawProgram, size_t rawProgramSize) {
+    // 64-bit FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < rawProgramSize; i += 1) {
+        hash ^= (uint64_t) rawProgram[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bigton_program_image_t *allocImage(
+    uint8_t *rawProgram, size_t rawProgramSize, uint64_t hash, bool mapped
+) {
+    bigton_program_image_t *image = malloc(sizeof(bigton_program_image_t));
+    atomic_init(&image->rc, 1);
+    image->hash = hash;
+    image->shared = false;
+    image->mapped = mapped;
+    image->rawProgramSize = rawProgramSize;
+    image->rawProgram = rawProgram;
+    image->error = BIGTONE_NONE;
+    image->initSnapshots = NULL;
+    bigtonParseProgram(
+        image->rawProgram, rawProgramSize, &image->program, &image->error
+    );
+    if (image->error != BIGTONE_NONE) {
+        bigtonFreeParsedProgram(&image->program);
+        memset(&image->program, 0, sizeof(bigton_parsed_program_t));
+        image->program.rawProgramBuffer = image->rawProgram;
+    }
+    return image;
+}
+
+static bigton_program_image_t *createImage(
+    const uint8_t *rawProgram, size_t rawProgramSize, uint64_t hash
+) {
+    // 'malloc' guarantees the alignment the sections of the program require
+    uint8_t *copy = malloc(rawProgramSize == 0 ? 1 : rawProgramSize);
+    memcpy(copy, rawProgram, rawProgramSize);
+    return allocImage(copy, rawProgramSize, hash, false);
+}
+
+static void freeImage(bigton_program_image_t *image) {
+    bigton_init_snapshot_t *initSnapshot = image->initSnapshots;
+    while (initSnapshot != NULL) {
+        bigton_init_snapshot_t *next = initSnapshot->next;
+        free(initSnapshot->snapshot);
+        free(initSnapshot);
+        initSnapshot = next;
+    }
+    bigtonFreeParsedProgram(&image->program);
+    if (!image->mapped) {
+        free(image->rawProgram);
+    } else {
+#ifdef _WIN32
+        UnmapViewOfFile(image->rawProgram);
+#else
+        munmap(image->rawProgram, image->rawProgramSize);
+#endif
+    }
+    free(image);
+}
+
+bigton_program_image_t *bigtonImageCreate(
+    const uint8_t *rawProgram, size_t rawProgramSize
+) {
+    uint64_t hash = bigtonHashProgram(rawProgram, rawProgramSize);
+    return createImage(rawProgram, rawProgramSize, hash);
+}
+
+
+// Maps the file at the given path into memory as read-only, returning NULL
+// if the file could not be opened. Since pages are only loaded once they are
+// accessed, this is the cheapest way of loading a program cached on disk.
+// Mapped images are never shared.
+// Empty files can not be mapped and are reported as 'EINVAL'.
+static uint8_t *mapFile(const char *path, size_t *sizeOut) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(
+        path, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL
+    );
+    if (file == INVALID_HANDLE_VALUE) { return NULL; }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        errno = EINVAL;
+        return NULL;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) { return NULL; }
+    void *mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (mapped == NULL) { return NULL; }
+    *sizeOut = (size_t) fileSize.QuadPart;
+    return mapped;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { return NULL; }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if (fileStat.st_size == 0) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    size_t size = (size_t) fileStat.st_size;
+    void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) { return NULL; }
+    *sizeOut = size;
+    return mapped;
+#endif
+}
+
+bigton_program_image_t *bigtonImageLoadFile(const char *path) {
+    size_t rawProgramSize;
+    uint8_t *rawProgram = mapFile(path, &rawProgramSize);
+    if (rawProgram == NULL) { return NULL; }
+    uint64_t hash = bigtonHashProgram(rawProgram, rawProgramSize);
+    return allocImage(rawProgram, rawProgramSize, hash, true);
+}
+
+
+// Registry of all shared images, used to make runtimes created from the same
+// program bytes share the same image. Entries do not hold a reference, and
+// are removed once the last reference to a shared image is released.
+static pthread_mutex_t sharedImagesLock = PTHREAD_MUTEX_INITIALIZER;
+static size_t sharedImagesCapacity = 0;
+static size_t sharedImagesCount = 0;
+static bigton_program_image_t **sharedImages = NULL;
+
+static bigton_program_image_t *findSharedImage(
+    const uint8_t *rawProgram, size_t rawProgramSize, uint64_t hash
+) {
+    for (size_t i = 0; i < sharedImagesCount; i += 1) {
+        bigton_program_image_t *image = sharedImages[i];
+        if (image->hash != hash) { continue; }
+        if (image->rawProgramSize != rawProgramSize) { continue; }
+        if (memcmp(image->rawProgram, rawProgram, rawProgramSize) != 0) {
+            continue;
+        }
+        return image;
+    }
+    return NULL;
+}
+
+bigton_program_image_t *bigtonImageLoadShared(
+    const uint8_t *rawProgram, size_t rawProgramSize
+) {
+    uint64_t hash = bigtonHashProgram(rawProgram, rawProgramSize);
+    pthread_mutex_lock(&sharedImagesLock);
+    bigton_program_image_t *image
+        = findSharedImage(rawProgram, rawProgramSize, hash);
+    if (image != NULL) {
+        atomic_fetch_add(&image->rc, 1);
+        pthread_mutex_unlock(&sharedImagesLock);
+        return image;
+    }
+    image = createImage(rawProgram, rawProgramSize, hash);
+    image->shared = true;
+    if (sharedImagesCount >= sharedImagesCapacity) {
+        sharedImagesCapacity = sharedImagesCapacity == 0
+            ? 8 : sharedImagesCapacity * 2;
+        sharedImages = realloc(
+            sharedImages,
+            sizeof(bigton_program_image_t *) * sharedImagesCapacity
+        );
+    }
+    sharedImages[sharedImagesCount] = image;
+    sharedImagesCount += 1;
+    pthread_mutex_unlock(&sharedImagesLock);
+    return image;
+}
+
+void bigtonImageRcIncr(bigton_program_image_t *image) {
+    atomic_fetch_add(&image->rc, 1);
+}
+
+void bigtonImageRcDecr(bigton_program_image_t *image) {
+    if (!image->shared) {
+        if (atomic_fetch_sub(&image->rc, 1) == 1) { freeImage(image); }
+        return;
+    }
+    // shared images may only reach zero references while holding the lock,
+    // since 'bigtonImageLoadShared' may otherwise revive a freed image
+    pthread_mutex_lock(&sharedImagesLock);
+    if (atomic_fetch_sub(&image->rc, 1) != 1) {
+        pthread_mutex_unlock(&sharedImagesLock);
+        return;
+    }
+    for (size_t i = 0; i < sharedImagesCount; i += 1) {
+        if (sharedImages[i] != image) { continue; }
+        sharedImagesCount -= 1;
+        sharedImages[i] = sharedImages[sharedImagesCount];
+        break;
+    }
+    pthread_mutex_unlock(&sharedImagesLock);
+    freeImage(image);
+}
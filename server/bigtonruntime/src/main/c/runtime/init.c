@@ -1,18 +1,51 @@
 
-#define BIGTON_ERROR_MACROS
 #include <bigton/values.h>
 #include <bigton/ir.h>
 #include <bigton/runtime.h>
+#include <stdlib.h>
+
+// The sections of a program are laid out such that each of them is
+// correctly aligned as long as the program itself starts at an address
+// aligned to 8 bytes (see 'ir.h'). Since programs may be read from memory
+// we do not control (e.g. mapped files), alignment is checked for each
+// section.
+#define PARSE_SECTION(dest, T, count) do { \
+    aligned = aligned && ((uintptr_t) p) % _Alignof(T) == 0; \
+    dest = (T *) p; \
+    p += sizeof(T) * (count); \
+} while (0)
 
 void bigtonParseProgram(
     const uint8_t *rawProgram, size_t rawProgramSize,
     bigton_parsed_program_t *dest, bigton_error_t *e
 ) {
+    dest->decodedProgramBuffer = NULL;
+    if (bigtonIsProgramV2(rawProgram, rawProgramSize)) {
+        size_t decodedSize;
+        uint8_t *decoded = bigtonDecodeProgramV2(
+            rawProgram, rawProgramSize, &decodedSize, e
+        );
+        if (decoded == NULL) { return; }
+        bigtonParseProgram(decoded, decodedSize, dest, e);
+        dest->decodedProgramBuffer = decoded;
+        return;
+    }
+
     const uint8_t *p = rawProgram;
+    bool aligned = true;
 
     dest->rawProgramBuffer = rawProgram;
+    if (rawProgramSize < sizeof(bigton_program_t)) {
+        *e = BIGTONE_INT_INCOMPLETE_PROGRAM;
+        return;
+    }
 
-    bigton_program_t *header = (bigton_program_t *) rawProgram;
+    const bigton_program_t *header;
+    PARSE_SECTION(header, const bigton_program_t, 1);
+    if (!aligned) {
+        *e = BIGTONE_INT_MISALIGNED_PROGRAM;
+        return;
+    }
     dest->unknownStrId          = header->unknownStrId;
     dest->numInstrs             = header->numInstrs;
     dest->numConstStrings       = header->numStrings;
@@ -24,37 +57,38 @@ void bigtonParseProgram(
     dest->numGlobals            = header->numGlobalVars;
     dest->globalStart           = header->globalStart;
     dest->globalEnd             = header->globalStart + header->globalLength;
-    p += sizeof(bigton_program_t);
-    
-    dest->instrArgs = (bigton_instr_args_t *) p;
-    p += sizeof(bigton_instr_args_t) * header->numInstrs;
-    
-    dest->constStrings = (bigton_const_string_t *) p;
-    p += sizeof(bigton_const_string_t) * header->numStrings;
     
-    dest->shapes = (bigton_shape_t *) p;
-    p += sizeof(bigton_shape_t) * header->numShapes;
-    
-    dest->functions = (bigton_function_t *) p;
-    p += sizeof(bigton_function_t) * header->numFunctions;
-    
-    dest->builtinFunctions = (bigton_builtin_function_t *) p;
-    p += sizeof(bigton_builtin_function_t) * header->numBuiltinFunctions;
-    
-    dest->props = (bigton_shape_prop_t *) p;
-    p += sizeof(bigton_shape_prop_t) * header->numShapeProps;
-    
-    dest->constStringChars = (const bigton_char_t *) p;
-    p += sizeof(bigton_char_t) * header->numConstStringChars;
-    
-    dest->instrTypes = (bigton_instr_type_t *) p;
-    p += sizeof(bigton_instr_type_t) * header->numInstrs;
+    PARSE_SECTION(dest->instrArgs, bigton_instr_args_t, header->numInstrs);
+    PARSE_SECTION(
+        dest->constStrings, bigton_const_string_t, header->numStrings
+    );
+    PARSE_SECTION(dest->shapes, bigton_shape_t, header->numShapes);
+    PARSE_SECTION(dest->functions, bigton_function_t, header->numFunctions);
+    PARSE_SECTION(
+        dest->builtinFunctions, bigton_builtin_function_t,
+        header->numBuiltinFunctions
+    );
+    PARSE_SECTION(dest->props, bigton_shape_prop_t, header->numShapeProps);
+    PARSE_SECTION(
+        dest->constStringChars, const bigton_char_t,
+        header->numConstStringChars
+    );
+    PARSE_SECTION(dest->instrTypes, bigton_instr_type_t, header->numInstrs);
     
     const uint8_t *end = rawProgram + rawProgramSize;
     if (p > end) {
         *e = BIGTONE_INT_INCOMPLETE_PROGRAM;
         return;
     }
+    if (!aligned) {
+        *e = BIGTONE_INT_MISALIGNED_PROGRAM;
+        return;
+    }
+}
+
+void bigtonFreeParsedProgram(bigton_parsed_program_t *p) {
+    free(p->decodedProgramBuffer);
+    p->decodedProgramBuffer = NULL;
 }
 
 static void allocateGlobals(bigton_runtime_state_t *r) {
@@ -67,6 +101,27 @@ static void allocateGlobals(bigton_runtime_state_t *r) {
     }
 }
 
+#define INITIAL_SCOPES_CAPACITY 8
+
+// The global scope is always pushed, which is why the scopes are allocated up
+// front, regardless of the memory usage limit (just like the globals).
+static void allocateScopes(bigton_runtime_state_t *r) {
+    r->scopesCapacity = INITIAL_SCOPES_CAPACITY;
+    r->scopes = bigtonAllocBuff(
+        &r->b, sizeof(bigton_scope_t) * INITIAL_SCOPES_CAPACITY
+    );
+    r->scopesCount = 0;
+}
+
+static void allocateConstStrings(bigton_runtime_state_t *r) {
+    r->constStrings = bigtonAllocNullableBuff(
+        &r->b, sizeof(bigton_string_t *) * r->program.numConstStrings
+    );
+    for (size_t i = 0; i < r->program.numConstStrings; i += 1) {
+        r->constStrings[i] = NULL;
+    }
+}
+
 void bigtonInit(
     bigton_runtime_state_t *r,
     const bigton_runtime_settings_t *settings,
@@ -74,14 +129,21 @@ void bigtonInit(
 ) {
     r->error = BIGTONE_NONE;
     r->program = *p;
-    if (HAS_ERROR(r)) { return; }
+    r->image = NULL;
     r->settings = *settings;
     r->b = (bigton_buff_owner_t) {
         .first = NULL,
         .last = NULL,
-        .totalSizeBytes = 0
+        .totalSizeBytes = 0,
+        .peakSizeBytes = 0,
+        .limitBytes = settings->memoryUsageLimit,
+        .nextSeq = 0,
+        .sharedBelow = 0,
+        .cycleRoots = BIGTON_CYCLE_ROOTS_INIT,
+        .freeQueue = BIGTON_FREE_QUEUE_INIT
     };
     allocateGlobals(r);
+    allocateConstStrings(r);
     r->logsCapacity = 0;
     r->logsCount = 0;
     r->logs = NULL;
@@ -89,9 +151,7 @@ void bigtonInit(
     r->traceCount = 0;
     r->trace = NULL;
     r->stack = BIGTON_VALUE_STACK_INIT;
-    r->scopesCapacity = 0;
-    r->scopesCount = 0;
-    r->scopes = NULL;
+    allocateScopes(r);
     r->locals = BIGTON_VALUE_STACK_INIT;
     r->currentSource = (bigton_source_t) {
         .file = r->program.unknownStrId,
@@ -100,6 +160,17 @@ void bigtonInit(
     r->currentInstr = r->program.globalStart;
     r->accCost = 0;
     r->awaitingBuiltinFun = 0;
+    r->createdValues = 0;
+    r->preparedStatus = BIGTONST_CONTINUE;
+    r->preparedCost = 0;
+    r->sharedHeap = NULL;
+    r->forkedHeap = NULL;
+    r->cow = (bigton_cow_map_t) {
+        .capacity = 0, .count = 0, .keys = NULL, .copies = NULL
+    };
+    r->hibernated = NULL;
+    r->hostValues = NULL;
+    r->cycles = BIGTON_CYCLE_COLLECTOR_INIT;
     bigtonScopePush(r, (bigton_scope_t) {
         .type = BIGTONSC_GLOBAL,
         .start = r->program.globalStart,
@@ -109,6 +180,150 @@ void bigtonInit(
     });
 }
 
-void bigtonFree(bigton_runtime_state_t *r) {
+void bigtonInitFromImage(
+    bigton_runtime_state_t *r,
+    const bigton_runtime_settings_t *settings,
+    bigton_program_image_t *image
+) {
+    bigtonInit(r, settings, &image->program);
+    bigtonImageRcIncr(image);
+    r->image = image;
+    r->error = image->error;
+}
+
+void bigtonHostValueAttach(
+    bigton_runtime_state_t *r, bigton_host_value_t *value
+) {
+    value->r = r;
+    value->prev = NULL;
+    value->next = NULL;
+    if (r == NULL) { return; }
+    value->next = r->hostValues;
+    if (r->hostValues != NULL) { r->hostValues->prev = value; }
+    r->hostValues = value;
+}
+
+void bigtonHostValueDetach(bigton_host_value_t *value) {
+    bigton_runtime_state_t *r = value->r;
+    if (r == NULL) { return; }
+    if (value->prev == NULL) {
+        r->hostValues = value->next;
+    } else {
+        value->prev->next = value->next;
+    }
+    if (value->next != NULL) { value->next->prev = value->prev; }
+    value->r = NULL;
+    value->prev = NULL;
+    value->next = NULL;
+}
+
+// Frees all buffers owned by the runtime (including the snapshot of a
+// hibernated runtime), and releases the heaps it shares with other runtimes.
+static void freeHeap(bigton_runtime_state_t *r) {
+    if (r->hibernated != NULL) {
+        free(r->hibernated->data);
+        free(r->hibernated);
+        r->hibernated = NULL;
+    }
+    while (r->hostValues != NULL) {
+        bigtonHostValueDetach(r->hostValues);
+    }
+    if (r->forkedHeap != NULL) {
+        bigtonMoveSharedBuffs(&r->b, &r->forkedHeap->b);
+        bigtonSharedHeapRcDecr(r->forkedHeap);
+        r->forkedHeap = NULL;
+    }
     bigtonFreeAll(&r->b);
-}
\ No newline at end of file
+    if (r->sharedHeap != NULL) {
+        bigtonSharedHeapRcDecr(r->sharedHeap);
+        r->sharedHeap = NULL;
+    }
+}
+
+void bigtonFree(bigton_runtime_state_t *r) {
+    freeHeap(r);
+    if (r->image != NULL) {
+        bigtonImageRcDecr(r->image);
+        r->image = NULL;
+    }
+}
+
+#define KEPT_BUFFER_COUNT 10
+
+void bigtonReset(bigton_runtime_state_t *r) {
+    void *kept[KEPT_BUFFER_COUNT] = {
+        r->globalTypes, r->globalValues, r->constStrings, r->logs, r->trace,
+        r->stack.types, r->stack.values, r->scopes,
+        r->locals.types, r->locals.values
+    };
+    // kept buffers are never shared, since forking copies them
+    bigton_buff_owner_t keptOwner = (bigton_buff_owner_t) {
+        .first = NULL,
+        .last = NULL,
+        .totalSizeBytes = 0,
+        .peakSizeBytes = 0,
+        .limitBytes = SIZE_MAX,
+        .nextSeq = 0,
+        .sharedBelow = 0,
+        .cycleRoots = BIGTON_CYCLE_ROOTS_INIT,
+        .freeQueue = BIGTON_FREE_QUEUE_INIT
+    };
+    for (size_t i = 0; i < KEPT_BUFFER_COUNT; i += 1) {
+        if (kept[i] != NULL) { bigtonMoveBuff(&keptOwner, kept[i]); }
+    }
+    freeHeap(r);
+    r->b = (bigton_buff_owner_t) {
+        .first = NULL,
+        .last = NULL,
+        .totalSizeBytes = 0,
+        .peakSizeBytes = 0,
+        .limitBytes = r->settings.memoryUsageLimit,
+        .nextSeq = 0,
+        .sharedBelow = 0,
+        .cycleRoots = BIGTON_CYCLE_ROOTS_INIT,
+        .freeQueue = BIGTON_FREE_QUEUE_INIT
+    };
+    for (size_t i = 0; i < KEPT_BUFFER_COUNT; i += 1) {
+        if (kept[i] != NULL) { bigtonMoveBuff(&r->b, kept[i]); }
+    }
+    r->error = r->image != NULL ? r->image->error : BIGTONE_NONE;
+    // hibernated runtimes do not have any buffers to keep
+    if (r->globalTypes == NULL) { allocateGlobals(r); }
+    for (size_t i = 0; i < r->program.numGlobals; i += 1) {
+        r->globalTypes[i] = BIGTON_NULL;
+    }
+    if (r->constStrings == NULL) {
+        allocateConstStrings(r);
+    } else {
+        for (size_t i = 0; i < r->program.numConstStrings; i += 1) {
+            r->constStrings[i] = NULL;
+        }
+    }
+    if (r->scopes == NULL) { allocateScopes(r); }
+    r->logsCount = 0;
+    r->traceCount = 0;
+    r->stack.count = 0;
+    r->scopesCount = 0;
+    r->locals.count = 0;
+    r->currentSource = (bigton_source_t) {
+        .file = r->program.unknownStrId,
+        .line = 0
+    };
+    r->currentInstr = r->program.globalStart;
+    r->accCost = 0;
+    r->awaitingBuiltinFun = 0;
+    r->createdValues = 0;
+    r->preparedStatus = BIGTONST_CONTINUE;
+    r->preparedCost = 0;
+    r->cow = (bigton_cow_map_t) {
+        .capacity = 0, .count = 0, .keys = NULL, .copies = NULL
+    };
+    r->cycles = BIGTON_CYCLE_COLLECTOR_INIT;
+    bigtonScopePush(r, (bigton_scope_t) {
+        .type = BIGTONSC_GLOBAL,
+        .start = r->program.globalStart,
+        .end = r->program.globalEnd,
+        .after = r->program.globalStart,
+        .numLocals = 0
+    });
+}
@@ -0,0 +1,642 @@
+
+#define BIGTON_ERROR_MACROS
+#include <bigton/kernels.h>
+#include <bigton/values.h>
+#include <bigton/runtime.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Function multiversioning relies on ifuncs, which are only supported by
+// ELF targets. The default clone is compiled for the SSE2 baseline of x86-64.
+// The AVX2 clone does not enable FMA, meaning that float products are rounded
+// before being accumulated in both clones.
+#if defined(__x86_64__) && defined(__linux__) && defined(__GNUC__)
+    #define KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+    #define KERNEL
+#endif
+
+// number of independent accumulators, enough to fill two AVX2 registers
+#define LANES 8
+
+// which NaN the hardware produces depends on the order of the operands, which
+// may differ between variants
+static inline bigton_float_t canonicalNaN(bigton_float_t f) {
+    return f != f ? NAN : f;
+}
+
+KERNEL
+bigton_int_t bigtonKernelSumInt(const bigton_value_t *x, size_t n) {
+    uint64_t acc[LANES] = { 0 };
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (size_t l = 0; l < LANES; l += 1) {
+            acc[l] += (uint64_t) x[i + l].i;
+        }
+    }
+    uint64_t sum = 0;
+    for (size_t l = 0; l < LANES; l += 1) { sum += acc[l]; }
+    for (; i < n; i += 1) { sum += (uint64_t) x[i].i; }
+    return (bigton_int_t) sum;
+}
+
+KERNEL
+bigton_float_t bigtonKernelSumFloat(const bigton_value_t *x, size_t n) {
+    bigton_float_t acc[LANES] = { 0 };
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (size_t l = 0; l < LANES; l += 1) {
+            acc[l] += x[i + l].f;
+        }
+    }
+    bigton_float_t sum = 0;
+    for (size_t l = 0; l < LANES; l += 1) { sum += acc[l]; }
+    for (; i < n; i += 1) { sum += x[i].f; }
+    return canonicalNaN(sum);
+}
+
+// 'BETTER(a, b)' is true if 'a' should replace 'b'. Whether a NaN was seen is
+// tracked separately for each lane (this is optimized out for ints), with the
+// result being NaN if there was any.
+#define EXTREMUM_KERNEL(name, type, member, BETTER, FINISH) \
+    KERNEL \
+    type name(const bigton_value_t *x, size_t n) { \
+        type acc[LANES]; \
+        bool unordered[LANES]; \
+        for (size_t l = 0; l < LANES; l += 1) { \
+            acc[l] = x[0].member; \
+            unordered[l] = false; \
+        } \
+        size_t i = 0; \
+        for (; i + LANES <= n; i += LANES) { \
+            for (size_t l = 0; l < LANES; l += 1) { \
+                type v = x[i + l].member; \
+                acc[l] = BETTER(v, acc[l]) ? v : acc[l]; \
+                unordered[l] |= v != v; \
+            } \
+        } \
+        type result = acc[0]; \
+        bool anyUnordered = unordered[0]; \
+        for (size_t l = 1; l < LANES; l += 1) { \
+            result = BETTER(acc[l], result) ? acc[l] : result; \
+            anyUnordered |= unordered[l]; \
+        } \
+        for (; i < n; i += 1) { \
+            type v = x[i].member; \
+            result = BETTER(v, result) ? v : result; \
+            anyUnordered |= v != v; \
+        } \
+        return FINISH(result, anyUnordered); \
+    }
+
+#define LESS_THAN(a, b) ((a) < (b))
+#define GREATER_THAN(a, b) ((a) > (b))
+#define INT_RESULT(r, anyUnordered) (r)
+#define FLOAT_RESULT(r, anyUnordered) ((anyUnordered) ? NAN : (r))
+
+EXTREMUM_KERNEL(bigtonKernelMinInt, bigton_int_t, i, LESS_THAN, INT_RESULT)
+EXTREMUM_KERNEL(
+    bigtonKernelMinFloat, bigton_float_t, f, LESS_THAN, FLOAT_RESULT
+)
+EXTREMUM_KERNEL(bigtonKernelMaxInt, bigton_int_t, i, GREATER_THAN, INT_RESULT)
+EXTREMUM_KERNEL(
+    bigtonKernelMaxFloat, bigton_float_t, f, GREATER_THAN, FLOAT_RESULT
+)
+
+// compares whole blocks without branching, only searching a block element by
+// element once it is known to contain a match
+#define FIND_KERNEL(name, type, member) \
+    KERNEL \
+    size_t name(const bigton_value_t *x, size_t n, type v) { \
+        size_t i = 0; \
+        for (; i + LANES <= n; i += LANES) { \
+            bool found = false; \
+            for (size_t l = 0; l < LANES; l += 1) { \
+                found |= x[i + l].member == v; \
+            } \
+            if (found) { break; } \
+        } \
+        for (; i < n; i += 1) { \
+            if (x[i].member == v) { return i; } \
+        } \
+        return n; \
+    }
+
+FIND_KERNEL(bigtonKernelFindInt, bigton_int_t, i)
+FIND_KERNEL(bigtonKernelFindFloat, bigton_float_t, f)
+
+KERNEL
+void bigtonKernelScaleInt(
+    bigton_value_t *dest, const bigton_value_t *x, size_t n, bigton_int_t f
+) {
+    for (size_t i = 0; i < n; i += 1) {
+        dest[i].i = (bigton_int_t) ((uint64_t) x[i].i * (uint64_t) f);
+    }
+}
+
+KERNEL
+void bigtonKernelScaleFloat(
+    bigton_value_t *dest, const bigton_value_t *x, size_t n, bigton_float_t f
+) {
+    for (size_t i = 0; i < n; i += 1) {
+        dest[i].f = canonicalNaN(x[i].f * f);
+    }
+}
+
+KERNEL
+void bigtonKernelAddInt(
+    bigton_value_t *dest, const bigton_value_t *x, const bigton_value_t *y,
+    size_t n
+) {
+    for (size_t i = 0; i < n; i += 1) {
+        dest[i].i = (bigton_int_t) ((uint64_t) x[i].i + (uint64_t) y[i].i);
+    }
+}
+
+KERNEL
+void bigtonKernelAddFloat(
+    bigton_value_t *dest, const bigton_value_t *x, const bigton_value_t *y,
+    size_t n
+) {
+    for (size_t i = 0; i < n; i += 1) {
+        dest[i].f = canonicalNaN(x[i].f + y[i].f);
+    }
+}
+
+KERNEL
+bigton_int_t bigtonKernelDotInt(
+    const bigton_value_t *x, const bigton_value_t *y, size_t n
+) {
+    uint64_t acc[LANES] = { 0 };
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (size_t l = 0; l < LANES; l += 1) {
+            acc[l] += (uint64_t) x[i + l].i * (uint64_t) y[i + l].i;
+        }
+    }
+    uint64_t sum = 0;
+    for (size_t l = 0; l < LANES; l += 1) { sum += acc[l]; }
+    for (; i < n; i += 1) { sum += (uint64_t) x[i].i * (uint64_t) y[i].i; }
+    return (bigton_int_t) sum;
+}
+
+KERNEL
+bigton_float_t bigtonKernelDotFloat(
+    const bigton_value_t *x, const bigton_value_t *y, size_t n
+) {
+    bigton_float_t acc[LANES] = { 0 };
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (size_t l = 0; l < LANES; l += 1) {
+            acc[l] += x[i + l].f * y[i + l].f;
+        }
+    }
+    bigton_float_t sum = 0;
+    for (size_t l = 0; l < LANES; l += 1) { sum += acc[l]; }
+    for (; i < n; i += 1) { sum += x[i].f * y[i].f; }
+    return canonicalNaN(sum);
+}
+
+// arrays up to this length are insertion sorted, which is also the length of
+// the runs merged by the float sort
+#define SMALL_SORT_LENGTH 32
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_DIGITS (64 / RADIX_BITS)
+
+static bool intBefore(bigton_int_t a, bigton_int_t b) {
+    return a < b;
+}
+
+static bool floatBefore(bigton_float_t a, bigton_float_t b) {
+    return a < b || (isnan(b) && !isnan(a));
+}
+
+#define INSERTION_SORT(name, member, BEFORE) \
+    static void name(bigton_value_t *x, size_t n) { \
+        for (size_t i = 1; i < n; i += 1) { \
+            bigton_value_t v = x[i]; \
+            size_t j = i; \
+            for (; j > 0 && BEFORE(v.member, x[j - 1].member); j -= 1) { \
+                x[j] = x[j - 1]; \
+            } \
+            x[j] = v; \
+        } \
+    }
+
+INSERTION_SORT(insertionSortInt, i, intBefore)
+INSERTION_SORT(insertionSortFloat, f, floatBefore)
+
+// flips the sign bit so that the unsigned order of keys matches the signed
+// order of the ints
+static uint64_t radixKey(bigton_int_t i) {
+    return (uint64_t) i ^ ((uint64_t) 1 << 63);
+}
+
+void bigtonKernelSortInt(
+    bigton_value_t *x, bigton_value_t *scratch, size_t n
+) {
+    if (n <= SMALL_SORT_LENGTH) {
+        insertionSortInt(x, n);
+        return;
+    }
+    size_t counts[RADIX_DIGITS][RADIX_BUCKETS];
+    memset(counts, 0, sizeof(counts));
+    for (size_t i = 0; i < n; i += 1) {
+        uint64_t key = radixKey(x[i].i);
+        for (size_t d = 0; d < RADIX_DIGITS; d += 1) {
+            counts[d][(key >> (d * RADIX_BITS)) & (RADIX_BUCKETS - 1)] += 1;
+        }
+    }
+    bigton_value_t *src = x;
+    bigton_value_t *dest = scratch;
+    for (size_t d = 0; d < RADIX_DIGITS; d += 1) {
+        size_t shift = d * RADIX_BITS;
+        size_t *offsets = counts[d];
+        size_t firstDigit = (radixKey(src[0].i) >> shift) & (RADIX_BUCKETS - 1);
+        // all keys share this digit, meaning the pass would not move anything
+        if (offsets[firstDigit] == n) { continue; }
+        size_t offset = 0;
+        for (size_t b = 0; b < RADIX_BUCKETS; b += 1) {
+            size_t count = offsets[b];
+            offsets[b] = offset;
+            offset += count;
+        }
+        for (size_t i = 0; i < n; i += 1) {
+            size_t digit = (radixKey(src[i].i) >> shift) & (RADIX_BUCKETS - 1);
+            dest[offsets[digit]] = src[i];
+            offsets[digit] += 1;
+        }
+        bigton_value_t *swapped = src;
+        src = dest;
+        dest = swapped;
+    }
+    if (src != x) { memcpy(x, src, sizeof(bigton_value_t) * n); }
+}
+
+// stable, taking from 'a' unless the next value of 'b' is strictly before it
+static void mergeFloats(
+    bigton_value_t *dest, const bigton_value_t *a, size_t aLength,
+    const bigton_value_t *b, size_t bLength
+) {
+    size_t i = 0;
+    size_t j = 0;
+    while (i < aLength && j < bLength) {
+        if (floatBefore(b[j].f, a[i].f)) {
+            *dest = b[j];
+            j += 1;
+        } else {
+            *dest = a[i];
+            i += 1;
+        }
+        dest += 1;
+    }
+    memcpy(dest, a + i, sizeof(bigton_value_t) * (aLength - i));
+    memcpy(dest + (aLength - i), b + j, sizeof(bigton_value_t) * (bLength - j));
+}
+
+void bigtonKernelSortFloat(
+    bigton_value_t *x, bigton_value_t *scratch, size_t n
+) {
+    for (size_t start = 0; start < n; start += SMALL_SORT_LENGTH) {
+        size_t remaining = n - start;
+        insertionSortFloat(
+            x + start,
+            remaining < SMALL_SORT_LENGTH ? remaining : SMALL_SORT_LENGTH
+        );
+    }
+    bigton_value_t *src = x;
+    bigton_value_t *dest = scratch;
+    for (size_t width = SMALL_SORT_LENGTH; width < n; width *= 2) {
+        for (size_t lo = 0; lo < n; lo += width * 2) {
+            size_t mid = lo + width < n ? lo + width : n;
+            size_t hi = lo + width * 2 < n ? lo + width * 2 : n;
+            mergeFloats(dest + lo, src + lo, mid - lo, src + mid, hi - mid);
+        }
+        bigton_value_t *swapped = src;
+        src = dest;
+        dest = swapped;
+    }
+    if (src != x) { memcpy(x, src, sizeof(bigton_value_t) * n); }
+}
+
+
+typedef struct KernelOperand {
+    // 'BIGTON_INT' or 'BIGTON_FLOAT', or 'BIGTON_NULL' if the array is empty
+    bigton_value_type_t t;
+    size_t length;
+    const bigton_value_t *values;
+} kernel_operand_t;
+
+static bool readOperand(
+    bigton_runtime_state_t *r, bigton_tagged_value_t v, kernel_operand_t *o
+) {
+    if (v.t != BIGTON_ARRAY) {
+        if (!HAS_ERROR(r)) { r->error = BIGTONE_OPERAND_NOT_ARRAY; }
+        return false;
+    }
+    bigton_array_t *a = bigtonArrayRead(r, v.v.a);
+    if (a->length > 0 && a->packedType == BIGTON_NULL) {
+        r->error = BIGTONE_OPERANDS_NOT_NUMBERS;
+        return false;
+    }
+    o->t = a->length == 0 ? BIGTON_NULL : a->packedType;
+    o->length = a->length;
+    o->values = a->elementValues;
+    r->accCost += a->length / BIGTON_KERNEL_ELEMS_PER_COST;
+    return true;
+}
+
+// Element type shared by both operands, which need to be of the same length.
+static bigton_value_type_t commonType(
+    bigton_runtime_state_t *r,
+    const kernel_operand_t *a, const kernel_operand_t *b
+) {
+    if (a->length != b->length) {
+        r->error = BIGTONE_ARRAY_INDEX_OOB;
+        return BIGTON_NULL;
+    }
+    if (a->t != b->t) {
+        r->error = BIGTONE_OPERANDS_NOT_NUMBERS;
+        return BIGTON_NULL;
+    }
+    return a->t;
+}
+
+static bigton_array_t *allocPackedArray(
+    bigton_runtime_state_t *r, bigton_value_type_t t, size_t length
+) {
+    size_t sizes[] = {
+        sizeof(bigton_value_t) * length,
+        sizeof(bigton_array_t)
+    };
+    void *buffers[2];
+    if (!bigtonAllocValueBuffs(r, 2, sizes, buffers)) { return NULL; }
+    bigton_array_t *a = buffers[1];
+    a->rc = BIGTON_RC_INIT;
+    a->hash = bigtonNextValueHash(r);
+    a->capacity = (uint32_t) length;
+    a->length = (uint32_t) length;
+    a->packedType = length == 0 ? BIGTON_NULL : t;
+    a->elementTypes = NULL;
+    a->elementValues = buffers[0];
+    a->viewed = NULL;
+    return a;
+}
+
+static bigton_tagged_value_t reduce(
+    bigton_runtime_state_t *r, bigton_instr_type_t t,
+    const kernel_operand_t *a
+) {
+    const bigton_value_t *x = a->values;
+    size_t n = a->length;
+    bool isFloat = a->t == BIGTON_FLOAT;
+    if (n == 0 && t != BIGTONIR_ARRAY_SUM) {
+        r->error = BIGTONE_ARRAY_INDEX_OOB;
+        return BIGTON_NULL_VALUE;
+    }
+    switch (t) {
+        case BIGTONIR_ARRAY_SUM:
+            return isFloat
+                ? BIGTON_FLOAT_VALUE(bigtonKernelSumFloat(x, n))
+                : BIGTON_INT_VALUE(bigtonKernelSumInt(x, n));
+        case BIGTONIR_ARRAY_MIN:
+            return isFloat
+                ? BIGTON_FLOAT_VALUE(bigtonKernelMinFloat(x, n))
+                : BIGTON_INT_VALUE(bigtonKernelMinInt(x, n));
+        case BIGTONIR_ARRAY_MAX:
+            return isFloat
+                ? BIGTON_FLOAT_VALUE(bigtonKernelMaxFloat(x, n))
+                : BIGTON_INT_VALUE(bigtonKernelMaxInt(x, n));
+        case BIGTONIR_ARRAY_ARGMIN: {
+            size_t i = isFloat
+                ? bigtonKernelFindFloat(x, n, bigtonKernelMinFloat(x, n))
+                : bigtonKernelFindInt(x, n, bigtonKernelMinInt(x, n));
+            if (i == n) {
+                // the minimum is NaN (which is not equal to itself) if any
+                // of the elements is, making the first NaN the result
+                i = 0;
+                while (!isnan(x[i].f)) { i += 1; }
+            }
+            return BIGTON_INT_VALUE((bigton_int_t) i);
+        }
+    }
+    return BIGTON_NULL_VALUE;
+}
+
+static void execScale(bigton_runtime_state_t *r) {
+    bigton_tagged_value_t fv = bigtonStackPop(&r->stack, r);
+    bigton_tagged_value_t av = bigtonStackPop(&r->stack, r);
+    kernel_operand_t a;
+    if (readOperand(r, av, &a)) {
+        bool isNumber = fv.t == BIGTON_INT || fv.t == BIGTON_FLOAT;
+        if (!isNumber || (a.t != BIGTON_NULL && a.t != fv.t)) {
+            r->error = BIGTONE_OPERANDS_NOT_NUMBERS;
+        }
+    }
+    bigton_array_t *result = HAS_ERROR(r) ? NULL
+        : allocPackedArray(r, fv.t, a.length);
+    if (result != NULL) {
+        if (fv.t == BIGTON_FLOAT) {
+            bigtonKernelScaleFloat(
+                result->elementValues, a.values, a.length, fv.v.f
+            );
+        } else {
+            bigtonKernelScaleInt(
+                result->elementValues, a.values, a.length, fv.v.i
+            );
+        }
+        bigtonStackPush(&r->stack, BIGTON_ARRAY_VALUE(result), r);
+    }
+    bigtonValRcDecr(av);
+    bigtonValRcDecr(fv);
+}
+
+static void execBinary(bigton_runtime_state_t *r, bigton_instr_type_t t) {
+    bigton_tagged_value_t bv = bigtonStackPop(&r->stack, r);
+    bigton_tagged_value_t av = bigtonStackPop(&r->stack, r);
+    kernel_operand_t a, b;
+    bigton_value_type_t et = BIGTON_NULL;
+    if (readOperand(r, av, &a) && readOperand(r, bv, &b)) {
+        et = commonType(r, &a, &b);
+    }
+    if (!HAS_ERROR(r) && t == BIGTONIR_ARRAY_ADD) {
+        bigton_array_t *result = allocPackedArray(r, et, a.length);
+        if (result != NULL && et == BIGTON_FLOAT) {
+            bigtonKernelAddFloat(
+                result->elementValues, a.values, b.values, a.length
+            );
+        } else if (result != NULL) {
+            bigtonKernelAddInt(
+                result->elementValues, a.values, b.values, a.length
+            );
+        }
+        if (result != NULL) {
+            bigtonStackPush(&r->stack, BIGTON_ARRAY_VALUE(result), r);
+        }
+    } else if (!HAS_ERROR(r)) {
+        bigton_tagged_value_t dot = et == BIGTON_FLOAT
+            ? BIGTON_FLOAT_VALUE(
+                bigtonKernelDotFloat(a.values, b.values, a.length)
+            )
+            : BIGTON_INT_VALUE(
+                bigtonKernelDotInt(a.values, b.values, a.length)
+            );
+        bigtonStackPush(&r->stack, dot, r);
+    }
+    bigtonValRcDecr(av);
+    bigtonValRcDecr(bv);
+}
+
+static size_t log2Ceil(size_t n) {
+    size_t log = 0;
+    while (((size_t) 1 << log) < n) { log += 1; }
+    return log;
+}
+
+static void sortArray(bigton_runtime_state_t *r, bigton_array_t *a) {
+    // arrays only holding numbers of one type may have been unpacked by
+    // storing other values that have since been overwritten
+    bigtonArrayPack(a);
+    size_t n = a->length;
+    if (n > 0 && a->packedType == BIGTON_NULL) {
+        r->error = BIGTONE_OPERANDS_NOT_NUMBERS;
+        return;
+    }
+    if (n <= 1) { return; }
+    void *scratch = NULL;
+    if (n > SMALL_SORT_LENGTH) {
+        size_t scratchSize = sizeof(bigton_value_t) * n;
+        if (!bigtonAllocValueBuffs(r, 1, &scratchSize, &scratch)) { return; }
+    }
+    if (a->packedType == BIGTON_INT) {
+        bigtonKernelSortInt(a->elementValues, scratch, n);
+    } else {
+        bigtonKernelSortFloat(a->elementValues, scratch, n);
+    }
+    bigtonFreeNullableBuff(scratch);
+    r->accCost += n * log2Ceil(n) / BIGTON_KERNEL_ELEMS_PER_COST;
+}
+
+static void execSort(bigton_runtime_state_t *r) {
+    bigton_tagged_value_t av = bigtonStackPop(&r->stack, r);
+    if (av.t == BIGTON_ARRAY) {
+        bigton_array_t *a = bigtonArrayWrite(r, av.v.a);
+        if (a != NULL) { sortArray(r, a); }
+    } else if (!HAS_ERROR(r)) {
+        r->error = BIGTONE_OPERAND_NOT_ARRAY;
+    }
+    bigtonValRcDecr(av);
+    bigtonStackPush(&r->stack, BIGTON_NULL_VALUE, r);
+}
+
+// Leftmost index the value could be inserted at while keeping the array
+// sorted, requiring all inspected elements to be numbers of the same type as
+// the value.
+static size_t lowerBound(
+    bigton_runtime_state_t *r, const bigton_array_t *a,
+    bigton_tagged_value_t v
+) {
+    if (v.t != BIGTON_INT && v.t != BIGTON_FLOAT) {
+        r->error = BIGTONE_OPERANDS_NOT_NUMBERS;
+        return 0;
+    }
+    size_t lo = 0;
+    size_t hi = a->length;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (bigtonArrayTypeAt(a, mid) != v.t) {
+            r->error = BIGTONE_OPERANDS_NOT_NUMBERS;
+            return 0;
+        }
+        bigton_value_t e = a->elementValues[mid];
+        bool before = v.t == BIGTON_INT
+            ? intBefore(e.i, v.v.i)
+            : floatBefore(e.f, v.v.f);
+        if (before) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    r->accCost += log2Ceil(a->length) / BIGTON_KERNEL_ELEMS_PER_COST;
+    return lo;
+}
+
+static bigton_int_t indexOf(
+    bigton_runtime_state_t *r, const bigton_array_t *a,
+    bigton_tagged_value_t v
+) {
+    size_t n = a->length;
+    r->accCost += n / BIGTON_KERNEL_ELEMS_PER_COST;
+    size_t i = n;
+    if (a->packedType == BIGTON_INT && v.t == BIGTON_INT) {
+        i = bigtonKernelFindInt(a->elementValues, n, v.v.i);
+    } else if (a->packedType == BIGTON_FLOAT && v.t == BIGTON_FLOAT) {
+        i = bigtonKernelFindFloat(a->elementValues, n, v.v.f);
+    } else if (a->packedType == BIGTON_NULL) {
+        for (i = 0; i < n; i += 1) {
+            bigton_tagged_value_t e = (bigton_tagged_value_t) {
+                .t = a->elementTypes[i],
+                .v = a->elementValues[i]
+            };
+            if (valuesEqual(e, v)) { break; }
+        }
+    }
+    return i == n ? -1 : (bigton_int_t) i;
+}
+
+static void execSearch(bigton_runtime_state_t *r, bigton_instr_type_t t) {
+    bigton_tagged_value_t v = bigtonStackPop(&r->stack, r);
+    bigton_tagged_value_t av = bigtonStackPop(&r->stack, r);
+    bigton_int_t result = 0;
+    if (av.t == BIGTON_ARRAY) {
+        bigton_array_t *a = bigtonArrayRead(r, av.v.a);
+        if (t == BIGTONIR_ARRAY_BINARY_SEARCH) {
+            size_t i = lowerBound(r, a, v);
+            bool found = i < a->length && valuesEqual(
+                bigtonArrayAt(a, (bigton_int_t) i, &r->error), v
+            );
+            result = found ? (bigton_int_t) i : -(bigton_int_t) i - 1;
+        } else {
+            result = indexOf(r, a, v);
+        }
+        if (t == BIGTONIR_ARRAY_CONTAINS) { result = result >= 0; }
+    } else if (!HAS_ERROR(r)) {
+        r->error = BIGTONE_OPERAND_NOT_ARRAY;
+    }
+    if (!HAS_ERROR(r)) {
+        bigtonStackPush(&r->stack, BIGTON_INT_VALUE(result), r);
+    }
+    bigtonValRcDecr(av);
+    bigtonValRcDecr(v);
+}
+
+void bigtonExecArrayKernel(bigton_runtime_state_t *r, bigton_instr_type_t t) {
+    switch (t) {
+        case BIGTONIR_ARRAY_SORT:
+            execSort(r);
+            return;
+        case BIGTONIR_ARRAY_BINARY_SEARCH:
+        case BIGTONIR_ARRAY_INDEX_OF:
+        case BIGTONIR_ARRAY_CONTAINS:
+            execSearch(r, t);
+            return;
+        case BIGTONIR_ARRAY_SCALE:
+            execScale(r);
+            return;
+        case BIGTONIR_ARRAY_ADD:
+        case BIGTONIR_ARRAY_DOT:
+            execBinary(r, t);
+            return;
+    }
+    bigton_tagged_value_t av = bigtonStackPop(&r->stack, r);
+    kernel_operand_t a;
+    if (readOperand(r, av, &a)) {
+        bigton_tagged_value_t result = reduce(r, t, &a);
+        if (!HAS_ERROR(r)) { bigtonStackPush(&r->stack, result, r); }
+    }
+    bigtonValRcDecr(av);
+}
@@ -5,33 +5,10 @@
 #include <stdio.h>
 #include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <wchar.h>
 
-static int readProgramFile(
-    const char *path, const uint8_t **programOut, size_t *lenOut
-) {
-    FILE *f = fopen(path, "rb");
-    if (f == NULL) {
-        perror("Failed to open file");
-        return 1;
-    }
-    fseek(f, 0, SEEK_END);
-    size_t rawProgramSize = (size_t) ftell(f);
-    rewind(f);
-    
-    uint8_t *rawProgram = malloc(sizeof(uint8_t) * rawProgramSize);
-    size_t readBytes = fread(rawProgram, sizeof(uint8_t), rawProgramSize, f);
-    if (readBytes != rawProgramSize) {
-        perror("Failed to read file");
-        return 1;
-    }
-    fclose(f);
-    
-    *programOut = rawProgram;
-    *lenOut = rawProgramSize;
-    return 0;
-}
-
 static bigton_string_t *valueToString(
     bigton_runtime_state_t *r, bigton_tagged_value_t value
 ) {
@@ -56,6 +33,8 @@ static bigton_string_t *valueToString(
             return bigtonAllocString(&r->b, 8, u"<object>");
         case BIGTON_ARRAY:
             return bigtonAllocString(&r->b, 7, u"<array>");
+        case BIGTON_MAP:
+            return bigtonAllocString(&r->b, 5, u"<map>");
     }
     return bigtonAllocString(&r->b, 9, u"<unknown>");
 }
@@ -90,35 +69,402 @@ const bigton_builtin_impl_t builtinImpls[] = {
     &builtinString
 };
 
+#define BENCH_ITERATIONS 1000
+
+static double secondsNow(void) {
+    struct timespec t;
+    timespec_get(&t, TIME_UTC);
+    return (double) t.tv_sec + (double) t.tv_nsec / 1e9;
+}
+
+// Reports the size of the given program in its encoded form (version 1 or 2)
+// and in its decoded form (version 1), as well as the average time taken to
+// parse (and if needed decode) it.
+static int benchProgram(const char *path) {
+    bigton_program_image_t *image = bigtonImageLoadFile(path);
+    if (image == NULL) {
+        perror("Failed to load file");
+        return 1;
+    }
+    if (image->error != BIGTONE_NONE) {
+        fprintf(
+            stderr, "Error while parsing BIGTON program: %u\n", image->error
+        );
+        bigtonImageRcDecr(image);
+        return 1;
+    }
+    bool isV2 = bigtonIsProgramV2(image->rawProgram, image->rawProgramSize);
+    size_t decodedSize = image->rawProgramSize;
+    if (isV2) {
+        bigton_error_t e = BIGTONE_NONE;
+        free(bigtonDecodeProgramV2(
+            image->rawProgram, image->rawProgramSize, &decodedSize, &e
+        ));
+    }
+    double start = secondsNow();
+    for (size_t i = 0; i < BENCH_ITERATIONS; i += 1) {
+        bigton_parsed_program_t p;
+        bigton_error_t e = BIGTONE_NONE;
+        bigtonParseProgram(image->rawProgram, image->rawProgramSize, &p, &e);
+        bigtonFreeParsedProgram(&p);
+    }
+    double elapsed = secondsNow() - start;
+    printf("Format version: %u\n", isV2 ? BIGTON_V2_VERSION : 1);
+    printf("Instructions: %u\n", image->program.numInstrs);
+    printf("Encoded size: %zu bytes\n", image->rawProgramSize);
+    printf("Decoded (version 1) size: %zu bytes\n", decodedSize);
+    printf(
+        "Average parse time: %.3f us (%d iterations)\n",
+        elapsed / BENCH_ITERATIONS * 1e6, BENCH_ITERATIONS
+    );
+    bigtonImageRcDecr(image);
+    return 0;
+}
+
+#define KERNEL_BENCH_LENGTH 1000
+#define KERNEL_BENCH_REPEATS 1000
+#define KERNEL_BENCH_MAX_INSTRS 128
+
+// global variable slots used by the kernel benchmark programs
+enum KernelBenchGlobal {
+    KB_ARRAY,
+    KB_INDEX,
+    KB_ACC,
+    KB_REPEAT,
+    KB_RESULT,
+    KB_NUM_GLOBALS
+};
+
+typedef struct KernelBenchProgram {
+    size_t count;
+    bigton_instr_type_t types[KERNEL_BENCH_MAX_INSTRS];
+    bigton_instr_args_t args[KERNEL_BENCH_MAX_INSTRS];
+} kernel_bench_program_t;
+
+static size_t emit(
+    kernel_bench_program_t *p, bigton_instr_type_t t, bigton_instr_args_t a
+) {
+    p->types[p->count] = t;
+    p->args[p->count] = a;
+    p->count += 1;
+    return p->count - 1;
+}
+
+#define EMIT(p, t) \
+    emit((p), BIGTONIR_##t, (bigton_instr_args_t) { .loadInt = 0 })
+#define EMIT_ARG(p, t, field, value) \
+    emit((p), BIGTONIR_##t, (bigton_instr_args_t) { .field = (value) })
+
+// sets the length of the loop or if started by the instruction at 'start' to
+// include all instructions emitted since
+static void endBlock(kernel_bench_program_t *p, size_t start) {
+    bigton_instr_idx_t length = (bigton_instr_idx_t) (p->count - start - 1);
+    if (p->types[start] == BIGTONIR_LOOP) {
+        p->args[start].infLoopLength = length;
+    } else {
+        p->args[start].ifParams.ifBodyLength = length;
+    }
+}
+
+// 'if global >= limit { break }'
+static void emitBreakIfReached(
+    kernel_bench_program_t *p, bigton_slot_t global, bigton_int_t limit
+) {
+    EMIT_ARG(p, LOAD_GLOBAL, loadGlobal, global);
+    EMIT_ARG(p, LOAD_INT, loadInt, limit);
+    EMIT(p, GREATER_THAN_EQUAL);
+    size_t cond = EMIT(p, IF);
+    EMIT(p, BREAK);
+    endBlock(p, cond);
+}
+
+static void emitIncrement(kernel_bench_program_t *p, bigton_slot_t global) {
+    EMIT_ARG(p, LOAD_GLOBAL, loadGlobal, global);
+    EMIT_ARG(p, LOAD_INT, loadInt, 1);
+    EMIT(p, ADD);
+    EMIT_ARG(p, STORE_GLOBAL, storeGlobal, global);
+}
+
+static void emitLoadElement(kernel_bench_program_t *p) {
+    EMIT_ARG(p, LOAD_GLOBAL, loadGlobal, KB_ARRAY);
+    EMIT_ARG(p, LOAD_GLOBAL, loadGlobal, KB_INDEX);
+    EMIT(p, LOAD_ARRAY_ELEMENT);
+}
+
+typedef enum KernelBenchOp {
+    KB_NONE,
+    KB_SUM,
+    KB_MAX,
+    KB_DOT,
+    KB_SCALE
+} kernel_bench_op_t;
+
+// Emits the equivalent of 'op(array)' (or 'op(array, array)') as a loop over
+// the elements of the array, storing the result in 'KB_RESULT'.
+static void emitInterpreted(kernel_bench_program_t *p, kernel_bench_op_t op) {
+    if (op == KB_MAX) {
+        EMIT_ARG(p, LOAD_GLOBAL, loadGlobal, KB_ARRAY);
+        EMIT_ARG(p, LOAD_INT, loadInt, 0);
+        EMIT(p, LOAD_ARRAY_ELEMENT);
+    } else if (op == KB_SCALE) {
+        EMIT_ARG(p, LOAD_ARRAY, loadArrayLength, 0);
+    } else {
+        EMIT_ARG(p, LOAD_INT, loadInt, 0);
+    }
+    EMIT_ARG(p, STORE_GLOBAL, storeGlobal, KB_ACC);
+    EMIT_ARG(p, LOAD_INT, loadInt, 0);
+    EMIT_ARG(p, STORE_GLOBAL, storeGlobal, KB_INDEX);
+    size_t loop = EMIT(p, LOOP);
+    emitBreakIfReached(p, KB_INDEX, KERNEL_BENCH_LENGTH);
+    switch (op) {
+        case KB_SUM:
+        case KB_DOT:
+            EMIT_ARG(p, LOAD_GLOBAL, loadGlobal, KB_ACC);
+            emitLoadElement(p);
+            if (op == KB_DOT) {
+                emitLoadElement(p);
+                EMIT(p, MULTIPLY);
+            }
+            EMIT(p, ADD);
+            EMIT_ARG(p, STORE_GLOBAL, storeGlobal, KB_ACC);
+            break;
+        case KB_MAX: {
+            emitLoadElement(p);
+            EMIT_ARG(p, LOAD_GLOBAL, loadGlobal, KB_ACC);
+            EMIT(p, GREATER_THAN);
+            size_t cond = EMIT(p, IF);
+            emitLoadElement(p);
+            EMIT_ARG(p, STORE_GLOBAL, storeGlobal, KB_ACC);
+            endBlock(p, cond);
+            break;
+        }
+        case KB_SCALE:
+            EMIT_ARG(p, LOAD_GLOBAL, loadGlobal, KB_ACC);
+            emitLoadElement(p);
+            EMIT_ARG(p, LOAD_INT, loadInt, 3);
+            EMIT(p, MULTIPLY);
+            EMIT(p, ARRAY_PUSH);
+            EMIT(p, DISCARD);
+            break;
+        case KB_NONE:
+            break;
+    }
+    emitIncrement(p, KB_INDEX);
+    endBlock(p, loop);
+    EMIT_ARG(p, LOAD_GLOBAL, loadGlobal, KB_ACC);
+    EMIT_ARG(p, STORE_GLOBAL, storeGlobal, KB_RESULT);
+}
+
+static void emitKernel(kernel_bench_program_t *p, kernel_bench_op_t op) {
+    EMIT_ARG(p, LOAD_GLOBAL, loadGlobal, KB_ARRAY);
+    switch (op) {
+        case KB_SUM: EMIT(p, ARRAY_SUM); break;
+        case KB_MAX: EMIT(p, ARRAY_MAX); break;
+        case KB_DOT:
+            EMIT_ARG(p, LOAD_GLOBAL, loadGlobal, KB_ARRAY);
+            EMIT(p, ARRAY_DOT);
+            break;
+        case KB_SCALE:
+            EMIT_ARG(p, LOAD_INT, loadInt, 3);
+            EMIT(p, ARRAY_SCALE);
+            break;
+        case KB_NONE:
+            break;
+    }
+    EMIT_ARG(p, STORE_GLOBAL, storeGlobal, KB_RESULT);
+}
+
+// Builds a program that fills an array with integers and then performs the
+// given operation on it 'KERNEL_BENCH_REPEATS' times.
+static bigton_program_image_t *buildKernelBench(
+    kernel_bench_op_t op, bool interpreted
+) {
+    kernel_bench_program_t p = { .count = 0 };
+    EMIT_ARG(&p, LOAD_ARRAY, loadArrayLength, 0);
+    EMIT_ARG(&p, STORE_GLOBAL, storeGlobal, KB_ARRAY);
+    EMIT_ARG(&p, LOAD_INT, loadInt, 0);
+    EMIT_ARG(&p, STORE_GLOBAL, storeGlobal, KB_INDEX);
+    size_t fill = EMIT(&p, LOOP);
+    emitBreakIfReached(&p, KB_INDEX, KERNEL_BENCH_LENGTH);
+    EMIT_ARG(&p, LOAD_GLOBAL, loadGlobal, KB_ARRAY);
+    EMIT_ARG(&p, LOAD_GLOBAL, loadGlobal, KB_INDEX);
+    EMIT_ARG(&p, LOAD_INT, loadInt, 7919);
+    EMIT(&p, MULTIPLY);
+    EMIT_ARG(&p, LOAD_INT, loadInt, 1009);
+    EMIT(&p, REMAINDER);
+    EMIT(&p, ARRAY_PUSH);
+    EMIT(&p, DISCARD);
+    emitIncrement(&p, KB_INDEX);
+    endBlock(&p, fill);
+    EMIT_ARG(&p, LOAD_INT, loadInt, 0);
+    EMIT_ARG(&p, STORE_GLOBAL, storeGlobal, KB_REPEAT);
+    size_t repeat = EMIT(&p, LOOP);
+    emitBreakIfReached(&p, KB_REPEAT, KERNEL_BENCH_REPEATS);
+    if (op != KB_NONE && interpreted) { emitInterpreted(&p, op); }
+    if (op != KB_NONE && !interpreted) { emitKernel(&p, op); }
+    emitIncrement(&p, KB_REPEAT);
+    endBlock(&p, repeat);
+    
+    bigton_program_t header = {
+        .numInstrs = (bigton_instr_idx_t) p.count,
+        .numStrings = 1,
+        .numGlobalVars = KB_NUM_GLOBALS,
+        .unknownStrId = 0,
+        .globalStart = 0,
+        .globalLength = (bigton_instr_idx_t) p.count
+    };
+    bigton_const_string_t unknownStr = { .firstOffset = 0, .charLength = 0 };
+    size_t argsSize = sizeof(bigton_instr_args_t) * p.count;
+    size_t size = sizeof(header) + argsSize + sizeof(unknownStr) + p.count;
+    uint8_t *raw = malloc(size);
+    uint8_t *w = raw;
+    memcpy(w, &header, sizeof(header));
+    w += sizeof(header);
+    memcpy(w, p.args, argsSize);
+    w += argsSize;
+    memcpy(w, &unknownStr, sizeof(unknownStr));
+    w += sizeof(unknownStr);
+    memcpy(w, p.types, p.count);
+    bigton_program_image_t *image = bigtonImageCreate(raw, size);
+    free(raw);
+    return image;
+}
+
+typedef struct KernelBenchResult {
+    double seconds;
+    size_t cost;
+    bigton_tagged_value_t value;
+} kernel_bench_result_t;
+
+// Runs the program to completion, taking over the caller's reference to it.
+// The returned value is owned by the caller, which is also responsible for
+// freeing the runtime afterwards.
+static kernel_bench_result_t runKernelBench(
+    bigton_runtime_state_t *r, bigton_program_image_t *image
+) {
+    bigton_runtime_settings_t settings = (bigton_runtime_settings_t) {
+        .tickInstructionLimit = UINT64_MAX,
+        .memoryUsageLimit = SIZE_MAX,
+        .maxCallDepth = 2048,
+        .maxTupleSize = 256,
+        .tickFreeBudget = SIZE_MAX
+    };
+    bigtonInitFromImage(r, &settings, image);
+    bigtonImageRcDecr(image);
+    double start = secondsNow();
+    bigtonStartTick(r);
+    bigton_exec_status_t status = bigtonExecBatch(r);
+    double elapsed = secondsNow() - start;
+    if (status != BIGTONST_COMPLETE) {
+        fprintf(stderr, "Execution error: %u\n", r->error);
+    }
+    bigton_tagged_value_t value = (bigton_tagged_value_t) {
+        .t = r->globalTypes[KB_RESULT],
+        .v = r->globalValues[KB_RESULT]
+    };
+    return (kernel_bench_result_t) {
+        .seconds = elapsed, .cost = r->accCost, .value = value
+    };
+}
+
+static bool kernelBenchResultsEqual(
+    bigton_tagged_value_t a, bigton_tagged_value_t b
+) {
+    if (a.t != b.t) { return false; }
+    if (a.t != BIGTON_ARRAY) { return a.v.i == b.v.i; }
+    bigton_array_t *aa = a.v.a;
+    bigton_array_t *ba = b.v.a;
+    if (aa->length != ba->length) { return false; }
+    for (size_t i = 0; i < aa->length; i += 1) {
+        bool equal = bigtonArrayTypeAt(aa, i) == bigtonArrayTypeAt(ba, i)
+            && aa->elementValues[i].i == ba->elementValues[i].i;
+        if (!equal) { return false; }
+    }
+    return true;
+}
+
+// Compares the time and instruction cost of the native array builtins backed
+// by the kernels in 'kernels.h' to equivalent loops written in BIGTON, with
+// the time and cost of filling the array being subtracted from both.
+static int benchKernels(void) {
+    static const char *const names[] = { "", "sum", "max", "dot", "scale" };
+    bigton_runtime_state_t base;
+    kernel_bench_result_t baseline = runKernelBench(
+        &base, buildKernelBench(KB_NONE, false)
+    );
+    bigtonFree(&base);
+    printf(
+        "%d elements, %d repeats (per call averages)\n",
+        KERNEL_BENCH_LENGTH, KERNEL_BENCH_REPEATS
+    );
+    bool allMatch = true;
+    for (int op = KB_SUM; op <= KB_SCALE; op += 1) {
+        bigton_runtime_state_t ir, kr;
+        kernel_bench_result_t interpreted = runKernelBench(
+            &ir, buildKernelBench((kernel_bench_op_t) op, true)
+        );
+        kernel_bench_result_t kernel = runKernelBench(
+            &kr, buildKernelBench((kernel_bench_op_t) op, false)
+        );
+        bool match = kernelBenchResultsEqual(interpreted.value, kernel.value);
+        allMatch = allMatch && match;
+        double interpretedUs = (interpreted.seconds - baseline.seconds)
+            / KERNEL_BENCH_REPEATS * 1e6;
+        double kernelUs = (kernel.seconds - baseline.seconds)
+            / KERNEL_BENCH_REPEATS * 1e6;
+        printf(
+            "%-5s interpreted: %9.3f us, cost %7zu | "
+            "kernel: %7.3f us, cost %4zu | %s\n",
+            names[op],
+            interpretedUs,
+            (interpreted.cost - baseline.cost) / KERNEL_BENCH_REPEATS,
+            kernelUs,
+            (kernel.cost - baseline.cost) / KERNEL_BENCH_REPEATS,
+            match ? "results match" : "RESULTS DIFFER"
+        );
+        bigtonFree(&ir);
+        bigtonFree(&kr);
+    }
+    return allMatch ? 0 : 1;
+}
+
 int main(int argc, char **argv) {
+    if (argc == 3 && strcmp(argv[1], "--bench") == 0) {
+        return benchProgram(argv[2]);
+    }
+    if (argc == 2 && strcmp(argv[1], "--bench-kernels") == 0) {
+        return benchKernels();
+    }
     if (argc != 2) {
-        printf("Usage: bigton <file>");
+        printf("Usage: bigton [--bench] <file> | --bench-kernels");
         return 1;
     }
     
-    const uint8_t *rawProgram;
-    size_t rawProgramSize;
-    int readStatus = readProgramFile(argv[1], &rawProgram, &rawProgramSize);
-    if (readStatus != 0) { return readStatus; }
-    
-    bigton_parsed_program_t p;
-    bigton_error_t parseError = BIGTONE_NONE;
-    bigtonParseProgram(rawProgram, rawProgramSize, &p, &parseError);
-    if (parseError != BIGTONE_NONE) {
-        fprintf(stderr, "Error while parsing BIGTON program: %u\n", parseError);
+    bigton_program_image_t *image = bigtonImageLoadFile(argv[1]);
+    if (image == NULL) {
+        perror("Failed to load file");
+        return 1;
+    }
+    if (image->error != BIGTONE_NONE) {
+        fprintf(
+            stderr, "Error while parsing BIGTON program: %u\n", image->error
+        );
+        bigtonImageRcDecr(image);
         return 1;
     }
-    bigtonDebugProgram(&p);
+    bigtonDebugProgram(&image->program);
     
     bigton_runtime_settings_t settings = (bigton_runtime_settings_t) {
         .tickInstructionLimit = 9999, //UINT64_MAX,
         .memoryUsageLimit = SIZE_MAX,
         .maxCallDepth = 2048,
-        .maxTupleSize = 256
+        .maxTupleSize = 256,
+        .tickFreeBudget = SIZE_MAX
     };
     
     bigton_runtime_state_t r;
-    bigtonInit(&r, &settings, &p);
+    bigtonInitFromImage(&r, &settings, image);
+    bigtonImageRcDecr(image);
     
     bigtonStartTick(&r);
     for (;;) {
@@ -147,6 +493,5 @@ int main(int argc, char **argv) {
     printf("%zu line(s) logged\n", r.logsCount);
     
     bigtonFree(&r);
-    free((void *) rawProgram);
     return 0;
 }
\ No newline at end of file
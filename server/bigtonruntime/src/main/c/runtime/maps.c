@@ -0,0 +1,261 @@
+
+#define BIGTON_ERROR_MACROS
+#include <bigton/values.h>
+#include <bigton/runtime.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MIN_MAP_CAPACITY 8
+// the capacity is a power of two that has to fit into 'uint32_t'
+#define MAX_MAP_CAPACITY ((size_t) 1 << 31)
+
+
+static uint64_t mix64(uint64_t h) {
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return h;
+}
+
+static uint32_t fold(uint64_t h) {
+    uint32_t folded = (uint32_t) (h ^ (h >> 32));
+    return folded == 0 ? 1 : folded;
+}
+
+uint32_t bigtonStringHash(bigton_string_t *s) {
+    if (s->hash != 0) { return s->hash; }
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < s->length; i += 1) {
+        h = (h ^ s->content[i]) * 0x100000001B3ULL;
+    }
+    uint32_t hash = fold(mix64(h));
+    if (!bigtonBuffIsShared(s)) { s->hash = hash; }
+    return hash;
+}
+
+static uint64_t hashValue(bigton_tagged_value_t v) {
+    switch (v.t) {
+        case BIGTON_NULL:
+            break;
+        case BIGTON_INT:
+            return mix64((uint64_t) v.v.i);
+        case BIGTON_FLOAT: {
+            // '-0.0' is equal to '0.0', while NaN is not equal to anything
+            bigton_float_t f = v.v.f == 0.0 ? 0.0 : v.v.f;
+            uint64_t bits;
+            memcpy(&bits, &f, sizeof(uint64_t));
+            return mix64(bits ^ BIGTON_FLOAT);
+        }
+        case BIGTON_STRING:
+            return mix64(bigtonStringHash(v.v.s));
+        case BIGTON_TUPLE: {
+            uint64_t h = BIGTON_TUPLE;
+            const bigton_tuple_t *t = v.v.t;
+            for (size_t i = 0; i < t->length; i += 1) {
+                h = mix64(h ^ hashValue((bigton_tagged_value_t) {
+                    .t = t->valueTypes[i], .v = t->values[i]
+                }));
+            }
+            return h;
+        }
+        case BIGTON_OBJECT:
+            return v.v.o->hash;
+        case BIGTON_ARRAY:
+            return v.v.a->hash;
+        case BIGTON_MAP:
+            return v.v.m->hash;
+    }
+    return mix64(v.t);
+}
+
+uint32_t bigtonValueHash(bigton_tagged_value_t v) {
+    return fold(hashValue(v));
+}
+
+uint32_t bigtonNextValueHash(bigton_runtime_state_t *r) {
+    r->createdValues += 1;
+    return fold(mix64(r->createdValues));
+}
+
+
+// Returns the slot holding the given key, or the empty slot the probe
+// sequence of the key ends at. The map may not be empty.
+static size_t findSlot(
+    const bigton_map_t *m, bigton_tagged_value_t key, uint32_t hash
+) {
+    size_t mask = (size_t) m->capacity - 1;
+    size_t slot = hash & mask;
+    while (m->slotHashes[slot] != 0) {
+        bool found = m->slotHashes[slot] == hash
+            && valuesEqual(bigtonMapKeyAt(m, slot), key);
+        if (found) { return slot; }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+size_t bigtonMapFind(const bigton_map_t *m, bigton_tagged_value_t key) {
+    if (m->length == 0) { return m->capacity; }
+    size_t slot = findSlot(m, key, bigtonValueHash(key));
+    return m->slotHashes[slot] == 0 ? m->capacity : slot;
+}
+
+static void clearSlots(bigton_map_t *m) {
+    if (m->capacity == 0) { return; }
+    memset(m->slotHashes, 0, sizeof(uint32_t) * m->capacity);
+    for (size_t i = 0; i < (size_t) m->capacity * 2; i += 1) {
+        m->slotTypes[i] = BIGTON_NULL;
+    }
+}
+
+static void moveSlot(bigton_map_t *m, size_t dest, size_t src) {
+    m->slotHashes[dest] = m->slotHashes[src];
+    m->slotTypes[dest * 2] = m->slotTypes[src * 2];
+    m->slotTypes[dest * 2 + 1] = m->slotTypes[src * 2 + 1];
+    m->slotValues[dest * 2] = m->slotValues[src * 2];
+    m->slotValues[dest * 2 + 1] = m->slotValues[src * 2 + 1];
+}
+
+bigton_map_t *bigtonMapCreate(bigton_runtime_state_t *r) {
+    size_t sizes[] = { sizeof(bigton_map_t) };
+    void *buffers[1];
+    if (!bigtonAllocValueBuffs(r, 1, sizes, buffers)) { return NULL; }
+    bigton_map_t *m = buffers[0];
+    m->rc = BIGTON_RC_INIT;
+    m->hash = bigtonNextValueHash(r);
+    m->capacity = 0;
+    m->length = 0;
+    m->slotHashes = NULL;
+    m->slotTypes = NULL;
+    m->slotValues = NULL;
+    return m;
+}
+
+// Moves all keys into new buffers with the given capacity, reusing the
+// hashes stored for them.
+static bool resize(
+    bigton_runtime_state_t *r, bigton_map_t *m, size_t capacity
+) {
+    size_t sizes[] = {
+        sizeof(uint32_t) * capacity,
+        sizeof(bigton_value_type_t) * capacity * 2,
+        sizeof(bigton_value_t) * capacity * 2
+    };
+    void *buffers[3];
+    if (!bigtonAllocValueBuffs(r, 3, sizes, buffers)) { return false; }
+    bigton_map_t old = *m;
+    m->capacity = (uint32_t) capacity;
+    m->slotHashes = buffers[0];
+    m->slotTypes = buffers[1];
+    m->slotValues = buffers[2];
+    clearSlots(m);
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < old.capacity; i += 1) {
+        uint32_t hash = old.slotHashes[i];
+        if (hash == 0) { continue; }
+        size_t slot = hash & mask;
+        while (m->slotHashes[slot] != 0) { slot = (slot + 1) & mask; }
+        m->slotHashes[slot] = hash;
+        m->slotTypes[slot * 2] = old.slotTypes[i * 2];
+        m->slotTypes[slot * 2 + 1] = old.slotTypes[i * 2 + 1];
+        m->slotValues[slot * 2] = old.slotValues[i * 2];
+        m->slotValues[slot * 2 + 1] = old.slotValues[i * 2 + 1];
+    }
+    bigtonFreeNullableBuff(old.slotHashes);
+    bigtonFreeNullableBuff(old.slotTypes);
+    bigtonFreeNullableBuff(old.slotValues);
+    return true;
+}
+
+bool bigtonMapSet(
+    bigton_runtime_state_t *r, bigton_map_t *m, bigton_tagged_value_t key,
+    bigton_tagged_value_t value
+) {
+    uint32_t hash = bigtonValueHash(key);
+    if (m->length > 0) {
+        size_t slot = findSlot(m, key, hash);
+        if (m->slotHashes[slot] != 0) {
+            bigtonValRcDecr(bigtonMapValueAt(m, slot));
+            m->slotTypes[slot * 2 + 1] = value.t;
+            m->slotValues[slot * 2 + 1] = value.v;
+            bigtonValRcDecr(key);
+            return true;
+        }
+    }
+    bool isFull = ((size_t) m->length + 1) * 4 > (size_t) m->capacity * 3;
+    if (isFull) {
+        size_t capacity = (size_t) m->capacity * 2;
+        if (capacity < MIN_MAP_CAPACITY) { capacity = MIN_MAP_CAPACITY; }
+        if (capacity > MAX_MAP_CAPACITY) {
+            r->error = BIGTONE_EXCEEDED_MEMORY_LIMIT;
+            return false;
+        }
+        if (!resize(r, m, capacity)) { return false; }
+    }
+    size_t slot = findSlot(m, key, hash);
+    m->slotHashes[slot] = hash;
+    m->slotTypes[slot * 2] = key.t;
+    m->slotTypes[slot * 2 + 1] = value.t;
+    m->slotValues[slot * 2] = key.v;
+    m->slotValues[slot * 2 + 1] = value.v;
+    m->length += 1;
+    return true;
+}
+
+bigton_tagged_value_t bigtonMapRemove(bigton_map_t *m, size_t slot) {
+    bigton_tagged_value_t removed = bigtonMapValueAt(m, slot);
+    bigtonValRcDecr(bigtonMapKeyAt(m, slot));
+    // keys following the removed one in its probe sequence are moved back
+    // if their own probe sequence starts at or before the emptied slot
+    size_t mask = (size_t) m->capacity - 1;
+    size_t empty = slot;
+    size_t next = (slot + 1) & mask;
+    while (m->slotHashes[next] != 0) {
+        size_t home = m->slotHashes[next] & mask;
+        if (((next - home) & mask) >= ((next - empty) & mask)) {
+            moveSlot(m, empty, next);
+            empty = next;
+        }
+        next = (next + 1) & mask;
+    }
+    m->slotHashes[empty] = 0;
+    m->slotTypes[empty * 2] = BIGTON_NULL;
+    m->slotTypes[empty * 2 + 1] = BIGTON_NULL;
+    m->length -= 1;
+    return removed;
+}
+
+bigton_array_t *bigtonMapKeys(
+    bigton_runtime_state_t *r, const bigton_map_t *m
+) {
+    size_t length = m->length;
+    size_t sizes[] = {
+        sizeof(bigton_value_type_t) * length,
+        sizeof(bigton_value_t) * length,
+        sizeof(bigton_array_t)
+    };
+    void *buffers[3];
+    if (!bigtonAllocValueBuffs(r, 3, sizes, buffers)) { return NULL; }
+    bigton_array_t *a = buffers[2];
+    a->rc = BIGTON_RC_INIT;
+    a->hash = bigtonNextValueHash(r);
+    a->capacity = (uint32_t) length;
+    a->length = (uint32_t) length;
+    a->packedType = BIGTON_NULL;
+    a->elementTypes = buffers[0];
+    a->elementValues = buffers[1];
+    a->viewed = NULL;
+    size_t i = 0;
+    for (size_t slot = 0; slot < m->capacity; slot += 1) {
+        if (m->slotHashes[slot] == 0) { continue; }
+        bigton_tagged_value_t key = bigtonMapKeyAt(m, slot);
+        bigtonValRcIncr(key);
+        a->elementTypes[i] = key.t;
+        a->elementValues[i] = key.v;
+        i += 1;
+    }
+    bigtonArrayPack(a);
+    return a;
+}
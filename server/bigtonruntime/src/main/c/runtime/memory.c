@@ -1,13 +1,38 @@
 
 #include <bigton/values.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <string.h>
     
-void *bigtonAllocBuff(bigton_buff_owner_t *o, size_t numBytes) {
-    bigton_buff_t *buff = malloc(sizeof(bigton_buff_t) + numBytes);
+// Memory used by a buffer of the given size, including its header.
+#define BUFF_FOOTPRINT(numBytes) (sizeof(bigton_buff_t) + (numBytes))
+
+static void addUsage(bigton_buff_owner_t *o, size_t numBytes) {
+    o->totalSizeBytes += numBytes;
+    if (o->totalSizeBytes > o->peakSizeBytes) {
+        o->peakSizeBytes = o->totalSizeBytes;
+    }
+}
+
+// Allocations that do not go through 'bigtonTryAllocBuffs' or
+// 'bigtonTryReallocBuff' have no way of failing gracefully, meaning that
+// running out of memory is fatal.
+static void outOfMemory(void) {
+    fputs("BIGTON runtime: out of memory\n", stderr);
+    abort();
+}
+
+void *bigtonCheckAllocated(void *allocated) {
+    if (allocated == NULL) { outOfMemory(); }
+    return allocated;
+}
+
+static void linkBuff(bigton_buff_owner_t *o, bigton_buff_t *buff) {
     buff->owner = o;
-    buff->sizeBytes = numBytes;
+    buff->seq = o->nextSeq;
+    o->nextSeq += 1;
     buff->prev = o->last;
     buff->next = NULL;
     if (o->last == NULL) {
@@ -17,10 +42,62 @@ void *bigtonAllocBuff(bigton_buff_owner_t *o, size_t numBytes) {
         o->last->next = buff;
         o->last = buff;
     }
-    o->totalSizeBytes += numBytes;
+    addUsage(o, BUFF_FOOTPRINT(buff->sizeBytes));
+}
+    
+void *bigtonAllocBuff(bigton_buff_owner_t *o, size_t numBytes) {
+    bigton_buff_t *buff = bigtonCheckAllocated(
+        malloc(BUFF_FOOTPRINT(numBytes))
+    );
+    buff->arena = NULL;
+    buff->sizeBytes = numBytes;
+    linkBuff(o, buff);
     return (void *) buff->data;
 }
 
+bool bigtonBuffsFit(
+    const bigton_buff_owner_t *o, size_t count, const size_t *sizes
+) {
+    if (o->totalSizeBytes > o->limitBytes) { return false; }
+    size_t remaining = o->limitBytes - o->totalSizeBytes;
+    for (size_t i = 0; i < count; i += 1) {
+        if (sizes[i] == 0) { continue; }
+        // compared separately so that huge sizes can not overflow
+        if (sizes[i] > remaining) { return false; }
+        remaining -= sizes[i];
+        if (sizeof(bigton_buff_t) > remaining) { return false; }
+        remaining -= sizeof(bigton_buff_t);
+    }
+    return true;
+}
+
+bool bigtonTryAllocBuffs(
+    bigton_buff_owner_t *o, size_t count, const size_t *sizes, void **buffers
+) {
+    if (!bigtonBuffsFit(o, count, sizes)) {
+        bigtonFreePending(o, SIZE_MAX);
+        if (!bigtonBuffsFit(o, count, sizes)) { return false; }
+    }
+    for (size_t i = 0; i < count; i += 1) {
+        if (sizes[i] == 0) {
+            buffers[i] = NULL;
+            continue;
+        }
+        bigton_buff_t *buff = malloc(BUFF_FOOTPRINT(sizes[i]));
+        if (buff == NULL) {
+            for (size_t j = 0; j < i; j += 1) {
+                bigtonFreeNullableBuff(buffers[j]);
+            }
+            return false;
+        }
+        buff->arena = NULL;
+        buff->sizeBytes = sizes[i];
+        linkBuff(o, buff);
+        buffers[i] = (void *) buff->data;
+    }
+    return true;
+}
+
 #define GET_HEADER(b) \
     (bigton_buff_t *) (((const uint8_t *) (b)) - offsetof(bigton_buff_t, data))
 
@@ -31,6 +108,73 @@ void *bigtonAllocBuff(bigton_buff_owner_t *o, size_t numBytes) {
 #define POINT_NEXT_NODE_TO(o, next, newRef) \
     if ((next) == NULL) { (o)->last = (newRef); } \
     else { (next)->prev = (newRef); }
+
+// Releases the memory of a buffer that has already been unlinked.
+static void releaseBuff(bigton_buff_t *buff) {
+    bigton_arena_t *arena = buff->arena;
+    if (arena == NULL) {
+        free((void *) buff);
+        return;
+    }
+    arena->liveCount -= 1;
+    if (arena->liveCount == 0) { free((void *) arena); }
+}
+
+// Alignment of each buffer in an arena, matching what 'malloc' guarantees.
+#define ARENA_ALIGNMENT 16
+#define ARENA_ALIGN(n) \
+    (((n) + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1))
+#define ARENA_HEADER_SIZE ARENA_ALIGN(sizeof(bigton_arena_t))
+
+// Returns false (without allocating anything) if the system is out of memory.
+static bool allocArena(
+    bigton_buff_owner_t *o, size_t count, const size_t *sizes, void **buffers
+) {
+    size_t totalSize = ARENA_HEADER_SIZE;
+    size_t liveCount = 0;
+    for (size_t i = 0; i < count; i += 1) {
+        if (sizes[i] == 0) { continue; }
+        totalSize += ARENA_ALIGN(sizeof(bigton_buff_t) + sizes[i]);
+        liveCount += 1;
+    }
+    if (liveCount == 0) {
+        for (size_t i = 0; i < count; i += 1) { buffers[i] = NULL; }
+        return true;
+    }
+    bigton_arena_t *arena = malloc(totalSize);
+    if (arena == NULL) { return false; }
+    arena->liveCount = liveCount;
+    uint8_t *next = ((uint8_t *) arena) + ARENA_HEADER_SIZE;
+    for (size_t i = 0; i < count; i += 1) {
+        if (sizes[i] == 0) {
+            buffers[i] = NULL;
+            continue;
+        }
+        bigton_buff_t *buff = (bigton_buff_t *) next;
+        next += ARENA_ALIGN(sizeof(bigton_buff_t) + sizes[i]);
+        buff->arena = arena;
+        buff->sizeBytes = sizes[i];
+        linkBuff(o, buff);
+        buffers[i] = (void *) buff->data;
+    }
+    return true;
+}
+
+void bigtonAllocArena(
+    bigton_buff_owner_t *o, size_t count, const size_t *sizes, void **buffers
+) {
+    if (!allocArena(o, count, sizes, buffers)) { outOfMemory(); }
+}
+
+bool bigtonTryAllocArena(
+    bigton_buff_owner_t *o, size_t count, const size_t *sizes, void **buffers
+) {
+    if (!bigtonBuffsFit(o, count, sizes)) {
+        bigtonFreePending(o, SIZE_MAX);
+        if (!bigtonBuffsFit(o, count, sizes)) { return false; }
+    }
+    return allocArena(o, count, sizes, buffers);
+}
     
 void bigtonFreeBuff(const void *buffData) {
     bigton_buff_t *buff = GET_HEADER(buffData);
@@ -39,30 +183,110 @@ void bigtonFreeBuff(const void *buffData) {
     bigton_buff_t *next = buff->next;
     POINT_PREV_NODE_TO(o, prev, next); // prev.next = next
     POINT_NEXT_NODE_TO(o, next, prev); // next.prev = prev
-    o->totalSizeBytes -= buff->sizeBytes;
-    free((void *) buff);
+    o->totalSizeBytes -= BUFF_FOOTPRINT(buff->sizeBytes);
+    releaseBuff(buff);
 }
 
-void *bigtonReallocBuff(const void *buffData, size_t numBytes) {
+// Returns NULL if the system is out of memory, in which case the buffer is
+// left unchanged.
+static void *reallocBuff(const void *buffData, size_t numBytes) {
     bigton_buff_t *oldBuff = GET_HEADER(buffData);
     bigton_buff_owner_t *o = oldBuff->owner;
     bigton_buff_t *prev = oldBuff->prev;
     bigton_buff_t *next = oldBuff->next;
     size_t oldSize = oldBuff->sizeBytes;
-    bigton_buff_t *newBuff = realloc(oldBuff, sizeof(bigton_buff_t) + numBytes);
+    bigton_buff_t *newBuff;
+    if (oldBuff->arena == NULL) {
+        newBuff = realloc(oldBuff, BUFF_FOOTPRINT(numBytes));
+        if (newBuff == NULL) { return NULL; }
+    } else {
+        newBuff = malloc(BUFF_FOOTPRINT(numBytes));
+        if (newBuff == NULL) { return NULL; }
+        size_t keptSize = oldSize < numBytes ? oldSize : numBytes;
+        memcpy(newBuff, oldBuff, sizeof(bigton_buff_t) + keptSize);
+        newBuff->arena = NULL;
+        releaseBuff(oldBuff);
+    }
     newBuff->sizeBytes = numBytes;
     POINT_PREV_NODE_TO(o, prev, newBuff); // prev.next = newBuff
     POINT_NEXT_NODE_TO(o, next, newBuff); // next.prev = newBuff
-    o->totalSizeBytes = o->totalSizeBytes - oldSize + numBytes;
+    o->totalSizeBytes -= oldSize;
+    addUsage(o, numBytes);
     return (void *) newBuff->data;
 }
 
+void *bigtonReallocBuff(const void *buffData, size_t numBytes) {
+    return bigtonCheckAllocated(reallocBuff(buffData, numBytes));
+}
+
+static bool growthFits(const bigton_buff_owner_t *o, size_t growth) {
+    return o->totalSizeBytes <= o->limitBytes
+        && growth <= o->limitBytes - o->totalSizeBytes;
+}
+
+void *bigtonTryReallocBuff(const void *buffData, size_t numBytes) {
+    bigton_buff_owner_t *o = BIGTON_BUFF_HEADER(buffData)->owner;
+    size_t oldSize = BIGTON_BUFF_HEADER(buffData)->sizeBytes;
+    size_t growth = numBytes > oldSize ? numBytes - oldSize : 0;
+    if (!growthFits(o, growth)) {
+        bigtonFreePending(o, SIZE_MAX);
+        if (!growthFits(o, growth)) { return NULL; }
+    }
+    return reallocBuff(buffData, numBytes);
+}
+
+void bigtonMoveBuff(bigton_buff_owner_t *dest, const void *buffData) {
+    bigton_buff_t *buff = GET_HEADER(buffData);
+    bigton_buff_owner_t *o = buff->owner;
+    POINT_PREV_NODE_TO(o, buff->prev, buff->next); // prev.next = next
+    POINT_NEXT_NODE_TO(o, buff->next, buff->prev); // next.prev = prev
+    o->totalSizeBytes -= BUFF_FOOTPRINT(buff->sizeBytes);
+    linkBuff(dest, buff);
+}
+
 void bigtonFreeAll(bigton_buff_owner_t *o) {
     bigton_buff_t *current = o->first;
     while (current != NULL) {
         bigton_buff_t *after = current->next;
-        free((void *) current);
+        releaseBuff(current);
         current = after;
     }
     o->totalSizeBytes = 0;
-}
\ No newline at end of file
+    free(o->cycleRoots.values);
+    o->cycleRoots = BIGTON_CYCLE_ROOTS_INIT;
+    free(o->freeQueue.values);
+    o->freeQueue = BIGTON_FREE_QUEUE_INIT;
+}
+
+void bigtonMoveSharedBuffs(
+    bigton_buff_owner_t *src, bigton_buff_owner_t *dest
+) {
+    bigton_buff_t *current = src->first;
+    while (current != NULL) {
+        bigton_buff_t *after = current->next;
+        if (current->seq >= src->sharedBelow) {
+            releaseBuff(current);
+            current = after;
+            continue;
+        }
+        current->owner = dest;
+        current->prev = dest->last;
+        current->next = NULL;
+        if (dest->last == NULL) {
+            dest->first = current;
+        } else {
+            dest->last->next = current;
+        }
+        dest->last = current;
+        addUsage(dest, BUFF_FOOTPRINT(current->sizeBytes));
+        current = after;
+    }
+    src->first = NULL;
+    src->last = NULL;
+    src->totalSizeBytes = 0;
+    free(src->cycleRoots.values);
+    src->cycleRoots = BIGTON_CYCLE_ROOTS_INIT;
+    free(src->freeQueue.values);
+    src->freeQueue = BIGTON_FREE_QUEUE_INIT;
+    dest->sharedBelow = UINT64_MAX;
+}
@@ -0,0 +1,354 @@
+
+#include <bigton/runtime.h>
+#include <bigton/scheduler.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+// Work stealing deque holding the indices of the tasks to execute.
+// All tasks are pushed by the thread calling 'bigtonSchedulerForEach' before
+// any worker is woken up, so only the owner pops from the bottom and thieves
+// take from the top (Chase-Lev without the need to grow while in use).
+typedef struct BigtonWorkDeque {
+    _Atomic int64_t top;
+    _Atomic int64_t bottom;
+    size_t capacity;
+    size_t *tasks;
+} bigton_work_deque_t;
+
+#define NO_TASK SIZE_MAX
+
+static size_t dequePop(bigton_work_deque_t *d) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    if (t > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return NO_TASK;
+    }
+    size_t task = d->tasks[b];
+    if (t == b) {
+        bool won = atomic_compare_exchange_strong_explicit(
+            &d->top, &t, t + 1,
+            memory_order_seq_cst, memory_order_relaxed
+        );
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        if (!won) { return NO_TASK; }
+    }
+    return task;
+}
+
+static size_t dequeSteal(bigton_work_deque_t *d) {
+    while (true) {
+        int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+        atomic_thread_fence(memory_order_seq_cst);
+        int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+        if (t >= b) { return NO_TASK; }
+        size_t task = d->tasks[t];
+        bool won = atomic_compare_exchange_strong_explicit(
+            &d->top, &t, t + 1,
+            memory_order_seq_cst, memory_order_relaxed
+        );
+        if (won) { return task; }
+    }
+}
+
+typedef struct BigtonWorker {
+    bigton_scheduler_t *scheduler;
+    uint32_t id;
+    pthread_t thread;
+    bigton_work_deque_t deque;
+} bigton_worker_t;
+
+// Runtime passed to 'bigtonSchedulerRun' together with its fork family.
+typedef struct BigtonRunEntry {
+    uintptr_t family;
+    size_t runtime;
+} bigton_run_entry_t;
+
+typedef struct BigtonScheduler {
+    uint32_t numWorkers;
+    bigton_worker_t *workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t roundStarted;
+    pthread_cond_t roundFinished;
+    uint64_t round;
+    uint32_t numBusyWorkers;
+    bool shuttingDown;
+
+    bigton_scheduler_task_t task;
+    void *taskContext;
+
+    // reused by 'bigtonSchedulerRun' to group runtimes by fork family
+    size_t runCapacity;
+    bigton_run_entry_t *runEntries;
+    size_t *runTaskStarts;
+} bigton_scheduler_t;
+
+static size_t findTask(bigton_scheduler_t *s, uint32_t workerId) {
+    size_t task = dequePop(&s->workers[workerId].deque);
+    if (task != NO_TASK) { return task; }
+    for (uint32_t o = 1; o < s->numWorkers; o += 1) {
+        uint32_t victim = (workerId + o) % s->numWorkers;
+        task = dequeSteal(&s->workers[victim].deque);
+        if (task != NO_TASK) { return task; }
+    }
+    return NO_TASK;
+}
+
+static void workUntilEmpty(bigton_scheduler_t *s, uint32_t workerId) {
+    while (true) {
+        size_t task = findTask(s, workerId);
+        if (task == NO_TASK) { return; }
+        s->task(s->taskContext, task);
+    }
+}
+
+static void *workerMain(void *arg) {
+    bigton_worker_t *w = arg;
+    bigton_scheduler_t *s = w->scheduler;
+    uint64_t seenRound = 0;
+    pthread_mutex_lock(&s->lock);
+    while (true) {
+        while (!s->shuttingDown && s->round == seenRound) {
+            pthread_cond_wait(&s->roundStarted, &s->lock);
+        }
+        if (s->shuttingDown) { break; }
+        seenRound = s->round;
+        pthread_mutex_unlock(&s->lock);
+        workUntilEmpty(s, w->id);
+        pthread_mutex_lock(&s->lock);
+        s->numBusyWorkers -= 1;
+        if (s->numBusyWorkers == 0) {
+            pthread_cond_signal(&s->roundFinished);
+        }
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+bigton_scheduler_t *bigtonSchedulerCreate(uint32_t numThreads) {
+    if (numThreads == 0) { numThreads = 1; }
+    bigton_scheduler_t *s = malloc(sizeof(bigton_scheduler_t));
+    if (s == NULL) { return NULL; }
+    s->numWorkers = numThreads;
+    s->workers = calloc(numThreads, sizeof(bigton_worker_t));
+    if (s->workers == NULL) {
+        free(s);
+        return NULL;
+    }
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->roundStarted, NULL);
+    pthread_cond_init(&s->roundFinished, NULL);
+    s->round = 0;
+    s->numBusyWorkers = 0;
+    s->shuttingDown = false;
+    s->task = NULL;
+    s->taskContext = NULL;
+    s->runCapacity = 0;
+    s->runEntries = NULL;
+    s->runTaskStarts = NULL;
+    // worker 0 is the thread calling 'bigtonSchedulerForEach'
+    for (uint32_t i = 0; i < numThreads; i += 1) {
+        bigton_worker_t *w = &s->workers[i];
+        w->scheduler = s;
+        w->id = i;
+        atomic_init(&w->deque.top, 0);
+        atomic_init(&w->deque.bottom, 0);
+        w->deque.capacity = 0;
+        w->deque.tasks = NULL;
+        if (i == 0) { continue; }
+        if (pthread_create(&w->thread, NULL, &workerMain, w) != 0) {
+            s->numWorkers = i;
+            break;
+        }
+    }
+    return s;
+}
+
+uint32_t bigtonSchedulerNumThreads(const bigton_scheduler_t *s) {
+    return s->numWorkers;
+}
+
+static void distributeTasks(bigton_scheduler_t *s, size_t count) {
+    size_t n = s->numWorkers;
+    for (size_t wi = 0; wi < n; wi += 1) {
+        bigton_work_deque_t *d = &s->workers[wi].deque;
+        size_t start = count * wi / n;
+        size_t end = count * (wi + 1) / n;
+        size_t taskCount = end - start;
+        if (taskCount > d->capacity) {
+            d->capacity = taskCount;
+            d->tasks = bigtonCheckAllocated(
+                realloc(d->tasks, sizeof(size_t) * taskCount)
+            );
+        }
+        // the owner pops from the bottom, so push in reverse to have
+        // each worker execute its share in order
+        for (size_t ti = 0; ti < taskCount; ti += 1) {
+            d->tasks[ti] = end - 1 - ti;
+        }
+        atomic_store_explicit(&d->top, 0, memory_order_relaxed);
+        atomic_store_explicit(
+            &d->bottom, (int64_t) taskCount, memory_order_relaxed
+        );
+    }
+}
+
+void bigtonSchedulerForEach(
+    bigton_scheduler_t *s, size_t count,
+    bigton_scheduler_task_t task, void *context
+) {
+    if (s == NULL || s->numWorkers <= 1 || count <= 1) {
+        for (size_t i = 0; i < count; i += 1) {
+            task(context, i);
+        }
+        return;
+    }
+    distributeTasks(s, count);
+    pthread_mutex_lock(&s->lock);
+    s->task = task;
+    s->taskContext = context;
+    s->numBusyWorkers = s->numWorkers - 1;
+    s->round += 1;
+    pthread_cond_broadcast(&s->roundStarted);
+    pthread_mutex_unlock(&s->lock);
+    workUntilEmpty(s, 0);
+    pthread_mutex_lock(&s->lock);
+    while (s->numBusyWorkers > 0) {
+        pthread_cond_wait(&s->roundFinished, &s->lock);
+    }
+    s->task = NULL;
+    s->taskContext = NULL;
+    pthread_mutex_unlock(&s->lock);
+}
+
+typedef struct BigtonRunContext {
+    bigton_runtime_state_t *const *runtimes;
+    bool startTick;
+    bigton_exec_result_t *results;
+    // NULL if every runtime is a task of its own
+    const bigton_run_entry_t *entries;
+    const size_t *taskStarts;
+} bigton_run_context_t;
+
+static void runTask(void *context, size_t i) {
+    bigton_run_context_t *c = context;
+    c->results[i] = bigtonExecUntilYield(c->runtimes[i], c->startTick);
+}
+
+static void runFamilyTask(void *context, size_t t) {
+    bigton_run_context_t *c = context;
+    for (size_t e = c->taskStarts[t]; e < c->taskStarts[t + 1]; e += 1) {
+        runTask(context, c->entries[e].runtime);
+    }
+}
+
+// Runtimes forked from the same runtime (directly or indirectly) share
+// buffers, with the root of their shared heaps identifying the family.
+// Returns 0 for runtimes that do not share any buffers.
+static uintptr_t forkFamily(const bigton_runtime_state_t *r) {
+    const bigton_shared_heap_t *h = r->forkedHeap != NULL
+        ? r->forkedHeap : r->sharedHeap;
+    if (h == NULL) { return 0; }
+    while (h->parent != NULL) { h = h->parent; }
+    return (uintptr_t) h;
+}
+
+static int compareRunEntries(const void *a, const void *b) {
+    const bigton_run_entry_t *ea = a;
+    const bigton_run_entry_t *eb = b;
+    if (ea->family != eb->family) { return ea->family < eb->family ? -1 : 1; }
+    if (ea->runtime != eb->runtime) {
+        return ea->runtime < eb->runtime ? -1 : 1;
+    }
+    return 0;
+}
+
+// Groups the runtimes into tasks, with each fork family forming a single
+// task that executes its runtimes in order. Returns the number of tasks.
+static size_t groupFamilies(
+    bigton_scheduler_t *s,
+    bigton_runtime_state_t *const *runtimes, size_t count
+) {
+    if (count > s->runCapacity) {
+        s->runCapacity = count;
+        s->runEntries = bigtonCheckAllocated(realloc(
+            s->runEntries, sizeof(bigton_run_entry_t) * count
+        ));
+        s->runTaskStarts = bigtonCheckAllocated(realloc(
+            s->runTaskStarts, sizeof(size_t) * (count + 1)
+        ));
+    }
+    for (size_t i = 0; i < count; i += 1) {
+        s->runEntries[i] = (bigton_run_entry_t) {
+            .family = forkFamily(runtimes[i]),
+            .runtime = i
+        };
+    }
+    qsort(s->runEntries, count, sizeof(bigton_run_entry_t), &compareRunEntries);
+    size_t taskCount = 0;
+    for (size_t e = 0; e < count; e += 1) {
+        uintptr_t family = s->runEntries[e].family;
+        bool continued = e > 0 && family != 0
+            && family == s->runEntries[e - 1].family;
+        if (continued) { continue; }
+        s->runTaskStarts[taskCount] = e;
+        taskCount += 1;
+    }
+    s->runTaskStarts[taskCount] = count;
+    return taskCount;
+}
+
+void bigtonSchedulerRun(
+    bigton_scheduler_t *s,
+    bigton_runtime_state_t *const *runtimes, size_t count, bool startTick,
+    bigton_exec_result_t *results
+) {
+    if (s->numWorkers <= 1 || count <= 1) {
+        bigtonExecMany(runtimes, count, startTick, results);
+        return;
+    }
+    bigton_run_context_t c = (bigton_run_context_t) {
+        .runtimes = runtimes,
+        .startTick = startTick,
+        .results = results,
+        .entries = NULL,
+        .taskStarts = NULL
+    };
+    bool anyForked = false;
+    for (size_t i = 0; i < count && !anyForked; i += 1) {
+        anyForked = runtimes[i]->sharedHeap != NULL
+            || runtimes[i]->forkedHeap != NULL;
+    }
+    if (!anyForked) {
+        bigtonSchedulerForEach(s, count, &runTask, &c);
+        return;
+    }
+    size_t taskCount = groupFamilies(s, runtimes, count);
+    c.entries = s->runEntries;
+    c.taskStarts = s->runTaskStarts;
+    bigtonSchedulerForEach(s, taskCount, &runFamilyTask, &c);
+}
+
+void bigtonSchedulerFree(bigton_scheduler_t *s) {
+    pthread_mutex_lock(&s->lock);
+    s->shuttingDown = true;
+    pthread_cond_broadcast(&s->roundStarted);
+    pthread_mutex_unlock(&s->lock);
+    for (uint32_t i = 1; i < s->numWorkers; i += 1) {
+        pthread_join(s->workers[i].thread, NULL);
+    }
+    for (uint32_t i = 0; i < s->numWorkers; i += 1) {
+        free(s->workers[i].deque.tasks);
+    }
+    pthread_cond_destroy(&s->roundFinished);
+    pthread_cond_destroy(&s->roundStarted);
+    pthread_mutex_destroy(&s->lock);
+    free(s->runEntries);
+    free(s->runTaskStarts);
+    free(s->workers);
+    free(s);
+}
@@ -0,0 +1,1064 @@
+
+#define BIGTON_ERROR_MACROS
+#include <bigton/runtime.h>
+#include <bigton/snapshot.h>
+#include <bigton/scheduler.h>
+#include <bigton/encoding.h>
+#include <bigton/compress.h>
+#include <bigton/util.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// SNAPSHOT FORMAT STRUCTURE:
+//
+// uint8_t magic[4] = "BGTS";
+// uint8_t version = 5;
+// uint8_t reserved[3] = { 0, 0, 0 };
+// uint64_t programHash; // little endian
+// settings - tickInstructionLimit, memoryUsageLimit, maxCallDepth,
+//     maxTupleSize, tickFreeBudget (varint each)
+// state - error, currentSource.file, currentSource.line, currentInstr,
+//     accCost, awaitingBuiltinFun, createdValues, preparedStatus,
+//     preparedCost (varint each)
+// numObjects varint
+// headersSize varint
+// headers - for each object, its type (byte) followed by:
+//     string => length varint
+//     tuple => length varint, flatLength varint
+//     object => shape id varint, hash varint
+//     array => length varint, capacity varint, hash varint
+//     map => length varint, capacity varint, hash varint
+// globals - count varint, values
+// stack - capacity varint, count varint, values
+// locals - capacity varint, count varint, values
+// scopes - capacity varint, count varint, for each: type, start, end, after,
+//     numLocals
+// trace - capacity varint, count varint, for each: name, calledFrom.file,
+//     calledFrom.line, definedAt.file, definedAt.line
+// logs - capacity varint, count varint, for each: object id varint
+// constStrings - count varint, for each: object id varint plus one, or 0 if
+//     the constant string has not been loaded
+// contents - for each object:
+//     string => chars (varint each)
+//     tuple, object, array => members / elements (values)
+//     map => for each used slot in order: slot index varint, key, value
+//
+// Capacities of arrays, maps, stacks, scopes, the trace and the logs are
+// preserved, so that the memory usage of a restored runtime is close to that
+// of the original runtime. It is not the same, since strings and array views
+// are restored with buffers of their own that have no spare capacity (see
+// 'bigtonStringConcat' and 'bigtonArraySlice'), and since arrays that only
+// hold ints or only floats are restored packed (see 'bigtonArrayPack').
+//
+// Values are written as their type (byte) followed by:
+//     null => nothing
+//     int => zigzag varint
+//     float => 8 bytes, little endian
+//     string, tuple, object, array, map => object id varint
+
+
+typedef struct BigtonObjectIds {
+    size_t capacity;
+    size_t count;
+    const void **keys;
+    uint32_t *ids;
+} bigton_object_ids_t;
+
+static void growObjectIds(bigton_object_ids_t *m) {
+    size_t oldCapacity = m->capacity;
+    const void **oldKeys = m->keys;
+    uint32_t *oldIds = m->ids;
+    m->capacity = oldCapacity == 0 ? 64 : oldCapacity * 2;
+    m->keys = calloc(m->capacity, sizeof(const void *));
+    m->ids = malloc(sizeof(uint32_t) * m->capacity);
+    for (size_t i = 0; i < oldCapacity; i += 1) {
+        if (oldKeys[i] == NULL) { continue; }
+        size_t slot = bigtonHashPointer(oldKeys[i], m->capacity);
+        while (m->keys[slot] != NULL) {
+            slot = (slot + 1) & (m->capacity - 1);
+        }
+        m->keys[slot] = oldKeys[i];
+        m->ids[slot] = oldIds[i];
+    }
+    free(oldKeys);
+    free(oldIds);
+}
+
+typedef struct BigtonSnapshotWriter {
+    const bigton_runtime_state_t *r;
+    bigton_object_ids_t ids;
+    size_t objectsCapacity;
+    size_t objectsCount;
+    bigton_tagged_value_t *objects;
+    bigton_writer_t headers;
+    bigton_writer_t contents;
+} bigton_snapshot_writer_t;
+
+static void writeObjectHeader(
+    bigton_snapshot_writer_t *s, bigton_tagged_value_t v
+) {
+    bigton_writer_t *w = &s->headers;
+    bigtonWriteByte(w, (uint8_t) v.t);
+    switch (v.t) {
+        case BIGTON_STRING:
+            bigtonWriteVarint(w, v.v.s->length);
+            break;
+        case BIGTON_TUPLE:
+            bigtonWriteVarint(w, v.v.t->length);
+            bigtonWriteVarint(w, v.v.t->flatLength);
+            break;
+        case BIGTON_OBJECT:
+            bigtonWriteVarint(w, v.v.o->shape - s->r->program.shapes);
+            bigtonWriteVarint(w, v.v.o->hash);
+            break;
+        case BIGTON_ARRAY:
+            bigtonWriteVarint(w, v.v.a->length);
+            bigtonWriteVarint(w, v.v.a->capacity);
+            bigtonWriteVarint(w, v.v.a->hash);
+            break;
+        case BIGTON_MAP:
+            bigtonWriteVarint(w, v.v.m->length);
+            bigtonWriteVarint(w, v.v.m->capacity);
+            bigtonWriteVarint(w, v.v.m->hash);
+            break;
+        default:
+            break;
+    }
+}
+
+static uint32_t objectIdOf(
+    bigton_snapshot_writer_t *s, bigton_tagged_value_t v
+) {
+    bigton_object_ids_t *m = &s->ids;
+    if ((m->count + 1) * 2 > m->capacity) { growObjectIds(m); }
+    // all object types are pointers at the same location in the union
+    const void *key = v.v.s;
+    size_t slot = bigtonHashPointer(key, m->capacity);
+    while (m->keys[slot] != NULL) {
+        if (m->keys[slot] == key) { return m->ids[slot]; }
+        slot = (slot + 1) & (m->capacity - 1);
+    }
+    uint32_t id = (uint32_t) s->objectsCount;
+    m->keys[slot] = key;
+    m->ids[slot] = id;
+    m->count += 1;
+    if (s->objectsCount >= s->objectsCapacity) {
+        s->objectsCapacity = s->objectsCapacity == 0
+            ? 64 : s->objectsCapacity * 2;
+        s->objects = realloc(
+            s->objects, sizeof(bigton_tagged_value_t) * s->objectsCapacity
+        );
+    }
+    // objects, arrays and maps shared with other runtimes may have been
+    // copied, but all references still use the original as the identity
+    if (v.t == BIGTON_OBJECT) { v.v.o = bigtonObjectRead(s->r, v.v.o); }
+    if (v.t == BIGTON_ARRAY) { v.v.a = bigtonArrayRead(s->r, v.v.a); }
+    if (v.t == BIGTON_MAP) { v.v.m = bigtonMapRead(s->r, v.v.m); }
+    s->objects[id] = v;
+    s->objectsCount += 1;
+    writeObjectHeader(s, v);
+    return id;
+}
+
+static void writeValue(
+    bigton_snapshot_writer_t *s, bigton_value_type_t t, bigton_value_t v
+) {
+    bigton_writer_t *w = &s->contents;
+    bigtonWriteByte(w, (uint8_t) t);
+    switch (t) {
+        case BIGTON_NULL:
+            break;
+        case BIGTON_INT:
+            bigtonWriteZigzag(w, v.i);
+            break;
+        case BIGTON_FLOAT: {
+            uint64_t bits;
+            memcpy(&bits, &v.f, sizeof(uint64_t));
+            bigtonWriteFixed64(w, bits);
+            break;
+        }
+        case BIGTON_STRING:
+        case BIGTON_TUPLE:
+        case BIGTON_OBJECT:
+        case BIGTON_ARRAY:
+        case BIGTON_MAP: {
+            bigton_tagged_value_t tv = { .t = t, .v = v };
+            bigtonWriteVarint(w, objectIdOf(s, tv));
+            break;
+        }
+    }
+}
+
+static void writeValues(
+    bigton_snapshot_writer_t *s, size_t count,
+    const bigton_value_type_t *types, const bigton_value_t *values
+) {
+    bigtonWriteVarint(&s->contents, count);
+    for (size_t i = 0; i < count; i += 1) {
+        writeValue(s, types[i], values[i]);
+    }
+}
+
+static void writeObjectContents(
+    bigton_snapshot_writer_t *s, bigton_tagged_value_t v
+) {
+    switch (v.t) {
+        case BIGTON_STRING: {
+            const bigton_string_t *str = v.v.s;
+            for (size_t i = 0; i < str->length; i += 1) {
+                bigtonWriteVarint(&s->contents, str->content[i]);
+            }
+            break;
+        }
+        case BIGTON_TUPLE: {
+            const bigton_tuple_t *t = v.v.t;
+            for (size_t i = 0; i < t->length; i += 1) {
+                writeValue(s, t->valueTypes[i], t->values[i]);
+            }
+            break;
+        }
+        case BIGTON_OBJECT: {
+            const bigton_object_t *o = v.v.o;
+            for (size_t i = 0; i < o->shape->propCount; i += 1) {
+                writeValue(s, o->memberTypes[i], o->memberValues[i]);
+            }
+            break;
+        }
+        case BIGTON_ARRAY: {
+            const bigton_array_t *a = v.v.a;
+            for (size_t i = 0; i < a->length; i += 1) {
+                writeValue(
+                    s, bigtonArrayTypeAt(a, i), a->elementValues[i]
+                );
+            }
+            break;
+        }
+        case BIGTON_MAP: {
+            const bigton_map_t *m = v.v.m;
+            for (size_t slot = 0; slot < m->capacity; slot += 1) {
+                if (m->slotHashes[slot] == 0) { continue; }
+                bigtonWriteVarint(&s->contents, slot);
+                writeValue(s, m->slotTypes[slot * 2], m->slotValues[slot * 2]);
+                writeValue(
+                    s, m->slotTypes[slot * 2 + 1], m->slotValues[slot * 2 + 1]
+                );
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Returns a copy of the snapshot a hibernated runtime has been stored as.
+static uint8_t *copyHibernated(
+    const bigton_hibernated_state_t *h, size_t *sizeOut
+) {
+    *sizeOut = h->rawSize;
+    if (h->compressed) {
+        return bigtonDecompress(h->data, h->size, h->rawSize);
+    }
+    uint8_t *copy = malloc(h->rawSize);
+    memcpy(copy, h->data, h->rawSize);
+    return copy;
+}
+
+uint8_t *bigtonSnapshot(const bigton_runtime_state_t *r, size_t *sizeOut) {
+    if (r->hibernated != NULL) {
+        return copyHibernated(r->hibernated, sizeOut);
+    }
+    bigton_snapshot_writer_t s = {
+        .r = r,
+        .ids = { .capacity = 0, .count = 0, .keys = NULL, .ids = NULL },
+        .objectsCapacity = 0,
+        .objectsCount = 0,
+        .objects = NULL,
+        .headers = BIGTON_WRITER_INIT,
+        .contents = BIGTON_WRITER_INIT
+    };
+    bigton_writer_t *c = &s.contents;
+    writeValues(
+        &s, r->program.numGlobals, r->globalTypes, r->globalValues
+    );
+    bigtonWriteVarint(c, r->stack.capacity);
+    writeValues(&s, r->stack.count, r->stack.types, r->stack.values);
+    bigtonWriteVarint(c, r->locals.capacity);
+    writeValues(&s, r->locals.count, r->locals.types, r->locals.values);
+    bigtonWriteVarint(c, r->scopesCapacity);
+    bigtonWriteVarint(c, r->scopesCount);
+    for (size_t i = 0; i < r->scopesCount; i += 1) {
+        const bigton_scope_t *scope = &r->scopes[i];
+        bigtonWriteVarint(c, scope->type);
+        bigtonWriteVarint(c, scope->start);
+        bigtonWriteVarint(c, scope->end);
+        bigtonWriteVarint(c, scope->after);
+        bigtonWriteVarint(c, scope->numLocals);
+    }
+    bigtonWriteVarint(c, r->traceCapacity);
+    bigtonWriteVarint(c, r->traceCount);
+    for (size_t i = 0; i < r->traceCount; i += 1) {
+        const bigton_trace_call_t *call = &r->trace[i];
+        bigtonWriteVarint(c, call->name);
+        bigtonWriteVarint(c, call->calledFrom.file);
+        bigtonWriteVarint(c, call->calledFrom.line);
+        bigtonWriteVarint(c, call->definedAt.file);
+        bigtonWriteVarint(c, call->definedAt.line);
+    }
+    bigtonWriteVarint(c, r->logsCapacity);
+    bigtonWriteVarint(c, r->logsCount);
+    for (size_t i = 0; i < r->logsCount; i += 1) {
+        bigtonWriteVarint(c, objectIdOf(&s, BIGTON_STRING_VALUE(r->logs[i])));
+    }
+    bigtonWriteVarint(c, r->program.numConstStrings);
+    for (size_t i = 0; i < r->program.numConstStrings; i += 1) {
+        bigton_string_t *str = r->constStrings[i];
+        if (str == NULL) {
+            bigtonWriteVarint(c, 0);
+            continue;
+        }
+        uint64_t id = objectIdOf(&s, BIGTON_STRING_VALUE(str));
+        bigtonWriteVarint(c, id + 1);
+    }
+    // writing the contents of an object may discover further objects
+    for (size_t i = 0; i < s.objectsCount; i += 1) {
+        writeObjectContents(&s, s.objects[i]);
+    }
+    bigton_writer_t out = BIGTON_WRITER_INIT;
+    bigtonWriteBytes(&out, BIGTON_SNAPSHOT_MAGIC, 4);
+    bigtonWriteByte(&out, BIGTON_SNAPSHOT_VERSION);
+    bigtonWriteBytes(&out, "\0\0\0", 3);
+    bigtonWriteFixed64(&out, r->image == NULL ? 0 : r->image->hash);
+    bigtonWriteVarint(&out, r->settings.tickInstructionLimit);
+    bigtonWriteVarint(&out, r->settings.memoryUsageLimit);
+    bigtonWriteVarint(&out, r->settings.maxCallDepth);
+    bigtonWriteVarint(&out, r->settings.maxTupleSize);
+    bigtonWriteVarint(&out, r->settings.tickFreeBudget);
+    bigtonWriteVarint(&out, r->error);
+    bigtonWriteVarint(&out, r->currentSource.file);
+    bigtonWriteVarint(&out, r->currentSource.line);
+    bigtonWriteVarint(&out, r->currentInstr);
+    bigtonWriteVarint(&out, r->accCost);
+    bigtonWriteVarint(&out, r->awaitingBuiltinFun);
+    bigtonWriteVarint(&out, r->createdValues);
+    bigtonWriteVarint(&out, r->preparedStatus);
+    bigtonWriteVarint(&out, r->preparedCost);
+    bigtonWriteVarint(&out, s.objectsCount);
+    bigtonWriteVarint(&out, s.headers.size);
+    bigtonWriteBytes(&out, s.headers.data, s.headers.size);
+    bigtonWriteBytes(&out, s.contents.data, s.contents.size);
+    free(s.ids.keys);
+    free(s.ids.ids);
+    free(s.objects);
+    free(s.headers.data);
+    free(s.contents.data);
+    *sizeOut = out.size;
+    return out.data;
+}
+
+typedef struct BigtonSnapshotManyContext {
+    const bigton_runtime_state_t *const *runtimes;
+    uint8_t **snapshots;
+    size_t *sizes;
+} bigton_snapshot_many_context_t;
+
+static void snapshotTask(void *context, size_t i) {
+    bigton_snapshot_many_context_t *c = context;
+    c->snapshots[i] = bigtonSnapshot(c->runtimes[i], &c->sizes[i]);
+}
+
+void bigtonSnapshotMany(
+    bigton_scheduler_t *scheduler,
+    const bigton_runtime_state_t *const *runtimes, size_t count,
+    uint8_t **snapshots, size_t *sizes
+) {
+    bigton_snapshot_many_context_t c = (bigton_snapshot_many_context_t) {
+        .runtimes = runtimes,
+        .snapshots = snapshots,
+        .sizes = sizes
+    };
+    bigtonSchedulerForEach(scheduler, count, &snapshotTask, &c);
+}
+
+
+// Capacities in valid snapshots may exceed the number of used elements,
+// but not by this much.
+#define MAX_CAPACITY_SLACK (1 << 20)
+
+static bool isValidCapacity(uint64_t capacity, uint64_t count) {
+    return capacity >= count && capacity - count <= MAX_CAPACITY_SLACK;
+}
+
+typedef struct BigtonSnapshotReader {
+    bigton_runtime_state_t *r;
+    bigton_reader_t in;
+    size_t objectsCount;
+    bigton_tagged_value_t *objects;
+} bigton_snapshot_reader_t;
+
+static bool allocObjectShell(
+    bigton_snapshot_reader_t *s, bigton_reader_t *h, size_t id
+) {
+    bigton_runtime_state_t *r = s->r;
+    // every char, member and element takes up at least one byte,
+    // which rules out allocating huge buffers for invalid snapshots
+    size_t maxLength = (size_t) (s->in.end - s->in.p);
+    bigton_value_type_t t = (bigton_value_type_t) bigtonReadByte(h);
+    switch (t) {
+        case BIGTON_STRING: {
+            uint32_t length = bigtonReadVarint32(h);
+            if (h->failed || length > maxLength) { return false; }
+            bigton_string_t *str
+                = bigtonAllocBuff(&r->b, sizeof(bigton_string_t));
+            str->rc = (bigton_rc_t) { .count = 0 };
+            str->length = length;
+            str->usedLength = length;
+            str->content = bigtonAllocNullableBuff(
+                &r->b, sizeof(bigton_char_t) * length
+            );
+            str->viewed = NULL;
+            str->hash = 0;
+            s->objects[id] = BIGTON_STRING_VALUE(str);
+            return true;
+        }
+        case BIGTON_TUPLE: {
+            uint32_t length = bigtonReadVarint32(h);
+            uint32_t flatLength = bigtonReadVarint32(h);
+            if (h->failed || length > maxLength) { return false; }
+            bigton_tuple_t *t = bigtonAllocBuff(&r->b, sizeof(bigton_tuple_t));
+            t->rc = (bigton_rc_t) { .count = 0 };
+            t->length = length;
+            t->flatLength = flatLength;
+            t->valueTypes = bigtonAllocBuff(
+                &r->b, sizeof(bigton_value_type_t) * length
+            );
+            t->values = bigtonAllocBuff(&r->b, sizeof(bigton_value_t) * length);
+            s->objects[id] = BIGTON_TUPLE_VALUE(t);
+            return true;
+        }
+        case BIGTON_OBJECT: {
+            uint32_t shapeId = bigtonReadVarint32(h);
+            uint32_t hash = bigtonReadVarint32(h);
+            if (h->failed || shapeId >= r->program.numShapes) { return false; }
+            const bigton_shape_t *shape = &r->program.shapes[shapeId];
+            if (shape->propCount > maxLength) { return false; }
+            bigton_object_t *o
+                = bigtonAllocBuff(&r->b, sizeof(bigton_object_t));
+            o->rc = (bigton_rc_t) { .count = 0 };
+            o->hash = hash;
+            o->shape = shape;
+            o->memberTypes = bigtonAllocNullableBuff(
+                &r->b, sizeof(bigton_value_type_t) * shape->propCount
+            );
+            o->memberValues = bigtonAllocNullableBuff(
+                &r->b, sizeof(bigton_value_t) * shape->propCount
+            );
+            s->objects[id] = BIGTON_OBJECT_VALUE(o);
+            return true;
+        }
+        case BIGTON_ARRAY: {
+            uint32_t length = bigtonReadVarint32(h);
+            uint32_t capacity = bigtonReadVarint32(h);
+            uint32_t hash = bigtonReadVarint32(h);
+            bool valid = !h->failed && length <= maxLength
+                && isValidCapacity(capacity, length);
+            if (!valid) { return false; }
+            bigton_array_t *a = bigtonAllocBuff(&r->b, sizeof(bigton_array_t));
+            a->rc = (bigton_rc_t) { .count = 0 };
+            a->hash = hash;
+            a->capacity = capacity;
+            a->length = length;
+            a->packedType = BIGTON_NULL;
+            a->elementTypes = bigtonAllocNullableBuff(
+                &r->b, sizeof(bigton_value_type_t) * capacity
+            );
+            a->elementValues = bigtonAllocNullableBuff(
+                &r->b, sizeof(bigton_value_t) * capacity
+            );
+            a->viewed = NULL;
+            s->objects[id] = BIGTON_ARRAY_VALUE(a);
+            return true;
+        }
+        case BIGTON_MAP: {
+            uint32_t length = bigtonReadVarint32(h);
+            uint32_t capacity = bigtonReadVarint32(h);
+            uint32_t hash = bigtonReadVarint32(h);
+            bool valid = !h->failed && length <= maxLength
+                && isValidCapacity(capacity, length)
+                && (capacity & (capacity - 1)) == 0
+                && (uint64_t) length * 4 <= (uint64_t) capacity * 3;
+            if (!valid) { return false; }
+            bigton_map_t *m = bigtonAllocBuff(&r->b, sizeof(bigton_map_t));
+            m->rc = (bigton_rc_t) { .count = 0 };
+            m->hash = hash;
+            m->capacity = capacity;
+            m->length = length;
+            m->slotHashes = bigtonAllocNullableBuff(
+                &r->b, sizeof(uint32_t) * capacity
+            );
+            m->slotTypes = bigtonAllocNullableBuff(
+                &r->b, sizeof(bigton_value_type_t) * capacity * 2
+            );
+            m->slotValues = bigtonAllocNullableBuff(
+                &r->b, sizeof(bigton_value_t) * capacity * 2
+            );
+            for (size_t i = 0; i < capacity; i += 1) {
+                m->slotHashes[i] = 0;
+                m->slotTypes[i * 2] = BIGTON_NULL;
+                m->slotTypes[i * 2 + 1] = BIGTON_NULL;
+            }
+            s->objects[id] = BIGTON_MAP_VALUE(m);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// Reads a value, taking a reference to it if it is an object.
+static bigton_tagged_value_t readValue(bigton_snapshot_reader_t *s) {
+    bigton_reader_t *in = &s->in;
+    bigton_value_type_t t = (bigton_value_type_t) bigtonReadByte(in);
+    switch (t) {
+        case BIGTON_NULL:
+            return BIGTON_NULL_VALUE;
+        case BIGTON_INT:
+            return BIGTON_INT_VALUE(bigtonReadZigzag(in));
+        case BIGTON_FLOAT: {
+            uint64_t bits = bigtonReadFixed64(in);
+            bigton_float_t f;
+            memcpy(&f, &bits, sizeof(bigton_float_t));
+            return BIGTON_FLOAT_VALUE(f);
+        }
+        case BIGTON_STRING:
+        case BIGTON_TUPLE:
+        case BIGTON_OBJECT:
+        case BIGTON_ARRAY:
+        case BIGTON_MAP: {
+            uint64_t id = bigtonReadVarint(in);
+            if (in->failed || id >= s->objectsCount || s->objects[id].t != t) {
+                in->failed = true;
+                return BIGTON_NULL_VALUE;
+            }
+            bigton_tagged_value_t v = s->objects[id];
+            bigtonValRcIncr(v);
+            return v;
+        }
+    }
+    in->failed = true;
+    return BIGTON_NULL_VALUE;
+}
+
+static void readObjectContents(
+    bigton_snapshot_reader_t *s, bigton_tagged_value_t v
+) {
+    bigton_reader_t *in = &s->in;
+    switch (v.t) {
+        case BIGTON_STRING: {
+            bigton_char_t *content = (bigton_char_t *) v.v.s->content;
+            for (size_t i = 0; i < v.v.s->length && !in->failed; i += 1) {
+                uint32_t c = bigtonReadVarint32(in);
+                if (c > UINT16_MAX) { in->failed = true; }
+                content[i] = (bigton_char_t) c;
+            }
+            break;
+        }
+        case BIGTON_TUPLE: {
+            bigton_tuple_t *t = v.v.t;
+            bigton_value_type_t *types = (bigton_value_type_t *) t->valueTypes;
+            bigton_value_t *values = (bigton_value_t *) t->values;
+            for (size_t i = 0; i < t->length && !in->failed; i += 1) {
+                bigton_tagged_value_t member = readValue(s);
+                types[i] = member.t;
+                values[i] = member.v;
+            }
+            break;
+        }
+        case BIGTON_OBJECT: {
+            bigton_object_t *o = v.v.o;
+            for (size_t i = 0; i < o->shape->propCount && !in->failed; i += 1) {
+                bigton_tagged_value_t member = readValue(s);
+                o->memberTypes[i] = member.t;
+                o->memberValues[i] = member.v;
+            }
+            break;
+        }
+        case BIGTON_ARRAY: {
+            bigton_array_t *a = v.v.a;
+            for (size_t i = 0; i < a->length && !in->failed; i += 1) {
+                bigton_tagged_value_t element = readValue(s);
+                a->elementTypes[i] = element.t;
+                a->elementValues[i] = element.v;
+            }
+            if (!in->failed) { bigtonArrayPack(a); }
+            break;
+        }
+        case BIGTON_MAP: {
+            // keys may reference objects whose contents have not been read
+            // yet, which is why the hashes of the keys are only computed
+            // after all contents have been read (see 'rehashMaps')
+            bigton_map_t *m = v.v.m;
+            uint64_t minSlot = 0;
+            for (size_t i = 0; i < m->length && !in->failed; i += 1) {
+                uint64_t slot = bigtonReadVarint(in);
+                if (slot < minSlot || slot >= m->capacity) {
+                    in->failed = true;
+                    break;
+                }
+                minSlot = slot + 1;
+                bigton_tagged_value_t key = readValue(s);
+                bigton_tagged_value_t value = readValue(s);
+                m->slotHashes[slot] = 1;
+                m->slotTypes[slot * 2] = key.t;
+                m->slotTypes[slot * 2 + 1] = value.t;
+                m->slotValues[slot * 2] = key.v;
+                m->slotValues[slot * 2 + 1] = value.v;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void rehashMaps(bigton_snapshot_reader_t *s) {
+    for (size_t i = 0; i < s->objectsCount; i += 1) {
+        if (s->objects[i].t != BIGTON_MAP) { continue; }
+        bigton_map_t *m = s->objects[i].v.m;
+        for (size_t slot = 0; slot < m->capacity; slot += 1) {
+            if (m->slotHashes[slot] == 0) { continue; }
+            m->slotHashes[slot] = bigtonValueHash(bigtonMapKeyAt(m, slot));
+        }
+    }
+}
+
+static bool readValueStack(
+    bigton_snapshot_reader_t *s, bigton_value_stack_t *dest
+) {
+    bigton_runtime_state_t *r = s->r;
+    bigton_reader_t *in = &s->in;
+    uint64_t capacity = bigtonReadVarint(in);
+    uint64_t count = bigtonReadVarint(in);
+    bool valid = !in->failed
+        && count <= (uint64_t) (in->end - in->p)
+        && isValidCapacity(capacity, count);
+    if (!valid) { return false; }
+    // runtimes that have been reset may already have a larger capacity
+    if (capacity < dest->capacity) { capacity = dest->capacity; }
+    dest->capacity = capacity;
+    dest->types = bigtonReallocNullableBuff(
+        &r->b, dest->types, sizeof(bigton_value_type_t) * capacity
+    );
+    dest->values = bigtonReallocNullableBuff(
+        &r->b, dest->values, sizeof(bigton_value_t) * capacity
+    );
+    for (size_t i = 0; i < count && !in->failed; i += 1) {
+        bigtonStackPush(dest, readValue(s), r);
+    }
+    return true;
+}
+
+// Reads the capacity and length of the given buffer and resizes it to
+// the read capacity.
+static bool readBufferSize(
+    bigton_snapshot_reader_t *s, void **buffer, size_t elemSize,
+    size_t *capacity, uint64_t *count
+) {
+    bigton_reader_t *in = &s->in;
+    uint64_t newCapacity = bigtonReadVarint(in);
+    *count = bigtonReadVarint(in);
+    bool valid = !in->failed
+        && *count <= (uint64_t) (in->end - in->p)
+        && isValidCapacity(newCapacity, *count);
+    if (!valid) { return false; }
+    if (newCapacity < *capacity) { newCapacity = *capacity; }
+    *capacity = newCapacity;
+    *buffer = bigtonReallocNullableBuff(
+        &s->r->b, *buffer, elemSize * newCapacity
+    );
+    return true;
+}
+
+static bool readState(bigton_snapshot_reader_t *s) {
+    bigton_runtime_state_t *r = s->r;
+    bigton_reader_t *in = &s->in;
+    r->error = bigtonReadVarint32(in);
+    r->currentSource.file = bigtonReadVarint32(in);
+    r->currentSource.line = bigtonReadVarint32(in);
+    r->currentInstr = bigtonReadVarint32(in);
+    r->accCost = bigtonReadVarint(in);
+    r->awaitingBuiltinFun = bigtonReadVarint32(in);
+    r->createdValues = bigtonReadVarint(in);
+    uint32_t preparedStatus = bigtonReadVarint32(in);
+    r->preparedStatus = (bigton_exec_status_t) preparedStatus;
+    r->preparedCost = bigtonReadVarint(in);
+    s->objectsCount = bigtonReadVarint(in);
+    uint64_t headersSize = bigtonReadVarint(in);
+    bool validSizes = !in->failed
+        && preparedStatus <= BIGTONST_ERROR
+        && headersSize <= (uint64_t) (in->end - in->p)
+        && s->objectsCount <= headersSize;
+    if (!validSizes) { return false; }
+    bigton_reader_t headers = {
+        .p = in->p, .end = in->p + headersSize, .failed = false
+    };
+    in->p += headersSize;
+    s->objects = malloc(
+        sizeof(bigton_tagged_value_t)
+            * (s->objectsCount == 0 ? 1 : s->objectsCount)
+    );
+    for (size_t i = 0; i < s->objectsCount; i += 1) {
+        s->objects[i] = BIGTON_NULL_VALUE;
+    }
+    for (size_t i = 0; i < s->objectsCount; i += 1) {
+        if (!allocObjectShell(s, &headers, i)) { return false; }
+    }
+    uint64_t numGlobals = bigtonReadVarint(in);
+    if (numGlobals != r->program.numGlobals) { return false; }
+    for (size_t i = 0; i < numGlobals && !in->failed; i += 1) {
+        bigton_tagged_value_t v = readValue(s);
+        r->globalTypes[i] = v.t;
+        r->globalValues[i] = v.v;
+    }
+    if (!readValueStack(s, &r->stack)) { return false; }
+    if (!readValueStack(s, &r->locals)) { return false; }
+    r->scopesCount = 0;
+    uint64_t scopesCount;
+    bool validScopes = readBufferSize(
+        s, (void **) &r->scopes, sizeof(bigton_scope_t),
+        &r->scopesCapacity, &scopesCount
+    );
+    if (!validScopes) { return false; }
+    for (size_t i = 0; i < scopesCount && !in->failed; i += 1) {
+        bigton_scope_t scope;
+        uint32_t type = bigtonReadVarint32(in);
+        if (type > BIGTONSC_RANGE) { return false; }
+        scope.type = (bigton_scope_type_t) type;
+        scope.start = bigtonReadVarint32(in);
+        scope.end = bigtonReadVarint32(in);
+        scope.after = bigtonReadVarint32(in);
+        scope.numLocals = bigtonReadVarint32(in);
+        bool validRange = scope.type != BIGTONSC_RANGE
+            || scope.numLocals >= BIGTON_RANGE_LOCALS;
+        if (!validRange) { return false; }
+        bigtonScopePush(r, scope);
+    }
+    uint64_t traceCount;
+    bool validTrace = readBufferSize(
+        s, (void **) &r->trace, sizeof(bigton_trace_call_t),
+        &r->traceCapacity, &traceCount
+    );
+    if (!validTrace) { return false; }
+    for (size_t i = 0; i < traceCount && !in->failed; i += 1) {
+        bigton_trace_call_t call;
+        call.name = bigtonReadVarint32(in);
+        call.calledFrom.file = bigtonReadVarint32(in);
+        call.calledFrom.line = bigtonReadVarint32(in);
+        call.definedAt.file = bigtonReadVarint32(in);
+        call.definedAt.line = bigtonReadVarint32(in);
+        bigtonTracePush(r, call);
+    }
+    uint64_t logsCount;
+    bool validLogs = readBufferSize(
+        s, (void **) &r->logs, sizeof(bigton_string_t *),
+        &r->logsCapacity, &logsCount
+    );
+    if (!validLogs) { return false; }
+    for (size_t i = 0; i < logsCount && !in->failed; i += 1) {
+        uint64_t id = bigtonReadVarint(in);
+        bool isString = id < s->objectsCount
+            && s->objects[id].t == BIGTON_STRING;
+        if (!isString) { return false; }
+        bigtonValRcIncr(s->objects[id]);
+        bigtonLogLine(r, s->objects[id].v.s);
+    }
+    uint64_t numConstStrings = bigtonReadVarint(in);
+    if (numConstStrings != r->program.numConstStrings) { return false; }
+    for (size_t i = 0; i < numConstStrings && !in->failed; i += 1) {
+        uint64_t idPlusOne = bigtonReadVarint(in);
+        if (idPlusOne == 0) { continue; }
+        uint64_t id = idPlusOne - 1;
+        bool isString = id < s->objectsCount
+            && s->objects[id].t == BIGTON_STRING;
+        if (!isString) { return false; }
+        bigtonValRcIncr(s->objects[id]);
+        r->constStrings[i] = s->objects[id].v.s;
+    }
+    for (size_t i = 0; i < s->objectsCount && !in->failed; i += 1) {
+        readObjectContents(s, s->objects[i]);
+    }
+    if (in->failed) { return false; }
+    rehashMaps(s);
+    return in->p == in->end;
+}
+
+// Settings used to initialize the runtime if the header of a snapshot is
+// invalid, so that none of the settings stored in it are ever used. Such a
+// runtime is unable to execute anything until it is reset.
+static const bigton_runtime_settings_t INVALID_SNAPSHOT_SETTINGS = {
+    .tickInstructionLimit = 0,
+    .memoryUsageLimit = 0,
+    .maxCallDepth = 0,
+    .maxTupleSize = 0,
+    .tickFreeBudget = 0
+};
+
+// Reads the header of the snapshot, returning false if it is invalid or
+// was made using a different program. The settings are only read if the
+// rest of the header is valid.
+static bool readHeader(
+    bigton_reader_t *in, const bigton_program_image_t *image,
+    bigton_runtime_settings_t *settings
+) {
+    size_t snapshotSize = (size_t) (in->end - in->p);
+    bool validHeader = snapshotSize >= 16
+        && memcmp(in->p, BIGTON_SNAPSHOT_MAGIC, 4) == 0
+        && in->p[4] == BIGTON_SNAPSHOT_VERSION;
+    if (!validHeader) { return false; }
+    in->p += 8;
+    uint64_t programHash = bigtonReadFixed64(in);
+    if (in->failed || programHash != image->hash) { return false; }
+    settings->tickInstructionLimit = bigtonReadVarint(in);
+    settings->memoryUsageLimit = (size_t) bigtonReadVarint(in);
+    settings->maxCallDepth = bigtonReadVarint32(in);
+    settings->maxTupleSize = bigtonReadVarint32(in);
+    settings->tickFreeBudget = (size_t) bigtonReadVarint(in);
+    return !in->failed;
+}
+
+// Restores the state following the header of a snapshot into 'r', which
+// needs to be in the state it was in after it was initialized.
+static bool restoreState(bigton_runtime_state_t *r, bigton_reader_t in) {
+    bigton_snapshot_reader_t s = {
+        .r = r,
+        .in = in,
+        .objectsCount = 0,
+        .objects = NULL
+    };
+    bool restored = readState(&s);
+    free(s.objects);
+    return restored;
+}
+
+void bigtonRestore(
+    bigton_runtime_state_t *r, bigton_program_image_t *image,
+    const uint8_t *snapshot, size_t snapshotSize
+) {
+    bigton_reader_t in = {
+        .p = snapshot, .end = snapshot + snapshotSize, .failed = false
+    };
+    bigton_runtime_settings_t settings;
+    if (!readHeader(&in, image, &settings)) {
+        bigtonInitFromImage(r, &INVALID_SNAPSHOT_SETTINGS, image);
+        if (!HAS_ERROR(r)) { r->error = BIGTONE_INT_INVALID_SNAPSHOT; }
+        return;
+    }
+    bigtonInitFromImage(r, &settings, image);
+    if (HAS_ERROR(r)) { return; }
+    if (restoreState(r, in)) { return; }
+    // the state may only be partially restored, but all of it is owned by
+    // the runtime and the buffers do not need to be traversed to free them
+    bigtonFree(r);
+    bigtonInitFromImage(r, &settings, image);
+    r->error = BIGTONE_INT_INVALID_SNAPSHOT;
+}
+
+
+bool bigtonHibernate(bigton_runtime_state_t *r, bool compress) {
+    if (r->hibernated != NULL) { return true; }
+    // host values point into the buffers that are about to be freed
+    if (r->image == NULL || r->hostValues != NULL) { return false; }
+    bigton_hibernated_state_t *h = malloc(sizeof(bigton_hibernated_state_t));
+    h->usedMemory = r->b.totalSizeBytes;
+    h->data = bigtonSnapshot(r, &h->rawSize);
+    h->size = h->rawSize;
+    h->compressed = false;
+    if (compress) {
+        size_t compressedSize;
+        uint8_t *compressed = bigtonCompress(
+            h->data, h->rawSize, &compressedSize
+        );
+        if (compressedSize < h->rawSize) {
+            free(h->data);
+            h->data = compressed;
+            h->size = compressedSize;
+            h->compressed = true;
+        } else {
+            free(compressed);
+        }
+    }
+    // the image reference and all state not stored in buffers is kept, so
+    // that it can still be inspected without waking the runtime
+    bigton_program_image_t *image = r->image;
+    r->image = NULL;
+    bigtonFree(r);
+    r->image = image;
+    r->globalTypes = NULL;
+    r->globalValues = NULL;
+    r->constStrings = NULL;
+    r->logsCapacity = 0;
+    r->logsCount = 0;
+    r->logs = NULL;
+    r->traceCapacity = 0;
+    r->traceCount = 0;
+    r->trace = NULL;
+    r->stack = BIGTON_VALUE_STACK_INIT;
+    r->scopesCapacity = 0;
+    r->scopesCount = 0;
+    r->scopes = NULL;
+    r->locals = BIGTON_VALUE_STACK_INIT;
+    r->cow = (bigton_cow_map_t) {
+        .capacity = 0, .count = 0, .keys = NULL, .copies = NULL
+    };
+    r->b = (bigton_buff_owner_t) {
+        .first = NULL,
+        .last = NULL,
+        .totalSizeBytes = 0,
+        .peakSizeBytes = r->b.peakSizeBytes,
+        .limitBytes = r->settings.memoryUsageLimit,
+        .nextSeq = 0,
+        .sharedBelow = 0,
+        .cycleRoots = BIGTON_CYCLE_ROOTS_INIT,
+        .freeQueue = BIGTON_FREE_QUEUE_INIT
+    };
+    r->hibernated = h;
+    return true;
+}
+
+void bigtonWake(bigton_runtime_state_t *r) {
+    bigton_hibernated_state_t *h = r->hibernated;
+    if (h == NULL) { return; }
+    r->hibernated = NULL;
+    bigton_program_image_t *image = r->image;
+    bigton_cycle_collector_t cycles = r->cycles;
+    size_t peakSizeBytes = r->b.peakSizeBytes;
+    size_t snapshotSize;
+    uint8_t *snapshot = copyHibernated(h, &snapshotSize);
+    free(h->data);
+    free(h);
+    if (snapshot == NULL) {
+        bigtonInitFromImage(r, &r->settings, image);
+        r->error = BIGTONE_INT_INVALID_SNAPSHOT;
+    } else {
+        bigtonRestore(r, image, snapshot, snapshotSize);
+        free(snapshot);
+    }
+    // restoring acquired a new reference to the image
+    bigtonImageRcDecr(image);
+    r->cycles = cycles;
+    if (peakSizeBytes > r->b.peakSizeBytes) {
+        r->b.peakSizeBytes = peakSizeBytes;
+    }
+}
+
+
+// Init snapshots are only rarely looked up and inserted (when runtimes are
+// created), which is why a single lock is shared by all images.
+static pthread_mutex_t initSnapshotsLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Limits the number of settings an image keeps init snapshots for.
+#define MAX_INIT_SNAPSHOTS 8
+
+static bool settingsEqual(
+    const bigton_runtime_settings_t *a, const bigton_runtime_settings_t *b
+) {
+    return a->tickInstructionLimit == b->tickInstructionLimit
+        && a->memoryUsageLimit == b->memoryUsageLimit
+        && a->maxCallDepth == b->maxCallDepth
+        && a->maxTupleSize == b->maxTupleSize
+        && a->tickFreeBudget == b->tickFreeBudget;
+}
+
+// Must be called while holding 'initSnapshotsLock'.
+static bigton_init_snapshot_t *findInitSnapshot(
+    bigton_program_image_t *image, const bigton_runtime_settings_t *settings,
+    size_t *countOut
+) {
+    size_t count = 0;
+    bigton_init_snapshot_t *found = NULL;
+    for (
+        bigton_init_snapshot_t *i = image->initSnapshots;
+        i != NULL; i = i->next
+    ) {
+        if (found == NULL && settingsEqual(&i->settings, settings)) {
+            found = i;
+        }
+        count += 1;
+    }
+    *countOut = count;
+    return found;
+}
+
+static void insertInitSnapshot(
+    bigton_program_image_t *image, const bigton_runtime_settings_t *settings,
+    uint8_t *snapshot, size_t snapshotSize
+) {
+    pthread_mutex_lock(&initSnapshotsLock);
+    size_t count;
+    bool exists = findInitSnapshot(image, settings, &count) != NULL;
+    if (exists || count >= MAX_INIT_SNAPSHOTS) {
+        pthread_mutex_unlock(&initSnapshotsLock);
+        free(snapshot);
+        return;
+    }
+    bigton_init_snapshot_t *entry = malloc(sizeof(bigton_init_snapshot_t));
+    entry->settings = *settings;
+    entry->snapshotSize = snapshotSize;
+    entry->snapshot = snapshot;
+    entry->next = image->initSnapshots;
+    image->initSnapshots = entry;
+    pthread_mutex_unlock(&initSnapshotsLock);
+}
+
+// Prepares 'r', which needs to be in the state it was in after it was
+// initialized, using its image and settings.
+static void prepare(bigton_runtime_state_t *r) {
+    if (HAS_ERROR(r)) { return; }
+    pthread_mutex_lock(&initSnapshotsLock);
+    size_t count;
+    bigton_init_snapshot_t *cached
+        = findInitSnapshot(r->image, &r->settings, &count);
+    pthread_mutex_unlock(&initSnapshotsLock);
+    if (cached != NULL) {
+        // entries are never modified or removed while the image is alive
+        bigton_reader_t in = {
+            .p = cached->snapshot,
+            .end = cached->snapshot + cached->snapshotSize,
+            .failed = false
+        };
+        bigton_runtime_settings_t settings;
+        bool restored = readHeader(&in, r->image, &settings)
+            && restoreState(r, in);
+        if (restored) { return; }
+        bigtonReset(r);
+        r->error = BIGTONE_INT_INVALID_SNAPSHOT;
+        return;
+    }
+    bigtonStartTick(r);
+    bigton_exec_status_t status = bigtonExecBatch(r);
+    r->preparedStatus = status;
+    r->preparedCost = r->accCost;
+    r->accCost = 0;
+    // the state after an error is not worth sharing
+    if (status == BIGTONST_ERROR || HAS_ERROR(r)) { return; }
+    size_t snapshotSize;
+    uint8_t *snapshot = bigtonSnapshot(r, &snapshotSize);
+    insertInitSnapshot(r->image, &r->settings, snapshot, snapshotSize);
+}
+
+void bigtonInitPrepared(
+    bigton_runtime_state_t *r,
+    const bigton_runtime_settings_t *settings,
+    bigton_program_image_t *image
+) {
+    bigtonInitFromImage(r, settings, image);
+    prepare(r);
+}
+
+void bigtonResetPrepared(
+    bigton_runtime_state_t *r, const bigton_runtime_settings_t *settings
+) {
+    r->settings = *settings;
+    bigtonReset(r);
+    prepare(r);
+}
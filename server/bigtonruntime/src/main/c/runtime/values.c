@@ -3,6 +3,24 @@
 #include <bigton/ir.h>
 #include <bigton/runtime.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bigton_free_queue_t *freeQueueOf(const void *buffer) {
+    return &BIGTON_BUFF_HEADER(buffer)->owner->freeQueue;
+}
+
+static void enqueueFree(bigton_tagged_value_t value, const void *buffer) {
+    bigton_free_queue_t *q = freeQueueOf(buffer);
+    if (q->count >= q->capacity) {
+        q->capacity = q->capacity == 0 ? 64 : q->capacity * 2;
+        q->values = bigtonCheckAllocated(realloc(
+            q->values, sizeof(bigton_tagged_value_t) * q->capacity
+        ));
+    }
+    q->values[q->count] = value;
+    q->count += 1;
+}
 
 void bigtonValFree(bigton_tagged_value_t value) {
     switch (value.t) {
@@ -11,9 +29,36 @@ void bigtonValFree(bigton_tagged_value_t value) {
         case BIGTON_FLOAT:
             return;
         case BIGTON_STRING:
-            bigtonFreeNullableBuff(value.v.s->content);
+            if (value.v.s->viewed != NULL) {
+                bigtonValRcDecr(BIGTON_STRING_VALUE(value.v.s->viewed));
+            } else {
+                bigtonFreeNullableBuff(value.v.s->content);
+            }
             bigtonFreeBuff(value.v.s);
             break;
+        case BIGTON_TUPLE:
+            if (value.v.t->rc.rootIdx != 0) { bigtonCycleRootsRemove(value); }
+            enqueueFree(value, value.v.t);
+            break;
+        case BIGTON_OBJECT:
+            if (value.v.o->rc.rootIdx != 0) { bigtonCycleRootsRemove(value); }
+            enqueueFree(value, value.v.o);
+            break;
+        case BIGTON_ARRAY:
+            if (value.v.a->rc.rootIdx != 0) { bigtonCycleRootsRemove(value); }
+            enqueueFree(value, value.v.a);
+            break;
+        case BIGTON_MAP:
+            if (value.v.m->rc.rootIdx != 0) { bigtonCycleRootsRemove(value); }
+            enqueueFree(value, value.v.m);
+            break;
+    }
+}
+
+// Frees a tuple, object, array or map, returning the number of values it had
+// to release (see 'bigtonFreePending').
+static size_t freeQueued(bigton_tagged_value_t value) {
+    switch (value.t) {
         case BIGTON_TUPLE: {
             bigton_tuple_t *t = value.v.t;
             for (size_t i = 0; i < t->length; i += 1) {
@@ -21,10 +66,11 @@ void bigtonValFree(bigton_tagged_value_t value) {
                     .t = t->valueTypes[i], .v = t->values[i]
                 });
             }
-            bigtonFreeBuff(t->valueTypes);
-            bigtonFreeBuff(t->values);
+            size_t length = t->length;
+            bigtonFreeNullableBuff(t->valueTypes);
+            bigtonFreeNullableBuff(t->values);
             bigtonFreeBuff(t);
-            break;
+            return length;
         }
         case BIGTON_OBJECT: {
             bigton_object_t *o = value.v.o;
@@ -37,23 +83,335 @@ void bigtonValFree(bigton_tagged_value_t value) {
             bigtonFreeNullableBuff(o->memberTypes);
             bigtonFreeNullableBuff(o->memberValues);
             bigtonFreeBuff(o);
-            break;
+            return propCount;
         }
         case BIGTON_ARRAY: {
             bigton_array_t *a = value.v.a;
+            if (a->viewed != NULL) {
+                bigtonValRcDecr(BIGTON_ARRAY_VALUE(a->viewed));
+                bigtonFreeBuff(a);
+                return 1;
+            }
+            if (a->packedType != BIGTON_NULL) {
+                bigtonFreeNullableBuff(a->elementValues);
+                bigtonFreeBuff(a);
+                return 1;
+            }
             for (size_t i = 0; i < a->length; i += 1) {
                 bigtonValRcDecr((bigton_tagged_value_t) {
                     .t = a->elementTypes[i], .v = a->elementValues[i]
                 });
             }
+            size_t length = a->length;
             bigtonFreeNullableBuff(a->elementTypes);
             bigtonFreeNullableBuff(a->elementValues);
             bigtonFreeBuff(a);
-            break;
+            return length;
+        }
+        case BIGTON_MAP: {
+            bigton_map_t *m = value.v.m;
+            size_t slotCount = (size_t) m->capacity * 2;
+            for (size_t i = 0; i < slotCount; i += 1) {
+                bigtonValRcDecr((bigton_tagged_value_t) {
+                    .t = m->slotTypes[i], .v = m->slotValues[i]
+                });
+            }
+            bigtonFreeNullableBuff(m->slotHashes);
+            bigtonFreeNullableBuff(m->slotTypes);
+            bigtonFreeNullableBuff(m->slotValues);
+            bigtonFreeBuff(m);
+            return slotCount;
+        }
+        default:
+            return 0;
+    }
+}
+
+void bigtonFreePending(bigton_buff_owner_t *o, size_t budget) {
+    bigton_free_queue_t *q = &o->freeQueue;
+    size_t used = 0;
+    while (q->count > 0 && used < budget) {
+        q->count -= 1;
+        used += 1 + freeQueued(q->values[q->count]);
+    }
+}
+
+
+bool bigtonAllocValueBuffs(
+    bigton_runtime_state_t *r, size_t count, const size_t *sizes,
+    void **buffers
+) {
+    if (bigtonTryAllocBuffs(&r->b, count, sizes, buffers)) { return true; }
+    bigtonCollectCycles(r, BIGTON_MAX_CYCLE_CREDIT);
+    if (bigtonTryAllocBuffs(&r->b, count, sizes, buffers)) { return true; }
+    r->error = BIGTONE_EXCEEDED_MEMORY_LIMIT;
+    return false;
+}
+
+bool bigtonAllocValueArena(
+    bigton_runtime_state_t *r, size_t count, const size_t *sizes,
+    void **buffers
+) {
+    if (bigtonTryAllocArena(&r->b, count, sizes, buffers)) { return true; }
+    bigtonCollectCycles(r, BIGTON_MAX_CYCLE_CREDIT);
+    if (bigtonTryAllocArena(&r->b, count, sizes, buffers)) { return true; }
+    r->error = BIGTONE_EXCEEDED_MEMORY_LIMIT;
+    return false;
+}
+
+bool bigtonReallocValueBuff(
+    bigton_runtime_state_t *r, void **buffer, size_t numBytes
+) {
+    if (*buffer == NULL) {
+        return bigtonAllocValueBuffs(r, 1, &numBytes, buffer);
+    }
+    void *resized = bigtonTryReallocBuff(*buffer, numBytes);
+    if (resized == NULL) {
+        bigtonCollectCycles(r, BIGTON_MAX_CYCLE_CREDIT);
+        resized = bigtonTryReallocBuff(*buffer, numBytes);
+    }
+    if (resized == NULL) {
+        r->error = BIGTONE_EXCEEDED_MEMORY_LIMIT;
+        return false;
+    }
+    *buffer = resized;
+    return true;
+}
+
+bool bigtonArrayUnpack(bigton_array_t *a) {
+    if (a->packedType == BIGTON_NULL) { return true; }
+    size_t sizes[] = { sizeof(bigton_value_type_t) * a->capacity };
+    void *buffers[1];
+    bool allocated = bigtonTryAllocBuffs(
+        BIGTON_BUFF_HEADER(a)->owner, 1, sizes, buffers
+    );
+    if (!allocated) { return false; }
+    bigton_value_type_t *elementTypes = buffers[0];
+    for (size_t i = 0; i < a->length; i += 1) {
+        elementTypes[i] = a->packedType;
+    }
+    a->elementTypes = elementTypes;
+    a->packedType = BIGTON_NULL;
+    return true;
+}
+
+void bigtonArrayPack(bigton_array_t *a) {
+    if (a->packedType != BIGTON_NULL || a->length == 0) { return; }
+    bigton_value_type_t t = a->elementTypes[0];
+    if (t != BIGTON_INT && t != BIGTON_FLOAT) { return; }
+    for (size_t i = 1; i < a->length; i += 1) {
+        if (a->elementTypes[i] != t) { return; }
+    }
+    bigtonFreeBuff(a->elementTypes);
+    a->elementTypes = NULL;
+    a->packedType = t;
+}
+
+#define MIN_ARRAY_CAPACITY 4
+
+bool bigtonArrayReserve(
+    bigton_runtime_state_t *r, bigton_array_t *a, size_t minCapacity
+) {
+    if (minCapacity <= a->capacity) { return true; }
+    if (minCapacity > UINT32_MAX) {
+        r->error = BIGTONE_EXCEEDED_MEMORY_LIMIT;
+        return false;
+    }
+    size_t capacity = (size_t) a->capacity * 2;
+    if (capacity < MIN_ARRAY_CAPACITY) { capacity = MIN_ARRAY_CAPACITY; }
+    if (capacity < minCapacity) { capacity = minCapacity; }
+    if (capacity > UINT32_MAX) { capacity = UINT32_MAX; }
+    bool isPacked = a->packedType != BIGTON_NULL;
+    size_t sizes[] = {
+        isPacked ? 0 : sizeof(bigton_value_type_t) * capacity,
+        sizeof(bigton_value_t) * capacity
+    };
+    void *buffers[2];
+    if (!bigtonAllocValueBuffs(r, 2, sizes, buffers)) { return false; }
+    bigton_value_type_t *elementTypes = buffers[0];
+    bigton_value_t *elementValues = buffers[1];
+    if (a->length > 0) {
+        if (!isPacked) {
+            memcpy(
+                elementTypes, a->elementTypes,
+                sizeof(bigton_value_type_t) * a->length
+            );
+        }
+        memcpy(
+            elementValues, a->elementValues,
+            sizeof(bigton_value_t) * a->length
+        );
+    }
+    bigtonFreeNullableBuff(a->elementTypes);
+    bigtonFreeNullableBuff(a->elementValues);
+    a->elementTypes = elementTypes;
+    a->elementValues = elementValues;
+    a->capacity = (uint32_t) capacity;
+    return true;
+}
+
+bool bigtonArrayInsert(
+    bigton_runtime_state_t *r, bigton_array_t *a, size_t i,
+    bigton_tagged_value_t v
+) {
+    if (!bigtonArrayReserve(r, a, (size_t) a->length + 1)) { return false; }
+    bool startsPacked = a->length == 0
+        && (v.t == BIGTON_INT || v.t == BIGTON_FLOAT);
+    if (startsPacked && a->packedType == BIGTON_NULL) {
+        bigtonFreeNullableBuff(a->elementTypes);
+        a->elementTypes = NULL;
+    }
+    if (startsPacked) { a->packedType = v.t; }
+    if (a->packedType != BIGTON_NULL && v.t != a->packedType) {
+        if (!bigtonArrayUnpack(a)) {
+            r->error = BIGTONE_EXCEEDED_MEMORY_LIMIT;
+            return false;
+        }
+    }
+    bool isPacked = a->packedType != BIGTON_NULL;
+    size_t numShifted = a->length - i;
+    if (numShifted > 0) {
+        if (!isPacked) {
+            memmove(
+                a->elementTypes + i + 1, a->elementTypes + i,
+                sizeof(bigton_value_type_t) * numShifted
+            );
+        }
+        memmove(
+            a->elementValues + i + 1, a->elementValues + i,
+            sizeof(bigton_value_t) * numShifted
+        );
+    }
+    if (!isPacked) { a->elementTypes[i] = v.t; }
+    a->elementValues[i] = v.v;
+    a->length += 1;
+    return true;
+}
+
+bigton_tagged_value_t bigtonArrayRemove(bigton_array_t *a, size_t i) {
+    bigton_tagged_value_t removed = (bigton_tagged_value_t) {
+        .t = bigtonArrayTypeAt(a, i),
+        .v = a->elementValues[i]
+    };
+    size_t numShifted = a->length - i - 1;
+    if (numShifted > 0) {
+        if (a->packedType == BIGTON_NULL) {
+            memmove(
+                a->elementTypes + i, a->elementTypes + i + 1,
+                sizeof(bigton_value_type_t) * numShifted
+            );
         }
+        memmove(
+            a->elementValues + i, a->elementValues + i + 1,
+            sizeof(bigton_value_t) * numShifted
+        );
+    }
+    a->length -= 1;
+    return removed;
+}
+
+// Slices shorter than this are copied instead, since a view keeps all of
+// the sliced value alive.
+#define MIN_VIEW_LENGTH 16
+
+static bigton_array_t *copyArraySlice(
+    bigton_runtime_state_t *r, const bigton_array_t *src, size_t start,
+    size_t length
+) {
+    bool isPacked = src->packedType != BIGTON_NULL;
+    size_t sizes[] = {
+        isPacked ? 0 : sizeof(bigton_value_type_t) * length,
+        sizeof(bigton_value_t) * length,
+        sizeof(bigton_array_t)
+    };
+    void *buffers[3];
+    if (!bigtonAllocValueBuffs(r, 3, sizes, buffers)) { return NULL; }
+    bigton_value_type_t *elementTypes = buffers[0];
+    bigton_value_t *elementValues = buffers[1];
+    if (isPacked && length > 0) {
+        memcpy(
+            elementValues, src->elementValues + start,
+            sizeof(bigton_value_t) * length
+        );
     }
+    for (size_t i = 0; i < length && !isPacked; i += 1) {
+        elementTypes[i] = src->elementTypes[start + i];
+        elementValues[i] = src->elementValues[start + i];
+        bigtonValRcIncr((bigton_tagged_value_t) {
+            .t = elementTypes[i], .v = elementValues[i]
+        });
+    }
+    bigton_array_t *a = buffers[2];
+    a->rc = BIGTON_RC_INIT;
+    a->hash = bigtonNextValueHash(r);
+    a->capacity = (uint32_t) length;
+    a->length = (uint32_t) length;
+    a->packedType = src->packedType;
+    a->elementTypes = elementTypes;
+    a->elementValues = elementValues;
+    a->viewed = NULL;
+    return a;
 }
 
+bigton_array_t *bigtonArraySlice(
+    bigton_runtime_state_t *r, bigton_array_t *a, size_t start, size_t end
+) {
+    bigton_array_t *src = bigtonArrayRead(r, a);
+    size_t length = end - start;
+    if (length < MIN_VIEW_LENGTH) {
+        return copyArraySlice(r, src, start, length);
+    }
+    // shared arrays are never modified and can be viewed directly, while the
+    // elements of other arrays are first moved into a new array that is then
+    // viewed by both the sliced array and the slice
+    bool movesElements = src->viewed == NULL && !bigtonBuffIsShared(src);
+    size_t sizes[] = { sizeof(bigton_array_t), sizeof(bigton_array_t) };
+    void *buffers[2];
+    if (!bigtonAllocValueBuffs(r, movesElements ? 2 : 1, sizes, buffers)) {
+        return NULL;
+    }
+    bigton_array_t *viewed = src->viewed != NULL ? src->viewed : src;
+    if (movesElements) {
+        viewed = buffers[1];
+        *viewed = *src;
+        viewed->rc = BIGTON_RC_INIT;
+        src->capacity = src->length;
+        src->viewed = viewed;
+    }
+    bigton_array_t *view = buffers[0];
+    view->rc = BIGTON_RC_INIT;
+    view->hash = bigtonNextValueHash(r);
+    view->capacity = (uint32_t) length;
+    view->length = (uint32_t) length;
+    view->packedType = src->packedType;
+    view->elementTypes = src->packedType != BIGTON_NULL
+        ? NULL : src->elementTypes + start;
+    view->elementValues = src->elementValues + start;
+    view->viewed = viewed;
+    bigtonValRcIncr(BIGTON_ARRAY_VALUE(viewed));
+    return view;
+}
+
+static bigton_string_t *initString(
+    void **buffers, uint64_t length, const bigton_char_t *content
+) {
+    bigton_char_t *buffer = (bigton_char_t *) buffers[0];
+    if (length > 0) {
+        memcpy(buffer, content, sizeof(bigton_char_t) * length);
+    }
+    bigton_string_t *str = (bigton_string_t *) buffers[1];
+    str->rc = BIGTON_RC_INIT;
+    str->length = length;
+    str->usedLength = length;
+    str->content = buffer;
+    str->viewed = NULL;
+    str->hash = 0;
+    return str;
+}
+
+#define STRING_BUFF_SIZES(length) { \
+    sizeof(bigton_char_t) * (length), sizeof(bigton_string_t) \
+}
 
 bigton_string_t *bigtonAllocConstString(
     bigton_runtime_state_t *r, bigton_str_id_t id
@@ -70,22 +428,151 @@ bigton_string_t *bigtonAllocConstString(
         r->error = BIGTONE_INT_INVALID_CONST_STRING;
         return NULL;
     }
-    return bigtonAllocString(
-        &r->b, cstr.charLength, p->constStringChars + cstr.firstOffset
+    size_t sizes[] = STRING_BUFF_SIZES(cstr.charLength);
+    void *buffers[2];
+    if (!bigtonAllocValueBuffs(r, 2, sizes, buffers)) { return NULL; }
+    return initString(
+        buffers, cstr.charLength, p->constStringChars + cstr.firstOffset
     );
 }
 
+bigton_string_t *bigtonLoadConstString(
+    bigton_runtime_state_t *r, bigton_str_id_t id
+) {
+    if (id >= r->program.numConstStrings) {
+        r->error = BIGTONE_INT_INVALID_CONST_STRING;
+        return NULL;
+    }
+    bigton_string_t *s = r->constStrings[id];
+    if (s == NULL) {
+        s = bigtonAllocConstString(r, id);
+        if (s == NULL) { return NULL; }
+        r->constStrings[id] = s;
+    }
+    bigtonValRcIncr(BIGTON_STRING_VALUE(s));
+    return s;
+}
+
 bigton_string_t *bigtonAllocString(
     bigton_buff_owner_t *o, uint64_t length, const bigton_char_t *content
 ) {
-    size_t lengthBytes = sizeof(bigton_char_t) * length;
-    bigton_char_t *buffer
-        = (bigton_char_t *) bigtonAllocNullableBuff(o, lengthBytes);
-    memcpy(buffer, content, lengthBytes);
-    bigton_string_t *str
-        = (bigton_string_t *) bigtonAllocBuff(o, sizeof(bigton_string_t));
-    str->rc = BIGTON_RC_INIT;
-    str->length = length;
-    str->content = buffer;
-    return str;
-}
\ No newline at end of file
+    size_t sizes[] = STRING_BUFF_SIZES(length);
+    void *buffers[2];
+    if (!bigtonTryAllocBuffs(o, 2, sizes, buffers)) { return NULL; }
+    return initString(buffers, length, content);
+}
+
+bigton_string_t *bigtonAllocValueString(
+    bigton_runtime_state_t *r, uint64_t length, const bigton_char_t *content
+) {
+    size_t sizes[] = STRING_BUFF_SIZES(length);
+    void *buffers[2];
+    if (!bigtonAllocValueBuffs(r, 2, sizes, buffers)) { return NULL; }
+    return initString(buffers, length, content);
+}
+
+bigton_string_t *bigtonStringSlice(
+    bigton_runtime_state_t *r, bigton_string_t *s, size_t start, size_t end
+) {
+    size_t length = end - start;
+    if (length < MIN_VIEW_LENGTH) {
+        return bigtonAllocValueString(r, length, s->content + start);
+    }
+    size_t sizes[] = { sizeof(bigton_string_t) };
+    void *buffers[1];
+    if (!bigtonAllocValueBuffs(r, 1, sizes, buffers)) { return NULL; }
+    bigton_string_t *view = buffers[0];
+    view->rc = BIGTON_RC_INIT;
+    view->length = (uint32_t) length;
+    view->usedLength = (uint32_t) length;
+    view->content = s->content + start;
+    view->viewed = s->viewed != NULL ? s->viewed : s;
+    view->hash = 0;
+    bigtonValRcIncr(BIGTON_STRING_VALUE(view->viewed));
+    return view;
+}
+
+#define MIN_STRING_CAPACITY 16
+
+// Returns the string owning the buffer the chars of 'b' can be appended to
+// in place of copying 'a', or NULL if there is none.
+static bigton_string_t *appendableBufferOf(
+    const bigton_string_t *a, const bigton_string_t *b
+) {
+    bigton_string_t *buffered = a->viewed != NULL
+        ? a->viewed : (bigton_string_t *) a;
+    if (buffered->content == NULL || bigtonBuffIsShared(buffered)) {
+        return NULL;
+    }
+    // all strings using the buffer end at or before its used length, meaning
+    // that the chars after it can be written to
+    size_t end = (size_t) (a->content - buffered->content) + a->length;
+    size_t capacity = BIGTON_BUFF_HEADER(buffered->content)->sizeBytes
+        / sizeof(bigton_char_t);
+    bool canAppend = end == buffered->usedLength
+        && end + b->length <= capacity;
+    return canAppend ? buffered : NULL;
+}
+
+static bigton_string_t *appendToBuffer(
+    bigton_runtime_state_t *r, bigton_string_t *buffered,
+    const bigton_string_t *a, const bigton_string_t *b
+) {
+    size_t sizes[] = { sizeof(bigton_string_t) };
+    void *buffers[1];
+    if (!bigtonAllocValueBuffs(r, 1, sizes, buffers)) { return NULL; }
+    bigton_char_t *content = (bigton_char_t *) buffered->content;
+    memcpy(
+        content + buffered->usedLength, b->content,
+        sizeof(bigton_char_t) * b->length
+    );
+    buffered->usedLength += b->length;
+    bigton_string_t *view = buffers[0];
+    view->rc = BIGTON_RC_INIT;
+    view->length = a->length + b->length;
+    view->usedLength = view->length;
+    view->content = a->content;
+    view->viewed = buffered;
+    view->hash = 0;
+    bigtonValRcIncr(BIGTON_STRING_VALUE(buffered));
+    return view;
+}
+
+bigton_string_t *bigtonStringConcat(
+    bigton_runtime_state_t *r, bigton_string_t *a, bigton_string_t *b
+) {
+    size_t length = (size_t) a->length + b->length;
+    if (length > UINT32_MAX) {
+        r->error = BIGTONE_EXCEEDED_MEMORY_LIMIT;
+        return NULL;
+    }
+    // strings are never modified, so an empty operand can simply be dropped
+    bigton_string_t *other = a->length == 0 ? b : b->length == 0 ? a : NULL;
+    if (other != NULL) {
+        bigtonValRcIncr(BIGTON_STRING_VALUE(other));
+        return other;
+    }
+    bigton_string_t *buffered = appendableBufferOf(a, b);
+    if (buffered != NULL) { return appendToBuffer(r, buffered, a, b); }
+    size_t capacity = length * 2;
+    if (capacity < MIN_STRING_CAPACITY) { capacity = MIN_STRING_CAPACITY; }
+    if (capacity > UINT32_MAX) { capacity = UINT32_MAX; }
+    size_t sizes[] = {
+        sizeof(bigton_char_t) * capacity, sizeof(bigton_string_t)
+    };
+    void *buffers[2];
+    if (!bigtonAllocValueBuffs(r, 2, sizes, buffers)) { return NULL; }
+    bigton_char_t *content = buffers[0];
+    memcpy(content, a->content, sizeof(bigton_char_t) * a->length);
+    memcpy(
+        content + a->length, b->content, sizeof(bigton_char_t) * b->length
+    );
+    bigton_string_t *s = buffers[1];
+    s->rc = BIGTON_RC_INIT;
+    s->length = (uint32_t) length;
+    s->usedLength = (uint32_t) length;
+    s->content = content;
+    s->viewed = NULL;
+    s->hash = 0;
+    return s;
+}
@@ -0,0 +1,26 @@
+#ifndef BIGTON_COMPRESS_H
+#define BIGTON_COMPRESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// A minimal LZ77 compressor used for hibernated runtimes (see
+// 'bigtonHibernate'). Compressed data is a sequence of blocks, each
+// consisting of a varint literal length, the literal bytes and (unless the
+// block is the last one) a varint match length (minus the minimum length)
+// and a varint match offset. The size of the uncompressed data is not
+// included and needs to be stored separately.
+// Favors speed over ratio - snapshots mostly consist of small varints and
+// repeated value headers, which even a simple greedy matcher handles well.
+
+// Returns a buffer allocated using 'malloc', which the caller is responsible
+// for freeing.
+uint8_t *bigtonCompress(const uint8_t *data, size_t size, size_t *sizeOut);
+
+// Returns a buffer of 'rawSize' bytes allocated using 'malloc', which the
+// caller is responsible for freeing, or NULL if the data is invalid.
+uint8_t *bigtonDecompress(
+    const uint8_t *compressed, size_t compressedSize, size_t rawSize
+);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef BIGTON_DISPATCH_H
+#define BIGTON_DISPATCH_H
+
+#include <bigton/runtime.h>
+
+// Grouped builtin dispatch allows the host to service all runtimes awaiting
+// the same builtin function at once after a call to 'bigtonExecMany' or
+// 'bigtonSchedulerRun', instead of popping arguments and pushing results for
+// each of the runtimes individually.
+//
+// 1. 'bigtonGroupAwaitingBuiltins' sorts the indices of all runtimes with
+//    status 'BIGTONST_EXEC_BUILTIN_FUN' by builtin function.
+// 2. 'bigtonGatherBuiltinArgs' copies the arguments of the runtimes in a group
+//    into columnar buffers - argument 'a' of runtime 'i' of the group is
+//    written to index '(a * stride) + i'. The first argument is the one
+//    deepest in the stack. Only null, integer and float arguments have their
+//    payload copied, for all other types only the type is written. Runtimes
+//    with fewer than 'argc' values on their stack (meaning that 'argc' does
+//    not match the builtin function) get 'BIGTON_DISPATCH_SKIP' for the types
+//    of all of their arguments.
+// 3. 'bigtonScatterBuiltinResults' pops the arguments of each runtime and
+//    pushes the given result. Runtimes for which a result of any type other
+//    than null, integer or float is given (such as 'BIGTON_DISPATCH_SKIP'),
+//    or that have fewer than 'argc' values on their stack, are left
+//    untouched, allowing the host to service them individually.
+
+typedef struct BigtonBuiltinGroup {
+    bigton_slot_t builtinId;
+    uint32_t start;
+    uint32_t count;
+} bigton_builtin_group_t;
+
+#define BIGTON_DISPATCH_SKIP 0xFF
+
+size_t bigtonGroupAwaitingBuiltins(
+    const bigton_exec_result_t *results, size_t count,
+    uint32_t *order, bigton_builtin_group_t *groups
+);
+void bigtonGatherBuiltinArgs(
+    bigton_runtime_state_t *const *runtimes, size_t count, uint32_t argc,
+    size_t stride, uint8_t *argTypes, bigton_value_t *argValues
+);
+void bigtonScatterBuiltinResults(
+    bigton_runtime_state_t *const *runtimes, size_t count, uint32_t argc,
+    const uint8_t *resultTypes, const bigton_value_t *resultValues
+);
+
+#endif
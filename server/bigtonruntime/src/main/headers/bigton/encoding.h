@@ -0,0 +1,124 @@
+#ifndef BIGTON_ENCODING_H
+#define BIGTON_ENCODING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Helpers for reading and writing the variable-length encodings used by
+// version 2 programs and by runtime snapshots. All varints are unsigned
+// LEB128, signed values are zigzag-encoded before being written as varints
+// and fixed-size values are little endian.
+
+
+typedef struct BigtonReader {
+    const uint8_t *p;
+    const uint8_t *end;
+    bool failed;
+} bigton_reader_t;
+
+static uint64_t bigtonReadVarint(bigton_reader_t *r) {
+    uint64_t value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+        if (r->p >= r->end) { break; }
+        uint8_t b = *r->p;
+        r->p += 1;
+        value |= ((uint64_t) (b & 0x7F)) << shift;
+        if ((b & 0x80) == 0) { return value; }
+    }
+    r->failed = true;
+    return 0;
+}
+
+static uint32_t bigtonReadVarint32(bigton_reader_t *r) {
+    uint64_t value = bigtonReadVarint(r);
+    if (value > UINT32_MAX) { r->failed = true; }
+    return (uint32_t) value;
+}
+
+static int64_t bigtonReadZigzag(bigton_reader_t *r) {
+    uint64_t value = bigtonReadVarint(r);
+    return (int64_t) (value >> 1) ^ -((int64_t) (value & 1));
+}
+
+static uint64_t bigtonReadFixed64(bigton_reader_t *r) {
+    if (r->end - r->p < 8) {
+        r->failed = true;
+        return 0;
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < 8; i += 1) {
+        value |= ((uint64_t) r->p[i]) << (i * 8);
+    }
+    r->p += 8;
+    return value;
+}
+
+static uint8_t bigtonReadByte(bigton_reader_t *r) {
+    if (r->p >= r->end) {
+        r->failed = true;
+        return 0;
+    }
+    uint8_t b = *r->p;
+    r->p += 1;
+    return b;
+}
+
+
+typedef struct BigtonWriter {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} bigton_writer_t;
+
+#define BIGTON_WRITER_INIT ((bigton_writer_t) { \
+    .data = NULL, .size = 0, .capacity = 0 \
+})
+
+static void bigtonWriterReserve(bigton_writer_t *w, size_t numBytes) {
+    if (w->size + numBytes <= w->capacity) { return; }
+    size_t newCapacity = w->capacity == 0 ? 256 : w->capacity * 2;
+    while (newCapacity < w->size + numBytes) { newCapacity *= 2; }
+    w->data = realloc(w->data, newCapacity);
+    w->capacity = newCapacity;
+}
+
+static void bigtonWriteByte(bigton_writer_t *w, uint8_t b) {
+    bigtonWriterReserve(w, 1);
+    w->data[w->size] = b;
+    w->size += 1;
+}
+
+static void bigtonWriteBytes(
+    bigton_writer_t *w, const void *bytes, size_t numBytes
+) {
+    if (numBytes == 0) { return; }
+    bigtonWriterReserve(w, numBytes);
+    memcpy(w->data + w->size, bytes, numBytes);
+    w->size += numBytes;
+}
+
+static void bigtonWriteVarint(bigton_writer_t *w, uint64_t value) {
+    bigtonWriterReserve(w, 10);
+    do {
+        uint8_t b = value & 0x7F;
+        value >>= 7;
+        w->data[w->size] = value == 0 ? b : (b | 0x80);
+        w->size += 1;
+    } while (value != 0);
+}
+
+static void bigtonWriteZigzag(bigton_writer_t *w, int64_t value) {
+    bigtonWriteVarint(w, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+}
+
+static void bigtonWriteFixed64(bigton_writer_t *w, uint64_t value) {
+    bigtonWriterReserve(w, 8);
+    for (size_t i = 0; i < 8; i += 1) {
+        w->data[w->size + i] = (uint8_t) (value >> (i * 8));
+    }
+    w->size += 8;
+}
+
+#endif
@@ -18,6 +18,10 @@ typedef enum BigtonError {
     BIGTONE_EXCEEDED_MAXIMUM_CALL_DEPTH,
     BIGTONE_TUPLE_TOO_BIG,
     BIGTONE_EXCEEDED_MEMORY_LIMIT,
+    BIGTONE_OPERAND_NOT_MAP,
+    // tuple arithmetic (see 'BIGTONIR_TUPLE_ADD') on two tuples of
+    // different lengths
+    BIGTONE_TUPLE_LENGTH_MISMATCH,
     
     BIGTONE_INT_INCOMPLETE_PROGRAM,
     BIGTONE_INT_INVALID_CONST_STRING,
@@ -30,7 +34,10 @@ typedef enum BigtonError {
     BIGTONE_INT_SHAPE_PROP_IDX_OOB,
     BIGTONE_INT_SHAPE_ID_OOB,
     BIGTONE_INT_BUILTIN_FUN_REF_INVALID,
-    BIGTONE_INT_FUN_REF_INVALID
+    BIGTONE_INT_FUN_REF_INVALID,
+    BIGTONE_INT_MISALIGNED_PROGRAM,
+    BIGTONE_INT_CORRUPTED_PROGRAM,
+    BIGTONE_INT_INVALID_SNAPSHOT
 } bigton_error_t;
 
 #endif
\ No newline at end of file
@@ -155,10 +155,132 @@ enum BigtonInstrType {
     BIGTONIR_CALL_BUILTIN,
     // arg:
     // stack: return_value -> <return_value>
-    BIGTONIR_RETURN
+    BIGTONIR_RETURN,
+    
+    // Builtin array functions executed by the interpreter itself
+    // arg:
+    // stack: array, value -> null
+    BIGTONIR_ARRAY_PUSH,
+    // arg:
+    // stack: array -> <last_element_value>
+    BIGTONIR_ARRAY_POP,
+    // arg:
+    // stack: array -> <length>
+    BIGTONIR_ARRAY_LENGTH,
+    // arg:
+    // stack: array, index, value -> null
+    BIGTONIR_ARRAY_INSERT,
+    // arg:
+    // stack: array, index -> <element_value>
+    BIGTONIR_ARRAY_REMOVE,
+    
+    // Builtin numeric array functions, executed using the kernels in
+    // 'bigton/kernels.h' (arrays need to be empty or packed)
+    // arg:
+    // stack: array -> <sum_of_elements>
+    BIGTONIR_ARRAY_SUM,
+    // arg:
+    // stack: array -> <smallest_element>
+    BIGTONIR_ARRAY_MIN,
+    // arg:
+    // stack: array -> <largest_element>
+    BIGTONIR_ARRAY_MAX,
+    // arg:
+    // stack: array -> <index_of_first_smallest_element>
+    BIGTONIR_ARRAY_ARGMIN,
+    // arg:
+    // stack: array, factor -> <array_of_products>
+    BIGTONIR_ARRAY_SCALE,
+    // arg:
+    // stack: array, array -> <array_of_sums>
+    BIGTONIR_ARRAY_ADD,
+    // arg:
+    // stack: array, array -> <dot_product>
+    BIGTONIR_ARRAY_DOT,
+    // arg:
+    // stack: array -> null
+    // (sorts the array in place)
+    BIGTONIR_ARRAY_SORT,
+    // arg:
+    // stack: array, value -> <index>
+    // (index of the first element equal to the value in the sorted array, or
+    // '-insertionIndex - 1' if there is none)
+    BIGTONIR_ARRAY_BINARY_SEARCH,
+    // arg:
+    // stack: array, value -> <index>
+    // (index of the first element equal to the value, or -1 if there is none)
+    BIGTONIR_ARRAY_INDEX_OF,
+    // arg:
+    // stack: array, value -> <contained>
+    BIGTONIR_ARRAY_CONTAINS,
+
+    // Builtin map functions (see 'bigton_map_t', and 'BIGTONIR_MAP_SIZE' and
+    // 'BIGTONIR_MAP_REMOVE' below)
+    // arg:
+    // stack: -> <map>
+    BIGTONIR_MAP_CREATE,
+    // arg:
+    // stack: map, key -> <value>
+    // (null if the map does not contain the key)
+    BIGTONIR_MAP_GET,
+    // arg:
+    // stack: map, key, value -> null
+    BIGTONIR_MAP_SET,
+    // arg:
+    // stack: map, key -> <contained>
+    BIGTONIR_MAP_HAS,
+    // arg:
+    // stack: map -> <array_of_keys>
+    // (in the order the map iterates them in)
+    BIGTONIR_MAP_KEYS,
+
+    // Builtin tuple functions, applying 'BIGTONIR_ADD' to 'BIGTONIR_DIVIDE'
+    // to each pair of members of two tuples of the same length, which both
+    // need to be numbers of the same type. Either operand may instead be a
+    // single number, which is then paired with each member of the other.
+    // Tuples of different lengths cause 'BIGTONE_TUPLE_LENGTH_MISMATCH'.
+    // arg:
+    // stack: a, b -> <tuple_of_sums>
+    BIGTONIR_TUPLE_ADD,
+    // arg:
+    // stack: a, b -> <tuple_of_differences>
+    BIGTONIR_TUPLE_SUBTRACT,
+    // arg:
+    // stack: a, b -> <tuple_of_products>
+    BIGTONIR_TUPLE_MULTIPLY,
+    // arg:
+    // stack: a, b -> <tuple_of_quotients>
+    BIGTONIR_TUPLE_DIVIDE,
+
+    // Loops over the integers from 'start' (inclusive) to 'end' (exclusive),
+    // evaluating both only once. The bound and the induction variable are
+    // kept as the first two locals of the loop scope, the induction variable
+    // being the second one. 'BIGTONIR_CONTINUE' and 'BIGTONIR_BREAK' behave
+    // the same as in a 'BIGTONIR_LOOP'.
+    // arg: bigton_instr_idx_t rangeLoopLength
+    // stack: start, end ->
+    BIGTONIR_FOR_RANGE,
+
+    // Builtin map functions (continued)
+    // arg:
+    // stack: map -> <size>
+    BIGTONIR_MAP_SIZE,
+    // arg:
+    // stack: map, key -> <removed_value>
+    // (null if the map does not contain the key)
+    BIGTONIR_MAP_REMOVE
 };
+
 typedef uint8_t bigton_instr_type_t; // enum BigtonInstrType
 
+// Number of locals 'BIGTONIR_FOR_RANGE' declares in the scope of the loop.
+#define BIGTON_RANGE_LOCALS 2
+// Cost charged for each check of the bound and for each increment of the
+// induction variable of a 'BIGTONIR_FOR_RANGE' loop, which is the cost of the
+// instructions doing the same in the equivalent 'BIGTONIR_LOOP'.
+#define BIGTON_RANGE_CHECK_COST 4
+#define BIGTON_RANGE_STEP_COST 4
+
 
 typedef uint32_t bigton_str_id_t;
 typedef uint16_t bigton_char_t;
@@ -204,6 +326,7 @@ typedef union BigtonInstrArg {
     bigton_if_args_t ifParams;
     bigton_instr_idx_t infLoopLength;
     bigton_instr_idx_t tickLoopLength;
+    bigton_instr_idx_t rangeLoopLength;
     bigton_slot_t called;
     bigton_slot_t calledBuiltin;
 } bigton_instr_args_t;
@@ -267,4 +390,48 @@ typedef struct BigtonProgram {
 // --- alignment = 1 ---
 // bigton_instr_type_t instrTypes[header.numInstrs];
 
+
+// VERSION 2 FILE FORMAT STRUCTURE:
+//
+// Version 2 programs are a compact encoding of the version 1 format above,
+// decoded into the version 1 format when loaded. All varints are unsigned
+// LEB128, signed values are zigzag-encoded before being written as varints.
+// There are no alignment requirements.
+//
+// --- header (16 bytes) ---
+// uint8_t magic[4] = "BGTN";
+// uint8_t version = 2;
+// uint8_t reserved[3] = { 0, 0, 0 };
+// uint64_t checksum; // little endian, 64-bit FNV-1a of all following bytes
+//
+// --- counts (varint each) ---
+// numInstrs, numStrings, numShapes, numFunctions, numBuiltinFunctions,
+// numGlobalVars, numShapeProps, numConstStringChars,
+// unknownStrId, globalStart, globalLength
+//
+// --- section offsets (varint each) ---
+// byte offset of each of the following sections, relative to the end of
+// the section offsets, in the order the sections are listed in
+//
+// --- sections ---
+// bigton_instr_type_t instrTypes[numInstrs]; // one byte each
+// instrArgs - for each instruction, depending on its type:
+//     no argument => nothing
+//     'bigton_int_t' => zigzag varint
+//     'bigton_float_t' => 8 bytes, little endian
+//     'bigton_if_args_t' => ifBodyLength varint, elseBodyLength varint
+//     any other argument => varint
+// constStrings - for each: charLength varint (offsets are implicit)
+// shapes - for each: propCount varint (offsets are implicit)
+// functions - for each: name, declSource.file, declSource.line,
+//     start, length varint
+// builtinFunctions - for each: name, cost varint
+// shapeProps - for each: name varint
+// constStringChars - for each: varint
+
+#define BIGTON_V2_MAGIC "BGTN"
+#define BIGTON_V2_VERSION 2
+#define BIGTON_V2_HEADER_SIZE 16
+#define BIGTON_V2_NUM_SECTIONS 8
+
 #endif
\ No newline at end of file
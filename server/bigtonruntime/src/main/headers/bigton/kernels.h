@@ -0,0 +1,74 @@
+
+#ifndef BIGTON_KERNELS_H
+#define BIGTON_KERNELS_H
+
+#include <bigton/runtime.h>
+
+// Bulk operations over the elements of packed arrays (see
+// 'bigtonArrayPack'), executed by the 'BIGTONIR_ARRAY_SUM' to
+// 'BIGTONIR_ARRAY_CONTAINS' instructions.
+// On x86-64 Linux each kernel is compiled for both the SSE2 baseline and for
+// AVX2, with the variant being selected when the library is loaded, while
+// other platforms only get the plain C version. All variants accumulate into
+// the same fixed number of lanes which are combined in a fixed order, meaning
+// that results (including the rounding of floats) do not depend on the
+// variant used. For the same reason float kernels only ever produce a single
+// kind of NaN.
+
+// Number of elements processed by a kernel for each unit of instruction cost
+// charged on top of the cost of the instruction itself.
+#define BIGTON_KERNEL_ELEMS_PER_COST 8
+
+// Integer kernels wrap around on overflow, just like integer arithmetic
+// instructions do. The kernels for minimums and maximums require 'n > 0'.
+// Float minimums and maximums are NaN if any of the elements is NaN.
+bigton_int_t bigtonKernelSumInt(const bigton_value_t *x, size_t n);
+bigton_float_t bigtonKernelSumFloat(const bigton_value_t *x, size_t n);
+bigton_int_t bigtonKernelMinInt(const bigton_value_t *x, size_t n);
+bigton_float_t bigtonKernelMinFloat(const bigton_value_t *x, size_t n);
+bigton_int_t bigtonKernelMaxInt(const bigton_value_t *x, size_t n);
+bigton_float_t bigtonKernelMaxFloat(const bigton_value_t *x, size_t n);
+// Returns the index of the first element equal to 'v', or 'n' if there is
+// none.
+size_t bigtonKernelFindInt(const bigton_value_t *x, size_t n, bigton_int_t v);
+size_t bigtonKernelFindFloat(
+    const bigton_value_t *x, size_t n, bigton_float_t v
+);
+// 'dest' may be the same as one of the operands.
+void bigtonKernelScaleInt(
+    bigton_value_t *dest, const bigton_value_t *x, size_t n, bigton_int_t f
+);
+void bigtonKernelScaleFloat(
+    bigton_value_t *dest, const bigton_value_t *x, size_t n, bigton_float_t f
+);
+void bigtonKernelAddInt(
+    bigton_value_t *dest, const bigton_value_t *x, const bigton_value_t *y,
+    size_t n
+);
+void bigtonKernelAddFloat(
+    bigton_value_t *dest, const bigton_value_t *x, const bigton_value_t *y,
+    size_t n
+);
+bigton_int_t bigtonKernelDotInt(
+    const bigton_value_t *x, const bigton_value_t *y, size_t n
+);
+bigton_float_t bigtonKernelDotFloat(
+    const bigton_value_t *x, const bigton_value_t *y, size_t n
+);
+// Sorts in ascending order, using 'scratch' (of 'n' values) as temporary
+// storage. Ints are radix sorted, floats are sorted stably (so '-0.0' and
+// '0.0' keep their order) with NaN being ordered after all other values.
+// Short arrays are insertion sorted without using 'scratch', which may then
+// be NULL (see 'SMALL_SORT_LENGTH' in kernels.c).
+void bigtonKernelSortInt(bigton_value_t *x, bigton_value_t *scratch, size_t n);
+void bigtonKernelSortFloat(
+    bigton_value_t *x, bigton_value_t *scratch, size_t n
+);
+
+// Executes one of the 'BIGTONIR_ARRAY_SUM' to 'BIGTONIR_ARRAY_CONTAINS'
+// instructions, charging the cost of processing the elements of its operands.
+// Except for the search instructions, the arrays must be packed arrays of the
+// same type or empty, otherwise 'BIGTONE_OPERANDS_NOT_NUMBERS' is set.
+void bigtonExecArrayKernel(bigton_runtime_state_t *r, bigton_instr_type_t t);
+
+#endif
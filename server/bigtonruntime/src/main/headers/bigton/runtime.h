@@ -8,6 +8,10 @@
 
 typedef struct BigtonParsedProgram {
     const uint8_t *rawProgramBuffer;
+    // version 1 program decoded from a version 2 program, owned by this
+    // parsed program (NULL for version 1 programs) and freed using
+    // 'bigtonFreeParsedProgram', which is required even if parsing failed
+    uint8_t *decodedProgramBuffer;
 
     bigton_str_id_t unknownStrId;
     
@@ -40,8 +44,37 @@ typedef struct BigtonRuntimeSettings {
     size_t memoryUsageLimit;
     uint32_t maxCallDepth;
     uint32_t maxTupleSize;
+    // budget for freeing values at the start of each tick (see
+    // 'bigtonFreePending'), with all values being freed regardless once the
+    // memory usage limit has been exceeded
+    size_t tickFreeBudget;
 } bigton_runtime_settings_t;
 
+// State of a runtime created from an image after executing the global
+// section up to its first yield, captured for one set of runtime settings.
+typedef struct BigtonInitSnapshot {
+    struct BigtonInitSnapshot *next;
+    bigton_runtime_settings_t settings;
+    size_t snapshotSize;
+    uint8_t *snapshot;
+} bigton_init_snapshot_t;
+
+// Parsed program shared read-only by any number of runtimes.
+// Images are reference counted, with each runtime created from an image
+// holding a reference to it until it is freed.
+typedef struct BigtonProgramImage {
+    _Atomic uint64_t rc;
+    uint64_t hash;
+    bool shared;
+    bool mapped;
+    size_t rawProgramSize;
+    uint8_t *rawProgram;
+    bigton_parsed_program_t program;
+    bigton_error_t error;
+    // init snapshots for different settings, see 'bigtonInitPrepared'
+    bigton_init_snapshot_t *initSnapshots;
+} bigton_program_image_t;
+
 typedef struct BigtonTraceCall {
     bigton_str_id_t name;
     bigton_source_t calledFrom;
@@ -53,7 +86,9 @@ typedef enum BigtonScopeType {
     BIGTONSC_FUNCTION,
     BIGTONSC_LOOP,
     BIGTONSC_TICK,
-    BIGTONSC_IF
+    BIGTONSC_IF,
+    // see 'BIGTONIR_FOR_RANGE'
+    BIGTONSC_RANGE
 } bigton_scope_type_t;
 
 typedef struct BigtonScope {
@@ -75,14 +110,106 @@ typedef struct BigtonValueStack {
     .capacity = 0, .count = 0, .types = NULL, .values = NULL \
 })
 
+// Buffers shared by runtimes created using 'bigtonFork'.
+// The shared buffers of a runtime stay owned by it until it is freed, at which
+// point they are moved to the shared heap, which is freed once the last
+// runtime referencing it has been freed.
+typedef struct BigtonSharedHeap {
+    _Atomic uint64_t rc;
+    bigton_buff_owner_t b;
+    // heap the values in this heap may reference (may be NULL)
+    struct BigtonSharedHeap *parent;
+} bigton_shared_heap_t;
+
+// Maps shared objects and arrays (see 'bigtonFork') to the copies a runtime
+// made of them once it first modified them. Keys are the shared values,
+// which are never replaced by their copies in the values referencing them.
+typedef struct BigtonCowMap {
+    size_t capacity;
+    size_t count;
+    const void **keys;
+    void **copies;
+} bigton_cow_map_t;
+
+// Value held by the host. Host values that belong to a runtime are linked
+// into a list owned by it, so that they can be updated when the values of
+// the runtime are relocated (see 'bigtonCompact').
+typedef struct BigtonHostValue {
+    bigton_tagged_value_t value;
+    // NULL if the value does not belong to a runtime (anymore)
+    struct BigtonRuntimeState *r;
+    struct BigtonHostValue *prev;
+    struct BigtonHostValue *next;
+} bigton_host_value_t;
+
+// Snapshot of a hibernated runtime (see 'bigtonHibernate').
+typedef struct BigtonHibernatedState {
+    size_t usedMemory;
+    size_t rawSize;
+    size_t size;
+    bool compressed;
+    uint8_t *data;
+} bigton_hibernated_state_t;
+
+typedef struct BigtonCycleStats {
+    uint64_t collections;
+    // collections that exceeded their budget and were undone
+    uint64_t abortedCollections;
+    // groups of values that were only referenced by reference cycles
+    uint64_t collectedCycles;
+    uint64_t collectedValues;
+    uint64_t totalPauseNanos;
+    uint64_t maxPauseNanos;
+} bigton_cycle_stats_t;
+
+// Limits the number of values a single collection may visit (see
+// 'bigtonCollectCyclesIfDue').
+#define BIGTON_CYCLE_CREDIT_PER_TICK 4096
+#define BIGTON_MAX_CYCLE_CREDIT (BIGTON_CYCLE_CREDIT_PER_TICK * 64)
+
+// State of the cycle collector of a runtime (see 'bigtonCollectCyclesIfDue').
+typedef struct BigtonCycleCollector {
+    // number of values the next collection may visit
+    size_t credit;
+    // credit required before the next collection is attempted
+    size_t requiredCredit;
+    bigton_cycle_stats_t stats;
+} bigton_cycle_collector_t;
+
+#define BIGTON_CYCLE_COLLECTOR_INIT ((bigton_cycle_collector_t) { \
+    .credit = 0, \
+    .requiredCredit = 0, \
+    .stats = (bigton_cycle_stats_t) { \
+        .collections = 0, \
+        .abortedCollections = 0, \
+        .collectedCycles = 0, \
+        .collectedValues = 0, \
+        .totalPauseNanos = 0, \
+        .maxPauseNanos = 0 \
+    } \
+})
+
+typedef enum BigtonExecStatus {
+    BIGTONST_CONTINUE,
+    BIGTONST_EXEC_BUILTIN_FUN,
+    BIGTONST_AWAIT_TICK,
+    BIGTONST_COMPLETE,
+    BIGTONST_ERROR
+} bigton_exec_status_t;
+
 typedef struct BigtonRuntimeState {
     bigton_parsed_program_t program;
+    bigton_program_image_t *image;
     bigton_runtime_settings_t settings;
 
     bigton_buff_owner_t b;
     
     bigton_value_type_t *globalTypes;
     bigton_value_t *globalValues;
+
+    // the string loaded for each constant string of the program (see
+    // 'bigtonLoadConstString'), or NULL if it has not been loaded yet
+    bigton_string_t **constStrings;
     
     size_t logsCapacity;
     size_t logsCount;
@@ -105,31 +232,221 @@ typedef struct BigtonRuntimeState {
     bigton_instr_idx_t currentInstr;
     size_t accCost;
     bigton_slot_t awaitingBuiltinFun;
+    // number of objects, arrays and maps created (see 'bigtonNextValueHash')
+    uint64_t createdValues;
+    
+    // status (and cost of the tick) to report by the next execution instead
+    // of executing, with 'BIGTONST_CONTINUE' indicating that there is none
+    // (used by runtimes created using 'bigtonInitPrepared')
+    bigton_exec_status_t preparedStatus;
+    size_t preparedCost;
+    
+    // heap shared with the runtime this runtime has been forked from
+    bigton_shared_heap_t *sharedHeap;
+    // heap the shared buffers of this runtime are moved to when it is freed
+    bigton_shared_heap_t *forkedHeap;
+    bigton_cow_map_t cow;
+    
+    // NULL unless the runtime is hibernated
+    bigton_hibernated_state_t *hibernated;
+    
+    bigton_host_value_t *hostValues;
+    
+    bigton_cycle_collector_t cycles;
 } bigton_runtime_state_t;
 
 
+bool bigtonIsProgramV2(const uint8_t *rawProgram, size_t rawProgramSize);
+uint8_t *bigtonDecodeProgramV2(
+    const uint8_t *rawProgram, size_t rawProgramSize,
+    size_t *decodedSize, bigton_error_t *e
+);
 void bigtonParseProgram(
     const uint8_t *rawProgram, size_t rawProgramSize,
     bigton_parsed_program_t *p, bigton_error_t *e
 );
+void bigtonFreeParsedProgram(bigton_parsed_program_t *p);
 void bigtonInit(
     bigton_runtime_state_t *r,
     const bigton_runtime_settings_t *settings,
     const bigton_parsed_program_t* p
 );
 void bigtonFree(bigton_runtime_state_t *r);
+// Returns the runtime to the state it was in after it was initialized, using
+// its current settings. All values of the runtime are freed, but the buffers
+// of its globals, constant strings, stacks, scopes, trace and logs (and
+// therefore their capacities) are kept for reuse. The loaded constant strings
+// are freed, meaning that they are loaded again after the reset.
+void bigtonReset(bigton_runtime_state_t *r);
+
+uint64_t bigtonHashProgram(const uint8_t *rawProgram, size_t rawProgramSize);
+bigton_program_image_t *bigtonImageCreate(
+    const uint8_t *rawProgram, size_t rawProgramSize
+);
+bigton_program_image_t *bigtonImageLoadShared(
+    const uint8_t *rawProgram, size_t rawProgramSize
+);
+// Maps the file at the given path, returning NULL if it could not be mapped.
+// Empty files set 'errno' to 'EINVAL', meaning that on POSIX systems 'errno'
+// describes every failure.
+bigton_program_image_t *bigtonImageLoadFile(const char *path);
+void bigtonImageRcIncr(bigton_program_image_t *image);
+void bigtonImageRcDecr(bigton_program_image_t *image);
+void bigtonInitFromImage(
+    bigton_runtime_state_t *r,
+    const bigton_runtime_settings_t *settings,
+    bigton_program_image_t *image
+);
 
 
 void bigtonDebugProgram(bigton_parsed_program_t *p);
 
-typedef enum BigtonExecStatus {
-    BIGTONST_CONTINUE,
-    BIGTONST_EXEC_BUILTIN_FUN,
-    BIGTONST_AWAIT_TICK,
-    BIGTONST_COMPLETE,
-    BIGTONST_ERROR
-} bigton_exec_status_t;
+// Links the host value to the given runtime (which may be NULL). Freeing or
+// resetting a runtime unlinks all of its host values, while runtimes with
+// linked host values can not be hibernated.
+void bigtonHostValueAttach(
+    bigton_runtime_state_t *r, bigton_host_value_t *value
+);
+void bigtonHostValueDetach(bigton_host_value_t *value);
+
+typedef struct BigtonCompactStats {
+    size_t movedBuffers;
+    size_t movedBytes;
+    size_t reclaimedBytes;
+    uint64_t elapsedNanos;
+} bigton_compact_stats_t;
+
+// Relocates all values reachable by the runtime (from its globals, stacks,
+// logs, loaded constant strings and host values) into a single contiguous
+// arena, in traversal order, and updates all references to them. The unused
+// capacity of arrays is released in the process ('reclaimedBytes'). Values
+// shared with other runtimes (see 'bigtonFork') are not moved.
+// May only be called while the runtime is not being executed, meaning
+// between two calls to 'bigtonExecBatch'.
+bigton_compact_stats_t bigtonCompact(bigton_runtime_state_t *r);
+
+// Frees tuples, objects, arrays and maps only kept alive by reference cycles,
+// starting from at most 'budget' possible cycle roots and visiting at most
+// 'budget' values (use SIZE_MAX for no limit). If more values would need to be
+// visited, the collection is undone. Returns false unless all possible cycle
+// roots have been processed.
+// Besides between two calls to 'bigtonExecBatch', this is also called while an
+// instruction is being executed when the memory limit is exceeded (see
+// 'bigtonAllocValueBuffs'). Instructions must therefore hold a reference to
+// every value they still use whenever they allocate, and may not allocate
+// while a value they created is only partially initialized and already
+// referenced by other values.
+bool bigtonCollectCycles(bigton_runtime_state_t *r, size_t budget);
+// Collects cycles if the runtime uses at least half of its memory limit or
+// has accumulated many possible cycle roots. Each call adds to a budget
+// that limits the number of values visited, so that the cost of collecting
+// is bounded for each tick. Called at the start of each tick.
+void bigtonCollectCyclesIfDue(bigton_runtime_state_t *r);
+
+// Initializes 'dest' as a copy of 'src' that shares all values with 'src'.
+// Objects and arrays are only copied once either runtime first modifies them,
+// meaning that the cost of forking is proportional to the size of the stacks
+// and globals of the runtime, not to the size of its heap.
+// A runtime may not be freed while another runtime it shares values with
+// is being executed.
+void bigtonFork(bigton_runtime_state_t *src, bigton_runtime_state_t *dest);
+void bigtonSharedHeapRcDecr(bigton_shared_heap_t *h);
+
+// Return the object, array or map that holds the current contents of the
+// given object, array or map - the value itself, or the copy made of it by
+// the runtime if it is shared. 'Write' variants make a copy if there is none
+// yet, and give array views their own copies of their elements. They return
+// NULL (setting 'BIGTONE_EXCEEDED_MEMORY_LIMIT' if 'r' is not NULL) if that
+// would exceed the memory usage limit.
+// 'r' may be NULL for values that do not belong to a runtime.
+bigton_object_t *bigtonObjectRead(
+    const bigton_runtime_state_t *r, bigton_object_t *o
+);
+bigton_object_t *bigtonObjectWrite(
+    bigton_runtime_state_t *r, bigton_object_t *o
+);
+bigton_array_t *bigtonArrayRead(
+    const bigton_runtime_state_t *r, bigton_array_t *a
+);
+bigton_array_t *bigtonArrayWrite(
+    bigton_runtime_state_t *r, bigton_array_t *a
+);
+bigton_map_t *bigtonMapRead(
+    const bigton_runtime_state_t *r, bigton_map_t *m
+);
+bigton_map_t *bigtonMapWrite(bigton_runtime_state_t *r, bigton_map_t *m);
+
+// Grows the capacity of the given array to at least 'minCapacity', at least
+// doubling it so that appending is amortized constant time. Returns false
+// (setting 'BIGTONE_EXCEEDED_MEMORY_LIMIT') if that would exceed the memory
+// usage limit. The array may not be shared or a view (see
+// 'bigtonArrayWrite').
+bool bigtonArrayReserve(
+    bigton_runtime_state_t *r, bigton_array_t *a, size_t minCapacity
+);
+// Inserts a value at index 'i' (at most the length of the array), taking over
+// the reference held by the caller unless false is returned.
+bool bigtonArrayInsert(
+    bigton_runtime_state_t *r, bigton_array_t *a, size_t i,
+    bigton_tagged_value_t v
+);
+// Removes the value at index 'i' (less than the length of the array), passing
+// its reference to the caller.
+bigton_tagged_value_t bigtonArrayRemove(bigton_array_t *a, size_t i);
+
+// Returns a new empty map, or NULL (setting 'BIGTONE_EXCEEDED_MEMORY_LIMIT')
+// if that would exceed the memory usage limit.
+bigton_map_t *bigtonMapCreate(bigton_runtime_state_t *r);
+// Associates the given key with the given value, taking over the references
+// held by the caller to both unless false is returned (setting
+// 'BIGTONE_EXCEEDED_MEMORY_LIMIT' if the map would have to grow beyond the
+// memory usage limit). If the map already contains the key, its previous
+// value and the given key are released. Grows the map before it is more than
+// three quarters full, making insertion amortized constant time.
+// The map may not be shared (see 'bigtonMapWrite').
+bool bigtonMapSet(
+    bigton_runtime_state_t *r, bigton_map_t *m, bigton_tagged_value_t key,
+    bigton_tagged_value_t value
+);
+// Removes the key in the given slot (see 'bigtonMapFind'), releasing the key
+// and passing the reference to its value to the caller.
+// The map may not be shared.
+bigton_tagged_value_t bigtonMapRemove(bigton_map_t *m, size_t slot);
+// Returns a new array holding the keys of the given map in the order of
+// their slots, or NULL (setting 'BIGTONE_EXCEEDED_MEMORY_LIMIT') if that
+// would exceed the memory usage limit.
+bigton_array_t *bigtonMapKeys(
+    bigton_runtime_state_t *r, const bigton_map_t *m
+);
+
+// Return the part of the given string or array from index 'start' up to
+// (excluding) index 'end', or NULL (setting 'BIGTONE_EXCEEDED_MEMORY_LIMIT')
+// if that would exceed the memory usage limit. Unless the part is short, the
+// result is a view that references the chars or elements of the sliced value
+// instead of copying them, meaning that slicing takes constant time.
+// Slicing an array turns it into a view as well, and views get their own
+// copies of the elements when they are first modified (see
+// 'bigtonArrayWrite').
+bigton_string_t *bigtonStringSlice(
+    bigton_runtime_state_t *r, bigton_string_t *s, size_t start, size_t end
+);
+bigton_array_t *bigtonArraySlice(
+    bigton_runtime_state_t *r, bigton_array_t *a, size_t start, size_t end
+);
+// Returns the concatenation of the given strings, or NULL (setting
+// 'BIGTONE_EXCEEDED_MEMORY_LIMIT') if that would exceed the memory usage
+// limit. The chars are copied into a buffer with spare capacity, and if 'a'
+// is the last string appended to such a buffer, the chars of 'b' are
+// appended to the buffer instead, with the result being a view of it. This
+// makes repeatedly appending to a string amortized linear time.
+bigton_string_t *bigtonStringConcat(
+    bigton_runtime_state_t *r, bigton_string_t *a, bigton_string_t *b
+);
+
 
+// Growing the logs, trace, stacks or scopes of a runtime beyond its memory
+// usage limit instead sets 'BIGTONE_EXCEEDED_MEMORY_LIMIT', releasing the
+// value or log line that was meant to be added.
 void bigtonLogLine(bigton_runtime_state_t *r, bigton_string_t *line);
 
 void bigtonTracePush(bigton_runtime_state_t *r, bigton_trace_call_t t);
@@ -154,17 +471,72 @@ void bigtonScopePush(bigton_runtime_state_t *r, bigton_scope_t scope);
 bigton_scope_t *bigtonScopeCurr(bigton_runtime_state_t *r);
 void bigtonScopePop(bigton_runtime_state_t *r);
 
+// Equality of values as tested by the 'BIGTONIR_EQUAL' instruction.
+bool valuesEqual(bigton_tagged_value_t a, bigton_tagged_value_t b);
+
 void bigtonStartTick(bigton_runtime_state_t *r);
 bigton_exec_status_t bigtonExecInstr(bigton_runtime_state_t *r);
 bigton_exec_status_t bigtonExecBatch(bigton_runtime_state_t *r);
 
+// Written by 'bigtonExecMany' for each of the executed runtimes.
+// The layout of this struct is mirrored by the Kotlin wrapper API
+// ('BigtonExecBatch'), which reads it from a direct byte buffer.
+typedef struct BigtonExecResult {
+    uint32_t status; // bigton_exec_status_t
+    bigton_slot_t awaitingBuiltinFun;
+    uint32_t logsCount;
+    uint32_t error; // bigton_error_t
+} bigton_exec_result_t;
+
+bigton_exec_result_t bigtonExecUntilYield(
+    bigton_runtime_state_t *r, bool startTick
+);
+void bigtonExecMany(
+    bigton_runtime_state_t *const *runtimes, size_t count, bool startTick,
+    bigton_exec_result_t *results
+);
+
+
+// Allocates buffers for a value of the runtime like 'bigtonTryAllocBuffs',
+// collecting reference cycles first if they would otherwise exceed the memory
+// usage limit. Sets 'BIGTONE_EXCEEDED_MEMORY_LIMIT' if they still do.
+bool bigtonAllocValueBuffs(
+    bigton_runtime_state_t *r, size_t count, const size_t *sizes,
+    void **buffers
+);
+// Resizes the given buffer (which may be NULL) of the runtime in the same way,
+// using 'bigtonTryReallocBuff'. The buffer is left unchanged on failure.
+bool bigtonReallocValueBuff(
+    bigton_runtime_state_t *r, void **buffer, size_t numBytes
+);
+// Same as 'bigtonAllocValueBuffs', but allocates the buffers in a single
+// arena (see 'bigtonAllocArena').
+bool bigtonAllocValueArena(
+    bigton_runtime_state_t *r, size_t count, const size_t *sizes,
+    void **buffers
+);
+// Returns the hash for a newly created object, array or map. The hashes only
+// depend on the number of values created before, making the order of map
+// keys deterministic.
+uint32_t bigtonNextValueHash(bigton_runtime_state_t *r);
 
+// All of these return NULL if the string could not be allocated, with the
+// runtime variants setting 'BIGTONE_EXCEEDED_MEMORY_LIMIT'.
 bigton_string_t *bigtonAllocConstString(
     bigton_runtime_state_t *r, bigton_str_id_t id
 );
+// Same as 'bigtonAllocConstString', but only allocates the string the first
+// time it is loaded, returning the same (reference counted) string from then
+// on, which also allows equal constants to be compared by their address.
+bigton_string_t *bigtonLoadConstString(
+    bigton_runtime_state_t *r, bigton_str_id_t id
+);
 bigton_string_t *bigtonAllocString(
     bigton_buff_owner_t *o, uint64_t length, const bigton_char_t *content
 );
+bigton_string_t *bigtonAllocValueString(
+    bigton_runtime_state_t *r, uint64_t length, const bigton_char_t *content
+);
 
 #ifdef BIGTON_ERROR_MACROS
     #define HAS_ERROR(r) ((r)->error != BIGTONE_NONE)
@@ -0,0 +1,47 @@
+#ifndef BIGTON_SCHEDULER_H
+#define BIGTON_SCHEDULER_H
+
+#include <bigton/runtime.h>
+
+// The scheduler executes independent runtimes on a pool of worker threads.
+// Each call to 'bigtonSchedulerRun' distributes the given runtimes across
+// per-worker deques, from which idle workers steal work. Every runtime is
+// executed until it yields (just like 'bigtonExecMany'), meaning runtimes
+// that need a builtin function are parked so that the host can service
+// all of them on its own thread before running them again.
+//
+// Since runtimes do not share any mutable state, the results (and logs)
+// of a run do not depend on the number of threads or on which thread
+// executed which runtime. The same runtime may however not be passed
+// more than once to the same call.
+// Runtimes created using 'bigtonFork' are the exception, as they read the
+// buffers shared with the runtime they were forked from (and the
+// 'sharedBelow' of its buffer owner). All runtimes of the same run that
+// share buffers (directly or through a chain of forks) are therefore
+// executed by the same worker, one after the other in the order they
+// were given in.
+//
+// 'bigtonSchedulerForEach' exposes the same pool for other work that can
+// be split into independent tasks (for example taking snapshots of many
+// runtimes at once). The task is called exactly once for each index in
+// [0, count), possibly from different threads. A scheduler of NULL
+// executes all tasks on the calling thread.
+
+typedef struct BigtonScheduler bigton_scheduler_t;
+
+typedef void (*bigton_scheduler_task_t)(void *context, size_t i);
+
+bigton_scheduler_t *bigtonSchedulerCreate(uint32_t numThreads);
+uint32_t bigtonSchedulerNumThreads(const bigton_scheduler_t *s);
+void bigtonSchedulerForEach(
+    bigton_scheduler_t *s, size_t count,
+    bigton_scheduler_task_t task, void *context
+);
+void bigtonSchedulerRun(
+    bigton_scheduler_t *s,
+    bigton_runtime_state_t *const *runtimes, size_t count, bool startTick,
+    bigton_exec_result_t *results
+);
+void bigtonSchedulerFree(bigton_scheduler_t *s);
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef BIGTON_SNAPSHOT_H
+#define BIGTON_SNAPSHOT_H
+
+#include <bigton/runtime.h>
+#include <bigton/scheduler.h>
+
+// A snapshot captures the complete state of a runtime (settings, globals,
+// stack, locals, scopes, trace, logs, loaded constant strings and all values
+// reachable from these, with shared references preserved) in a compact
+// binary format.
+// The program is not included, only referenced by its content hash - a
+// snapshot may only be restored using an image of the same program.
+//
+// Reference counts are reconstructed from the references contained in the
+// snapshot, meaning that references held by the host (for example values
+// still held by the Kotlin wrapper) are not preserved.
+
+#define BIGTON_SNAPSHOT_MAGIC "BGTS"
+#define BIGTON_SNAPSHOT_VERSION 5
+
+// Returns a buffer allocated using 'malloc', which the caller is responsible
+// for freeing.
+uint8_t *bigtonSnapshot(const bigton_runtime_state_t *r, size_t *sizeOut);
+
+// Takes a snapshot of each of the given runtimes, with the work being split
+// across the threads of the given scheduler (which may be NULL).
+// Since taking a snapshot only reads the state of a runtime, this is safe
+// as long as none of the runtimes is being executed at the same time.
+void bigtonSnapshotMany(
+    bigton_scheduler_t *scheduler,
+    const bigton_runtime_state_t *const *runtimes, size_t count,
+    uint8_t **snapshots, size_t *sizes
+);
+
+// Initializes 'r' using the given image and the state stored in the snapshot.
+// If the snapshot is invalid or was made using a different program, the
+// error of the runtime is set to 'BIGTONE_INT_INVALID_SNAPSHOT'. If the header
+// of the snapshot is invalid, the settings stored in it are ignored and the
+// runtime is initialized with all limits set to zero instead.
+void bigtonRestore(
+    bigton_runtime_state_t *r, bigton_program_image_t *image,
+    const uint8_t *snapshot, size_t snapshotSize
+);
+
+// Stores the runtime as a snapshot (compressed if requested and if this makes
+// it smaller) and frees all of its buffers, until it is woken up again using
+// 'bigtonWake'. Executing a hibernated runtime ('bigtonStartTick',
+// 'bigtonExecBatch') or forking it wakes it automatically, while its settings,
+// error, current source location and tick cost can still be read directly.
+// Taking a snapshot of a hibernated runtime does not wake it, but returns a
+// (decompressed) copy of the stored snapshot instead.
+// Runtimes not created from an image and runtimes that still have host values
+// linked to them (see 'bigtonHostValueAttach') can not be hibernated, in which
+// case false is returned and the runtime is left unchanged.
+bool bigtonHibernate(bigton_runtime_state_t *r, bool compress);
+void bigtonWake(bigton_runtime_state_t *r);
+
+// Initializes 'r' to the state reached by executing the global section of
+// the program up to its first yield (the first tick, call to a builtin
+// function, completion or error), using the given settings.
+// The state reached by the first runtime prepared for an image and a set of
+// settings is stored in the image as an "init snapshot", from which all
+// further runtimes with the same settings are then restored instead of
+// executing the global section again. Init snapshots are freed together with
+// the image. States after an error are not stored.
+//
+// The first execution of a prepared runtime ('bigtonExecBatch') does not
+// execute any instructions, and instead reports the status and tick cost of
+// the yield - prepared runtimes are therefore indistinguishable from runtimes
+// created using 'bigtonInitFromImage', as long as the first interaction with
+// them is to execute them.
+void bigtonInitPrepared(
+    bigton_runtime_state_t *r,
+    const bigton_runtime_settings_t *settings,
+    bigton_program_image_t *image
+);
+
+// Resets 'r' (see 'bigtonReset') and prepares it like 'bigtonInitPrepared'
+// would using the given settings and the image of the runtime, while keeping
+// the capacities of its buffers.
+void bigtonResetPrepared(
+    bigton_runtime_state_t *r, const bigton_runtime_settings_t *settings
+);
+
+#endif
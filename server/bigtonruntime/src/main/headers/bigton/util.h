@@ -0,0 +1,28 @@
+#ifndef BIGTON_UTIL_H
+#define BIGTON_UTIL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// Small helpers shared by multiple parts of the runtime.
+
+
+// Slot of the given pointer in an open addressing table with the given
+// capacity, which must be a power of two.
+static size_t bigtonHashPointer(const void *p, size_t capacity) {
+    uint64_t h = (uint64_t) (uintptr_t) p;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    return (size_t) (h & (capacity - 1));
+}
+
+// Current wall clock time in nanoseconds, used to measure pauses.
+static uint64_t bigtonNanosNow(void) {
+    struct timespec t;
+    timespec_get(&t, TIME_UTC);
+    return (uint64_t) t.tv_sec * 1000000000ULL + (uint64_t) t.tv_nsec;
+}
+
+#endif
@@ -6,10 +6,16 @@
 #include <bigton/error.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 
 typedef struct BigtonRc {
     int32_t count;
+    // color of the value during cycle collection (see 'bigtonCollectCycles')
+    uint32_t color: 2;
+    // one plus the index of the value in the possible cycle roots of its
+    // owner, or zero if it is not a possible cycle root
+    uint32_t rootIdx: 30;
 } bigton_rc_t;
 
 #define BIGTON_RC_INIT ((bigton_rc_t) { .count = 1 })
@@ -22,7 +28,8 @@ typedef enum BigtonValueType {
     BIGTON_STRING,
     BIGTON_TUPLE,
     BIGTON_OBJECT,
-    BIGTON_ARRAY
+    BIGTON_ARRAY,
+    BIGTON_MAP
 } bigton_value_type_t;
 
 
@@ -31,7 +38,18 @@ typedef union BigtonValue bigton_value_t;
 typedef struct BigtonString {
     bigton_rc_t rc;
     uint32_t length;
+    // number of chars at the start of the buffer 'content' points to that
+    // are in use by this string or by strings appended to it (see
+    // 'bigtonStringConcat'), only kept up to date for strings that are not
+    // views
+    uint32_t usedLength;
     const bigton_char_t *content;
+    // if the string is a slice of another string (see 'bigtonStringSlice'),
+    // the string that owns the buffer 'content' points into
+    struct BigtonString *viewed;
+    // hash of the chars of the string (see 'bigtonStringHash'), or 0 if it
+    // has not been computed yet
+    uint32_t hash;
 } bigton_string_t;
 
 typedef struct BigtonTuple {
@@ -44,6 +62,10 @@ typedef struct BigtonTuple {
 
 typedef struct BigtonObject {
     bigton_rc_t rc;
+    // hash given to the object when it was created (see
+    // 'bigtonNextValueHash'), which unlike its location is kept when the
+    // runtime is compacted, forked or restored
+    uint32_t hash;
     const bigton_shape_t *shape;
     bigton_value_type_t *memberTypes;
     bigton_value_t *memberValues;
@@ -51,12 +73,46 @@ typedef struct BigtonObject {
 
 typedef struct BigtonArray {
     bigton_rc_t rc;
+    // see 'bigton_object_t'
+    uint32_t hash;
     uint32_t capacity;
     uint32_t length;
+    // 'BIGTON_INT' or 'BIGTON_FLOAT' if the array is packed, meaning that
+    // all elements are of that type and 'elementTypes' is NULL, otherwise
+    // 'BIGTON_NULL' (see 'bigtonArrayUnpack')
+    bigton_value_type_t packedType;
     bigton_value_type_t *elementTypes;
     bigton_value_t *elementValues;
+    // if the array is a slice of another array (see 'bigtonArraySlice'),
+    // the array that owns the buffers the elements point into - the
+    // elements are then referenced by that array, not by this one
+    struct BigtonArray *viewed;
 } bigton_array_t;
 
+// Hash table using open addressing with linear probing, where removing a key
+// shifts the following keys of its probe sequence back instead of leaving a
+// tombstone. Keys are compared like the 'BIGTONIR_EQUAL' instruction does.
+// The keys are iterated in the order of their slots, which only depends on
+// the values created, inserted and removed, not on where values are located
+// in memory.
+typedef struct BigtonMap {
+    bigton_rc_t rc;
+    // see 'bigton_object_t'
+    uint32_t hash;
+    // number of slots, either zero or a power of two
+    uint32_t capacity;
+    uint32_t length;
+    // hash of the key in each slot (see 'bigtonValueHash'), or zero for
+    // empty slots - the hashes are kept so that neither growing the map nor
+    // probing slots holding other keys requires hashing or comparing keys
+    uint32_t *slotHashes;
+    // key of each slot at index '2 * slot', followed by its value - both are
+    // null for empty slots, meaning that all '2 * capacity' values can be
+    // traversed without checking which slots are in use
+    bigton_value_type_t *slotTypes;
+    bigton_value_t *slotValues;
+} bigton_map_t;
+
 typedef union BigtonValue {
     bigton_int_t i;
     bigton_float_t f;
@@ -64,6 +120,7 @@ typedef union BigtonValue {
     bigton_tuple_t *t;
     bigton_object_t *o;
     bigton_array_t *a;
+    bigton_map_t *m;
 } bigton_value_t;
 
 typedef struct BigtonTaggedValue {
@@ -99,6 +156,10 @@ typedef struct BigtonTaggedValue {
     .t = BIGTON_ARRAY, \
     .v = ((bigton_value_t) { .a = (value) }) \
 })
+#define BIGTON_MAP_VALUE(value) ((bigton_tagged_value_t) { \
+    .t = BIGTON_MAP, \
+    .v = ((bigton_value_t) { .m = (value) }) \
+})
 
 
 static bigton_tagged_value_t bigtonTupleAt(
@@ -153,6 +214,24 @@ static bigton_tagged_value_t bigtonObjectSet(
     return oldMem;
 }
 
+static bigton_value_type_t bigtonArrayTypeAt(
+    const bigton_array_t *a, size_t i
+) {
+    if (a->packedType != BIGTON_NULL) { return a->packedType; }
+    return a->elementTypes[i];
+}
+
+// Arrays holding only ints or only floats are packed, storing the type of
+// their elements only once. Storing a value of another type unpacks them,
+// giving them a buffer with the types of all elements.
+// The array may not be shared or a view (see 'bigtonArrayWrite'). Returns
+// false (leaving the array packed) if the owner of the array would exceed its
+// limit.
+bool bigtonArrayUnpack(bigton_array_t *a);
+// Packs the given array if all of its elements are ints or all are floats.
+// The array may not be shared or a view.
+void bigtonArrayPack(bigton_array_t *a);
+
 static bigton_tagged_value_t bigtonArrayAt(
     bigton_array_t *a, bigton_int_t i, bigton_error_t *e
 ) {
@@ -161,47 +240,173 @@ static bigton_tagged_value_t bigtonArrayAt(
         return BIGTON_NULL_VALUE;
     }
     return (bigton_tagged_value_t) {
-        .t = a->elementTypes[i],
+        .t = bigtonArrayTypeAt(a, (size_t) i),
         .v = a->elementValues[i]
     };
 }
 
+// Returns the value previously stored at the index, or 'v' itself if it could
+// not be stored (setting the error), to be released by the caller either way.
 static bigton_tagged_value_t bigtonArraySet(
     bigton_array_t *a, bigton_int_t i, bigton_tagged_value_t v,
     bigton_error_t *e
 ) {
-    if (i < 0 && (size_t) i >= a->length) {
+    if (i < 0 || (size_t) i >= a->length) {
         *e = BIGTONE_ARRAY_INDEX_OOB;
-        return BIGTON_NULL_VALUE;
+        return v;
     }
     bigton_tagged_value_t oldValue = (bigton_tagged_value_t) {
-        .t = a->elementTypes[i],
+        .t = bigtonArrayTypeAt(a, (size_t) i),
         .v = a->elementValues[i]
     };
-    a->elementTypes[i] = v.t;
+    if (a->packedType != BIGTON_NULL && v.t != a->packedType) {
+        if (!bigtonArrayUnpack(a)) {
+            *e = BIGTONE_EXCEEDED_MEMORY_LIMIT;
+            return v;
+        }
+    }
+    if (a->packedType == BIGTON_NULL) { a->elementTypes[i] = v.t; }
     a->elementValues[i] = v.v;
     return oldValue;
 }
 
+// Hash of a value that is consistent with the equality of values (see
+// 'BigtonMap'), and that never is zero. Objects, arrays and maps are only
+// equal to themselves, and are hashed using the hash they were given when
+// they were created, since their locations change when runtimes are compacted
+// or restored.
+uint32_t bigtonValueHash(bigton_tagged_value_t v);
+// Hash of the chars of a string, as used by 'bigtonValueHash'. The hash is
+// cached in the string unless it is shared with other runtimes, which may be
+// reading it concurrently. Comparing strings uses cached hashes to tell
+// strings apart early, but never computes them.
+uint32_t bigtonStringHash(bigton_string_t *s);
+
+static bigton_tagged_value_t bigtonMapKeyAt(
+    const bigton_map_t *m, size_t slot
+) {
+    return (bigton_tagged_value_t) {
+        .t = m->slotTypes[slot * 2],
+        .v = m->slotValues[slot * 2]
+    };
+}
+
+static bigton_tagged_value_t bigtonMapValueAt(
+    const bigton_map_t *m, size_t slot
+) {
+    return (bigton_tagged_value_t) {
+        .t = m->slotTypes[slot * 2 + 1],
+        .v = m->slotValues[slot * 2 + 1]
+    };
+}
+
+// Returns the slot holding the given key, or the capacity of the map if it
+// does not contain the key.
+size_t bigtonMapFind(const bigton_map_t *m, bigton_tagged_value_t key);
+
 
 typedef struct BigtonBuff bigton_buff_t;
 typedef struct BigtonBuffOwner bigton_buff_owner_t;
 
+// Block of memory holding multiple buffers (see 'bigtonAllocArena'), which
+// is freed once all buffers in it have been freed.
+typedef struct BigtonArena {
+    size_t liveCount;
+} bigton_arena_t;
+
 typedef struct BigtonBuff {
     bigton_buff_owner_t *owner;
     bigton_buff_t *prev;
     bigton_buff_t *next;
+    // NULL if the buffer has been allocated on its own
+    bigton_arena_t *arena;
     size_t sizeBytes;
+    // allocation order of the buffer within its owner
+    uint64_t seq;
     const uint8_t data[];
 } bigton_buff_t;
 
+// Tuples, objects, arrays and maps in the buffers of an owner that may be
+// part of a garbage reference cycle, since their reference count has been
+// decremented without reaching zero (see 'bigtonCollectCycles').
+typedef struct BigtonCycleRoots {
+    size_t capacity;
+    size_t count;
+    bigton_tagged_value_t *values;
+} bigton_cycle_roots_t;
+
+#define BIGTON_CYCLE_ROOTS_INIT ((bigton_cycle_roots_t) { \
+    .capacity = 0, .count = 0, .values = NULL \
+})
+
+// Tuples, objects, arrays and maps in the buffers of an owner whose reference
+// count has reached zero, but which have not been freed yet (see
+// 'bigtonFreePending').
+typedef struct BigtonFreeQueue {
+    size_t capacity;
+    size_t count;
+    bigton_tagged_value_t *values;
+} bigton_free_queue_t;
+
+#define BIGTON_FREE_QUEUE_INIT ((bigton_free_queue_t) { \
+    .capacity = 0, .count = 0, .values = NULL \
+})
+
 typedef struct BigtonBuffOwner {
     bigton_buff_t *first;
     bigton_buff_t *last;
+    // memory used by all buffers, including their headers
     size_t totalSizeBytes;
+    // highest value 'totalSizeBytes' has reached
+    size_t peakSizeBytes;
+    // limit for 'totalSizeBytes' enforced by 'bigtonTryAllocBuffs'
+    size_t limitBytes;
+    uint64_t nextSeq;
+    // all buffers allocated before this point ('seq' less than this) are
+    // shared with other owners, see 'bigtonBuffIsShared'
+    uint64_t sharedBelow;
+    bigton_cycle_roots_t cycleRoots;
+    bigton_free_queue_t freeQueue;
 } bigton_buff_owner_t;
 
+#define BIGTON_BUFF_HEADER(buffer) \
+    ((const bigton_buff_t *) ( \
+        ((const uint8_t *) (buffer)) - offsetof(bigton_buff_t, data) \
+    ))
+
+// Buffers shared between runtimes (see 'bigtonFork') are immutable.
+// Values stored in shared buffers are also not reference counted, and instead
+// live until all runtimes sharing them have been freed.
+static bool bigtonBuffIsShared(const void *buffer) {
+    const bigton_buff_t *b = BIGTON_BUFF_HEADER(buffer);
+    return b->seq < b->owner->sharedBelow;
+}
+
+// Returns the given result of 'malloc', 'calloc' or 'realloc' (which may not
+// have been asked for zero bytes), aborting the process if it is NULL because
+// the system is out of memory.
+void *bigtonCheckAllocated(void *allocated);
+
+// Allocations through 'bigtonAllocBuff', 'bigtonReallocBuff' and
+// 'bigtonAllocArena' may exceed the limit of the owner and abort the process
+// if the system is out of memory. They are only meant for buffers whose sizes
+// were already accounted for when the runtime was created, restored, forked
+// or compacted (such as its globals), while everything the executed program
+// can make grow goes through 'bigtonTryAllocBuffs', 'bigtonTryAllocArena' and
+// 'bigtonTryReallocBuff'.
 void *bigtonAllocBuff(bigton_buff_owner_t *o, size_t numBytes);
+// Returns whether buffers of the given sizes can be allocated without the
+// owner exceeding its limit.
+bool bigtonBuffsFit(
+    const bigton_buff_owner_t *o, size_t count, const size_t *sizes
+);
+// Allocates buffers of the given sizes, writing them to 'buffers' (NULL for
+// sizes of zero), unless that would make the owner exceed its limit (even
+// after freeing all pending values, see 'bigtonFreePending') or the system
+// is out of memory. Either all or none of the buffers are allocated.
+bool bigtonTryAllocBuffs(
+    bigton_buff_owner_t *o, size_t count, const size_t *sizes, void **buffers
+);
 static void *bigtonAllocNullableBuff(bigton_buff_owner_t *o, size_t numBytes) {
     if (numBytes == 0) { return NULL; }
     return bigtonAllocBuff(o, numBytes);
@@ -216,6 +421,10 @@ static void bigtonFreeNullableBuff(const void *buffer) {
 void *bigtonReallocBuff(
     const void *buffer, size_t numBytes
 );
+// Same as 'bigtonReallocBuff', but returns NULL (leaving the buffer unchanged)
+// if growing the buffer would make the owner exceed its limit (even after
+// freeing all pending values) or if the system is out of memory.
+void *bigtonTryReallocBuff(const void *buffer, size_t numBytes);
 static void *bigtonReallocNullableBuff(
     bigton_buff_owner_t *o, const void *buffer, size_t numBytes
 ) {
@@ -231,6 +440,29 @@ static void *bigtonReallocNullableBuff(
 
 void bigtonFreeAll(bigton_buff_owner_t *o);
 
+// Allocates buffers of the given sizes in a single contiguous block, in
+// order, writing them to 'buffers' (NULL for sizes of zero). Reallocating a
+// buffer in an arena moves it out of the arena.
+// The buffers of an arena may only be freed from multiple threads if all of
+// them have been shared with other runtimes (and are therefore freed
+// together with their shared heap).
+void bigtonAllocArena(
+    bigton_buff_owner_t *o, size_t count, const size_t *sizes, void **buffers
+);
+// Same as 'bigtonAllocArena', but fails like 'bigtonTryAllocBuffs' does.
+bool bigtonTryAllocArena(
+    bigton_buff_owner_t *o, size_t count, const size_t *sizes, void **buffers
+);
+
+// Moves the given buffer from its current owner to 'dest'.
+void bigtonMoveBuff(bigton_buff_owner_t *dest, const void *buffData);
+
+// Moves all shared buffers of 'src' to 'dest', freeing all other buffers.
+// Afterwards, all buffers of 'dest' are shared.
+void bigtonMoveSharedBuffs(
+    bigton_buff_owner_t *src, bigton_buff_owner_t *dest
+);
+
 
 static void bigtonValRcIncr(bigton_tagged_value_t value) {
     switch (value.t) {
@@ -239,23 +471,48 @@ static void bigtonValRcIncr(bigton_tagged_value_t value) {
         case BIGTON_FLOAT:
             break;
         case BIGTON_STRING:
+            if (bigtonBuffIsShared(value.v.s)) { break; }
             value.v.s->rc.count += 1;
             break;
         case BIGTON_TUPLE:
+            if (bigtonBuffIsShared(value.v.t)) { break; }
             value.v.t->rc.count += 1;
             break;
         case BIGTON_OBJECT:
+            if (bigtonBuffIsShared(value.v.o)) { break; }
             value.v.o->rc.count += 1;
             break;
         case BIGTON_ARRAY:
+            if (bigtonBuffIsShared(value.v.a)) { break; }
             value.v.a->rc.count += 1;
             break;
+        case BIGTON_MAP:
+            if (bigtonBuffIsShared(value.v.m)) { break; }
+            value.v.m->rc.count += 1;
+            break;
     }
 }
 
+// Frees strings immediately. Tuples, objects, arrays and maps are added to the
+// free queue of their owner instead, since freeing them requires releasing
+// all values they reference (see 'bigtonFreePending').
 void bigtonValFree(bigton_tagged_value_t value);
+// Frees values from the free queue of the given owner until it is empty or
+// 'budget' has been used up, with freeing a value costing one plus the number
+// of values it has to release (for maps, all of their slots, including empty
+// ones). Values referenced by freed values that reach a reference count of
+// zero are added to the queue, meaning that nested values are freed without
+// recursion.
+void bigtonFreePending(bigton_buff_owner_t *o, size_t budget);
+
+// Records the given tuple, object, array or map as a possible cycle root.
+void bigtonCycleRootsAdd(bigton_tagged_value_t value);
+// Removes the given tuple, object, array or map from the possible cycle
+// roots.
+void bigtonCycleRootsRemove(bigton_tagged_value_t value);
 
 static void bigtonValRcDecr(bigton_tagged_value_t value) {
+    bigton_rc_t *rc;
     int32_t newCount;
     switch (value.t) {
         case BIGTON_NULL:
@@ -263,20 +520,32 @@ static void bigtonValRcDecr(bigton_tagged_value_t value) {
         case BIGTON_FLOAT:
             return;
         case BIGTON_STRING:
+            if (bigtonBuffIsShared(value.v.s)) { return; }
             newCount = value.v.s->rc.count -= 1;
-            break;
+            if (newCount <= 0) { bigtonValFree(value); }
+            return;
         case BIGTON_TUPLE:
-            newCount = value.v.t->rc.count -= 1;
+            if (bigtonBuffIsShared(value.v.t)) { return; }
+            rc = &value.v.t->rc;
             break;
         case BIGTON_OBJECT:
-            newCount = value.v.o->rc.count -= 1;
+            if (bigtonBuffIsShared(value.v.o)) { return; }
+            rc = &value.v.o->rc;
             break;
         case BIGTON_ARRAY:
-            newCount = value.v.a->rc.count -= 1;
+            if (bigtonBuffIsShared(value.v.a)) { return; }
+            rc = &value.v.a->rc;
+            break;
+        case BIGTON_MAP:
+            if (bigtonBuffIsShared(value.v.m)) { return; }
+            rc = &value.v.m->rc;
             break;
     }
+    newCount = rc->count -= 1;
     if (newCount <= 0) {
         bigtonValFree(value);
+    } else if (rc->rootIdx == 0) {
+        bigtonCycleRootsAdd(value);
     }
 }
 
@@ -0,0 +1,179 @@
+
+package schwalbe.ventura.bigton.runtime
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+object BigtonDispatchN {
+
+    /**
+     * Mirror of 'bigton_builtin_group_t'
+     * defined in 'src/main/headers/bigton/dispatch.h'
+     */
+    object GroupLayout {
+        const val BUILTIN_ID_OFFSET = 0
+        const val START_OFFSET = 4
+        const val COUNT_OFFSET = 8
+        const val SIZE_BYTES = 12
+    }
+
+    /**
+     * Mirror of 'BIGTON_DISPATCH_SKIP'
+     * defined in 'src/main/headers/bigton/dispatch.h'
+     */
+    const val SKIP: Byte = 0xFF.toByte()
+
+    @JvmStatic external fun groupAwaitingBuiltins(
+        resultsBuf: ByteBuffer,
+        count: Int,
+        orderBuf: ByteBuffer,
+        groupsBuf: ByteBuffer
+    ): Int
+    @JvmStatic external fun gatherArgs(
+        runtimeHandlesBuf: ByteBuffer,
+        orderBuf: ByteBuffer,
+        groupStart: Int,
+        groupCount: Int,
+        argc: Int,
+        argTypesBuf: ByteBuffer,
+        argValuesBuf: ByteBuffer
+    )
+    @JvmStatic external fun scatterResults(
+        runtimeHandlesBuf: ByteBuffer,
+        orderBuf: ByteBuffer,
+        groupStart: Int,
+        groupCount: Int,
+        argc: Int,
+        resultTypesBuf: ByteBuffer,
+        resultValuesBuf: ByteBuffer
+    )
+
+}
+
+/**
+ * Services the runtimes of a [BigtonExecBatch] that await a builtin function
+ * grouped by the awaited builtin function.
+ * After calling [group], the arguments of each group may be read in bulk
+ * using [gatherArgs], after which results are written using [setResultNull],
+ * [setResultInt] or [setResultFloat] and passed to all runtimes of the
+ * group using [scatterResults].
+ * Runtimes whose arguments or results are not null, integers or floats
+ * may be serviced individually by calling [skipResult] for them, which is
+ * also the result of runtimes no result has been set for. Arguments of
+ * runtimes whose stack holds fewer values than the given argument count
+ * have the type [BigtonDispatchN.SKIP].
+ */
+class BigtonBuiltinDispatch(val capacity: Int, val maxArgc: Int) {
+
+    private fun allocate(sizeBytes: Int): ByteBuffer = ByteBuffer
+        .allocateDirect(maxOf(sizeBytes, 1))
+        .order(ByteOrder.nativeOrder())
+
+    private val order: ByteBuffer = allocate(capacity * Int.SIZE_BYTES)
+    private val groups: ByteBuffer
+        = allocate(capacity * BigtonDispatchN.GroupLayout.SIZE_BYTES)
+    private val argTypes: ByteBuffer = allocate(capacity * maxArgc)
+    private val argValues: ByteBuffer
+        = allocate(capacity * maxArgc * Long.SIZE_BYTES)
+    private val resultTypes: ByteBuffer = allocate(capacity)
+    private val resultValues: ByteBuffer
+        = allocate(capacity * Long.SIZE_BYTES)
+
+    private var batch: BigtonExecBatch? = null
+    private var currentGroup: Int = -1
+    private var currentArgc: Int = 0
+
+    var numGroups: Int = 0
+        private set
+
+    fun group(batch: BigtonExecBatch) {
+        require(batch.size <= this.capacity)
+        this.batch = batch
+        this.currentGroup = -1
+        this.numGroups = BigtonDispatchN.groupAwaitingBuiltins(
+            batch.results, batch.size, this.order, this.groups
+        )
+    }
+
+    private fun groupIntAt(g: Int, offset: Int): Int {
+        require(g in 0..<this.numGroups)
+        return this.groups.getInt(
+            g * BigtonDispatchN.GroupLayout.SIZE_BYTES + offset
+        )
+    }
+
+    fun groupBuiltinId(g: Int): Int
+        = this.groupIntAt(g, BigtonDispatchN.GroupLayout.BUILTIN_ID_OFFSET)
+
+    fun groupSize(g: Int): Int
+        = this.groupIntAt(g, BigtonDispatchN.GroupLayout.COUNT_OFFSET)
+
+    private fun groupStart(g: Int): Int
+        = this.groupIntAt(g, BigtonDispatchN.GroupLayout.START_OFFSET)
+
+    fun batchIndexAt(g: Int, i: Int): Int {
+        require(i in 0..<this.groupSize(g))
+        return this.order.getInt((this.groupStart(g) + i) * Int.SIZE_BYTES)
+    }
+
+    fun runtimeAt(g: Int, i: Int): BigtonRuntime
+        = this.batch!!.runtimeAt(this.batchIndexAt(g, i))
+
+    fun gatherArgs(g: Int, argc: Int) {
+        require(argc in 0..this.maxArgc)
+        val batch: BigtonExecBatch = this.batch!!
+        this.currentGroup = g
+        this.currentArgc = argc
+        BigtonDispatchN.gatherArgs(
+            batch.handles, this.order, this.groupStart(g), this.groupSize(g),
+            argc, this.argTypes, this.argValues
+        )
+        // results set for the previous group may not be passed to this one
+        for (i in 0..<this.groupSize(g)) {
+            this.resultTypes.put(i, BigtonDispatchN.SKIP)
+        }
+    }
+
+    private fun argIndex(i: Int, a: Int): Int {
+        val size: Int = this.groupSize(this.currentGroup)
+        require(i in 0..<size && a in 0..<this.currentArgc)
+        return a * size + i
+    }
+
+    fun argTypeAt(i: Int, a: Int): Int
+        = this.argTypes.get(this.argIndex(i, a)).toInt()
+
+    fun argIntAt(i: Int, a: Int): Long
+        = this.argValues.getLong(this.argIndex(i, a) * Long.SIZE_BYTES)
+
+    fun argFloatAt(i: Int, a: Int): Double
+        = this.argValues.getDouble(this.argIndex(i, a) * Long.SIZE_BYTES)
+
+    private fun setResult(i: Int, type: Byte, value: Long) {
+        require(i in 0..<this.groupSize(this.currentGroup))
+        this.resultTypes.put(i, type)
+        this.resultValues.putLong(i * Long.SIZE_BYTES, value)
+    }
+
+    fun setResultNull(i: Int)
+        = this.setResult(i, BigtonValueN.ValueType.NULL.toByte(), 0L)
+
+    fun setResultInt(i: Int, value: Long)
+        = this.setResult(i, BigtonValueN.ValueType.INT.toByte(), value)
+
+    fun setResultFloat(i: Int, value: Double) = this.setResult(
+        i, BigtonValueN.ValueType.FLOAT.toByte(), value.toRawBits()
+    )
+
+    fun skipResult(i: Int) = this.setResult(i, BigtonDispatchN.SKIP, 0L)
+
+    fun scatterResults() {
+        val batch: BigtonExecBatch = this.batch!!
+        val g: Int = this.currentGroup
+        BigtonDispatchN.scatterResults(
+            batch.handles, this.order, this.groupStart(g), this.groupSize(g),
+            this.currentArgc, this.resultTypes, this.resultValues
+        )
+    }
+
+}
@@ -0,0 +1,94 @@
+package schwalbe.ventura.bigton.runtime
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Mirror of 'bigton_exec_result_t'
+ * defined in 'src/main/headers/bigton/runtime.h'
+ */
+object BigtonExecResultLayout {
+    const val STATUS_OFFSET = 0
+    const val AWAITING_BUILTIN_FUN_OFFSET = 4
+    const val LOGS_COUNT_OFFSET = 8
+    const val ERROR_OFFSET = 12
+    const val SIZE_BYTES = 16
+}
+
+/**
+ * Executes many runtimes using a single JNI call per round.
+ * Each runtime is executed until it awaits the next tick, completes, errors
+ * or needs a builtin function to be executed by the host, after which the
+ * results of all runtimes may be read from the batch.
+ * If a [BigtonScheduler] is given the runtimes are executed in parallel.
+ */
+class BigtonExecBatch(val capacity: Int) {
+
+    internal val handles: ByteBuffer = ByteBuffer
+        .allocateDirect(capacity * Long.SIZE_BYTES)
+        .order(ByteOrder.nativeOrder())
+    internal val results: ByteBuffer = ByteBuffer
+        .allocateDirect(capacity * BigtonExecResultLayout.SIZE_BYTES)
+        .order(ByteOrder.nativeOrder())
+    private val runtimes: Array<BigtonRuntime?> = arrayOfNulls(capacity)
+
+    var size: Int = 0
+        private set
+
+    fun clear() {
+        this.runtimes.fill(null, 0, this.size)
+        this.size = 0
+    }
+
+    fun add(runtime: BigtonRuntime) {
+        require(this.size < this.capacity)
+        this.handles.putLong(this.size * Long.SIZE_BYTES, runtime.handle)
+        this.runtimes[this.size] = runtime
+        this.size += 1
+    }
+
+    fun execute(startTick: Boolean, scheduler: BigtonScheduler? = null) {
+        if (scheduler == null) {
+            BigtonRuntimeN.executeMany(
+                this.handles, this.size, startTick, this.results
+            )
+        } else {
+            BigtonSchedulerN.execute(
+                scheduler.handle,
+                this.handles, this.size, startTick, this.results
+            )
+        }
+    }
+
+    fun runtimeAt(i: Int): BigtonRuntime {
+        require(i in 0..<this.size)
+        return this.runtimes[i]!!
+    }
+
+    private fun resultIntAt(i: Int, offset: Int): Int {
+        require(i in 0..<this.size)
+        return this.results.getInt(
+            i * BigtonExecResultLayout.SIZE_BYTES + offset
+        )
+    }
+
+    fun statusAt(i: Int): BigtonExecStatus = BigtonExecStatus.fromNative(
+        this.resultIntAt(i, BigtonExecResultLayout.STATUS_OFFSET),
+        awaitingBuiltinId = {
+            this.resultIntAt(
+                i, BigtonExecResultLayout.AWAITING_BUILTIN_FUN_OFFSET
+            )
+        },
+        error = {
+            val error: Int = this.resultIntAt(
+                i, BigtonExecResultLayout.ERROR_OFFSET
+            )
+            BigtonRuntimeError.allTypes.getOrNull(error)
+                ?: BigtonRuntimeError.NONE
+        }
+    )
+
+    fun logLineCountAt(i: Int): Int
+        = this.resultIntAt(i, BigtonExecResultLayout.LOGS_COUNT_OFFSET)
+
+}
@@ -30,4 +30,22 @@ sealed class BigtonExecStatus {
     class Error(val error: BigtonRuntimeError)
         : BigtonExecStatus()
 
+    companion object {
+        inline fun fromNative(
+            status: Int,
+            awaitingBuiltinId: () -> Int,
+            error: () -> BigtonRuntimeError
+        ): BigtonExecStatus = when (status) {
+            BigtonExecStatusType.CONTINUE -> Continue
+            BigtonExecStatusType.EXEC_BUILTIN_FUN
+                -> ExecBuiltinFun(awaitingBuiltinId())
+            BigtonExecStatusType.AWAIT_TICK -> AwaitTick
+            BigtonExecStatusType.COMPLETE -> Complete
+            BigtonExecStatusType.ERROR -> Error(error())
+            else -> throw IllegalStateException(
+                "C runtime returned invalid execution status"
+            )
+        }
+    }
+
 }
@@ -0,0 +1,59 @@
+
+package schwalbe.ventura.bigton.runtime
+
+import java.nio.ByteBuffer
+
+object BigtonProgramN {
+
+    @JvmStatic external fun load(
+        rawProgramBuf: ByteBuffer,
+        rawProgramOffset: Int,
+        rawProgramLength: Int
+    ): Long
+    @JvmStatic external fun loadFile(path: String): Long
+    @JvmStatic external fun free(programHandle: Long)
+
+    @JvmStatic external fun getError(programHandle: Long): Int
+    @JvmStatic external fun getHash(programHandle: Long): Long
+
+}
+
+/**
+ * Parsed BIGTON program that may be shared by any number of runtimes.
+ * Loading the same program bytes multiple times results in the same
+ * underlying native program, and each runtime created from a program keeps
+ * it alive until the runtime is closed, meaning that the program may be
+ * closed as soon as no more runtimes need to be created from it.
+ */
+class BigtonProgram private constructor(
+    val handle: Long
+) : AutoCloseable {
+
+    companion object {
+        /**
+         * Maps the program file at the given path into memory instead of
+         * reading it, returning null if the file could not be opened.
+         * Programs loaded from files are not shared with other programs.
+         */
+        fun loadFile(path: String): BigtonProgram? {
+            val handle: Long = BigtonProgramN.loadFile(path)
+            if (handle == 0L) { return null }
+            return BigtonProgram(handle)
+        }
+    }
+
+    constructor(program: ByteBuffer) : this(BigtonProgramN.load(
+        program, program.position(), program.remaining()
+    ))
+
+    override fun close() = BigtonProgramN.free(this.handle)
+
+}
+
+val BigtonProgram.error: BigtonRuntimeError
+    get() = BigtonRuntimeError.allTypes
+        .getOrNull(BigtonProgramN.getError(this.handle))
+        ?: BigtonRuntimeError.NONE
+
+val BigtonProgram.contentHash: Long
+    get() = BigtonProgramN.getHash(this.handle)
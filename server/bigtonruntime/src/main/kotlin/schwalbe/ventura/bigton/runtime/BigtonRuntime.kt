@@ -12,10 +12,32 @@ object BigtonRuntimeN {
         tickInstructionLimit: Long,
         memoryUsageLimit: Long,
         maxCallDepth: Int,
-        maxTupleSize: Int
+        maxTupleSize: Int,
+        tickFreeBudget: Long
     ): Long
+    @JvmStatic external fun createFromProgram(
+        programHandle: Long,
+        tickInstructionLimit: Long,
+        memoryUsageLimit: Long,
+        maxCallDepth: Int,
+        maxTupleSize: Int,
+        tickFreeBudget: Long
+    ): Long
+    @JvmStatic external fun restore(
+        programHandle: Long, snapshot: ByteArray
+    ): Long
+    @JvmStatic external fun fork(runtimeHandle: Long): Long
     @JvmStatic external fun free(runtimeHandle: Long)
     
+    @JvmStatic external fun snapshot(runtimeHandle: Long): ByteArray
+    @JvmStatic external fun hibernate(
+        runtimeHandle: Long, compress: Boolean
+    ): Boolean
+    @JvmStatic external fun isHibernated(runtimeHandle: Long): Boolean
+    @JvmStatic external fun compact(runtimeHandle: Long): LongArray
+    @JvmStatic external fun collectCycles(runtimeHandle: Long): Boolean
+    @JvmStatic external fun getCycleStats(runtimeHandle: Long): LongArray
+    
     @JvmStatic external fun debugLoadedProgram(runtimeHandle: Long)
     
     @JvmStatic external fun addLogLine(
@@ -53,6 +75,7 @@ object BigtonRuntimeN {
     @JvmStatic external fun getCurrentFile(runtimeHandle: Long): Int
     @JvmStatic external fun getCurrentLine(runtimeHandle: Long): Int
     @JvmStatic external fun getUsedMemory(runtimeHandle: Long): Long
+    @JvmStatic external fun getPeakMemory(runtimeHandle: Long): Long
     @JvmStatic external fun getUsedInstrCost(runtimeHandle: Long): Long
     
     @JvmStatic external fun getError(runtimeHandle: Long): Int
@@ -62,18 +85,40 @@ object BigtonRuntimeN {
     
     @JvmStatic external fun startTick(runtimeHandle: Long)
     @JvmStatic external fun executeBatch(runtimeHandle: Long): Int
+    @JvmStatic external fun executeMany(
+        runtimeHandlesBuf: ByteBuffer,
+        count: Int,
+        startTick: Boolean,
+        resultsBuf: ByteBuffer
+    )
     
 }
 
-class BigtonRuntime(
-    program: ByteBuffer,
-    tickInstructionLimit: Long,
-    memoryUsageLimit: Long,
-    maxCallDepth: Int,
-    maxTupleSize: Int
+/**
+ * Runtime executing a BIGTON program.
+ * Runtimes created from the same program with the same settings share the
+ * state reached after the global section of the program has been executed
+ * up to its first yield, meaning that the global section is only executed
+ * once for all of them. This is not observable by the host, as long as a
+ * new runtime is executed before interacting with it in any other way.
+ * Closed runtimes are reset and reused for runtimes later created from the
+ * same program, which is why runtimes should always be closed once they are
+ * no longer needed. Values obtained from a runtime may not be used after it
+ * has been closed.
+ */
+class BigtonRuntime private constructor(
+    val handle: Long
 ) : AutoCloseable {
     
-    companion object;
+    companion object {
+        /**
+         * Default budget for freeing values at the start of each tick, with
+         * freeing a value costing one plus the number of values it
+         * references. Values are always freed immediately once the memory
+         * usage limit has been exceeded.
+         */
+        const val DEFAULT_TICK_FREE_BUDGET: Long = 1L shl 16
+    }
     
     data class TraceEntry(
         val name: BigtonConstStr,
@@ -82,16 +127,120 @@ class BigtonRuntime(
     )
     
     
-    val handle: Long = BigtonRuntimeN.create(
+    constructor(
+        program: ByteBuffer,
+        tickInstructionLimit: Long,
+        memoryUsageLimit: Long,
+        maxCallDepth: Int,
+        maxTupleSize: Int,
+        tickFreeBudget: Long = DEFAULT_TICK_FREE_BUDGET
+    ) : this(BigtonRuntimeN.create(
         program, program.position(), program.remaining(),
         tickInstructionLimit, memoryUsageLimit,
-        maxCallDepth, maxTupleSize
-    )
+        maxCallDepth, maxTupleSize, tickFreeBudget
+    ))
+    
+    constructor(
+        program: BigtonProgram,
+        tickInstructionLimit: Long,
+        memoryUsageLimit: Long,
+        maxCallDepth: Int,
+        maxTupleSize: Int,
+        tickFreeBudget: Long = DEFAULT_TICK_FREE_BUDGET
+    ) : this(BigtonRuntimeN.createFromProgram(
+        program.handle,
+        tickInstructionLimit, memoryUsageLimit,
+        maxCallDepth, maxTupleSize, tickFreeBudget
+    ))
+    
+    /**
+     * Restores a runtime from a snapshot previously made using
+     * [BigtonRuntime.snapshot] with the same program. If the snapshot is
+     * invalid or belongs to a different program, the error of the created
+     * runtime is [BigtonRuntimeError.INT_INVALID_SNAPSHOT].
+     */
+    constructor(
+        program: BigtonProgram,
+        snapshot: ByteArray
+    ) : this(BigtonRuntimeN.restore(program.handle, snapshot))
+    
+    /**
+     * Creates a copy of this runtime in its current state. Objects and arrays
+     * are shared between the two runtimes until either of them modifies
+     * them, making forking cheap regardless of the memory used by the
+     * runtime. Runtimes sharing memory may not be executed concurrently with
+     * closing any of the others.
+     */
+    fun fork(): BigtonRuntime = BigtonRuntime(BigtonRuntimeN.fork(this.handle))
     
     override fun close() = BigtonRuntimeN.free(this.handle)
 
 }
 
+/**
+ * Captures the complete state of the runtime in a compact binary form
+ * that can later be restored using the [BigtonRuntime] constructor.
+ * Values only referenced by the host are not included.
+ */
+fun BigtonRuntime.snapshot(): ByteArray
+    = BigtonRuntimeN.snapshot(this.handle)
+
+/**
+ * Stores the runtime in a compact (optionally compressed) form and frees
+ * all memory used by its values until it is next used, at which point it is
+ * restored automatically. Runtimes are only hibernated while no values
+ * obtained from them are still alive (not closed), meaning that this returns
+ * false without changing the runtime otherwise.
+ */
+fun BigtonRuntime.hibernate(compress: Boolean = true): Boolean
+    = BigtonRuntimeN.hibernate(this.handle, compress)
+
+val BigtonRuntime.isHibernated: Boolean
+    get() = BigtonRuntimeN.isHibernated(this.handle)
+
+data class BigtonCompactionStats(
+    val movedBuffers: Long,
+    val movedBytes: Long,
+    val reclaimedBytes: Long,
+    val elapsedNanos: Long
+)
+
+/**
+ * Moves all values of the runtime (and values obtained from it) into
+ * contiguous blocks of memory, trimming unused array capacity. Memory shared
+ * with forked runtimes is left in place. Has no effect on hibernated runtimes.
+ */
+fun BigtonRuntime.compact(): BigtonCompactionStats {
+    val stats = BigtonRuntimeN.compact(this.handle)
+    return BigtonCompactionStats(stats[0], stats[1], stats[2], stats[3])
+}
+
+/**
+ * Frees all values of the runtime that are only kept alive by reference
+ * cycles. The runtime also does this on its own at the start of ticks,
+ * visiting a limited number of values each tick.
+ */
+fun BigtonRuntime.collectCycles() {
+    BigtonRuntimeN.collectCycles(this.handle)
+}
+
+data class BigtonCycleStats(
+    val collections: Long,
+    val abortedCollections: Long,
+    val collectedCycles: Long,
+    val collectedValues: Long,
+    val totalPauseNanos: Long,
+    val maxPauseNanos: Long
+)
+
+val BigtonRuntime.cycleStats: BigtonCycleStats
+    get() {
+        val stats = BigtonRuntimeN.getCycleStats(this.handle)
+        return BigtonCycleStats(
+            stats[0], stats[1], stats[2], stats[3], stats[4], stats[5]
+        )
+    }
+
 fun BigtonRuntime.debugLoadedProgram()
     = BigtonRuntimeN.debugLoadedProgram(this.handle)
 
@@ -155,6 +304,10 @@ val BigtonRuntime.currentLine: Int
 val BigtonRuntime.usedMemory: Long
     get() = BigtonRuntimeN.getUsedMemory(this.handle)
 
+/** Highest memory usage of the runtime since it was created or reset. */
+val BigtonRuntime.peakMemory: Long
+    get() = BigtonRuntimeN.getPeakMemory(this.handle)
+
 val BigtonRuntime.usedInstrCost: Long
     get() = BigtonRuntimeN.getUsedInstrCost(this.handle)
     
@@ -173,17 +326,11 @@ fun BigtonRuntime.startTick()
 
 fun BigtonRuntime.executeBatch(): BigtonExecStatus {
     val status: Int = BigtonRuntimeN.executeBatch(this.handle)
-    return when (status) {
-        BigtonExecStatusType.CONTINUE -> BigtonExecStatus.Continue
-        BigtonExecStatusType.EXEC_BUILTIN_FUN -> {
-            val id: Int = BigtonRuntimeN.getAwaitingBuiltinId(this.handle)
-            BigtonExecStatus.ExecBuiltinFun(id)
-        }
-        BigtonExecStatusType.AWAIT_TICK -> BigtonExecStatus.AwaitTick
-        BigtonExecStatusType.COMPLETE -> BigtonExecStatus.Complete
-        BigtonExecStatusType.ERROR -> BigtonExecStatus.Error(this.error)
-        else -> throw IllegalStateException(
-            "C runtime returned invalid execution status"
-        )
-    }
+    return BigtonExecStatus.fromNative(
+        status,
+        awaitingBuiltinId = {
+            BigtonRuntimeN.getAwaitingBuiltinId(this.handle)
+        },
+        error = { this.error }
+    )
 }
\ No newline at end of file
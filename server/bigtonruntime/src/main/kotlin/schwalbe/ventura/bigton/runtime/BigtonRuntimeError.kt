@@ -21,6 +21,8 @@ enum class BigtonRuntimeError {
     EXCEEDED_MAXIMUM_CALL_DEPTH,
     TUPLE_TOO_BIG,
     EXCEEDED_MEMORY_LIMIT,
+    OPERAND_NOT_MAP,
+    TUPLE_LENGTH_MISMATCH,
     
     INT_INCOMPLETE_PROGRAM,
     INT_INVALID_CONST_STRING,
@@ -33,7 +35,10 @@ enum class BigtonRuntimeError {
     INT_SHAPE_PROP_IDX_OOB,
     INT_SHAPE_ID_OOB,
     INT_BUILTIN_FUN_REF_INVALID,
-    INT_FUN_REF_INVALID;
+    INT_FUN_REF_INVALID,
+    INT_MISALIGNED_PROGRAM,
+    INT_CORRUPTED_PROGRAM,
+    INT_INVALID_SNAPSHOT;
     
     companion object {
         val allTypes = BigtonRuntimeError.values()
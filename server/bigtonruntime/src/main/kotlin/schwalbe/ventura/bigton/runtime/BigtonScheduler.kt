@@ -0,0 +1,54 @@
+
+package schwalbe.ventura.bigton.runtime
+
+import java.nio.ByteBuffer
+
+object BigtonSchedulerN {
+
+    @JvmStatic external fun create(numThreads: Int): Long
+    @JvmStatic external fun free(schedulerHandle: Long)
+
+    @JvmStatic external fun getNumThreads(schedulerHandle: Long): Int
+
+    @JvmStatic external fun execute(
+        schedulerHandle: Long,
+        runtimeHandlesBuf: ByteBuffer,
+        count: Int,
+        startTick: Boolean,
+        resultsBuf: ByteBuffer
+    )
+
+    @JvmStatic external fun snapshotMany(
+        schedulerHandle: Long,
+        runtimeHandles: LongArray
+    ): Array<ByteArray>
+
+}
+
+/**
+ * Pool of native worker threads that execute the runtimes of a
+ * [BigtonExecBatch] in parallel using work stealing.
+ * The results of an execution do not depend on the number of threads.
+ * A single scheduler may only be used by one thread at a time.
+ */
+class BigtonScheduler(
+    numThreads: Int = Runtime.getRuntime().availableProcessors()
+) : AutoCloseable {
+
+    val handle: Long = BigtonSchedulerN.create(numThreads)
+
+    override fun close() = BigtonSchedulerN.free(this.handle)
+
+}
+
+val BigtonScheduler.numThreads: Int
+    get() = BigtonSchedulerN.getNumThreads(this.handle)
+
+/**
+ * Takes a snapshot of each of the given runtimes (see [BigtonRuntime.snapshot])
+ * in parallel. None of the runtimes may be executed while this is in progress.
+ */
+fun BigtonScheduler.snapshotAll(runtimes: List<BigtonRuntime>): List<ByteArray>
+    = BigtonSchedulerN.snapshotMany(
+        this.handle, LongArray(runtimes.size) { i -> runtimes[i].handle }
+    ).asList()
@@ -18,11 +18,15 @@ object BigtonValueN {
         const val TUPLE     = 4
         const val OBJECT    = 5
         const val ARRAY     = 6
+        const val MAP       = 7
     }
     
     @JvmStatic external fun free(handle: Long)
     
     @JvmStatic external fun getType(handle: Long): Int
+    @JvmStatic external fun valuesEqual(
+        handleA: Long, handleB: Long
+    ): Boolean
     
     @JvmStatic external fun createNull(): Long
     
@@ -67,7 +71,7 @@ object BigtonValueN {
     ): Long
     @JvmStatic external fun setObjectPropValue(
         handle: Long, propHandle: Int, valueHandle: Long
-    )
+    ): Boolean
 
     @JvmStatic external fun createArray(
         length: Int, runtimeHandle: Long
@@ -75,10 +79,10 @@ object BigtonValueN {
     @JvmStatic external fun getArrayLength(handle: Long): Int
     @JvmStatic external fun setArrayAt(
         handle: Long, index: Int, valueHandle: Long
-    )
+    ): Boolean
     @JvmStatic external fun insertArrayAt(
         handle: Long, index: Int, valueHandle: Long, runtimeHandle: Long
-    )
+    ): Boolean
     @JvmStatic external fun removeArrayAt(handle: Long, index: Int): Long
     @JvmStatic external fun getArrayAt(handle: Long, index: Int): Long
     @JvmStatic external fun concatArrays(
@@ -87,6 +91,16 @@ object BigtonValueN {
     @JvmStatic external fun sliceArray(
         handle: Long, startIdx: Int, endIdx: Int, runtimeHandle: Long
     ): Long
+
+    @JvmStatic external fun createMap(runtimeHandle: Long): Long
+    @JvmStatic external fun getMapLength(handle: Long): Int
+    @JvmStatic external fun hasMapKey(handle: Long, keyHandle: Long): Boolean
+    @JvmStatic external fun getMapValue(handle: Long, keyHandle: Long): Long
+    @JvmStatic external fun setMapValue(
+        handle: Long, keyHandle: Long, valueHandle: Long, runtimeHandle: Long
+    ): Boolean
+    @JvmStatic external fun removeMapValue(handle: Long, keyHandle: Long): Long
+    @JvmStatic external fun getMapKeys(handle: Long, runtimeHandle: Long): Long
     
     fun wrapHandle(handle: Long): BigtonValue {
         return when (BigtonValueN.getType(handle)) {
@@ -97,6 +111,7 @@ object BigtonValueN {
             ValueType.TUPLE -> BigtonTuple(handle)
             ValueType.OBJECT -> BigtonObject(handle)
             ValueType.ARRAY -> BigtonArray(handle)
+            ValueType.MAP -> BigtonMap(handle)
             else -> BigtonNull(handle) // <- THIS SHOULD NEVER HAPPEN!
         }
     }
@@ -108,14 +123,36 @@ sealed class BigtonValue(val handle: Long): AutoCloseable {
     
 }
 
+/**
+ * Thrown when creating a value would make the runtime exceed its memory usage
+ * limit, in which case the runtime is also put into the
+ * [BigtonRuntimeError.EXCEEDED_MEMORY_LIMIT] error state.
+ */
+class BigtonMemoryLimitException
+    : RuntimeException("BIGTON runtime memory usage limit exceeded")
+
+private fun checkCreated(handle: Long): Long {
+    if (handle == 0L) { throw BigtonMemoryLimitException() }
+    return handle
+}
+
 val BigtonValue.isTruthy: Boolean
     get() = when (this) {
         is BigtonNull -> false
         is BigtonInt -> this.value != 0L
         is BigtonFloat -> this.value != 0.0 && !this.value.isNaN()
-        is BigtonString, is BigtonTuple, is BigtonObject, is BigtonArray -> true
+        is BigtonString, is BigtonTuple, is BigtonObject, is BigtonArray,
+            is BigtonMap -> true
     }
 
+/**
+ * Compares two values the same way the '==' operator of the language does,
+ * meaning that strings and tuples are compared by their contents while
+ * objects, arrays and maps are compared by identity.
+ */
+infix fun BigtonValue.valueEquals(other: BigtonValue): Boolean
+    = BigtonValueN.valuesEqual(this.handle, other.handle)
+
 
 class BigtonNull(handle: Long) : BigtonValue(handle) { companion object }
 
@@ -144,7 +181,9 @@ val BigtonFloat.value: Double
 class BigtonString(handle: Long) : BigtonValue(handle) { companion object }
 
 fun BigtonString.Companion.fromValue(value: String, runtime: BigtonRuntime)
-    = BigtonString(BigtonValueN.createString(value, runtime.handle))
+    = BigtonString(checkCreated(
+        BigtonValueN.createString(value, runtime.handle)
+    ))
 
 val BigtonString.length: Int
     get() = BigtonValueN.getStringLength(this.handle)
@@ -154,9 +193,9 @@ val BigtonString.value: String
 
 fun BigtonString.Companion.concat(
     a: BigtonString, b: BigtonString, runtime: BigtonRuntime
-) = BigtonString(BigtonValueN.concatStrings(
-    a.handle, b.handle, runtime.handle)
-)
+) = BigtonString(checkCreated(BigtonValueN.concatStrings(
+    a.handle, b.handle, runtime.handle
+)))
 
 fun BigtonString.slice(
     startIdx: Int, endIdx: Int, runtime: BigtonRuntime
@@ -165,9 +204,9 @@ fun BigtonString.slice(
     require(startIdx in 0..thisLength)
     require(endIdx in 0..thisLength)
     require(startIdx <= endIdx)
-    return BigtonString(BigtonValueN.sliceString(
+    return BigtonString(checkCreated(BigtonValueN.sliceString(
         this.handle, startIdx, endIdx, runtime.handle
-    ))
+    )))
 }
 
 
@@ -176,7 +215,9 @@ class BigtonTuple(handle: Long) : BigtonValue(handle) { companion object }
 fun BigtonTuple.Companion.fromElements(
     values: Iterable<BigtonValue>, runtime: BigtonRuntime
 ): BigtonTuple {
-    val handle: Long = BigtonValueN.createTuple(values.count(), runtime.handle)
+    val handle: Long = checkCreated(
+        BigtonValueN.createTuple(values.count(), runtime.handle)
+    )
     for ((i, v) in values.withIndex()) {
         BigtonValueN.setTupleAt(handle, i, v.handle)
     }
@@ -242,7 +283,10 @@ operator fun BigtonObject.set(
     property: BigtonObjectProperty, value: BigtonValue
 ) {
     require(property.handle >= 0 && property.handle < this.size)
-    BigtonValueN.setObjectPropValue(this.handle, property.handle, value.handle)
+    val set: Boolean = BigtonValueN.setObjectPropValue(
+        this.handle, property.handle, value.handle
+    )
+    if (!set) { throw BigtonMemoryLimitException() }
 }
 
 
@@ -251,9 +295,14 @@ class BigtonArray(handle: Long) : BigtonValue(handle) { companion object }
 fun BigtonArray.Companion.fromElements(
     values: Iterable<BigtonValue>, runtime: BigtonRuntime
 ): BigtonArray {
-    val handle: Long = BigtonValueN.createArray(values.count(), runtime.handle)
+    val handle: Long = checkCreated(
+        BigtonValueN.createArray(values.count(), runtime.handle)
+    )
     for ((i, v) in values.withIndex()) {
-        BigtonValueN.setArrayAt(handle, i, v.handle)
+        if (!BigtonValueN.setArrayAt(handle, i, v.handle)) {
+            BigtonValueN.free(handle)
+            throw BigtonMemoryLimitException()
+        }
     }
     return BigtonArray(handle)
 }
@@ -269,7 +318,10 @@ operator fun BigtonArray.get(index: Int): BigtonValue {
 
 operator fun BigtonArray.set(index: Int, value: BigtonValue) {
     require(index >= 0 && index < this.length)
-    BigtonValueN.setArrayAt(this.handle, index, value.handle)
+    val set: Boolean = BigtonValueN.setArrayAt(
+        this.handle, index, value.handle
+    )
+    if (!set) { throw BigtonMemoryLimitException() }
 }
 
 val BigtonArray.values: Sequence<BigtonValue>
@@ -277,9 +329,9 @@ val BigtonArray.values: Sequence<BigtonValue>
 
 fun BigtonArray.Companion.concat(
     a: BigtonArray, b: BigtonArray, runtime: BigtonRuntime
-) = BigtonArray(BigtonValueN.concatArrays(
+) = BigtonArray(checkCreated(BigtonValueN.concatArrays(
     a.handle, b.handle, runtime.handle
-))
+)))
 
 fun BigtonArray.slice(
     startIdx: Int, endIdx: Int, runtime: BigtonRuntime
@@ -288,26 +340,66 @@ fun BigtonArray.slice(
     require(startIdx in 0..thisLength)
     require(endIdx in 0..thisLength)
     require(startIdx <= endIdx)
-    return BigtonArray(BigtonValueN.sliceArray(
+    return BigtonArray(checkCreated(BigtonValueN.sliceArray(
         this.handle, startIdx, endIdx, runtime.handle
-    ))
+    )))
 }
 
 fun BigtonArray.insert(index: Int, value: BigtonValue, runtime: BigtonRuntime) {
     require(index in 0..this.length)
-    BigtonValueN.insertArrayAt(
+    val inserted: Boolean = BigtonValueN.insertArrayAt(
         this.handle, index, value.handle, runtime.handle
     )
+    if (!inserted) { throw BigtonMemoryLimitException() }
 }
 
 fun BigtonArray.remove(index: Int): BigtonValue {
     require(index in 0..<this.length)
     return BigtonValueN.wrapHandle(
-        BigtonValueN.removeArrayAt(this.handle, index)
+        checkCreated(BigtonValueN.removeArrayAt(this.handle, index))
     )
 }
 
 
+class BigtonMap(handle: Long) : BigtonValue(handle) { companion object }
+
+fun BigtonMap.Companion.create(runtime: BigtonRuntime)
+    = BigtonMap(checkCreated(BigtonValueN.createMap(runtime.handle)))
+
+val BigtonMap.size: Int
+    get() = BigtonValueN.getMapLength(this.handle)
+
+operator fun BigtonMap.contains(key: BigtonValue): Boolean
+    = BigtonValueN.hasMapKey(this.handle, key.handle)
+
+operator fun BigtonMap.get(key: BigtonValue): BigtonValue? {
+    val valueHandle: Long = BigtonValueN.getMapValue(this.handle, key.handle)
+    return if (valueHandle == 0L) { null }
+        else { BigtonValueN.wrapHandle(valueHandle) }
+}
+
+fun BigtonMap.set(
+    key: BigtonValue, value: BigtonValue, runtime: BigtonRuntime
+) {
+    val set: Boolean = BigtonValueN.setMapValue(
+        this.handle, key.handle, value.handle, runtime.handle
+    )
+    if (!set) { throw BigtonMemoryLimitException() }
+}
+
+fun BigtonMap.remove(key: BigtonValue): BigtonValue? {
+    val valueHandle: Long = BigtonValueN.removeMapValue(this.handle, key.handle)
+    if (valueHandle != 0L) { return BigtonValueN.wrapHandle(valueHandle) }
+    if (key in this) { throw BigtonMemoryLimitException() }
+    return null
+}
+
+fun BigtonMap.keys(runtime: BigtonRuntime): BigtonArray
+    = BigtonArray(checkCreated(
+        BigtonValueN.getMapKeys(this.handle, runtime.handle)
+    ))
+
+
 inline fun <R> Iterable<BigtonValue?>.useAll(f: () -> R): R {
     try {
         return f()
@@ -50,6 +50,7 @@ enum class BigtonAstType {
     LOOP,           //              List<BigtonAst>
     TICK,           //              List<BigtonAst>
     WHILE,          // [cond]       List<BigtonAst>
+    FOR,            // [start, end] Pair<String, List<BigtonAst>>
     CONTINUE,
     BREAK,
     RETURN,         // [value]
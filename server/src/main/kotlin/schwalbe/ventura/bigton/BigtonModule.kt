@@ -98,6 +98,21 @@ private fun displayValue(
                 .joinToString(", ")
             "[$c]"
         }
+        is BigtonMap -> {
+            if (value.size == 0) { return "{:}" }
+            if (maxDepth == 0) { return "{...}" }
+            val c: String = value.keys(r).use { keys -> keys.values
+                .map { k -> k.use {
+                    val dispKey: String = displayValue(k, nextDepth, r)
+                    val dispValue: String = value[k]
+                        ?.use { displayValue(it, nextDepth, r) }
+                        ?: "null"
+                    "$dispKey: $dispValue"
+                } }
+                .joinToString(", ")
+            }
+            "{$c}"
+        }
     }
 }
 
@@ -287,6 +302,325 @@ private fun remove(r: BigtonRuntime) {
     }
 }
 
+/**
+ * Reads the elements of an array holding either only integers or only floats
+ * (the arrays the numeric array builtins operate on), reporting an error and
+ * returning null if the value is anything else.
+ */
+private fun numericElements(
+    name: String, value: BigtonValue, r: BigtonRuntime
+): List<Number>? {
+    if (value !is BigtonArray) {
+        runtimeError(r,
+            "'$name' expects an array, but function received something else"
+        )
+        return null
+    }
+    val elements: List<Number?> = value.values
+        .map { it.use { e -> when (e) {
+            is BigtonInt -> e.value
+            is BigtonFloat -> e.value
+            else -> null
+        } } }
+        .toList()
+    val isNumeric: Boolean = elements.all { it is Long }
+        || elements.all { it is Double }
+    if (!isNumeric) {
+        runtimeError(r,
+            "'$name' expects an array holding either only integers or only " +
+            "floats, but function received an array holding something else"
+        )
+        return null
+    }
+    return elements.map { it!! }
+}
+
+private fun pushNumber(value: Number, r: BigtonRuntime) = when (value) {
+    is Double -> BigtonFloat.fromValue(value).use(r::pushStack)
+    else -> BigtonInt.fromValue(value.toLong()).use(r::pushStack)
+}
+
+private fun pushNumbers(values: List<Number>, r: BigtonRuntime) {
+    val elements: List<BigtonValue> = values.map { when (it) {
+        is Double -> BigtonFloat.fromValue(it)
+        else -> BigtonInt.fromValue(it.toLong())
+    } }
+    elements.useAll {
+        BigtonArray.fromElements(elements, r).use(r::pushStack)
+    }
+}
+
+private fun sum(values: List<Number>): Number = when (values.firstOrNull()) {
+    is Double -> values.sumOf { it as Double }
+    else -> values.fold(0L) { acc, v -> acc + (v as Long) }
+}
+
+private fun product(a: Number, b: Number): Number = when (a) {
+    is Double -> a * (b as Double)
+    else -> (a as Long) * (b as Long)
+}
+
+/** Index of the first smallest (or largest) element, NaN never being one. */
+private fun indexOfExtremum(values: List<Number>, largest: Boolean): Int {
+    var best = 0
+    for (i in 1..<values.size) {
+        val v: Number = values[i]
+        val b: Number = values[best]
+        val isBetter: Boolean = when (v) {
+            is Double -> if (largest) v > (b as Double) else v < (b as Double)
+            else -> if (largest) (v as Long) > (b as Long)
+                else (v as Long) < (b as Long)
+        }
+        if (isBetter) { best = i }
+    }
+    return best
+}
+
+private fun numericReduction(
+    name: String, f: (List<Number>) -> Number
+): (BigtonRuntime) -> Unit = impl@{ r ->
+    val src: BigtonValue = r.popStack()
+        ?: return@impl BigtonNull.create().use(r::pushStack)
+    val values: List<Number> = src.use { numericElements(name, it, r) }
+        ?: return@impl
+    if (values.isEmpty()) { return@impl runtimeError(r,
+        "'$name' requires the given array to contain at least one value, " +
+        "but the given array was empty"
+    ) }
+    pushNumber(f(values), r)
+}
+
+private fun scale(r: BigtonRuntime) {
+    val factor: BigtonValue? = r.popStack()
+    val source: BigtonValue? = r.popStack()
+    arrayOf(source, factor).useAll {
+        if (source == null || factor == null) {
+            return BigtonNull.create().use(r::pushStack)
+        }
+        val values: List<Number> = numericElements("scale", source, r)
+            ?: return
+        val f: Number = when (factor) {
+            is BigtonInt -> factor.value
+            is BigtonFloat -> factor.value
+            else -> null
+        }
+            ?.takeIf { values.isEmpty() || it::class == values[0]::class }
+            ?: return runtimeError(r,
+                "'scale' expects the factor (second argument) to be a " +
+                "number of the same type as the elements of the given array, " +
+                "but the function received something else"
+            )
+        pushNumbers(values.map { product(it, f) }, r)
+    }
+}
+
+private fun numericPairwise(
+    name: String, f: (List<Number>, List<Number>, BigtonRuntime) -> Unit
+): (BigtonRuntime) -> Unit = impl@{ r ->
+    val bv: BigtonValue? = r.popStack()
+    val av: BigtonValue? = r.popStack()
+    arrayOf(av, bv).useAll {
+        if (av == null || bv == null) {
+            return@impl BigtonNull.create().use(r::pushStack)
+        }
+        val a: List<Number> = numericElements(name, av, r) ?: return@impl
+        val b: List<Number> = numericElements(name, bv, r) ?: return@impl
+        if (a.size != b.size) { return@impl runtimeError(r,
+            "'$name' expects both arrays to be of the same length, but " +
+            "received arrays of lengths ${a.size} and ${b.size}"
+        ) }
+        val sameType: Boolean = a.isEmpty() || a[0]::class == b[0]::class
+        if (!sameType) { return@impl runtimeError(r,
+            "'$name' expects both arrays to hold numbers of the same type, " +
+            "but received one holding integers and one holding floats"
+        ) }
+        f(a, b, r)
+    }
+}
+
+/**
+ * Members of a tuple operand of an element-wise tuple function, with a number
+ * being repeated to pair it with each member of the other operand.
+ */
+private fun numericMembers(value: BigtonValue, length: Int): List<Number?> =
+    when (value) {
+        is BigtonTuple -> value.values
+            .map { it.use { m -> when (m) {
+                is BigtonInt -> m.value
+                is BigtonFloat -> m.value
+                else -> null
+            } } }
+            .toList()
+        is BigtonInt -> List(length) { value.value }
+        is BigtonFloat -> List(length) { value.value }
+        else -> List(length) { null }
+    }
+
+private fun tupleArithmetic(
+    name: String,
+    intOp: (Long, Long) -> Long?, floatOp: (Double, Double) -> Double
+): (BigtonRuntime) -> Unit = impl@{ r ->
+    val bv: BigtonValue? = r.popStack()
+    val av: BigtonValue? = r.popStack()
+    arrayOf(av, bv).useAll {
+        if (av == null || bv == null) {
+            return@impl BigtonNull.create().use(r::pushStack)
+        }
+        val length: Int = when {
+            av is BigtonTuple -> av.length
+            bv is BigtonTuple -> bv.length
+            else -> return@impl runtimeError(r,
+                "'$name' expects at least one of its arguments to be a " +
+                "tuple, but function received something else"
+            )
+        }
+        if (av is BigtonTuple && bv is BigtonTuple && bv.length != length) {
+            return@impl runtimeError(r,
+                "'$name' expects both tuples to be of the same length, but " +
+                "received tuples of lengths $length and ${bv.length}"
+            )
+        }
+        val a: List<Number?> = numericMembers(av, length)
+        val b: List<Number?> = numericMembers(bv, length)
+        val results: List<Number> = a.indices.map { i ->
+            val x: Number? = a[i]
+            val y: Number? = b[i]
+            when {
+                x is Long && y is Long -> intOp(x, y)
+                    ?: return@impl runtimeError(r,
+                        "'$name' attempted to divide an integer by zero"
+                    )
+                x is Double && y is Double -> floatOp(x, y)
+                else -> return@impl runtimeError(r,
+                    "'$name' expects the members of the tuples to be numbers " +
+                    "of the same type, but function received something else"
+                )
+            }
+        }
+        val members: List<BigtonValue> = results.map { when (it) {
+            is Double -> BigtonFloat.fromValue(it)
+            else -> BigtonInt.fromValue(it.toLong())
+        } }
+        members.useAll {
+            BigtonTuple.fromElements(members, r).use(r::pushStack)
+        }
+    }
+}
+
+/**
+ * Ascending order of numbers of the same type, with NaN being ordered after
+ * all other floats. Unlike [Double.compareTo] this treats '-0.0' and '0.0' as
+ * equal, matching the comparison operators of the language.
+ */
+private val numberOrder = Comparator<Number> { a, b -> when (a) {
+    is Double -> {
+        val y: Double = b as Double
+        when {
+            a < y || (y.isNaN() && !a.isNaN()) -> -1
+            y < a || (a.isNaN() && !y.isNaN()) -> 1
+            else -> 0
+        }
+    }
+    else -> (a as Long).compareTo(b as Long)
+} }
+
+private fun sort(r: BigtonRuntime) {
+    val dest: BigtonValue = r.popStack()
+        ?: return BigtonNull.create().use(r::pushStack)
+    dest.use {
+        val values: List<Number> = numericElements("sort", dest, r) ?: return
+        val array = dest as BigtonArray
+        for ((i, v) in values.sortedWith(numberOrder).withIndex()) {
+            val element: BigtonValue = when (v) {
+                is Double -> BigtonFloat.fromValue(v)
+                else -> BigtonInt.fromValue(v.toLong())
+            }
+            element.use { array[i] = it }
+        }
+        BigtonNull.create().use(r::pushStack)
+    }
+}
+
+private fun binarySearch(r: BigtonRuntime) {
+    val value: BigtonValue? = r.popStack()
+    val source: BigtonValue? = r.popStack()
+    arrayOf(source, value).useAll {
+        if (source == null || value == null) {
+            return BigtonNull.create().use(r::pushStack)
+        }
+        if (source !is BigtonArray) { return runtimeError(r,
+            "'binarySearch' expects the searched container (first " +
+            "argument) to be an array, but function received something else"
+        ) }
+        val v: Number = when (value) {
+            is BigtonInt -> value.value
+            is BigtonFloat -> value.value
+            else -> return runtimeError(r,
+                "'binarySearch' expects the searched value (second " +
+                "argument) to be a number, but function received " +
+                "something else"
+            )
+        }
+        var low = 0
+        var high: Int = source.length
+        while (low < high) {
+            val mid: Int = low + (high - low) / 2
+            val e: Number? = source[mid].use { when (it) {
+                is BigtonInt -> it.value
+                is BigtonFloat -> it.value
+                else -> null
+            } }
+            if (e == null || e::class != v::class) { return runtimeError(r,
+                "'binarySearch' expects the searched array to only hold " +
+                "numbers of the same type as the searched value, but the " +
+                "given array holds something else"
+            ) }
+            if (numberOrder.compare(e, v) < 0) { low = mid + 1 }
+            else { high = mid }
+        }
+        val found: Boolean = low < source.length
+            && source[low].use { it valueEquals value }
+        val result: Int = if (found) low else -low - 1
+        BigtonInt.fromValue(result.toLong()).use(r::pushStack)
+    }
+}
+
+private fun indexOf(
+    name: String, f: (Int) -> BigtonValue
+): (BigtonRuntime) -> Unit = impl@{ r ->
+    val value: BigtonValue? = r.popStack()
+    val source: BigtonValue? = r.popStack()
+    arrayOf(source, value).useAll {
+        if (source == null || value == null) {
+            return@impl BigtonNull.create().use(r::pushStack)
+        }
+        if (source !is BigtonArray) { return@impl runtimeError(r,
+            "'$name' expects the searched container (first argument) " +
+            "to be an array, but function received something else"
+        ) }
+        val i: Int = source.values
+            .indexOfFirst { it.use { e -> e valueEquals value } }
+        f(i).use(r::pushStack)
+    }
+}
+
+private fun mapLookup(
+    name: String, f: (BigtonMap, BigtonValue) -> BigtonValue
+): (BigtonRuntime) -> Unit = impl@{ r ->
+    val key: BigtonValue? = r.popStack()
+    val source: BigtonValue? = r.popStack()
+    arrayOf(source, key).useAll {
+        if (source == null || key == null) {
+            return@impl BigtonNull.create().use(r::pushStack)
+        }
+        if (source !is BigtonMap) { return@impl runtimeError(r,
+            "'$name' expects the searched container (first argument) " +
+            "to be a map, but function received something else"
+        ) }
+        f(source, key).use(r::pushStack)
+    }
+}
+
 class BigtonModules<C> {
     
     val functions = BigtonBuiltinFunctions<C>()
@@ -403,6 +737,121 @@ class BigtonModules<C> {
                 src.remove(srcLen - 1).use(r::pushStack)
             }
         }
+        .withFunction("sum", cost = 1, argc = 1) { r ->
+            val src: BigtonValue = r.popStack()
+                ?: return@withFunction BigtonNull.create().use(r::pushStack)
+            src.use { numericElements("sum", it, r) }
+                ?.let { pushNumber(sum(it), r) }
+        }
+        .withFunction("min", cost = 1, argc = 1, numericReduction("min") {
+            it[indexOfExtremum(it, largest = false)]
+        })
+        .withFunction("max", cost = 1, argc = 1, numericReduction("max") {
+            it[indexOfExtremum(it, largest = true)]
+        })
+        .withFunction("argmin", cost = 1, argc = 1,
+            numericReduction("argmin") {
+                indexOfExtremum(it, largest = false).toLong()
+            }
+        )
+        .withFunction("scale", cost = 1, argc = 2, ::scale)
+        .withFunction("add", cost = 1, argc = 2,
+            numericPairwise("add") { a, b, r ->
+                pushNumbers(a.indices.map { i -> when (val x: Number = a[i]) {
+                    is Double -> x + (b[i] as Double)
+                    else -> (x as Long) + (b[i] as Long)
+                } }, r)
+            }
+        )
+        .withFunction("dot", cost = 1, argc = 2,
+            numericPairwise("dot") { a, b, r ->
+                pushNumber(sum(a.indices.map { i -> product(a[i], b[i]) }), r)
+            }
+        )
+        .withFunction("sort", cost = 1, argc = 1, ::sort)
+        .withFunction("binarySearch", cost = 1, argc = 2, ::binarySearch)
+        .withFunction("indexOf", cost = 1, argc = 2, indexOf("indexOf") {
+            BigtonInt.fromValue(it.toLong())
+        })
+        .withFunction("contains", cost = 1, argc = 2, indexOf("contains") {
+            BigtonInt.fromValue(if (it >= 0) 1L else 0L)
+        })
+        .withFunction("map", cost = 1, argc = 0) { r ->
+            BigtonMap.create(r).use(r::pushStack)
+        }
+        .withFunction("get", cost = 1, argc = 2, mapLookup("get") { m, k ->
+            m[k] ?: BigtonNull.create()
+        })
+        .withFunction("has", cost = 1, argc = 2, mapLookup("has") { m, k ->
+            BigtonInt.fromValue(if (k in m) 1L else 0L)
+        })
+        .withFunction("set", cost = 1, argc = 3) { r ->
+            val value: BigtonValue? = r.popStack()
+            val key: BigtonValue? = r.popStack()
+            val dest: BigtonValue? = r.popStack()
+            arrayOf(dest, key, value).useAll {
+                if (dest == null || key == null || value == null) {
+                    return@withFunction BigtonNull.create().use(r::pushStack)
+                }
+                if (dest !is BigtonMap) { return@withFunction runtimeError(r,
+                    "'set' expects the destination container (first " +
+                    "argument) to be a map, but function received " +
+                    "something else"
+                ) }
+                dest.set(key, value, r)
+                BigtonNull.create().use(r::pushStack)
+            }
+        }
+        .withFunction("keys", cost = 1, argc = 1) { r ->
+            val src: BigtonValue = r.popStack()
+                ?: return@withFunction BigtonNull.create().use(r::pushStack)
+            src.use {
+                if (src !is BigtonMap) { return@withFunction runtimeError(r,
+                    "'keys' expects the given source container " +
+                    "to be a map, but function received something else"
+                ) }
+                src.keys(r).use(r::pushStack)
+            }
+        }
+        .withFunction("size", cost = 1, argc = 1) { r ->
+            val src: BigtonValue = r.popStack()
+                ?: return@withFunction BigtonNull.create().use(r::pushStack)
+            src.use {
+                if (src !is BigtonMap) { return@withFunction runtimeError(r,
+                    "'size' expects the given source container " +
+                    "to be a map, but function received something else"
+                ) }
+                BigtonInt.fromValue(src.size.toLong()).use(r::pushStack)
+            }
+        }
+        .withFunction("unset", cost = 1, argc = 2) { r ->
+            val key: BigtonValue? = r.popStack()
+            val src: BigtonValue? = r.popStack()
+            arrayOf(src, key).useAll {
+                if (src == null || key == null) {
+                    return@withFunction BigtonNull.create().use(r::pushStack)
+                }
+                if (src !is BigtonMap) { return@withFunction runtimeError(r,
+                    "'unset' expects the source container (first " +
+                    "argument) to be a map, but function received " +
+                    "something else"
+                ) }
+                (src.remove(key) ?: BigtonNull.create()).use(r::pushStack)
+            }
+        }
+        .withFunction("vecAdd", cost = 1, argc = 2,
+            tupleArithmetic("vecAdd", { a, b -> a + b }, { a, b -> a + b })
+        )
+        .withFunction("vecSub", cost = 1, argc = 2,
+            tupleArithmetic("vecSub", { a, b -> a - b }, { a, b -> a - b })
+        )
+        .withFunction("vecMul", cost = 1, argc = 2,
+            tupleArithmetic("vecMul", { a, b -> a * b }, { a, b -> a * b })
+        )
+        .withFunction("vecDiv", cost = 1, argc = 2, tupleArithmetic(
+            "vecDiv",
+            { a, b -> if (b == 0L) null else a / b }, { a, b -> a / b }
+        ))
 
     val floatingPoint = BigtonModule(functions)
         .withFunction("toFloat", cost = 1, argc = 1, ::parseFloat)
@@ -300,6 +300,37 @@ fun BigtonParser.parseStatement(): BigtonAst {
                 BigtonAstType.WHILE, start.source, body, listOf(cond)
             )
         }
+        BigtonTokenType.KEYWORD_FOR -> {
+            this.advance()
+            if (this.curr.type != BigtonTokenType.IDENTIFIER) {
+                throw BigtonException(
+                    BigtonErrorType.MISSING_EXPECTED_LOOP_VARIABLE_NAME,
+                    this.curr.source
+                )
+            }
+            val name: String = this.curr.content
+            this.advance()
+            if (this.curr.type != BigtonTokenType.EQUALS) {
+                throw BigtonException(
+                    BigtonErrorType.MISSING_EXPECTED_VAR_EQUALS,
+                    this.curr.source
+                )
+            }
+            this.advance()
+            val rangeStart: BigtonAst = this.parseExpression()
+            if (this.curr.type != BigtonTokenType.COMMA) {
+                throw BigtonException(
+                    BigtonErrorType.MISSING_EXPECTED_COMMA, this.curr.source
+                )
+            }
+            this.advance()
+            val rangeEnd: BigtonAst = this.parseExpression()
+            val body: List<BigtonAst> = this.parseBracedStatementList()
+            return BigtonAst(
+                BigtonAstType.FOR, start.source, Pair(name, body),
+                listOf(rangeStart, rangeEnd)
+            )
+        }
         BigtonTokenType.KEYWORD_VAR -> {
             this.advance()
             if (this.curr.type != BigtonTokenType.IDENTIFIER) {
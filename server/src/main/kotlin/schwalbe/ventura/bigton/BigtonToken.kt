@@ -36,6 +36,7 @@ enum class BigtonTokenType {
     KEYWORD_FUN,
     KEYWORD_LOOP,
     KEYWORD_WHILE,
+    KEYWORD_FOR,
     KEYWORD_TICK,
     KEYWORD_CONT,
     KEYWORD_BREAK,
@@ -24,7 +24,7 @@ private class IdBank<T> {
 /**
  * Mirror of 'bigton_instr_type_t' in 'ir.h'
  */
-private enum class InstrType {
+internal enum class InstrType {
     SOURCE_LINE,
     SOURCE_FILE,
     DISCARD,
@@ -74,9 +74,71 @@ private enum class InstrType {
     BREAK,
     CALL,
     CALL_BUILTIN,
-    RETURN
+    RETURN,
+    
+    ARRAY_PUSH,
+    ARRAY_POP,
+    ARRAY_LENGTH,
+    ARRAY_INSERT,
+    ARRAY_REMOVE,
+    ARRAY_SUM,
+    ARRAY_MIN,
+    ARRAY_MAX,
+    ARRAY_ARGMIN,
+    ARRAY_SCALE,
+    ARRAY_ADD,
+    ARRAY_DOT,
+    ARRAY_SORT,
+    ARRAY_BINARY_SEARCH,
+    ARRAY_INDEX_OF,
+    ARRAY_CONTAINS,
+    MAP_CREATE,
+    MAP_GET,
+    MAP_SET,
+    MAP_HAS,
+    MAP_KEYS,
+    TUPLE_ADD,
+    TUPLE_SUBTRACT,
+    TUPLE_MULTIPLY,
+    TUPLE_DIVIDE,
+    FOR_RANGE,
+    MAP_SIZE,
+    MAP_REMOVE
 }
 
+/**
+ * Builtin functions that are compiled to instructions executed by the
+ * interpreter itself instead of calling into the host.
+ */
+private val nativeBuiltinInstrs: Map<String, InstrType> = mapOf(
+    "push" to InstrType.ARRAY_PUSH,
+    "pop" to InstrType.ARRAY_POP,
+    "insert" to InstrType.ARRAY_INSERT,
+    "remove" to InstrType.ARRAY_REMOVE,
+    "sum" to InstrType.ARRAY_SUM,
+    "min" to InstrType.ARRAY_MIN,
+    "max" to InstrType.ARRAY_MAX,
+    "argmin" to InstrType.ARRAY_ARGMIN,
+    "scale" to InstrType.ARRAY_SCALE,
+    "add" to InstrType.ARRAY_ADD,
+    "dot" to InstrType.ARRAY_DOT,
+    "sort" to InstrType.ARRAY_SORT,
+    "binarySearch" to InstrType.ARRAY_BINARY_SEARCH,
+    "indexOf" to InstrType.ARRAY_INDEX_OF,
+    "contains" to InstrType.ARRAY_CONTAINS,
+    "map" to InstrType.MAP_CREATE,
+    "get" to InstrType.MAP_GET,
+    "set" to InstrType.MAP_SET,
+    "has" to InstrType.MAP_HAS,
+    "keys" to InstrType.MAP_KEYS,
+    "size" to InstrType.MAP_SIZE,
+    "unset" to InstrType.MAP_REMOVE,
+    "vecAdd" to InstrType.TUPLE_ADD,
+    "vecSub" to InstrType.TUPLE_SUBTRACT,
+    "vecMul" to InstrType.TUPLE_MULTIPLY,
+    "vecDiv" to InstrType.TUPLE_DIVIDE
+)
+
 private data class ProgramBuilder(
     val strings: IdBank<String> = IdBank(),
     val shapes: IdBank<List<Int>> = IdBank(),
@@ -323,6 +385,13 @@ private fun generateExpression(
                     BigtonErrorType.TOO_MANY_CALL_ARGS, ast.source
                 )
             }
+            val nativeInstr: InstrType? = nativeBuiltinInstrs[name]
+            if (isBuiltin && nativeInstr != null) {
+                // executes no other code, meaning that the current source
+                // location does not need to be restored afterwards
+                program.addNoArgInstr(nativeInstr)
+                return
+            }
             if (isBuiltin) {
                 val id: Int = ctx.program.symbols.builtinFunctions
                     .functionIds[name]!!
@@ -525,6 +594,42 @@ private fun generateStatement(
             program.instrArgs.alignTo(8)
             program.append(body)
         }
+        BigtonAstType.FOR -> {
+            val rangeStart: BigtonAst = ast.children[0]
+            val rangeEnd: BigtonAst = ast.children[1]
+            val (name, bodyAst) = ast.castArg<
+                Pair<String, List<BigtonAst>>
+            >()
+            generateExpression(rangeStart, ctx, program)
+            generateExpression(rangeEnd, ctx, program)
+            // The following BIGTON source:
+            //
+            //     for i = a, b { ... }
+            //
+            // ...behaves like the following BIGTON source, except that 'a'
+            // and 'b' are only evaluated once, 'continue' also increments
+            // 'i' and 'i' is only visible inside of the loop:
+            //
+            //     var i = a
+            //     while i < b {
+            //         ...
+            //         i = i + 1
+            //     }
+            //
+            // The bound check and increment are done by the FOR_RANGE
+            // instruction itself, which keeps the bound and 'i' as the first
+            // two locals of the loop scope.
+            val childCtx = ctx.inChildScope(isLoop = true)
+            childCtx.numLocals += 1
+            childCtx.locals[name] = childCtx.numLocals
+            childCtx.numLocals += 1
+            val body = program.child()
+            generateStatementList(bodyAst, childCtx, body)
+            program.instrTypes.add(InstrType.FOR_RANGE)
+            program.instrArgs.putInt(body.instrTypes.size)
+            program.instrArgs.alignTo(8)
+            program.append(body)
+        }
         BigtonAstType.CONTINUE -> {
             ctx.assertInLoop()
             program.addNoArgInstr(InstrType.CONTINUE)
@@ -21,7 +21,8 @@ fun compileSources(
     val unrestricted: Set<String> = allSources.mapNotNullTo(mutableSetOf()) {
         if (it.isUnrestricted) it.name else null
     }
-    return generateProgram(
+    val program: ByteArray = generateProgram(
         ast, features, unrestricted, modules, builtinFunctions
     )
+    return encodeProgramV2(program)
 }
\ No newline at end of file
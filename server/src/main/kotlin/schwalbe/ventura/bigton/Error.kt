@@ -26,6 +26,7 @@ enum class BigtonErrorType(val id: String, val message: String) {
     MISSING_EXPECTED_FUNC_ARGS_OPEN("PA013", "Expected '(' after the function name, but got something else"),
     MISSING_EXPECTED_ARGUMENT_NAME("PA014", "Expected a function argument name in the function argument list, but got something else"),
     MISSING_EXPECTED_CLOSING_BRACKET("PA015", "Expected ']' after array index, but got something else"),
+    MISSING_EXPECTED_LOOP_VARIABLE_NAME("PA016", "Expected the variable name after 'for', but got something else"),
 
     // [SC___] - Failed Static Checks
     FEATURE_UNSUPPORTED("SC001", "Feature not supported by the processor"),
@@ -57,6 +58,8 @@ enum class BigtonErrorType(val id: String, val message: String) {
     MAXIMUM_CALL_DEPTH("RT012", "Number of nested calls exceeded the maximum call depth allowed by this processor"),
     TUPLE_TOO_BIG("RT013", "Number of values contained by a created tuple exceeded the maximum allowed by the processor"),
     MAXIMUM_MEMORY_USAGE("RT014", "Out of memory"),
+    OPERAND_NOT_MAP("RT015", "The operand of this operation should be (but isn't) a map"),
+    TUPLE_LENGTH_MISMATCH("RT016", "The tuple operands of this operation should have (but don't have) the same length"),
     
     // [RT-INTERNAL___] - Internal Runtime Error
     INCOMPLETE_PROGRAM("RT-INTERNAL001", "Runtime failed to load the program"),
@@ -71,6 +74,9 @@ enum class BigtonErrorType(val id: String, val message: String) {
     SHAPE_ID_OOB("RT-INTERNAL010", "An object shape referenced by the program does not exist"),
     BUILTIN_FUN_REF_INVALID("RT-INTERNAL011", "A builtin function referenced by the program does not exist"),
     FUN_REF_INVALID("RT-INTERNAL012", "A user-defined function referenced by the program does not exist"),
+    MISALIGNED_PROGRAM("RT-INTERNAL013", "Runtime failed to load the program due to misaligned program data"),
+    CORRUPTED_PROGRAM("RT-INTERNAL014", "Runtime failed to load the program due to corrupted program data"),
+    INVALID_SNAPSHOT("RT-INTERNAL015", "Runtime failed to restore a saved program state"),
     
     // [RT-UNKOWN] - Unknown Runtime Error
     UNKNOWN("RT-UNKNOWN", "Runtime reported unknown error");
@@ -101,6 +107,8 @@ private val runtimeToStandardError: Map<BigtonRuntimeError, BigtonErrorType> = m
     BigtonRuntimeError.EXCEEDED_MAXIMUM_CALL_DEPTH  to BigtonErrorType.MAXIMUM_CALL_DEPTH,
     BigtonRuntimeError.TUPLE_TOO_BIG                to BigtonErrorType.TUPLE_TOO_BIG,
     BigtonRuntimeError.EXCEEDED_MEMORY_LIMIT        to BigtonErrorType.MAXIMUM_MEMORY_USAGE,
+    BigtonRuntimeError.OPERAND_NOT_MAP              to BigtonErrorType.OPERAND_NOT_MAP,
+    BigtonRuntimeError.TUPLE_LENGTH_MISMATCH        to BigtonErrorType.TUPLE_LENGTH_MISMATCH,
     
     BigtonRuntimeError.INT_INCOMPLETE_PROGRAM       to BigtonErrorType.INCOMPLETE_PROGRAM,
     BigtonRuntimeError.INT_INVALID_CONST_STRING     to BigtonErrorType.INVALID_CONST_STRING,
@@ -113,7 +121,10 @@ private val runtimeToStandardError: Map<BigtonRuntimeError, BigtonErrorType> = m
     BigtonRuntimeError.INT_SHAPE_PROP_IDX_OOB       to BigtonErrorType.SHAPE_PROP_IDX_OOB,
     BigtonRuntimeError.INT_SHAPE_ID_OOB             to BigtonErrorType.SHAPE_ID_OOB,
     BigtonRuntimeError.INT_BUILTIN_FUN_REF_INVALID  to BigtonErrorType.BUILTIN_FUN_REF_INVALID,
-    BigtonRuntimeError.INT_FUN_REF_INVALID          to BigtonErrorType.FUN_REF_INVALID
+    BigtonRuntimeError.INT_FUN_REF_INVALID          to BigtonErrorType.FUN_REF_INVALID,
+    BigtonRuntimeError.INT_MISALIGNED_PROGRAM       to BigtonErrorType.MISALIGNED_PROGRAM,
+    BigtonRuntimeError.INT_CORRUPTED_PROGRAM        to BigtonErrorType.CORRUPTED_PROGRAM,
+    BigtonRuntimeError.INT_INVALID_SNAPSHOT         to BigtonErrorType.INVALID_SNAPSHOT
 )
 
 fun BigtonErrorType.Companion.fromRuntimeError(
@@ -62,6 +62,7 @@ fun tokenize(file: String, source: String): List<BigtonToken> {
                 "fun"       -> BigtonTokenType.KEYWORD_FUN
                 "loop"      -> BigtonTokenType.KEYWORD_LOOP
                 "while"     -> BigtonTokenType.KEYWORD_WHILE
+                "for"       -> BigtonTokenType.KEYWORD_FOR
                 "tick"      -> BigtonTokenType.KEYWORD_TICK
                 "continue"  -> BigtonTokenType.KEYWORD_CONT
                 "break"     -> BigtonTokenType.KEYWORD_BREAK
@@ -0,0 +1,214 @@
+package schwalbe.ventura.bigton
+
+import java.io.ByteArrayOutputStream
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+// Encodes programs in the compact version 2 format described in
+// 'server/bigtonruntime/src/main/headers/bigton/ir.h'.
+// The runtime accepts both formats, with version 2 programs being decoded
+// into the version 1 format when loaded.
+
+private const val V2_VERSION: Byte = 2
+private const val V1_HEADER_SIZE: Int = 56
+
+private enum class ArgKind { NONE, VARINT, INT, FLOAT, IF }
+
+private val InstrType.argKind: ArgKind
+    get() = when (this) {
+        InstrType.DISCARD,
+        InstrType.LOAD_NULL,
+        InstrType.LOAD_ARRAY_ELEMENT,
+        InstrType.ADD,
+        InstrType.SUBTRACT,
+        InstrType.MULTIPLY,
+        InstrType.DIVIDE,
+        InstrType.REMAINDER,
+        InstrType.NEGATE,
+        InstrType.LESS_THAN,
+        InstrType.LESS_THAN_EQUAL,
+        InstrType.GREATER_THAN,
+        InstrType.GREATER_THAN_EQUAL,
+        InstrType.EQUAL,
+        InstrType.NOT_EQUAL,
+        InstrType.AND,
+        InstrType.OR,
+        InstrType.NOT,
+        InstrType.PUSH_LOCAL,
+        InstrType.STORE_ARRAY_ELEMENT,
+        InstrType.CONTINUE,
+        InstrType.BREAK,
+        InstrType.RETURN,
+        InstrType.ARRAY_PUSH,
+        InstrType.ARRAY_POP,
+        InstrType.ARRAY_LENGTH,
+        InstrType.ARRAY_INSERT,
+        InstrType.ARRAY_REMOVE,
+        InstrType.ARRAY_SUM,
+        InstrType.ARRAY_MIN,
+        InstrType.ARRAY_MAX,
+        InstrType.ARRAY_ARGMIN,
+        InstrType.ARRAY_SCALE,
+        InstrType.ARRAY_ADD,
+        InstrType.ARRAY_DOT,
+        InstrType.ARRAY_SORT,
+        InstrType.ARRAY_BINARY_SEARCH,
+        InstrType.ARRAY_INDEX_OF,
+        InstrType.ARRAY_CONTAINS,
+        InstrType.MAP_CREATE,
+        InstrType.MAP_GET,
+        InstrType.MAP_SET,
+        InstrType.MAP_HAS,
+        InstrType.MAP_KEYS,
+        InstrType.TUPLE_ADD,
+        InstrType.TUPLE_SUBTRACT,
+        InstrType.TUPLE_MULTIPLY,
+        InstrType.TUPLE_DIVIDE,
+        InstrType.MAP_SIZE,
+        InstrType.MAP_REMOVE -> ArgKind.NONE
+        InstrType.LOAD_INT -> ArgKind.INT
+        InstrType.LOAD_FLOAT -> ArgKind.FLOAT
+        InstrType.IF -> ArgKind.IF
+        else -> ArgKind.VARINT
+    }
+
+private fun ByteArrayOutputStream.putVarint(value: Long) {
+    var v: Long = value
+    while (true) {
+        val b: Int = (v and 0x7F).toInt()
+        v = v ushr 7
+        if (v == 0L) {
+            this.write(b)
+            return
+        }
+        this.write(b or 0x80)
+    }
+}
+
+private fun ByteArrayOutputStream.putVarint(value: Int)
+    = this.putVarint(value.toLong() and 0xFFFFFFFFL)
+
+private fun ByteArrayOutputStream.putZigzag(value: Long)
+    = this.putVarint((value shl 1) xor (value shr 63))
+
+private fun ByteArrayOutputStream.putFixed64(value: Long) {
+    for (i in 0..<8) {
+        this.write((value ushr (i * 8)).toInt() and 0xFF)
+    }
+}
+
+/**
+ * Mirror of 'bigtonHashProgram'
+ * defined in 'src/main/c/runtime/image.c'
+ */
+private fun hashProgram(bytes: ByteArray): Long {
+    var hash: Long = -3750763034362895579L // 14695981039346656037
+    for (b in bytes) {
+        hash = hash xor (b.toLong() and 0xFF)
+        hash *= 1099511628211L
+    }
+    return hash
+}
+
+/**
+ * Encodes a program in the version 1 format (as produced by
+ * [generateProgram]) using the version 2 format.
+ */
+fun encodeProgramV2(
+    v1: ByteArray, byteOrder: ByteOrder = ByteOrder.nativeOrder()
+): ByteArray {
+    val src: ByteBuffer = ByteBuffer.wrap(v1).order(byteOrder)
+    // --- bigton_program_t header ---
+    val numInstrs: Int = src.getInt(0)
+    val numStrings: Int = src.getInt(4)
+    val numShapes: Int = src.getInt(8)
+    val numFunctions: Int = src.getInt(12)
+    val numBuiltinFunctions: Int = src.getInt(16)
+    val numGlobalVars: Int = src.getInt(20)
+    val numShapeProps: Int = src.getInt(24)
+    val numConstStringChars: Long = src.getLong(32)
+    val unknownStrId: Int = src.getInt(40)
+    val globalStart: Int = src.getInt(44)
+    val globalLength: Int = src.getInt(48)
+    val instrArgsOffset: Int = V1_HEADER_SIZE
+    val constStringsOffset: Int = instrArgsOffset + numInstrs * 8
+    val shapesOffset: Int = constStringsOffset + numStrings * 16
+    val functionsOffset: Int = shapesOffset + numShapes * 8
+    val builtinsOffset: Int = functionsOffset + numFunctions * 20
+    val propsOffset: Int = builtinsOffset + numBuiltinFunctions * 8
+    val charsOffset: Int = propsOffset + numShapeProps * 4
+    val instrTypesOffset: Int = charsOffset + numConstStringChars.toInt() * 2
+    val sections: List<ByteArrayOutputStream>
+        = List(8) { ByteArrayOutputStream() }
+    val instrTypes: ByteArrayOutputStream = sections[0]
+    val instrArgs: ByteArrayOutputStream = sections[1]
+    for (i in 0..<numInstrs) {
+        val rawType: Byte = src.get(instrTypesOffset + i)
+        instrTypes.write(rawType.toInt())
+        val argOffset: Int = instrArgsOffset + i * 8
+        when (InstrType.entries[rawType.toInt()].argKind) {
+            ArgKind.NONE -> {}
+            ArgKind.VARINT -> instrArgs.putVarint(src.getInt(argOffset))
+            ArgKind.INT -> instrArgs.putZigzag(src.getLong(argOffset))
+            ArgKind.FLOAT -> instrArgs.putFixed64(src.getLong(argOffset))
+            ArgKind.IF -> {
+                instrArgs.putVarint(src.getInt(argOffset))
+                instrArgs.putVarint(src.getInt(argOffset + 4))
+            }
+        }
+    }
+    for (i in 0..<numStrings) {
+        // bigton_const_string_t - only charLength, offsets are implicit
+        sections[2].putVarint(src.getLong(constStringsOffset + i * 16 + 8))
+    }
+    for (i in 0..<numShapes) {
+        // bigton_shape_t - only propCount, offsets are implicit
+        sections[3].putVarint(src.getInt(shapesOffset + i * 8))
+    }
+    for (i in 0..<numFunctions) {
+        // bigton_function_t - name, declFile, declLine, start, length
+        for (m in 0..<5) {
+            sections[4].putVarint(src.getInt(functionsOffset + i * 20 + m * 4))
+        }
+    }
+    for (i in 0..<numBuiltinFunctions) {
+        // bigton_builtin_function_t - name, cost
+        sections[5].putVarint(src.getInt(builtinsOffset + i * 8))
+        sections[5].putVarint(src.getInt(builtinsOffset + i * 8 + 4))
+    }
+    for (i in 0..<numShapeProps) {
+        // bigton_shape_prop_t - name
+        sections[6].putVarint(src.getInt(propsOffset + i * 4))
+    }
+    for (i in 0..<numConstStringChars.toInt()) {
+        val c: Int = src.getShort(charsOffset + i * 2).toInt() and 0xFFFF
+        sections[7].putVarint(c)
+    }
+    val payload = ByteArrayOutputStream()
+    for (count in listOf(
+        numInstrs, numStrings, numShapes, numFunctions, numBuiltinFunctions,
+        numGlobalVars, numShapeProps
+    )) {
+        payload.putVarint(count)
+    }
+    payload.putVarint(numConstStringChars)
+    payload.putVarint(unknownStrId)
+    payload.putVarint(globalStart)
+    payload.putVarint(globalLength)
+    var sectionOffset: Long = 0
+    for (section in sections) {
+        payload.putVarint(sectionOffset)
+        sectionOffset += section.size()
+    }
+    for (section in sections) {
+        section.writeTo(payload)
+    }
+    val payloadBytes: ByteArray = payload.toByteArray()
+    val out = ByteArrayOutputStream()
+    out.write("BGTN".toByteArray(Charsets.US_ASCII))
+    out.write(V2_VERSION.toInt())
+    out.write(ByteArray(3))
+    out.putFixed64(hashProgram(payloadBytes))
+    out.write(payloadBytes)
+    return out.toByteArray()
+}
@@ -162,6 +162,8 @@ class PlayerRobot(
         when (this.status) {
             RobotStatus.RUNNING -> {
                 this.status = RobotStatus.PAUSED
+                // paused robots may stay paused for a long time
+                this.runtime?.hibernate()
             }
             RobotStatus.PAUSED, RobotStatus.STOPPED, RobotStatus.ERROR -> {}
         }
@@ -190,6 +192,11 @@ class PlayerRobot(
         this.logs.clear()
         this.stats = null
         this.compileTask = null
+        this.closeRuntime()
+    }
+
+    private fun closeRuntime() {
+        this.runtime?.close()
         this.runtime = null
     }
 
@@ -281,13 +288,15 @@ class PlayerRobot(
                     .order(ByteOrder.nativeOrder())
                     .put(compStatus.binary).flip()
                 val procStats = stats.processor.stats
-                this.runtime = BigtonRuntime(
-                    programBuffer,
-                    tickInstructionLimit = procStats.instructionLimit,
-                    memoryUsageLimit = stats.totalMemoryLimit,
-                    maxCallDepth = procStats.maxCallDepth,
-                    maxTupleSize = procStats.maxTupleSize
-                )
+                this.runtime = BigtonProgram(programBuffer).use { program ->
+                    BigtonRuntime(
+                        program,
+                        tickInstructionLimit = procStats.instructionLimit,
+                        memoryUsageLimit = stats.totalMemoryLimit,
+                        maxCallDepth = procStats.maxCallDepth,
+                        maxTupleSize = procStats.maxTupleSize
+                    )
+                }
             }
             is CompilationTask.Failed -> {
                 val src: BigtonSource = compStatus.error.source
@@ -312,7 +321,7 @@ class PlayerRobot(
         when (this.status) {
             RobotStatus.ERROR, RobotStatus.STOPPED -> {
                 this.compileTask = null
-                this.runtime = null
+                this.closeRuntime()
                 return
             }
             else -> {}